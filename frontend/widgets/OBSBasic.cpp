@@ -1565,6 +1565,9 @@ bool OBSBasic::ResetAudio()
 		ai.fixed_buffering = true;
 	}
 
+	obs_set_adaptive_audio_buffering(
+		config_get_bool(App()->GetUserConfig(), "Audio", "AdaptiveAudioBuffering"));
+
 	return obs_reset_audio2(&ai);
 }
 
@@ -80,6 +80,7 @@ OBSBasicStats::OBSBasicStats(QWidget *parent, bool closable)
 	hddSpace = new QLabel(this);
 	recordTimeLeft = new QLabel(this);
 	memUsage = new QLabel(this);
+	audioBuffering = new QLabel(this);
 
 	QString str = MakeTimeLeftText(99999, 59);
 	int textWidth = recordTimeLeft->fontMetrics().boundingRect(str).width();
@@ -89,6 +90,7 @@ OBSBasicStats::OBSBasicStats(QWidget *parent, bool closable)
 	newStat("HDDSpaceAvailable", hddSpace, 0);
 	newStat("DiskFullIn", recordTimeLeft, 0);
 	newStat("MemoryUsage", memUsage, 0);
+	newStat("AudioBuffering", audioBuffering, 0);
 
 	fps = new QLabel(this);
 	renderTime = new QLabel(this);
@@ -339,6 +341,27 @@ void OBSBasicStats::Update()
 
 	/* ------------------ */
 
+	struct obs_audio_buffering_stats buffering = {};
+	if (obs_get_audio_buffering_stats(&buffering)) {
+		str = QTStr("Basic.Stats.AudioBuffering.Value")
+			      .arg(QString::number(buffering.buffering_ms), QString::number(buffering.peak_buffering_ms));
+		audioBuffering->setText(str);
+
+		/* with fixed buffering it always sits at the maximum, which is
+		 * only a problem once it has grown past what is configured */
+		uint32_t growth = buffering.max_buffering_ms - buffering.min_buffering_ms;
+		bool grown = buffering.buffering_ms > buffering.min_buffering_ms;
+
+		if (grown && buffering.buffering_ms >= buffering.max_buffering_ms)
+			setClasses(audioBuffering, "text-danger");
+		else if (grown && buffering.buffering_ms > buffering.min_buffering_ms + growth / 2)
+			setClasses(audioBuffering, "text-warning");
+		else
+			setClasses(audioBuffering, "");
+	}
+
+	/* ------------------ */
+
 	num = (long double)obs_get_average_frame_time_ns() / 1000000.0l;
 
 	str = QString::number(num, 'f', 1) + QStringLiteral(" ms");
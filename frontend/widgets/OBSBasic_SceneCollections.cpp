@@ -22,6 +22,7 @@
 #include <utility/item-widget-helpers.hpp>
 
 #include <qt-wrappers.hpp>
+#include <util/crc32.h>
 
 #include <QDir>
 
@@ -77,6 +78,77 @@ void cleanBackupCollision(const OBSSceneCollection &collection)
 		}
 	}
 }
+
+std::filesystem::path getBinaryCollectionFile(const std::filesystem::path &collectionFile)
+{
+	std::filesystem::path binaryFilePath = collectionFile;
+	binaryFilePath.replace_extension(".obsdata");
+
+	return binaryFilePath;
+}
+
+/* The binary snapshot wraps the collection data together with the size and
+ * checksum of the Json text saved alongside it.  It is only used while the
+ * Json file still holds exactly that text, so any edit made to the Json file
+ * by hand or by other tools takes precedence. */
+constexpr long long binaryCollectionVersion = 1;
+
+/* Called right after the Json file was saved, so the text it holds is still
+ * cached in saveData and doesn't have to be serialized again */
+void saveBinaryCollectionData(obs_data_t *saveData, const char *file)
+{
+	const std::filesystem::path binaryFile = getBinaryCollectionFile(std::filesystem::u8path(file));
+	const char *json = obs_data_get_last_json(saveData);
+	size_t jsonSize = json ? strlen(json) : 0;
+
+	OBSDataAutoRelease snapshot = obs_data_create();
+	obs_data_set_int(snapshot, "format_version", binaryCollectionVersion);
+	obs_data_set_int(snapshot, "json_size", (long long)jsonSize);
+	obs_data_set_int(snapshot, "json_crc32", calc_crc32(0, json, jsonSize));
+	obs_data_set_obj(snapshot, "data", saveData);
+
+	if (!obs_data_save_binary_safe(snapshot, binaryFile.u8string().c_str(), "tmp", nullptr)) {
+		blog(LOG_WARNING, "Could not save binary scene data to %s", binaryFile.u8string().c_str());
+	}
+}
+
+obs_data_t *loadBinaryCollectionData(const char *file)
+{
+	const std::filesystem::path binaryFile = getBinaryCollectionFile(std::filesystem::u8path(file));
+
+	if (!std::filesystem::exists(binaryFile)) {
+		return nullptr;
+	}
+
+	OBSDataAutoRelease snapshot = obs_data_create_from_binary_file(binaryFile.u8string().c_str());
+	if (!snapshot || obs_data_get_int(snapshot, "format_version") != binaryCollectionVersion) {
+		blog(LOG_WARNING, "Failed to load binary scene collection '%s', falling back to Json",
+		     binaryFile.u8string().c_str());
+		return nullptr;
+	}
+
+	BPtr<char> json = os_quick_read_utf8_file(file);
+	size_t jsonSize = json ? strlen(json) : 0;
+
+	if (!json || (long long)jsonSize != obs_data_get_int(snapshot, "json_size") ||
+	    (long long)calc_crc32(0, json, jsonSize) != obs_data_get_int(snapshot, "json_crc32")) {
+		blog(LOG_INFO, "Scene collection '%s' was changed after its binary snapshot was saved, loading Json",
+		     file);
+		return nullptr;
+	}
+
+	return obs_data_get_obj(snapshot, "data");
+}
+
+obs_data_t *loadCollectionData(const char *file)
+{
+	obs_data_t *data = loadBinaryCollectionData(file);
+	if (data) {
+		return data;
+	}
+
+	return obs_data_create_from_json_file_safe(file, "bak");
+}
 } // namespace
 
 // MARK: - Main Scene Collection Management Functions
@@ -219,6 +291,7 @@ void OBSBasic::RemoveSceneCollection(OBSSceneCollection collection)
 {
 	try {
 		std::filesystem::remove(collection.collectionFile);
+		std::filesystem::remove(getBinaryCollectionFile(collection.collectionFile));
 	} catch (const std::filesystem::filesystem_error &error) {
 		blog(LOG_DEBUG, "%s", error.what());
 		throw std::logic_error("Failed to remove scene collection file: " + collection.fileName);
@@ -878,8 +951,11 @@ void OBSBasic::Save(const char *file)
 		obs_data_set_obj(saveData, "migration_resolution", res);
 	}
 
-	if (!obs_data_save_json_pretty_safe(saveData, file, "tmp", "bak"))
+	if (!obs_data_save_json_pretty_safe(saveData, file, "tmp", "bak")) {
 		blog(LOG_ERROR, "Could not save scene data to %s", file);
+	} else {
+		saveBinaryCollectionData(saveData, file);
+	}
 }
 
 void OBSBasic::DeferSaveBegin()
@@ -1032,7 +1108,7 @@ void OBSBasic::Load(const char *file, bool remigrate)
 	lastOutputResolution.reset();
 	migrationBaseResolution.reset();
 
-	obs_data_t *data = obs_data_create_from_json_file_safe(file, "bak");
+	obs_data_t *data = loadCollectionData(file);
 	if (!data) {
 		disableSaving--;
 		const auto path = filesystem::u8path(file);
@@ -0,0 +1,307 @@
+/******************************************************************************
+    Copyright (C) 2023 by Lain Bailey <lain@obsproject.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include <inttypes.h>
+#include <stdio.h>
+
+#include <util/dstr.h>
+#include <util/platform.h>
+#include "gl-subsystem.h"
+
+/*
+ * On-disk cache of linked program binaries.
+ *
+ * Each linked program is saved as <key>.glprog, where the key hashes the
+ * GLSL of both shaders together with the driver's vendor, renderer and
+ * version strings, so a driver update never sees binaries of another.  The
+ * file holds the binary format, the binary and a checksum of both.
+ *
+ * For every shader that compiled once on this driver an empty <key>.glsl
+ * file is left.  Those shaders aren't compiled when they're created, only
+ * if no binary of a program using them loads.  If the driver rejects a
+ * binary, the file is removed and the program is compiled and linked the
+ * usual way.
+ */
+
+/* increment if the file format changes */
+#define CACHE_VERSION 1
+
+static uint64_t fnv1a_hash(uint64_t hash, const void *data, size_t len)
+{
+	const uint64_t FNV_PRIME = 1099511628211ULL;
+	const uint8_t *bytes = data;
+
+	for (size_t i = 0; i < len; i++) {
+		hash ^= (uint64_t)bytes[i];
+		hash *= FNV_PRIME;
+	}
+	return hash;
+}
+
+static const uint64_t FNV_OFFSET = 14695981039346656037ULL;
+
+uint64_t gl_shader_hash(const char *str, size_t len)
+{
+	return fnv1a_hash(FNV_OFFSET, str, len);
+}
+
+static inline uint64_t driver_key(const struct gs_device *device, uint64_t hash)
+{
+	uint32_t version = CACHE_VERSION;
+
+	hash = fnv1a_hash(hash, &device->driver_hash, sizeof(device->driver_hash));
+	return fnv1a_hash(hash, &version, sizeof(version));
+}
+
+static void get_path(struct dstr *path, const struct gs_device *device, uint64_t key, const char *ext)
+{
+	dstr_printf(path, "%s/%016" PRIx64 ".%s", device->program_cache_path, key, ext);
+}
+
+static inline const char *gl_string(GLenum name)
+{
+	const char *str = (const char *)glGetString(name);
+	return str ? str : "";
+}
+
+void gl_program_cache_init(struct gs_device *device)
+{
+	GLint num_formats = 0;
+	uint64_t hash = FNV_OFFSET;
+	char *path;
+
+	if (!GLAD_GL_VERSION_4_1 && !GLAD_GL_ARB_get_program_binary)
+		return;
+
+	glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &num_formats);
+	if (!gl_success("glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS)") || num_formats <= 0) {
+		blog(LOG_INFO, "OpenGL program binaries not supported, "
+			       "shaders will not be cached");
+		return;
+	}
+
+	/* the program data path isn't writable on every platform, so this
+	 * goes in the user's config directory */
+	path = os_get_config_path_ptr("obs-studio/shader-cache/opengl");
+	if (!path || os_mkdirs(path) == MKDIR_ERROR) {
+		blog(LOG_WARNING, "Failed to create shader cache directory, "
+				  "cache will not be available.");
+		bfree(path);
+		return;
+	}
+
+	const char *strings[] = {gl_string(GL_VENDOR), gl_string(GL_RENDERER), gl_string(GL_VERSION),
+				 gl_string(GL_SHADING_LANGUAGE_VERSION)};
+	for (size_t i = 0; i < sizeof(strings) / sizeof(strings[0]); i++)
+		hash = fnv1a_hash(hash, strings[i], strlen(strings[i]) + 1);
+
+	device->program_cache_path = path;
+	device->driver_hash = hash;
+}
+
+void gl_program_cache_free(struct gs_device *device)
+{
+	const struct gl_shader_stats *stats = &device->shader_stats;
+
+	if (stats->compiled || stats->linked || stats->loaded || stats->rejected) {
+		blog(LOG_INFO,
+		     "OpenGL shaders: %" PRIu32 " compiled in %.1f ms, "
+		     "%" PRIu32 " programs linked in %.1f ms, "
+		     "%" PRIu32 " loaded from cache in %.1f ms, "
+		     "%" PRIu32 " rejected by the driver",
+		     stats->compiled, (double)stats->compile_ns / 1000000.0, stats->linked,
+		     (double)stats->link_ns / 1000000.0, stats->loaded, (double)stats->load_ns / 1000000.0,
+		     stats->rejected);
+	}
+
+	bfree(device->program_cache_path);
+	device->program_cache_path = NULL;
+}
+
+bool gl_shader_cache_contains(struct gs_device *device, uint64_t shader_hash)
+{
+	struct dstr path = {0};
+	bool exists;
+
+	if (!device->program_cache_path)
+		return false;
+
+	get_path(&path, device, driver_key(device, shader_hash), "glsl");
+	exists = os_file_exists(path.array);
+	dstr_free(&path);
+	return exists;
+}
+
+void gl_shader_cache_add(struct gs_device *device, uint64_t shader_hash)
+{
+	struct dstr path = {0};
+	FILE *file;
+
+	if (!device->program_cache_path)
+		return;
+
+	get_path(&path, device, driver_key(device, shader_hash), "glsl");
+	file = os_fopen(path.array, "wb");
+	if (file)
+		fclose(file);
+	dstr_free(&path);
+}
+
+static uint64_t program_key(const struct gs_program *program)
+{
+	uint64_t hash = FNV_OFFSET;
+
+	hash = fnv1a_hash(hash, &program->vertex_shader->hash, sizeof(uint64_t));
+	hash = fnv1a_hash(hash, &program->pixel_shader->hash, sizeof(uint64_t));
+	return driver_key(program->device, hash);
+}
+
+static bool read_program_file(const char *path, GLenum *format, uint8_t **binary, size_t *size)
+{
+	uint32_t file_format;
+	uint64_t checksum;
+	int64_t file_size;
+	uint8_t *data = NULL;
+	FILE *file;
+	bool success = false;
+
+	file = os_fopen(path, "rb");
+	if (!file)
+		return false;
+
+	file_size = os_fgetsize(file);
+	if (file_size <= (int64_t)(sizeof(file_format) + sizeof(checksum)))
+		goto fail;
+
+	*size = (size_t)file_size - sizeof(file_format) - sizeof(checksum);
+	data = bmalloc(*size);
+
+	if (fread(&file_format, 1, sizeof(file_format), file) != sizeof(file_format) ||
+	    fread(data, 1, *size, file) != *size || fread(&checksum, 1, sizeof(checksum), file) != sizeof(checksum))
+		goto fail;
+
+	if (checksum != fnv1a_hash(fnv1a_hash(FNV_OFFSET, &file_format, sizeof(file_format)), data, *size))
+		goto fail;
+
+	*format = (GLenum)file_format;
+	*binary = data;
+	data = NULL;
+	success = true;
+
+fail:
+	bfree(data);
+	fclose(file);
+	return success;
+}
+
+bool gl_program_cache_load(struct gs_program *program)
+{
+	struct gs_device *device = program->device;
+	uint64_t start = os_gettime_ns();
+	struct dstr path = {0};
+	uint8_t *binary = NULL;
+	GLint linked = GL_FALSE;
+	GLenum format;
+	size_t size;
+
+	if (!device->program_cache_path)
+		return false;
+
+	get_path(&path, device, program_key(program), "glprog");
+
+	if (!read_program_file(path.array, &format, &binary, &size)) {
+		if (os_file_exists(path.array)) {
+			blog(LOG_WARNING, "Loading program cache file failed: %s", path.array);
+			os_unlink(path.array);
+		}
+		goto finish;
+	}
+
+	glProgramBinary(program->obj, format, binary, (GLsizei)size);
+	if (gl_success("glProgramBinary")) {
+		glGetProgramiv(program->obj, GL_LINK_STATUS, &linked);
+		gl_success("glGetProgramiv");
+	}
+
+	if (linked == GL_FALSE) {
+		blog(LOG_DEBUG, "Driver rejected program cache file: %s", path.array);
+		device->shader_stats.rejected++;
+		os_unlink(path.array);
+	} else {
+		device->shader_stats.loaded++;
+		device->shader_stats.load_ns += os_gettime_ns() - start;
+	}
+
+finish:
+	bfree(binary);
+	dstr_free(&path);
+	return linked != GL_FALSE;
+}
+
+void gl_program_cache_save(struct gs_program *program)
+{
+	struct gs_device *device = program->device;
+	struct dstr path = {0};
+	struct dstr temp_path = {0};
+	uint8_t *binary = NULL;
+	GLint length = 0;
+	GLsizei written = 0;
+	GLenum format = 0;
+	uint32_t file_format;
+	uint64_t checksum;
+	FILE *file;
+	bool success;
+
+	if (!device->program_cache_path)
+		return;
+
+	glGetProgramiv(program->obj, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (!gl_success("glGetProgramiv(GL_PROGRAM_BINARY_LENGTH)") || length <= 0)
+		return;
+
+	binary = bmalloc((size_t)length);
+	glGetProgramBinary(program->obj, length, &written, &format, binary);
+	if (!gl_success("glGetProgramBinary") || written <= 0)
+		goto finish;
+
+	file_format = (uint32_t)format;
+	checksum = fnv1a_hash(fnv1a_hash(FNV_OFFSET, &file_format, sizeof(file_format)), binary, (size_t)written);
+
+	/* written next to it and moved into place, so a crash never leaves a
+	 * truncated file behind under the real name */
+	get_path(&path, device, program_key(program), "glprog");
+	dstr_printf(&temp_path, "%s.tmp", path.array);
+
+	file = os_fopen(temp_path.array, "wb");
+	if (!file)
+		goto finish;
+
+	success = fwrite(&file_format, 1, sizeof(file_format), file) == sizeof(file_format) &&
+		  fwrite(binary, 1, (size_t)written, file) == (size_t)written &&
+		  fwrite(&checksum, 1, sizeof(checksum), file) == sizeof(checksum);
+	success = fclose(file) == 0 && success;
+
+	if (!success || os_rename(temp_path.array, path.array) != 0) {
+		blog(LOG_WARNING, "Writing program cache file failed: %s", path.array);
+		os_unlink(temp_path.array);
+	}
+
+finish:
+	bfree(binary);
+	dstr_free(&path);
+	dstr_free(&temp_path);
+}
@@ -22,6 +22,8 @@
 #include <graphics/vec4.h>
 #include <graphics/matrix3.h>
 #include <graphics/matrix4.h>
+#include <util/platform.h>
+#include <util/profiler.h>
 #include "gl-subsystem.h"
 #include "gl-shaderparser.h"
 
@@ -174,10 +176,12 @@ static inline bool gl_process_attribs(struct gs_shader *shader, struct gl_shader
 	return true;
 }
 
-static bool gl_shader_init(struct gs_shader *shader, struct gl_shader_parser *glsp, const char *file,
-			   char **error_string)
+static const char *compile_shader_name = "gl_compile_shader";
+
+static bool gl_shader_compile(struct gs_shader *shader, const char *source, const char *file, char **error_string)
 {
 	GLenum type = convert_shader_type(shader->type);
+	uint64_t start = os_gettime_ns();
 	int compiled = 0;
 	bool success = true;
 
@@ -185,11 +189,13 @@ static bool gl_shader_init(struct gs_shader *shader, struct gl_shader_parser *gl
 	if (!gl_success("glCreateShader") || !shader->obj)
 		return false;
 
-	glShaderSource(shader->obj, 1, (const GLchar **)&glsp->gl_string.array, 0);
+	glShaderSource(shader->obj, 1, (const GLchar **)&source, 0);
 	if (!gl_success("glShaderSource"))
 		return false;
 
+	profile_start(compile_shader_name);
 	glCompileShader(shader->obj);
+	profile_end(compile_shader_name);
 	if (!gl_success("glCompileShader"))
 		return false;
 
@@ -197,7 +203,7 @@ static bool gl_shader_init(struct gs_shader *shader, struct gl_shader_parser *gl
 	blog(LOG_DEBUG, "+++++++++++++++++++++++++++++++++++");
 	blog(LOG_DEBUG, "  GL shader string for: %s", file);
 	blog(LOG_DEBUG, "-----------------------------------");
-	blog(LOG_DEBUG, "%s", glsp->gl_string.array);
+	blog(LOG_DEBUG, "%s", source);
 	blog(LOG_DEBUG, "+++++++++++++++++++++++++++++++++++");
 #endif
 
@@ -224,6 +230,50 @@ static bool gl_shader_init(struct gs_shader *shader, struct gl_shader_parser *gl
 
 	gl_get_shader_info(shader->obj, file, error_string);
 
+	shader->device->shader_stats.compiled++;
+	shader->device->shader_stats.compile_ns += os_gettime_ns() - start;
+
+	if (success)
+		gl_shader_cache_add(shader->device, shader->hash);
+
+	return success;
+}
+
+/* compiles a shader that was created without compiling it */
+static bool gl_shader_compile_deferred(struct gs_shader *shader)
+{
+	bool success;
+
+	if (!shader->deferred_source)
+		return true;
+
+	success = gl_shader_compile(shader, shader->deferred_source, shader->deferred_file, NULL);
+	if (!success)
+		blog(LOG_ERROR, "Deferred compile of shader '%s' failed", shader->deferred_file);
+
+	bfree(shader->deferred_source);
+	bfree(shader->deferred_file);
+	shader->deferred_source = NULL;
+	shader->deferred_file = NULL;
+	return success;
+}
+
+static bool gl_shader_init(struct gs_shader *shader, struct gl_shader_parser *glsp, const char *file,
+			   char **error_string)
+{
+	bool success = true;
+
+	shader->hash = gl_shader_hash(glsp->gl_string.array, glsp->gl_string.len);
+
+	/* programs with shaders that compiled before likely load from the
+	 * program cache, so those are only compiled if that fails */
+	if (gl_shader_cache_contains(shader->device, shader->hash)) {
+		shader->deferred_source = bstrdup(glsp->gl_string.array);
+		shader->deferred_file = bstrdup(file ? file : "(unknown)");
+	} else {
+		success = gl_shader_compile(shader, glsp->gl_string.array, file, error_string);
+	}
+
 	if (success)
 		success = gl_add_params(shader, glsp);
 	/* Only vertex shaders actually require input attributes */
@@ -322,6 +372,9 @@ void gs_shader_destroy(gs_shader_t *shader)
 		gl_success("glDeleteShader");
 	}
 
+	bfree(shader->deferred_source);
+	bfree(shader->deferred_file);
+
 	da_free(shader->samplers);
 	da_free(shader->params);
 	da_free(shader->attribs);
@@ -598,28 +651,36 @@ static inline bool assign_program_params(struct gs_program *program)
 	return true;
 }
 
-struct gs_program *gs_program_create(struct gs_device *device)
+static const char *link_program_name = "gl_link_program";
+
+static bool link_program(struct gs_program *program)
 {
-	struct gs_program *program = bzalloc(sizeof(*program));
+	struct gs_device *device = program->device;
+	uint64_t start;
 	int linked = false;
 
-	program->device = device;
-	program->vertex_shader = device->cur_vertex_shader;
-	program->pixel_shader = device->cur_pixel_shader;
-
-	program->obj = glCreateProgram();
-	if (!gl_success("glCreateProgram"))
-		goto error_detach_neither;
+	if (!gl_shader_compile_deferred(program->vertex_shader))
+		return false;
+	if (!gl_shader_compile_deferred(program->pixel_shader))
+		return false;
 
 	glAttachShader(program->obj, program->vertex_shader->obj);
 	if (!gl_success("glAttachShader (vertex)"))
-		goto error_detach_neither;
+		return false;
 
 	glAttachShader(program->obj, program->pixel_shader->obj);
 	if (!gl_success("glAttachShader (pixel)"))
 		goto error_detach_vertex;
 
+	if (device->program_cache_path) {
+		glProgramParameteri(program->obj, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+		gl_success("glProgramParameteri");
+	}
+
+	start = os_gettime_ns();
+	profile_start(link_program_name);
 	glLinkProgram(program->obj);
+	profile_end(link_program_name);
 	if (!gl_success("glLinkProgram"))
 		goto error;
 
@@ -627,29 +688,22 @@ struct gs_program *gs_program_create(struct gs_device *device)
 	if (!gl_success("glGetProgramiv"))
 		goto error;
 
+	device->shader_stats.linked++;
+	device->shader_stats.link_ns += os_gettime_ns() - start;
+
 	if (linked == GL_FALSE) {
 		print_link_errors(program->obj);
 		goto error;
 	}
 
-	if (!assign_program_attribs(program))
-		goto error;
-	if (!assign_program_params(program))
-		goto error;
-
 	glDetachShader(program->obj, program->vertex_shader->obj);
 	gl_success("glDetachShader (vertex)");
 
 	glDetachShader(program->obj, program->pixel_shader->obj);
 	gl_success("glDetachShader (pixel)");
 
-	program->next = device->first_program;
-	program->prev_next = &device->first_program;
-	device->first_program = program;
-	if (program->next)
-		program->next->prev_next = &program->next;
-
-	return program;
+	gl_program_cache_save(program);
+	return true;
 
 error:
 	glDetachShader(program->obj, program->pixel_shader->obj);
@@ -658,8 +712,38 @@ error:
 error_detach_vertex:
 	glDetachShader(program->obj, program->vertex_shader->obj);
 	gl_success("glDetachShader (vertex)");
+	return false;
+}
+
+struct gs_program *gs_program_create(struct gs_device *device)
+{
+	struct gs_program *program = bzalloc(sizeof(*program));
+
+	program->device = device;
+	program->vertex_shader = device->cur_vertex_shader;
+	program->pixel_shader = device->cur_pixel_shader;
+
+	program->obj = glCreateProgram();
+	if (!gl_success("glCreateProgram"))
+		goto error;
 
-error_detach_neither:
+	if (!gl_program_cache_load(program) && !link_program(program))
+		goto error;
+
+	if (!assign_program_attribs(program))
+		goto error;
+	if (!assign_program_params(program))
+		goto error;
+
+	program->next = device->first_program;
+	program->prev_next = &device->first_program;
+	device->first_program = program;
+	if (program->next)
+		program->next->prev_next = &program->next;
+
+	return program;
+
+error:
 	gs_program_destroy(program);
 	return NULL;
 }
@@ -471,6 +471,12 @@ struct gs_shader {
 	gs_device_t *device;
 	enum gs_shader_type type;
 	GLuint obj;
+	uint64_t hash;
+
+	/* kept until compiled, for shaders that compiled before and whose
+	 * programs are likely in the program cache */
+	char *deferred_source;
+	char *deferred_file;
 
 	struct gs_shader_param *viewproj;
 	struct gs_shader_param *world;
@@ -502,6 +508,24 @@ extern struct gs_program *gs_program_create(struct gs_device *device);
 extern void gs_program_destroy(struct gs_program *program);
 extern void program_update_params(struct gs_program *shader);
 
+struct gl_shader_stats {
+	uint32_t compiled;
+	uint32_t linked;
+	uint32_t loaded;
+	uint32_t rejected;
+	uint64_t compile_ns;
+	uint64_t link_ns;
+	uint64_t load_ns;
+};
+
+extern uint64_t gl_shader_hash(const char *str, size_t len);
+extern void gl_program_cache_init(struct gs_device *device);
+extern void gl_program_cache_free(struct gs_device *device);
+extern bool gl_shader_cache_contains(struct gs_device *device, uint64_t shader_hash);
+extern void gl_shader_cache_add(struct gs_device *device, uint64_t shader_hash);
+extern bool gl_program_cache_load(struct gs_program *program);
+extern void gl_program_cache_save(struct gs_program *program);
+
 struct gs_vertex_buffer {
 	GLuint vao;
 	GLuint vertex_buffer;
@@ -646,6 +670,10 @@ struct gs_device {
 
 	struct gs_program *first_program;
 
+	char *program_cache_path;
+	uint64_t driver_hash;
+	struct gl_shader_stats shader_stats;
+
 	enum gs_cull_mode cur_cull_mode;
 	struct gs_rect cur_viewport;
 
@@ -16,22 +16,270 @@
 
 #include "../util/darray.h"
 #include "../util/threading.h"
+#include "../util/platform.h"
 
 #include "decl.h"
 #include "signal.h"
 
+/*
+ * Callbacks are kept in arrays that are never changed once they've been
+ * published, so emitting a signal only has to register itself as a reader,
+ * read the current array and call through it, without taking any lock.
+ *
+ * Connecting or disconnecting builds a new array under the set's mutex,
+ * swaps it in, then waits until every emission that could still be reading
+ * the old array has finished before freeing it (and any callback it removed).
+ * Readers are counted in one of two counters picked by the epoch, so that a
+ * writer can steer new emissions to the other counter and isn't starved by a
+ * signal that's emitted constantly.
+ *
+ * When the writer is itself being called from an emission of the same set,
+ * it can't wait for that emission to finish, so the old array is kept on the
+ * retired list and freed by a later writer.
+ */
+
 struct signal_callback {
 	signal_callback_t callback;
+	global_signal_callback_t global_callback;
 	void *data;
-	bool remove;
+	volatile bool remove;
 	bool keep_ref;
 };
 
+struct callback_list {
+	size_t num;
+	struct signal_callback **array;
+};
+
+typedef DARRAY(void *) callback_garbage_t;
+
+struct callback_set {
+	struct callback_list *volatile list;
+	volatile long readers[2];
+	volatile long epoch;
+
+	pthread_mutex_t mutex;
+	callback_garbage_t retired;
+};
+
+struct signal_emission {
+	struct callback_set *set;
+	long reader_idx;
+	struct signal_callback *current;
+	bool purge;
+
+	struct signal_emission *prev;
+};
+
+static THREAD_LOCAL struct signal_emission *current_emission = NULL;
+
+static struct callback_list *callback_list_create(size_t num)
+{
+	struct callback_list *list = bmalloc(sizeof(struct callback_list) + num * sizeof(struct signal_callback *));
+	list->num = num;
+	list->array = (struct signal_callback **)(list + 1);
+	return list;
+}
+
+static bool callback_set_init(struct callback_set *set)
+{
+	memset(set, 0, sizeof(struct callback_set));
+	set->list = callback_list_create(0);
+
+	if (pthread_mutex_init(&set->mutex, NULL) != 0) {
+		bfree(set->list);
+		return false;
+	}
+
+	return true;
+}
+
+static void callback_set_free(struct callback_set *set)
+{
+	struct callback_list *list = set->list;
+
+	for (size_t i = 0; i < list->num; i++)
+		bfree(list->array[i]);
+	for (size_t i = 0; i < set->retired.num; i++)
+		bfree(set->retired.array[i]);
+
+	bfree(list);
+	da_free(set->retired);
+	pthread_mutex_destroy(&set->mutex);
+}
+
+static inline struct callback_list *callback_set_enter(struct callback_set *set, struct signal_emission *em)
+{
+	em->set = set;
+	em->reader_idx = os_atomic_load_long(&set->epoch) & 1;
+	em->current = NULL;
+	em->purge = false;
+	em->prev = current_emission;
+
+	/* has to be counted before the list is read, see
+	 * callback_set_synchronize */
+	os_atomic_inc_long(&set->readers[em->reader_idx]);
+	current_emission = em;
+
+	return os_atomic_load_ptr((void *const volatile *)&set->list);
+}
+
+static inline void callback_set_leave(struct callback_set *set, struct signal_emission *em)
+{
+	current_emission = em->prev;
+	os_atomic_dec_long(&set->readers[em->reader_idx]);
+}
+
+static inline void callback_set_wait_readers(struct callback_set *set, long idx)
+{
+	int spins = 0;
+
+	while (os_atomic_load_long(&set->readers[idx]) > 0) {
+		os_sleep_ms(spins < 100 ? 0 : 1);
+		spins++;
+	}
+}
+
+/* Waits until no emission can still be using a list that was replaced before
+ * the call.  Returns false without waiting if this thread is emitting from
+ * the set itself. */
+static bool callback_set_synchronize(struct callback_set *set)
+{
+	for (struct signal_emission *em = current_emission; em; em = em->prev) {
+		if (em->set == set)
+			return false;
+	}
+
+	/* both counters have to be seen at zero after the new list was
+	 * published.  flipping the epoch first sends new emissions to the
+	 * other counter, so the one being waited on can only go down. */
+	long idx = (os_atomic_inc_long(&set->epoch) - 1) & 1;
+	callback_set_wait_readers(set, idx);
+	os_atomic_inc_long(&set->epoch);
+	callback_set_wait_readers(set, idx ^ 1);
+	return true;
+}
+
+/* Publishes a new list.  Called with the set's mutex held, the old list and
+ * everything that was retired before it are moved to garbage. */
+static void callback_set_publish(struct callback_set *set, struct callback_list *list, callback_garbage_t *garbage)
+{
+	struct callback_list *old = os_atomic_exchange_ptr((void *volatile *)&set->list, list);
+
+	da_push_back_da(*garbage, set->retired);
+	da_push_back(*garbage, &old);
+	da_resize(set->retired, 0);
+}
+
+/* Called after the set's mutex is released. */
+static void callback_set_free_garbage(struct callback_set *set, callback_garbage_t *garbage)
+{
+	if (!garbage->num)
+		return;
+
+	if (callback_set_synchronize(set)) {
+		for (size_t i = 0; i < garbage->num; i++)
+			bfree(garbage->array[i]);
+	} else {
+		pthread_mutex_lock(&set->mutex);
+		da_push_back_da(set->retired, *garbage);
+		pthread_mutex_unlock(&set->mutex);
+	}
+
+	da_free(*garbage);
+}
+
+static void callback_set_add(struct callback_set *set, const struct signal_callback *cb_data, bool unique)
+{
+	callback_garbage_t garbage = {0};
+
+	pthread_mutex_lock(&set->mutex);
+
+	struct callback_list *old = set->list;
+
+	if (unique) {
+		for (size_t i = 0; i < old->num; i++) {
+			struct signal_callback *cb = old->array[i];
+
+			if (cb->callback == cb_data->callback && cb->global_callback == cb_data->global_callback &&
+			    cb->data == cb_data->data && !cb->remove) {
+				pthread_mutex_unlock(&set->mutex);
+				return;
+			}
+		}
+	}
+
+	struct callback_list *list = callback_list_create(old->num + 1);
+	struct signal_callback *cb = bmalloc(sizeof(struct signal_callback));
+
+	*cb = *cb_data;
+	memcpy(list->array, old->array, old->num * sizeof(struct signal_callback *));
+	list->array[old->num] = cb;
+
+	callback_set_publish(set, list, &garbage);
+
+	pthread_mutex_unlock(&set->mutex);
+
+	callback_set_free_garbage(set, &garbage);
+}
+
+/* Removes the first callback matching callback/global_callback/data that
+ * isn't already marked for removal, or all callbacks marked for removal (by
+ * signal_handler_remove_current) if match is NULL.  Returns the number of
+ * removed callbacks that held a reference to the handler. */
+static long callback_set_remove(struct callback_set *set, const struct signal_callback *match)
+{
+	callback_garbage_t garbage = {0};
+	long removed_refs = 0;
+	bool found = false;
+
+	pthread_mutex_lock(&set->mutex);
+
+	struct callback_list *old = set->list;
+	struct callback_list *list = callback_list_create(old->num);
+	list->num = 0;
+
+	for (size_t i = 0; i < old->num; i++) {
+		struct signal_callback *cb = old->array[i];
+		bool remove;
+
+		if (match) {
+			remove = !found && cb->callback == match->callback &&
+				 cb->global_callback == match->global_callback && cb->data == match->data &&
+				 !os_atomic_load_bool(&cb->remove);
+		} else {
+			remove = os_atomic_load_bool(&cb->remove);
+		}
+
+		if (remove) {
+			/* emissions still reading the old list skip it */
+			os_atomic_set_bool(&cb->remove, true);
+			if (cb->keep_ref)
+				removed_refs++;
+
+			da_push_back(garbage, &cb);
+			found = true;
+		} else {
+			list->array[list->num++] = cb;
+		}
+	}
+
+	if (found)
+		callback_set_publish(set, list, &garbage);
+	else
+		bfree(list);
+
+	pthread_mutex_unlock(&set->mutex);
+
+	callback_set_free_garbage(set, &garbage);
+	return removed_refs;
+}
+
+/* ------------------------------------------------------------------------- */
+
 struct signal_info {
 	struct decl_info func;
-	DARRAY(struct signal_callback) callbacks;
-	pthread_mutex_t mutex;
-	bool signalling;
+	struct callback_set callbacks;
 
 	struct signal_info *next;
 };
@@ -41,10 +289,8 @@ static inline struct signal_info *signal_info_create(struct decl_info *info)
 	struct signal_info *si = bmalloc(sizeof(struct signal_info));
 	si->func = *info;
 	si->next = NULL;
-	si->signalling = false;
-	da_init(si->callbacks);
 
-	if (pthread_mutex_init_recursive(&si->mutex) != 0) {
+	if (!callback_set_init(&si->callbacks)) {
 		blog(LOG_ERROR, "Could not create signal");
 
 		decl_info_free(&si->func);
@@ -58,39 +304,18 @@ static inline struct signal_info *signal_info_create(struct decl_info *info)
 static inline void signal_info_destroy(struct signal_info *si)
 {
 	if (si) {
-		pthread_mutex_destroy(&si->mutex);
+		callback_set_free(&si->callbacks);
 		decl_info_free(&si->func);
-		da_free(si->callbacks);
 		bfree(si);
 	}
 }
 
-static inline size_t signal_get_callback_idx(struct signal_info *si, signal_callback_t callback, void *data)
-{
-	for (size_t i = 0; i < si->callbacks.num; i++) {
-		struct signal_callback *sc = si->callbacks.array + i;
-
-		if (sc->callback == callback && sc->data == data)
-			return i;
-	}
-
-	return DARRAY_INVALID;
-}
-
-struct global_callback_info {
-	global_signal_callback_t callback;
-	void *data;
-	long signaling;
-	bool remove;
-};
-
 struct signal_handler {
 	struct signal_info *first;
 	pthread_mutex_t mutex;
 	volatile long refs;
 
-	DARRAY(struct global_callback_info) global_callbacks;
-	pthread_mutex_t global_callbacks_mutex;
+	struct callback_set global_callbacks;
 };
 
 static struct signal_info *getsignal(signal_handler_t *handler, const char *name, struct signal_info **p_last)
@@ -124,7 +349,7 @@ signal_handler_t *signal_handler_create(void)
 		bfree(handler);
 		return NULL;
 	}
-	if (pthread_mutex_init_recursive(&handler->global_callbacks_mutex) != 0) {
+	if (!callback_set_init(&handler->global_callbacks)) {
 		blog(LOG_ERROR, "Couldn't create signal handler global "
 				"callbacks mutex!");
 		pthread_mutex_destroy(&handler->mutex);
@@ -144,8 +369,7 @@ static void signal_handler_actually_destroy(signal_handler_t *handler)
 		sig = next;
 	}
 
-	da_free(handler->global_callbacks);
-	pthread_mutex_destroy(&handler->global_callbacks_mutex);
+	callback_set_free(&handler->global_callbacks);
 	pthread_mutex_destroy(&handler->mutex);
 	bfree(handler);
 }
@@ -188,20 +412,35 @@ bool signal_handler_add(signal_handler_t *handler, const char *signal_decl)
 	return success;
 }
 
-static void signal_handler_connect_internal(signal_handler_t *handler, const char *signal, signal_callback_t callback,
-					    void *data, bool keep_ref)
+static inline struct signal_info *getsignal_locked(signal_handler_t *handler, const char *name)
 {
-	struct signal_info *sig, *last;
-	struct signal_callback cb_data = {callback, data, false, keep_ref};
-	size_t idx;
+	struct signal_info *sig;
 
 	if (!handler)
-		return;
+		return NULL;
 
 	pthread_mutex_lock(&handler->mutex);
-	sig = getsignal(handler, signal, &last);
+	sig = getsignal(handler, name, NULL);
 	pthread_mutex_unlock(&handler->mutex);
 
+	return sig;
+}
+
+signal_t *signal_handler_get_signal(signal_handler_t *handler, const char *signal)
+{
+	return getsignal_locked(handler, signal);
+}
+
+static void signal_handler_connect_internal(signal_handler_t *handler, const char *signal, signal_callback_t callback,
+					    void *data, bool keep_ref)
+{
+	struct signal_info *sig;
+	struct signal_callback cb_data = {callback, NULL, data, false, keep_ref};
+
+	if (!handler)
+		return;
+
+	sig = getsignal_locked(handler, signal);
 	if (!sig) {
 		blog(LOG_WARNING,
 		     "signal_handler_connect: "
@@ -212,16 +451,10 @@ static void signal_handler_connect_internal(signal_handler_t *handler, const cha
 
 	/* -------------- */
 
-	pthread_mutex_lock(&sig->mutex);
-
 	if (keep_ref)
 		os_atomic_inc_long(&handler->refs);
 
-	idx = signal_get_callback_idx(sig, callback, data);
-	if (keep_ref || idx == DARRAY_INVALID)
-		da_push_back(sig->callbacks, &cb_data);
-
-	pthread_mutex_unlock(&sig->mutex);
+	callback_set_add(&sig->callbacks, &cb_data, !keep_ref);
 }
 
 void signal_handler_connect(signal_handler_t *handler, const char *signal, signal_callback_t callback, void *data)
@@ -234,158 +467,92 @@ void signal_handler_connect_ref(signal_handler_t *handler, const char *signal, s
 	signal_handler_connect_internal(handler, signal, callback, data, true);
 }
 
-static inline struct signal_info *getsignal_locked(signal_handler_t *handler, const char *name)
-{
-	struct signal_info *sig;
-
-	if (!handler)
-		return NULL;
-
-	pthread_mutex_lock(&handler->mutex);
-	sig = getsignal(handler, name, NULL);
-	pthread_mutex_unlock(&handler->mutex);
-
-	return sig;
-}
-
 void signal_handler_disconnect(signal_handler_t *handler, const char *signal, signal_callback_t callback, void *data)
 {
 	struct signal_info *sig = getsignal_locked(handler, signal);
-	bool keep_ref = false;
-	size_t idx;
+	struct signal_callback match = {callback, NULL, data, false, false};
+	long removed_refs;
 
 	if (!sig)
 		return;
 
-	pthread_mutex_lock(&sig->mutex);
-
-	idx = signal_get_callback_idx(sig, callback, data);
-	if (idx != DARRAY_INVALID) {
-		if (sig->signalling) {
-			sig->callbacks.array[idx].remove = true;
-		} else {
-			keep_ref = sig->callbacks.array[idx].keep_ref;
-			da_erase(sig->callbacks, idx);
-		}
-	}
-
-	pthread_mutex_unlock(&sig->mutex);
+	removed_refs = callback_set_remove(&sig->callbacks, &match);
 
-	if (keep_ref && os_atomic_dec_long(&handler->refs) == 0) {
+	if (removed_refs && os_atomic_add_long(&handler->refs, -removed_refs) == 0) {
 		signal_handler_actually_destroy(handler);
 	}
 }
 
-static THREAD_LOCAL struct signal_callback *current_signal_cb = NULL;
-static THREAD_LOCAL struct global_callback_info *current_global_cb = NULL;
-
 void signal_handler_remove_current(void)
 {
-	if (current_signal_cb)
-		current_signal_cb->remove = true;
-	else if (current_global_cb)
-		current_global_cb->remove = true;
+	struct signal_emission *em = current_emission;
+
+	if (em && em->current) {
+		os_atomic_set_bool(&em->current->remove, true);
+		em->purge = true;
+	}
 }
 
-void signal_handler_signal(signal_handler_t *handler, const char *signal, calldata_t *params)
+static void signal_call_callbacks(struct callback_set *set, const char *signal, calldata_t *params, long *removed_refs)
 {
-	struct signal_info *sig = getsignal_locked(handler, signal);
-	long remove_refs = 0;
+	struct signal_emission em;
+	struct callback_list *list = callback_set_enter(set, &em);
 
-	if (!sig)
-		return;
+	for (size_t i = 0; i < list->num; i++) {
+		struct signal_callback *cb = list->array[i];
 
-	pthread_mutex_lock(&sig->mutex);
-	sig->signalling = true;
+		if (os_atomic_load_bool(&cb->remove))
+			continue;
 
-	for (size_t i = 0; i < sig->callbacks.num; i++) {
-		struct signal_callback *cb = sig->callbacks.array + i;
-		if (!cb->remove) {
-			current_signal_cb = cb;
+		em.current = cb;
+		if (cb->global_callback)
+			cb->global_callback(cb->data, signal, params);
+		else
 			cb->callback(cb->data, params);
-			current_signal_cb = NULL;
-		}
-	}
-
-	for (size_t i = sig->callbacks.num; i > 0; i--) {
-		struct signal_callback *cb = sig->callbacks.array + i - 1;
-		if (cb->remove) {
-			if (cb->keep_ref)
-				remove_refs++;
-
-			da_erase(sig->callbacks, i - 1);
-		}
 	}
 
-	sig->signalling = false;
-	pthread_mutex_unlock(&sig->mutex);
+	callback_set_leave(set, &em);
 
-	pthread_mutex_lock(&handler->global_callbacks_mutex);
+	if (em.purge)
+		*removed_refs += callback_set_remove(set, NULL);
+}
 
-	if (handler->global_callbacks.num) {
-		for (size_t i = 0; i < handler->global_callbacks.num; i++) {
-			struct global_callback_info *cb = handler->global_callbacks.array + i;
+void signal_handler_emit(signal_handler_t *handler, signal_t *signal, calldata_t *params)
+{
+	long removed_refs = 0;
 
-			if (!cb->remove) {
-				cb->signaling++;
-				current_global_cb = cb;
-				cb->callback(cb->data, signal, params);
-				current_global_cb = NULL;
-				cb->signaling--;
-			}
-		}
+	if (!handler || !signal)
+		return;
 
-		for (size_t i = handler->global_callbacks.num; i > 0; i--) {
-			struct global_callback_info *cb = handler->global_callbacks.array + (i - 1);
+	signal_call_callbacks(&signal->callbacks, signal->func.name, params, &removed_refs);
+	signal_call_callbacks(&handler->global_callbacks, signal->func.name, params, &removed_refs);
 
-			if (cb->remove && !cb->signaling)
-				da_erase(handler->global_callbacks, i - 1);
-		}
+	if (removed_refs) {
+		os_atomic_add_long(&handler->refs, -removed_refs);
 	}
+}
 
-	pthread_mutex_unlock(&handler->global_callbacks_mutex);
-
-	if (remove_refs) {
-		os_atomic_set_long(&handler->refs, os_atomic_load_long(&handler->refs) - remove_refs);
-	}
+void signal_handler_signal(signal_handler_t *handler, const char *signal, calldata_t *params)
+{
+	signal_handler_emit(handler, getsignal_locked(handler, signal), params);
 }
 
 void signal_handler_connect_global(signal_handler_t *handler, global_signal_callback_t callback, void *data)
 {
-	struct global_callback_info cb_data = {callback, data, 0, false};
-	size_t idx;
+	struct signal_callback cb_data = {NULL, callback, data, false, false};
 
 	if (!handler || !callback)
 		return;
 
-	pthread_mutex_lock(&handler->global_callbacks_mutex);
-
-	idx = da_find(handler->global_callbacks, &cb_data, 0);
-	if (idx == DARRAY_INVALID)
-		da_push_back(handler->global_callbacks, &cb_data);
-
-	pthread_mutex_unlock(&handler->global_callbacks_mutex);
+	callback_set_add(&handler->global_callbacks, &cb_data, true);
 }
 
 void signal_handler_disconnect_global(signal_handler_t *handler, global_signal_callback_t callback, void *data)
 {
-	struct global_callback_info cb_data = {callback, data, 0, false};
-	size_t idx;
+	struct signal_callback match = {NULL, callback, data, false, false};
 
 	if (!handler || !callback)
 		return;
 
-	pthread_mutex_lock(&handler->global_callbacks_mutex);
-
-	idx = da_find(handler->global_callbacks, &cb_data, 0);
-	if (idx != DARRAY_INVALID) {
-		struct global_callback_info *cb = handler->global_callbacks.array + idx;
-
-		if (cb->signaling)
-			cb->remove = true;
-		else
-			da_erase(handler->global_callbacks, idx);
-	}
-
-	pthread_mutex_unlock(&handler->global_callbacks_mutex);
+	callback_set_remove(&handler->global_callbacks, &match);
 }
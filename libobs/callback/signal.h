@@ -32,7 +32,9 @@ extern "C" {
  */
 
 struct signal_handler;
+struct signal_info;
 typedef struct signal_handler signal_handler_t;
+typedef struct signal_info signal_t;
 typedef void (*global_signal_callback_t)(void *, const char *, calldata_t *);
 typedef void (*signal_callback_t)(void *, calldata_t *);
 
@@ -68,6 +70,14 @@ EXPORT void signal_handler_remove_current(void);
 
 EXPORT void signal_handler_signal(signal_handler_t *handler, const char *signal, calldata_t *params);
 
+/*
+ * Signals are never removed from a handler, so the signal returned here stays
+ * valid for as long as the handler does and can be kept to emit the signal
+ * without having to look it up by name each time.
+ */
+EXPORT signal_t *signal_handler_get_signal(signal_handler_t *handler, const char *signal);
+EXPORT void signal_handler_emit(signal_handler_t *handler, signal_t *signal, calldata_t *params);
+
 #ifdef __cplusplus
 }
 #endif
@@ -44,6 +44,13 @@ if(NOT HAVE_UUID_HEADER)
   message(FATAL_ERROR "Required system header <uuid/uuid.h> not found.")
 endif()
 
+set(IO_URING_TEST_SOURCE "#include<linux/io_uring.h>\n#include<sys/syscall.h>\nint main(){return __NR_io_uring_setup + IORING_OP_WRITEV;}")
+check_c_source_compiles("${IO_URING_TEST_SOURCE}" HAVE_LINUX_IO_URING)
+
+if(HAVE_LINUX_IO_URING)
+  target_compile_definitions(libobs PRIVATE HAVE_LINUX_IO_URING)
+endif()
+
 target_link_libraries(
   libobs
   PRIVATE
@@ -1760,6 +1760,7 @@ static void ep_compile_param(struct effect_parser *ep, size_t idx)
 	param_in->param = param;
 
 	param->name = bstrdup(param_in->name);
+	param->id = gs_effect_param_id(param->name);
 	param->section = EFFECT_PARAM;
 	param->effect = ep->effect;
 	da_move(param->default_val, param_in->default_val);
@@ -1945,6 +1946,8 @@ static bool ep_compile(struct effect_parser *ep)
 	for (i = 0; i < ep->params.num; i++)
 		ep_compile_param(ep, i);
 
+	effect_build_param_table(ep->effect);
+
 #if defined(_DEBUG) && defined(_DEBUG_SHADERS)
 	blog(LOG_DEBUG, "Shader has %lld techniques:", ep->techniques.num);
 #endif
@@ -272,15 +272,89 @@ gs_eparam_t *gs_effect_get_param_by_idx(const gs_effect_t *effect, size_t param)
 	return params + param;
 }
 
+void effect_build_param_table(gs_effect_t *effect)
+{
+	struct gs_effect_param *params = effect->params.array;
+	uint32_t size = 4;
+
+	bfree(effect->param_table);
+	effect->param_table = NULL;
+	effect->param_table_mask = 0;
+	effect->param_id_collision = false;
+
+	if (!effect->params.num)
+		return;
+
+	/* keep the table at most half full so probe chains stay short */
+	while (size < effect->params.num * 2)
+		size <<= 1;
+
+	effect->param_table = bzalloc(size * sizeof(uint32_t));
+	effect->param_table_mask = size - 1;
+
+	for (size_t i = 0; i < effect->params.num; i++) {
+		struct gs_effect_param *param = params + i;
+		uint32_t slot = (uint32_t)param->id & effect->param_table_mask;
+		bool duplicate = false;
+
+		while (effect->param_table[slot]) {
+			if (params[effect->param_table[slot] - 1].id == param->id) {
+				duplicate = true;
+				break;
+			}
+			slot = (slot + 1) & effect->param_table_mask;
+		}
+
+		if (duplicate) {
+			blog(LOG_WARNING,
+			     "Effect '%s': parameter '%s' has the same ID "
+			     "as parameter '%s', it can only be looked up "
+			     "by name",
+			     effect->effect_path ? effect->effect_path : "(string)", param->name,
+			     params[effect->param_table[slot] - 1].name);
+			effect->param_id_collision = true;
+			continue;
+		}
+
+		effect->param_table[slot] = (uint32_t)i + 1;
+	}
+}
+
+static inline struct gs_effect_param *find_param_by_id(const gs_effect_t *effect, gs_param_id_t id)
+{
+	struct gs_effect_param *params = effect->params.array;
+	uint32_t slot = (uint32_t)id & effect->param_table_mask;
+	uint32_t idx;
+
+	if (!effect->param_table)
+		return NULL;
+
+	while ((idx = effect->param_table[slot]) != 0) {
+		if (params[idx - 1].id == id)
+			return params + idx - 1;
+		slot = (slot + 1) & effect->param_table_mask;
+	}
+
+	return NULL;
+}
+
 gs_eparam_t *gs_effect_get_param_by_name(const gs_effect_t *effect, const char *name)
 {
 	if (!effect)
 		return NULL;
 
+	struct gs_effect_param *param = find_param_by_id(effect, gs_effect_param_id(name));
+	if (param && strcmp(param->name, name) == 0)
+		return param;
+
+	if (!effect->param_id_collision)
+		return NULL;
+
+	/* a param whose ID collided with another isn't in the table */
 	struct gs_effect_param *params = effect->params.array;
 
 	for (size_t i = 0; i < effect->params.num; i++) {
-		struct gs_effect_param *param = params + i;
+		param = params + i;
 
 		if (strcmp(param->name, name) == 0)
 			return param;
@@ -289,6 +363,11 @@ gs_eparam_t *gs_effect_get_param_by_name(const gs_effect_t *effect, const char *
 	return NULL;
 }
 
+gs_eparam_t *gs_effect_get_param_by_id(const gs_effect_t *effect, gs_param_id_t id)
+{
+	return effect ? find_param_by_id(effect, id) : NULL;
+}
+
 size_t gs_param_get_num_annotations(const gs_eparam_t *param)
 {
 	return param ? param->annotations.num : 0;
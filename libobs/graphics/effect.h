@@ -46,6 +46,7 @@ enum effect_section { EFFECT_PARAM, EFFECT_TECHNIQUE, EFFECT_SAMPLER, EFFECT_PAS
 
 struct gs_effect_param {
 	char *name;
+	gs_param_id_t id;
 	enum effect_section section;
 
 	enum gs_shader_param_type type;
@@ -84,6 +85,9 @@ static inline void effect_param_free(struct gs_effect_param *param)
 
 EXPORT void effect_param_parse_property(gs_eparam_t *param, const char *property);
 
+/** builds the ID lookup table once all params have been added */
+EXPORT void effect_build_param_table(gs_effect_t *effect);
+
 /* ------------------------------------------------------------------------- */
 
 struct pass_shaderparam {
@@ -151,6 +155,12 @@ struct gs_effect {
 	gs_effect_param_array_t params;
 	DARRAY(struct gs_effect_technique) techniques;
 
+	/* open addressing table of params indexed by their ID, each entry is
+	 * the param index + 1 so that 0 can mark an empty slot */
+	uint32_t *param_table;
+	uint32_t param_table_mask;
+	bool param_id_collision;
+
 	struct gs_effect_technique *cur_technique;
 	struct gs_effect_pass *cur_pass;
 
@@ -179,6 +189,9 @@ static inline void effect_free(gs_effect_t *effect)
 	da_free(effect->params);
 	da_free(effect->techniques);
 
+	bfree(effect->param_table);
+	effect->param_table = NULL;
+
 	bfree(effect->effect_path);
 	bfree(effect->effect_dir);
 	effect->effect_path = NULL;
@@ -386,6 +386,25 @@ struct gs_effect_param_info {
 };
 #endif
 
+/**
+ * Parameter IDs are a hash of the parameter name, so they are the same for
+ * every effect and can be worked out once and kept (e.g. in a static) for use
+ * with gs_effect_get_param_by_id, which doesn't have to compare any strings.
+ */
+typedef uint64_t gs_param_id_t;
+
+static inline gs_param_id_t gs_effect_param_id(const char *name)
+{
+	gs_param_id_t id = 0xcbf29ce484222325ULL;
+
+	while (*name) {
+		id ^= (uint8_t)*(name++);
+		id *= 0x100000001b3ULL;
+	}
+
+	return id;
+}
+
 EXPORT void gs_effect_destroy(gs_effect_t *effect);
 
 EXPORT gs_technique_t *gs_effect_get_technique(const gs_effect_t *effect, const char *name);
@@ -403,6 +422,7 @@ EXPORT gs_epass_t *gs_technique_get_pass_by_name(const gs_technique_t *technique
 EXPORT size_t gs_effect_get_num_params(const gs_effect_t *effect);
 EXPORT gs_eparam_t *gs_effect_get_param_by_idx(const gs_effect_t *effect, size_t param);
 EXPORT gs_eparam_t *gs_effect_get_param_by_name(const gs_effect_t *effect, const char *name);
+EXPORT gs_eparam_t *gs_effect_get_param_by_id(const gs_effect_t *effect, gs_param_id_t id);
 EXPORT size_t gs_param_get_num_annotations(const gs_eparam_t *param);
 EXPORT gs_eparam_t *gs_param_get_annotation_by_idx(const gs_eparam_t *param, size_t annotation);
 EXPORT gs_eparam_t *gs_param_get_annotation_by_name(const gs_eparam_t *param, const char *name);
@@ -76,6 +76,7 @@ struct audio_output {
 	audio_input_callback_t input_cb;
 	void *input_param;
 	pthread_mutex_t input_mutex;
+	volatile long extra_ticks;
 	struct audio_mix mixes[MAX_AUDIO_MIXES];
 };
 
@@ -231,6 +232,11 @@ static void *audio_thread(void *param)
 		input_and_output(audio, audio_time, prev_time);
 		prev_time = audio_time;
 
+		while (os_atomic_load_long(&audio->extra_ticks) > 0) {
+			os_atomic_dec_long(&audio->extra_ticks);
+			input_and_output(audio, audio_time, audio_time);
+		}
+
 		profile_end(audio_thread_name);
 
 		profile_reenable_thread();
@@ -419,6 +425,12 @@ const struct audio_output_info *audio_output_get_info(const audio_t *audio)
 	return audio ? &audio->info : NULL;
 }
 
+void audio_output_request_extra_tick(audio_t *audio)
+{
+	if (audio)
+		os_atomic_inc_long(&audio->extra_ticks);
+}
+
 bool audio_output_active(const audio_t *audio)
 {
 	if (!audio)
@@ -217,6 +217,11 @@ EXPORT void audio_output_disconnect(audio_t *video, size_t mix_idx, audio_output
 
 EXPORT bool audio_output_active(const audio_t *audio);
 
+/* Calls the input callback once more right after the current tick, with a
+ * zero length time range (start_ts == end_ts).  Used to output audio that has
+ * already been buffered without a gap in the output timestamps. */
+EXPORT void audio_output_request_extra_tick(audio_t *audio);
+
 EXPORT size_t audio_output_get_block_size(const audio_t *audio);
 EXPORT size_t audio_output_get_planes(const audio_t *audio);
 EXPORT size_t audio_output_get_channels(const audio_t *audio);
@@ -173,6 +173,29 @@ void convert_uyvx_to_i444(const uint8_t *input, uint32_t in_linesize, uint32_t s
 	}
 }
 
+/* 16 pixels of packed 32-bit output from 16 luma bytes and 8 bytes of each
+ * chroma component, each chroma value shared by two horizontal pixels.  The
+ * output bytes of each pixel are (b0, b1, b2, b3) = (lo_a, lo_b, hi_a, hi_b),
+ * where the lo/hi pairs come from the two byte vectors passed in. */
+#define store_2x16_pixels(out, lo_a, lo_b, hi_a, hi_b)                                            \
+	do {                                                                                      \
+		__m128i lo_lo = _mm_unpacklo_epi8(lo_a, lo_b);                                    \
+		__m128i lo_hi = _mm_unpackhi_epi8(lo_a, lo_b);                                    \
+		__m128i hi_lo = _mm_unpacklo_epi8(hi_a, hi_b);                                    \
+		__m128i hi_hi = _mm_unpackhi_epi8(hi_a, hi_b);                                    \
+                                                                                                  \
+		_mm_storeu_si128((__m128i *)(out), _mm_unpacklo_epi16(lo_lo, hi_lo));             \
+		_mm_storeu_si128((__m128i *)(out) + 1, _mm_unpackhi_epi16(lo_lo, hi_lo));         \
+		_mm_storeu_si128((__m128i *)(out) + 2, _mm_unpacklo_epi16(lo_hi, hi_hi));         \
+		_mm_storeu_si128((__m128i *)(out) + 3, _mm_unpackhi_epi16(lo_hi, hi_hi));         \
+	} while (false)
+
+static FORCE_INLINE __m128i dup_chroma(const uint8_t *ptr)
+{
+	__m128i val = _mm_loadl_epi64((const __m128i *)ptr);
+	return _mm_unpacklo_epi8(val, val);
+}
+
 void decompress_420(const uint8_t *const input[], const uint32_t in_linesize[], uint32_t start_y, uint32_t end_y,
 		    uint8_t *output, uint32_t out_linesize)
 {
@@ -181,19 +204,38 @@ void decompress_420(const uint8_t *const input[], const uint32_t in_linesize[],
 	uint32_t height_d2 = end_y / 2;
 	uint32_t y;
 
+	__m128i zero = _mm_setzero_si128();
+
 	for (y = start_y_d2; y < height_d2; y++) {
 		const uint8_t *chroma0 = input[1] + y * in_linesize[1];
 		const uint8_t *chroma1 = input[2] + y * in_linesize[2];
 		register const uint8_t *lum0, *lum1;
 		register uint32_t *output0, *output1;
-		uint32_t x;
+		uint32_t x = 0;
 
 		lum0 = input[0] + y * 2 * in_linesize[0];
 		lum1 = lum0 + in_linesize[0];
 		output0 = (uint32_t *)(output + y * 2 * out_linesize);
 		output1 = (uint32_t *)((uint8_t *)output0 + out_linesize);
 
-		for (x = 0; x < width_d2; x++) {
+		for (; x + 8 <= width_d2; x += 8) {
+			__m128i u = dup_chroma(chroma0);
+			__m128i v = dup_chroma(chroma1);
+			__m128i line0 = _mm_loadu_si128((const __m128i *)lum0);
+			__m128i line1 = _mm_loadu_si128((const __m128i *)lum1);
+
+			store_2x16_pixels(output0, v, u, line0, zero);
+			store_2x16_pixels(output1, v, u, line1, zero);
+
+			chroma0 += 8;
+			chroma1 += 8;
+			lum0 += 16;
+			lum1 += 16;
+			output0 += 16;
+			output1 += 16;
+		}
+
+		for (; x < width_d2; x++) {
 			uint32_t out;
 			out = (*(chroma0++) << 8) | *(chroma1++);
 
@@ -214,11 +256,14 @@ void decompress_nv12(const uint8_t *const input[], const uint32_t in_linesize[],
 	uint32_t height_d2 = end_y / 2;
 	uint32_t y;
 
+	__m128i zero = _mm_setzero_si128();
+	__m128i lo_mask = _mm_set1_epi16(0x00FF);
+
 	for (y = start_y_d2; y < height_d2; y++) {
 		const uint16_t *chroma;
 		register const uint8_t *lum0, *lum1;
 		register uint32_t *output0, *output1;
-		uint32_t x;
+		uint32_t x = 0;
 
 		chroma = (const uint16_t *)(input[1] + y * in_linesize[1]);
 		lum0 = input[0] + y * 2 * in_linesize[0];
@@ -226,7 +271,27 @@ void decompress_nv12(const uint8_t *const input[], const uint32_t in_linesize[],
 		output0 = (uint32_t *)(output + y * 2 * out_linesize);
 		output1 = (uint32_t *)((uint8_t *)output0 + out_linesize);
 
-		for (x = 0; x < width_d2; x++) {
+		for (; x + 8 <= width_d2; x += 8) {
+			__m128i uv = _mm_loadu_si128((const __m128i *)chroma);
+			__m128i u = _mm_packus_epi16(_mm_and_si128(uv, lo_mask), zero);
+			__m128i v = _mm_packus_epi16(_mm_srli_epi16(uv, 8), zero);
+			__m128i line0 = _mm_loadu_si128((const __m128i *)lum0);
+			__m128i line1 = _mm_loadu_si128((const __m128i *)lum1);
+
+			u = _mm_unpacklo_epi8(u, u);
+			v = _mm_unpacklo_epi8(v, v);
+
+			store_2x16_pixels(output0, line0, u, v, zero);
+			store_2x16_pixels(output1, line1, u, v, zero);
+
+			chroma += 8;
+			lum0 += 16;
+			lum1 += 16;
+			output0 += 16;
+			output1 += 16;
+		}
+
+		for (; x < width_d2; x++) {
 			uint32_t out = *(chroma++) << 8;
 
 			*(output0++) = *(lum0++) | out;
@@ -249,11 +314,26 @@ void decompress_422(const uint8_t *input, uint32_t in_linesize, uint32_t start_y
 	register uint32_t *output32;
 
 	if (leading_lum) {
+		__m128i keep_mask = _mm_set1_epi32(0xFFFFFF00);
+		__m128i lum_mask = _mm_set1_epi32(0x000000FF);
+
 		for (y = start_y; y < end_y; y++) {
 			input32 = (const uint32_t *)(input + y * in_linesize);
 			input32_end = input32 + width_d2;
 			output32 = (uint32_t *)(output + y * out_linesize);
 
+			while (input32 + 4 <= input32_end) {
+				__m128i dw = _mm_loadu_si128((const __m128i *)input32);
+				__m128i dup = _mm_or_si128(_mm_and_si128(dw, keep_mask),
+							   _mm_and_si128(_mm_srli_epi32(dw, 16), lum_mask));
+
+				_mm_storeu_si128((__m128i *)output32, _mm_unpacklo_epi32(dw, dup));
+				_mm_storeu_si128((__m128i *)output32 + 1, _mm_unpackhi_epi32(dw, dup));
+
+				output32 += 8;
+				input32 += 4;
+			}
+
 			while (input32 < input32_end) {
 				register uint32_t dw = *input32;
 
@@ -267,11 +347,26 @@ void decompress_422(const uint8_t *input, uint32_t in_linesize, uint32_t start_y
 			}
 		}
 	} else {
+		__m128i keep_mask = _mm_set1_epi32(0xFFFF00FF);
+		__m128i lum_mask = _mm_set1_epi32(0x0000FF00);
+
 		for (y = start_y; y < end_y; y++) {
 			input32 = (const uint32_t *)(input + y * in_linesize);
 			input32_end = input32 + width_d2;
 			output32 = (uint32_t *)(output + y * out_linesize);
 
+			while (input32 + 4 <= input32_end) {
+				__m128i dw = _mm_loadu_si128((const __m128i *)input32);
+				__m128i dup = _mm_or_si128(_mm_and_si128(dw, keep_mask),
+							   _mm_and_si128(_mm_srli_epi32(dw, 16), lum_mask));
+
+				_mm_storeu_si128((__m128i *)output32, _mm_unpacklo_epi32(dw, dup));
+				_mm_storeu_si128((__m128i *)output32 + 1, _mm_unpackhi_epi32(dw, dup));
+
+				output32 += 8;
+				input32 += 4;
+			}
+
 			while (input32 < input32_end) {
 				register uint32_t dw = *input32;
 
@@ -34,15 +34,26 @@ extern profiler_name_store_t *obs_get_profiler_name_store(void);
 #define MAX_CONVERT_BUFFERS 3
 #define MAX_CACHE_SIZE 16
 
+/* Cached frames are handed to each input through its own queue of frame
+ * references, so a slow input only ever holds back the frames it has queued
+ * rather than every other input connected to the output. */
+
 struct cached_frame_info {
 	struct video_data frame;
-	int skipped;
+	volatile long refs;
 	int count;
 };
 
+struct frame_ref {
+	size_t slot;
+	int count;
+	long repeats;
+};
+
 struct video_input {
 	struct video_scale_info conversion;
 	video_scaler_t *scaler;
+	const char *scale_profile_name;
 	struct video_frame frame[MAX_CONVERT_BUFFERS];
 	int cur_frame;
 
@@ -58,6 +69,27 @@ struct video_input {
 
 	void (*callback)(void *param, struct video_data *frame);
 	void *param;
+
+	struct video_output *video;
+	pthread_t thread;
+	os_sem_t *update_semaphore;
+	bool thread_created;
+	volatile bool stop;
+
+	/* single producer (video_output_unlock_frame), single consumer
+	 * (input thread) queue of cached frames waiting for this input */
+	struct frame_ref queue[MAX_CACHE_SIZE];
+	size_t queue_size;
+	volatile long queue_head;
+	volatile long queue_tail;
+
+	/* frames that could not be queued for this input, output as repeats
+	 * of the next queued frame so frame timing stays continuous; only
+	 * touched by the producer */
+	long pending_repeats;
+
+	volatile long skipped_frames;
+	volatile long total_frames;
 };
 
 static inline void video_input_free(struct video_input *input)
@@ -65,26 +97,30 @@ static inline void video_input_free(struct video_input *input)
 	for (size_t i = 0; i < MAX_CONVERT_BUFFERS; i++)
 		video_frame_free(&input->frame[i]);
 	video_scaler_destroy(input->scaler);
+	os_sem_destroy(input->update_semaphore);
+	bfree(input);
 }
 
 struct video_output {
 	struct video_output_info info;
 
-	pthread_t thread;
 	pthread_mutex_t data_mutex;
-	bool stop;
+	volatile bool stop;
 
-	os_sem_t *update_semaphore;
 	uint64_t frame_time;
 	volatile long skipped_frames;
 	volatile long total_frames;
 
+	/* inputs is changed with both input_mutex and data_mutex locked, so
+	 * the graphics thread only needs data_mutex to walk it.  Neither is
+	 * held while an input thread is joined, because an encoder callback
+	 * can connect or disconnect inputs itself. */
 	pthread_mutex_t input_mutex;
-	DARRAY(struct video_input) inputs;
+	DARRAY(struct video_input *) inputs;
+	DARRAY(struct video_input *) stopped_inputs;
 
-	size_t available_frames;
-	size_t first_added;
-	size_t last_added;
+	size_t next_slot;
+	size_t locked_slot;
 	struct cached_frame_info cache[MAX_CACHE_SIZE];
 
 	struct video_output *parent;
@@ -107,8 +143,10 @@ static inline bool scale_video_output(struct video_input *input, struct video_da
 
 		frame = &input->frame[input->cur_frame];
 
+		profile_start(input->scale_profile_name);
 		success = video_scaler_scale(input->scaler, frame->data, frame->linesize,
 					     (const uint8_t *const *)data->data, data->linesize);
+		profile_end(input->scale_profile_name);
 
 		if (success) {
 			for (size_t i = 0; i < MAX_AV_PLANES; i++) {
@@ -123,27 +161,56 @@ static inline bool scale_video_output(struct video_input *input, struct video_da
 	return success;
 }
 
-static inline bool video_output_cur_frame(struct video_output *video)
+static inline void release_slot(struct video_output *video, size_t slot)
 {
-	struct cached_frame_info *frame_info;
-	bool complete;
-	bool skipped;
+	os_atomic_dec_long(&video->cache[slot].refs);
+}
 
-	/* -------------------------------- */
+static inline bool queue_frame(struct video_input *input, size_t slot, int count)
+{
+	long head = os_atomic_load_long(&input->queue_head);
+	long tail = input->queue_tail;
+	struct frame_ref *ref;
 
-	pthread_mutex_lock(&video->data_mutex);
+	if ((size_t)(tail - head) >= input->queue_size)
+		return false;
 
-	frame_info = &video->cache[video->first_added];
+	ref = &input->queue[(size_t)tail % input->queue_size];
+	ref->slot = slot;
+	ref->count = count;
+	ref->repeats = input->pending_repeats;
+	input->pending_repeats = 0;
 
-	pthread_mutex_unlock(&video->data_mutex);
+	os_atomic_inc_long(&input->video->cache[slot].refs);
+	os_atomic_inc_long(&input->queue_tail);
+	return true;
+}
 
-	/* -------------------------------- */
+static inline bool dequeue_frame(struct video_input *input, struct frame_ref *ref)
+{
+	long head = input->queue_head;
 
-	pthread_mutex_lock(&video->input_mutex);
+	if (head == os_atomic_load_long(&input->queue_tail))
+		return false;
 
-	for (size_t i = 0; i < video->inputs.num; i++) {
-		struct video_input *input = video->inputs.array + i;
-		struct video_data frame = frame_info->frame;
+	*ref = input->queue[(size_t)head % input->queue_size];
+	os_atomic_inc_long(&input->queue_head);
+	return true;
+}
+
+static void video_input_output_frame(struct video_input *input, const struct frame_ref *ref)
+{
+	struct video_output *video = input->video;
+	struct video_data frame = video->cache[ref->slot].frame;
+	long count = ref->count + ref->repeats;
+
+	frame.timestamp -= (uint64_t)ref->repeats * video->frame_time;
+
+	for (long i = 0; i < count; i++) {
+		struct video_data scaled = frame;
+
+		frame.timestamp += video->frame_time;
+		os_atomic_inc_long(&input->total_frames);
 
 		// an explicit counter is used instead of remainder calculation
 		// to allow multiple encoders started at the same time to start on
@@ -155,63 +222,100 @@ static inline bool video_output_cur_frame(struct video_output *video)
 		if (skip)
 			continue;
 
-		if (scale_video_output(input, &frame))
-			input->callback(input->param, &frame);
+		if (scale_video_output(input, &scaled))
+			input->callback(input->param, &scaled);
+
+		/* the callback may have disconnected this input */
+		if (os_atomic_load_bool(&input->stop))
+			break;
 	}
+}
 
-	pthread_mutex_unlock(&video->input_mutex);
+static void *video_input_thread(void *param)
+{
+	struct video_input *input = param;
+	struct video_output *video = input->video;
 
-	/* -------------------------------- */
+	os_set_thread_name("video-io: video thread");
 
-	pthread_mutex_lock(&video->data_mutex);
+	const char *video_thread_name =
+		profile_store_name(obs_get_profiler_name_store(), "video_thread(%s)", video->info.name);
+
+	while (os_sem_wait(input->update_semaphore) == 0) {
+		struct frame_ref ref;
 
-	frame_info->frame.timestamp += video->frame_time;
-	complete = --frame_info->count == 0;
-	skipped = frame_info->skipped > 0;
+		if (os_atomic_load_bool(&input->stop))
+			break;
+		if (!dequeue_frame(input, &ref))
+			continue;
 
-	if (complete) {
-		if (++video->first_added == video->info.cache_size)
-			video->first_added = 0;
+		profile_start(video_thread_name);
+		video_input_output_frame(input, &ref);
+		release_slot(video, ref.slot);
+		profile_end(video_thread_name);
 
-		if (++video->available_frames == video->info.cache_size)
-			video->last_added = video->first_added;
-	} else if (skipped) {
-		--frame_info->skipped;
-		os_atomic_inc_long(&video->skipped_frames);
+		profile_reenable_thread();
 	}
 
-	pthread_mutex_unlock(&video->data_mutex);
+	struct frame_ref ref;
+	while (dequeue_frame(input, &ref))
+		release_slot(video, ref.slot);
 
-	/* -------------------------------- */
+	return NULL;
+}
+
+static inline bool video_input_start(struct video_input *input)
+{
+	if (os_sem_init(&input->update_semaphore, 0) != 0)
+		return false;
 
-	return complete;
+	input->thread_created = pthread_create(&input->thread, NULL, video_input_thread, input) == 0;
+	return input->thread_created;
 }
 
-static void *video_thread(void *param)
+/* Stops the input thread and drops any frames still queued for it.  The input
+ * must already be removed from inputs, and input_mutex must not be held.  When
+ * called from the input's own thread (an encoder stopping itself from its
+ * video callback) the thread cannot be joined yet, so the input is parked in
+ * stopped_inputs and reaped later. */
+static void video_input_stop(struct video_output *video, struct video_input *input)
 {
-	struct video_output *video = param;
+	os_atomic_set_bool(&input->stop, true);
 
-	os_set_thread_name("video-io: video thread");
+	if (input->thread_created && pthread_equal(pthread_self(), input->thread)) {
+		pthread_mutex_lock(&video->input_mutex);
+		da_push_back(video->stopped_inputs, &input);
+		pthread_mutex_unlock(&video->input_mutex);
+		return;
+	}
 
-	const char *video_thread_name =
-		profile_store_name(obs_get_profiler_name_store(), "video_thread(%s)", video->info.name);
+	if (input->thread_created) {
+		os_sem_post(input->update_semaphore);
+		pthread_join(input->thread, NULL);
+	}
 
-	while (os_sem_wait(video->update_semaphore) == 0) {
-		if (video->stop)
-			break;
+	video_input_free(input);
+}
 
-		profile_start(video_thread_name);
-		while (!video->stop && !video_output_cur_frame(video)) {
-			os_atomic_inc_long(&video->total_frames);
-		}
+static void reap_stopped_inputs(struct video_output *video)
+{
+	DARRAY(struct video_input *) reaped = {0};
 
-		os_atomic_inc_long(&video->total_frames);
-		profile_end(video_thread_name);
+	pthread_mutex_lock(&video->input_mutex);
+	for (size_t i = video->stopped_inputs.num; i > 0; i--) {
+		struct video_input *input = video->stopped_inputs.array[i - 1];
 
-		profile_reenable_thread();
+		if (pthread_equal(pthread_self(), input->thread))
+			continue;
+
+		da_erase(video->stopped_inputs, i - 1);
+		da_push_back(reaped, &input);
 	}
+	pthread_mutex_unlock(&video->input_mutex);
 
-	return NULL;
+	for (size_t i = 0; i < reaped.num; i++)
+		video_input_stop(video, reaped.array[i]);
+	da_free(reaped);
 }
 
 /* ------------------------------------------------------------------------- */
@@ -225,6 +329,8 @@ static inline void init_cache(struct video_output *video)
 {
 	if (video->info.cache_size > MAX_CACHE_SIZE)
 		video->info.cache_size = MAX_CACHE_SIZE;
+	if (video->info.cache_size == 0)
+		video->info.cache_size = 1;
 
 	for (size_t i = 0; i < video->info.cache_size; i++) {
 		struct video_frame *frame;
@@ -232,8 +338,6 @@ static inline void init_cache(struct video_output *video)
 
 		video_frame_init(frame, video->info.format, video->info.width, video->info.height);
 	}
-
-	video->available_frames = video->info.cache_size;
 }
 
 int video_output_open(video_t **video, struct video_output_info *info)
@@ -254,20 +358,12 @@ int video_output_open(video_t **video, struct video_output_info *info)
 		goto fail0;
 	if (pthread_mutex_init_recursive(&out->input_mutex) != 0)
 		goto fail1;
-	if (os_sem_init(&out->update_semaphore, 0) != 0)
-		goto fail2;
-	if (pthread_create(&out->thread, NULL, video_thread, out) != 0)
-		goto fail3;
 
 	init_cache(out);
 
 	*video = out;
 	return VIDEO_OUTPUT_SUCCESS;
 
-fail3:
-	os_sem_destroy(out->update_semaphore);
-fail2:
-	pthread_mutex_destroy(&out->input_mutex);
 fail1:
 	pthread_mutex_destroy(&out->data_mutex);
 fail0:
@@ -280,19 +376,26 @@ void video_output_close(video_t *video)
 	if (!video)
 		return;
 
+	DARRAY(struct video_input *) inputs = {0};
+
 	video_output_stop(video);
 
 	pthread_mutex_lock(&video->input_mutex);
+	pthread_mutex_lock(&video->data_mutex);
+	da_move(inputs, video->inputs);
+	pthread_mutex_unlock(&video->data_mutex);
+	pthread_mutex_unlock(&video->input_mutex);
+
+	for (size_t i = 0; i < inputs.num; i++)
+		video_input_stop(video, inputs.array[i]);
+	da_free(inputs);
 
-	for (size_t i = 0; i < video->inputs.num; i++)
-		video_input_free(&video->inputs.array[i]);
-	da_free(video->inputs);
+	reap_stopped_inputs(video);
+	da_free(video->stopped_inputs);
 
 	for (size_t i = 0; i < video->info.cache_size; i++)
 		video_frame_free((struct video_frame *)&video->cache[i]);
 
-	pthread_mutex_unlock(&video->input_mutex);
-	os_sem_destroy(video->update_semaphore);
 	pthread_mutex_destroy(&video->data_mutex);
 	pthread_mutex_destroy(&video->input_mutex);
 
@@ -303,7 +406,7 @@ static size_t video_get_input_idx(const video_t *video, void (*callback)(void *p
 				  void *param)
 {
 	for (size_t i = 0; i < video->inputs.num; i++) {
-		struct video_input *input = video->inputs.array + i;
+		struct video_input *input = video->inputs.array[i];
 		if (input->callback == callback && input->param == param)
 			return i;
 	}
@@ -349,7 +452,8 @@ static inline bool video_input_init(struct video_input *input, struct video_outp
 						.range = video->info.range,
 						.colorspace = video->info.colorspace};
 
-		int ret = video_scaler_create(&input->scaler, &input->conversion, &from, VIDEO_SCALE_FAST_BILINEAR);
+		int ret = video_scaler_create2(&input->scaler, &input->conversion, &from, VIDEO_SCALE_FAST_BILINEAR,
+					       video->info.scale_threads);
 		if (ret != VIDEO_SCALER_SUCCESS) {
 			if (ret == VIDEO_SCALER_BAD_CONVERSION)
 				blog(LOG_ERROR, "video_input_init: Bad "
@@ -364,6 +468,12 @@ static inline bool video_input_init(struct video_input *input, struct video_outp
 		for (size_t i = 0; i < MAX_CONVERT_BUFFERS; i++)
 			video_frame_init(&input->frame[i], input->conversion.format, input->conversion.width,
 					 input->conversion.height);
+
+		input->scale_profile_name = profile_store_name(
+			obs_get_profiler_name_store(), "video_scaler_scale(%s %ux%u -> %s %ux%u)",
+			get_video_format_name(video->info.format), video->info.width, video->info.height,
+			get_video_format_name(input->conversion.format), input->conversion.width,
+			input->conversion.height);
 	}
 
 	return true;
@@ -405,33 +515,41 @@ bool video_output_connect2(video_t *video, const struct video_scale_info *conver
 	if (!video || !callback || frame_rate_divisor == 0)
 		return false;
 
+	reap_stopped_inputs(video);
+
 	pthread_mutex_lock(&video->input_mutex);
 
 	if (video_get_input_idx(video, callback, param) == DARRAY_INVALID) {
-		struct video_input input;
-		memset(&input, 0, sizeof(input));
+		struct video_input *input = bzalloc(sizeof(*input));
+
+		input->callback = callback;
+		input->param = param;
+		input->video = video;
 
-		input.callback = callback;
-		input.param = param;
+		input->frame_rate_divisor = frame_rate_divisor;
 
-		input.frame_rate_divisor = frame_rate_divisor;
+		/* leave enough cached frames free that one lagging input can't
+		 * starve the others */
+		input->queue_size = video->info.cache_size / 2;
+		if (input->queue_size == 0)
+			input->queue_size = 1;
 
 		if (conversion) {
-			input.conversion = *conversion;
+			input->conversion = *conversion;
 		} else {
-			input.conversion.format = video->info.format;
-			input.conversion.width = video->info.width;
-			input.conversion.height = video->info.height;
-			input.conversion.range = video->info.range;
-			input.conversion.colorspace = video->info.colorspace;
+			input->conversion.format = video->info.format;
+			input->conversion.width = video->info.width;
+			input->conversion.height = video->info.height;
+			input->conversion.range = video->info.range;
+			input->conversion.colorspace = video->info.colorspace;
 		}
 
-		if (input.conversion.width == 0)
-			input.conversion.width = video->info.width;
-		if (input.conversion.height == 0)
-			input.conversion.height = video->info.height;
+		if (input->conversion.width == 0)
+			input->conversion.width = video->info.width;
+		if (input->conversion.height == 0)
+			input->conversion.height = video->info.height;
 
-		success = video_input_init(&input, video);
+		success = video_input_init(input, video) && video_input_start(input);
 		if (success) {
 			if (video->inputs.num == 0) {
 				if (!os_atomic_load_long(&video->gpu_refs)) {
@@ -439,7 +557,12 @@ bool video_output_connect2(video_t *video, const struct video_scale_info *conver
 				}
 				os_atomic_set_bool(&video->raw_active, true);
 			}
+
+			pthread_mutex_lock(&video->data_mutex);
 			da_push_back(video->inputs, &input);
+			pthread_mutex_unlock(&video->data_mutex);
+		} else {
+			video_input_free(input);
 		}
 	}
 
@@ -462,6 +585,19 @@ static void log_skipped(video_t *video)
 		     video->skipped_frames, video->total_frames, percentage_skipped);
 }
 
+static void log_input_skipped(struct video_input *input)
+{
+	long skipped = os_atomic_load_long(&input->skipped_frames);
+	long total = os_atomic_load_long(&input->total_frames);
+
+	if (skipped)
+		blog(LOG_INFO,
+		     "Video input disconnected, number of "
+		     "skipped frames due to lag of this input: "
+		     "%ld/%ld (%0.1f%%)",
+		     skipped, total, (double)skipped / (double)total * 100.0);
+}
+
 void video_output_disconnect(video_t *video, void (*callback)(void *param, struct video_data *frame), void *param)
 {
 	video_output_disconnect2(video, callback, param);
@@ -474,12 +610,19 @@ bool video_output_disconnect2(video_t *video, void (*callback)(void *param, stru
 
 	video = get_root(video);
 
+	reap_stopped_inputs(video);
+
+	struct video_input *input = NULL;
+
 	pthread_mutex_lock(&video->input_mutex);
 
 	size_t idx = video_get_input_idx(video, callback, param);
 	if (idx != DARRAY_INVALID) {
-		video_input_free(video->inputs.array + idx);
+		input = video->inputs.array[idx];
+
+		pthread_mutex_lock(&video->data_mutex);
 		da_erase(video->inputs, idx);
+		pthread_mutex_unlock(&video->data_mutex);
 
 		if (video->inputs.num == 0) {
 			os_atomic_set_bool(&video->raw_active, false);
@@ -491,7 +634,12 @@ bool video_output_disconnect2(video_t *video, void (*callback)(void *param, stru
 
 	pthread_mutex_unlock(&video->input_mutex);
 
-	return idx != DARRAY_INVALID;
+	if (input) {
+		log_input_skipped(input);
+		video_input_stop(video, input);
+	}
+
+	return input != NULL;
 }
 
 bool video_output_active(const video_t *video)
@@ -506,9 +654,17 @@ const struct video_output_info *video_output_get_info(const video_t *video)
 	return video ? &video->info : NULL;
 }
 
+/* Marks frames that could not be queued for an input so the input repeats its
+ * next frame instead, keeping its frame timing continuous. */
+static inline void skip_input_frames(struct video_input *input, int count)
+{
+	input->pending_repeats += count;
+	os_atomic_add_long(&input->skipped_frames, count);
+}
+
 bool video_output_lock_frame(video_t *video, struct video_frame *frame, int count, uint64_t timestamp)
 {
-	struct cached_frame_info *cfi;
+	struct cached_frame_info *cfi = NULL;
 	bool locked;
 
 	if (!video)
@@ -516,23 +672,35 @@ bool video_output_lock_frame(video_t *video, struct video_frame *frame, int coun
 
 	video = get_root(video);
 
+	if (os_atomic_load_bool(&video->stop))
+		return false;
+
 	pthread_mutex_lock(&video->data_mutex);
 
-	if (video->available_frames == 0) {
-		video->cache[video->last_added].count += count;
-		video->cache[video->last_added].skipped += count;
-		locked = false;
+	for (size_t i = 0; i < video->info.cache_size; i++) {
+		size_t slot = (video->next_slot + i) % video->info.cache_size;
 
-	} else {
-		if (video->available_frames != video->info.cache_size) {
-			if (++video->last_added == video->info.cache_size)
-				video->last_added = 0;
+		if (os_atomic_compare_swap_long(&video->cache[slot].refs, 0, 1)) {
+			video->locked_slot = slot;
+			video->next_slot = (slot + 1) % video->info.cache_size;
+			cfi = &video->cache[slot];
+			break;
 		}
+	}
+
+	os_atomic_add_long(&video->total_frames, count);
+
+	if (!cfi) {
+		/* every cached frame is still in use by some input */
+		for (size_t i = 0; i < video->inputs.num; i++)
+			skip_input_frames(video->inputs.array[i], count);
+
+		os_atomic_add_long(&video->skipped_frames, count);
+		locked = false;
 
-		cfi = &video->cache[video->last_added];
+	} else {
 		cfi->frame.timestamp = timestamp;
 		cfi->count = count;
-		cfi->skipped = 0;
 
 		memcpy(frame, &cfi->frame, sizeof(*frame));
 
@@ -546,6 +714,10 @@ bool video_output_lock_frame(video_t *video, struct video_frame *frame, int coun
 
 void video_output_unlock_frame(video_t *video)
 {
+	struct cached_frame_info *cfi;
+	bool skipped = false;
+	size_t slot;
+
 	if (!video)
 		return;
 
@@ -553,8 +725,25 @@ void video_output_unlock_frame(video_t *video)
 
 	pthread_mutex_lock(&video->data_mutex);
 
-	video->available_frames--;
-	os_sem_post(video->update_semaphore);
+	slot = video->locked_slot;
+	cfi = &video->cache[slot];
+
+	for (size_t i = 0; i < video->inputs.num; i++) {
+		struct video_input *input = video->inputs.array[i];
+
+		if (!queue_frame(input, slot, cfi->count)) {
+			skip_input_frames(input, cfi->count);
+			skipped = true;
+			continue;
+		}
+
+		os_sem_post(input->update_semaphore);
+	}
+
+	if (skipped)
+		os_atomic_add_long(&video->skipped_frames, cfi->count);
+
+	release_slot(video, slot);
 
 	pthread_mutex_unlock(&video->data_mutex);
 }
@@ -566,17 +755,20 @@ uint64_t video_output_get_frame_time(const video_t *video)
 
 void video_output_stop(video_t *video)
 {
-	void *thread_ret;
-
 	if (!video)
 		return;
 
 	video = get_root(video);
 
-	if (!video->stop) {
-		video->stop = true;
-		os_sem_post(video->update_semaphore);
-		pthread_join(video->thread, &thread_ret);
+	if (!os_atomic_set_bool(&video->stop, true)) {
+		pthread_mutex_lock(&video->input_mutex);
+		for (size_t i = 0; i < video->inputs.num; i++) {
+			struct video_input *input = video->inputs.array[i];
+
+			os_atomic_set_bool(&input->stop, true);
+			os_sem_post(input->update_semaphore);
+		}
+		pthread_mutex_unlock(&video->input_mutex);
 	}
 }
 
@@ -585,7 +777,7 @@ bool video_output_stopped(video_t *video)
 	if (!video)
 		return true;
 
-	return get_root(video)->stop;
+	return os_atomic_load_bool(&get_root(video)->stop);
 }
 
 enum video_format video_output_get_format(const video_t *video)
@@ -623,6 +815,27 @@ uint32_t video_output_get_total_frames(const video_t *video)
 	return (uint32_t)os_atomic_load_long(&get_const_root(video)->total_frames);
 }
 
+uint32_t video_output_get_input_skipped_frames(video_t *video, void (*callback)(void *param, struct video_data *frame),
+					       void *param)
+{
+	uint32_t skipped = 0;
+
+	if (!video || !callback)
+		return 0;
+
+	video = get_root(video);
+
+	pthread_mutex_lock(&video->input_mutex);
+
+	size_t idx = video_get_input_idx(video, callback, param);
+	if (idx != DARRAY_INVALID)
+		skipped = (uint32_t)os_atomic_load_long(&video->inputs.array[idx]->skipped_frames);
+
+	pthread_mutex_unlock(&video->input_mutex);
+
+	return skipped;
+}
+
 /* Note: These four functions below are a very slight bit of a hack.  If the
  * texture encoder thread is active while the raw encoder thread is active, the
  * total frame count will just be doubled while they're both active.  Which is
@@ -136,6 +136,10 @@ struct video_output_info {
 
 	enum video_colorspace colorspace;
 	enum video_range_type range;
+
+	/* number of threads each connected input's scaling/format conversion
+	 * is split across, 0 to pick based on the frame size */
+	uint32_t scale_threads;
 };
 
 static inline bool format_is_yuv(enum video_format format)
@@ -324,6 +328,9 @@ EXPORT double video_output_get_frame_rate(const video_t *video);
 
 EXPORT uint32_t video_output_get_skipped_frames(const video_t *video);
 EXPORT uint32_t video_output_get_total_frames(const video_t *video);
+EXPORT uint32_t video_output_get_input_skipped_frames(video_t *video,
+						      void (*callback)(void *param, struct video_data *frame),
+						      void *param);
 
 extern void video_output_inc_texture_encoders(video_t *video);
 extern void video_output_dec_texture_encoders(video_t *video);
@@ -16,15 +16,18 @@
 ******************************************************************************/
 
 #include "../util/bmem.h"
+#include "../util/platform.h"
 #include "video-scaler.h"
 
+#include <libavutil/frame.h>
 #include <libavutil/imgutils.h>
 #include <libavutil/opt.h>
 #include <libswscale/swscale.h>
 
 struct video_scaler {
 	struct SwsContext *swscale;
-	int src_height;
+	AVFrame *src_frame;
+	AVFrame *dst_frame;
 	int dst_heights[4];
 	uint8_t *dst_pointers[4];
 	int dst_linesizes[4];
@@ -140,8 +143,37 @@ static inline int get_ffmpeg_range_type(enum video_range_type type)
 
 #define FIXED_1_0 (1 << 16)
 
+/* Unless the count is given, conversions of frames this large are split into
+ * horizontal bands that swscale converts on its own worker threads.  Raw
+ * video inputs each convert on their own thread already, so only a few more
+ * are used. */
+static int get_scale_threads(const struct video_scale_info *src, uint32_t threads_override)
+{
+	if (threads_override)
+		return (int)threads_override;
+	if ((uint64_t)src->width * src->height < 1920 * 1080)
+		return 1;
+
+	int threads = os_get_logical_cores() / 4;
+	return threads < 1 ? 1 : threads > 4 ? 4 : threads;
+}
+
+/* the frames only wrap buffers owned elsewhere, so the buffer references
+ * given to swscale must not free anything */
+static void dummy_free(void *opaque, uint8_t *data)
+{
+	UNUSED_PARAMETER(opaque);
+	UNUSED_PARAMETER(data);
+}
+
 int video_scaler_create(video_scaler_t **scaler_out, const struct video_scale_info *dst,
 			const struct video_scale_info *src, enum video_scale_type type)
+{
+	return video_scaler_create2(scaler_out, dst, src, type, 0);
+}
+
+int video_scaler_create2(video_scaler_t **scaler_out, const struct video_scale_info *dst,
+			 const struct video_scale_info *src, enum video_scale_type type, uint32_t threads)
 {
 	enum AVPixelFormat format_src = get_ffmpeg_video_format(src->format);
 	enum AVPixelFormat format_dst = get_ffmpeg_video_format(dst->format);
@@ -160,7 +192,6 @@ int video_scaler_create(video_scaler_t **scaler_out, const struct video_scale_in
 		return VIDEO_SCALER_BAD_CONVERSION;
 
 	scaler = bzalloc(sizeof(struct video_scaler));
-	scaler->src_height = src->height;
 
 	const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(format_dst);
 	bool has_plane[4] = {0};
@@ -181,6 +212,27 @@ int video_scaler_create(video_scaler_t **scaler_out, const struct video_scale_in
 		goto fail;
 	}
 
+	scaler->src_frame = av_frame_alloc();
+	scaler->dst_frame = av_frame_alloc();
+	if (!scaler->src_frame || !scaler->dst_frame)
+		goto fail;
+
+	scaler->src_frame->format = format_src;
+	scaler->src_frame->width = src->width;
+	scaler->src_frame->height = src->height;
+
+	scaler->dst_frame->format = format_dst;
+	scaler->dst_frame->width = dst->width;
+	scaler->dst_frame->height = dst->height;
+	for (size_t i = 0; i < 4; i++) {
+		scaler->dst_frame->data[i] = scaler->dst_pointers[i];
+		scaler->dst_frame->linesize[i] = scaler->dst_linesizes[i];
+	}
+
+	scaler->dst_frame->buf[0] = av_buffer_create(scaler->dst_pointers[0], ret, dummy_free, NULL, 0);
+	if (!scaler->dst_frame->buf[0])
+		goto fail;
+
 	scaler->swscale = sws_alloc_context();
 	if (!scaler->swscale) {
 		blog(LOG_ERROR, "video_scaler_create: Could not create "
@@ -197,6 +249,7 @@ int video_scaler_create(video_scaler_t **scaler_out, const struct video_scale_in
 	av_opt_set_int(scaler->swscale, "dst_format", format_dst, 0);
 	av_opt_set_int(scaler->swscale, "src_range", range_src, 0);
 	av_opt_set_int(scaler->swscale, "dst_range", range_dst, 0);
+	av_opt_set_int(scaler->swscale, "threads", get_scale_threads(src, threads), 0);
 	if (sws_init_context(scaler->swscale, NULL, NULL) < 0) {
 		blog(LOG_ERROR, "video_scaler_create: sws_init_context failed");
 		goto fail;
@@ -221,6 +274,8 @@ void video_scaler_destroy(video_scaler_t *scaler)
 {
 	if (scaler) {
 		sws_freeContext(scaler->swscale);
+		av_frame_free(&scaler->src_frame);
+		av_frame_free(&scaler->dst_frame);
 
 		if (scaler->dst_pointers[0])
 			av_freep(scaler->dst_pointers);
@@ -235,10 +290,24 @@ bool video_scaler_scale(video_scaler_t *scaler, uint8_t *output[], const uint32_
 	if (!scaler)
 		return false;
 
-	int ret = sws_scale(scaler->swscale, input, (const int *)in_linesize, 0, scaler->src_height,
-			    scaler->dst_pointers, scaler->dst_linesizes);
-	if (ret <= 0) {
-		blog(LOG_ERROR, "video_scaler_scale: sws_scale failed: %d", ret);
+	AVFrame *src_frame = scaler->src_frame;
+
+	for (size_t plane = 0; plane < 4; ++plane) {
+		src_frame->data[plane] = (uint8_t *)input[plane];
+		src_frame->linesize[plane] = (int)in_linesize[plane];
+	}
+
+	/* only sws_scale_frame splits the conversion across swscale's
+	 * threads, sws_scale always converts on the calling thread */
+	src_frame->buf[0] = av_buffer_create(src_frame->data[0], 0, dummy_free, NULL, 0);
+	if (!src_frame->buf[0])
+		return false;
+
+	int ret = sws_scale_frame(scaler->swscale, scaler->dst_frame, src_frame);
+	av_buffer_unref(&src_frame->buf[0]);
+
+	if (ret < 0) {
+		blog(LOG_ERROR, "video_scaler_scale: sws_scale_frame failed: %d", ret);
 		return false;
 	}
 
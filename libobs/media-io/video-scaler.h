@@ -33,6 +33,10 @@ typedef struct video_scaler video_scaler_t;
 
 EXPORT int video_scaler_create(video_scaler_t **scaler, const struct video_scale_info *dst,
 			       const struct video_scale_info *src, enum video_scale_type type);
+/* threads > 1 splits each conversion into horizontal slices that are
+ * processed in parallel, 0 picks the count based on the frame size */
+EXPORT int video_scaler_create2(video_scaler_t **scaler, const struct video_scale_info *dst,
+				const struct video_scale_info *src, enum video_scale_type type, uint32_t threads);
 EXPORT void video_scaler_destroy(video_scaler_t *scaler);
 
 EXPORT bool video_scaler_scale(video_scaler_t *scaler, uint8_t *output[], const uint32_t out_linesize[],
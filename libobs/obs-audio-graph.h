@@ -0,0 +1,120 @@
+/******************************************************************************
+    Copyright (C) 2023 by Lain Bailey <lain@obsproject.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+#include "util/c99defs.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Sorts the audio render order into levels that can each be rendered in
+ * parallel.  A node is on level 0 if it reads no other node while it is
+ * rendered, otherwise one level above the highest of its inputs.  Nodes are
+ * opaque here, the callbacks map them to sources.
+ */
+
+typedef void (*audio_graph_visit_t)(void *input, void *param);
+
+struct audio_graph_ops {
+	void *data;
+
+	/* storage for the level of a node, -1 until it is known */
+	int *(*level)(void *node);
+	/* whether the node is part of the render order being sorted */
+	bool (*in_order)(void *data, void *node);
+	/* calls visit for every node the node reads while it is rendered */
+	void (*enum_inputs)(void *data, void *node, audio_graph_visit_t visit, void *param);
+};
+
+struct audio_graph_level_info {
+	const struct audio_graph_ops *ops;
+	int level;
+};
+
+static inline int audio_graph_get_level(const struct audio_graph_ops *ops, void *node);
+
+static inline void audio_graph_input_level(void *input, void *param)
+{
+	struct audio_graph_level_info *info = param;
+
+	/* inputs that aren't rendered this tick don't need to be waited on */
+	if (info->ops->in_order(info->ops->data, input)) {
+		int level = audio_graph_get_level(info->ops, input) + 1;
+		if (level > info->level)
+			info->level = level;
+	}
+}
+
+/* the level is set to 0 before the inputs are visited, so a cycle ends there
+ * instead of recursing forever */
+static inline int audio_graph_get_level(const struct audio_graph_ops *ops, void *node)
+{
+	struct audio_graph_level_info info = {ops, 0};
+	int *level = ops->level(node);
+
+	if (*level >= 0)
+		return *level;
+
+	*level = 0;
+	ops->enum_inputs(ops->data, node, audio_graph_input_level, &info);
+
+	*level = info.level;
+	return info.level;
+}
+
+/* Writes the nodes to sorted, ordered by level and otherwise kept in their
+ * order, and the end of each level to level_ends.  Both must have room for
+ * count entries.  Returns the number of levels. */
+static inline size_t audio_graph_sort_levels(const struct audio_graph_ops *ops, void **nodes, size_t count,
+					     void **sorted, size_t *level_ends)
+{
+	int max_level = -1;
+	size_t num_levels = 0;
+	size_t num = 0;
+
+	for (size_t i = 0; i < count; i++)
+		*ops->level(nodes[i]) = -1;
+
+	for (size_t i = 0; i < count; i++) {
+		int level = audio_graph_get_level(ops, nodes[i]);
+		if (level > max_level)
+			max_level = level;
+	}
+
+	/* a cycle can leave a level empty, it is skipped so there are never
+	 * more levels than nodes */
+	for (int level = 0; level <= max_level; level++) {
+		size_t level_start = num;
+
+		for (size_t i = 0; i < count; i++) {
+			if (*ops->level(nodes[i]) == level)
+				sorted[num++] = nodes[i];
+		}
+
+		if (num > level_start)
+			level_ends[num_levels++] = num;
+	}
+
+	return num_levels;
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,54 @@
+/******************************************************************************
+    Copyright (C) 2023 by Lain Bailey <lain@obsproject.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+#include "util/sse-intrin.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Adds count floats of aud to mix.  The buffers are offset by the start point
+ * of the source within the tick, so they are not guaranteed to be 16-byte
+ * aligned. */
+static inline void mix_audio_channel(float *mix, const float *aud, size_t count)
+{
+	size_t i = 0;
+
+	for (; i + 16 <= count; i += 16) {
+		__m128 m0 = _mm_add_ps(_mm_loadu_ps(mix + i), _mm_loadu_ps(aud + i));
+		__m128 m1 = _mm_add_ps(_mm_loadu_ps(mix + i + 4), _mm_loadu_ps(aud + i + 4));
+		__m128 m2 = _mm_add_ps(_mm_loadu_ps(mix + i + 8), _mm_loadu_ps(aud + i + 8));
+		__m128 m3 = _mm_add_ps(_mm_loadu_ps(mix + i + 12), _mm_loadu_ps(aud + i + 12));
+
+		_mm_storeu_ps(mix + i, m0);
+		_mm_storeu_ps(mix + i + 4, m1);
+		_mm_storeu_ps(mix + i + 8, m2);
+		_mm_storeu_ps(mix + i + 12, m3);
+	}
+
+	for (; i + 4 <= count; i += 4)
+		_mm_storeu_ps(mix + i, _mm_add_ps(_mm_loadu_ps(mix + i), _mm_loadu_ps(aud + i)));
+
+	for (; i < count; i++)
+		mix[i] += aud[i];
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -18,6 +18,8 @@
 #include <inttypes.h>
 #include "obs-internal.h"
 #include "util/util_uint64.h"
+#include "obs-audio-graph.h"
+#include "obs-audio-mix.h"
 
 struct ts_info {
 	uint64_t start;
@@ -31,10 +33,13 @@ static void push_audio_tree(obs_source_t *parent, obs_source_t *source, void *p)
 {
 	struct obs_core_audio *audio = p;
 
-	if (da_find(audio->render_order, &source, 0) == DARRAY_INVALID) {
+	if (source->audio_graph_mark != audio->graph_mark) {
 		obs_source_t *s = obs_source_get_ref(source);
-		if (s)
+		if (s) {
+			source->audio_graph_mark = audio->graph_mark;
+			os_atomic_set_bool(&source->audio_graph_ref, true);
 			da_push_back(audio->render_order, &s);
+		}
 	}
 
 	UNUSED_PARAMETER(parent);
@@ -45,8 +50,8 @@ static inline size_t convert_time_to_frames(size_t sample_rate, uint64_t t)
 	return (size_t)util_mul_div64(t, sample_rate, 1000000000ULL);
 }
 
-static inline void mix_audio(struct audio_output_data *mixes, obs_source_t *source, size_t channels, size_t sample_rate,
-			     struct ts_info *ts)
+static inline void mix_audio(struct audio_output_data *mixes, obs_source_t *source, uint32_t mixers, size_t channels,
+			     size_t sample_rate, struct ts_info *ts)
 {
 	size_t total_floats = AUDIO_OUTPUT_FRAMES;
 	size_t start_point = 0;
@@ -62,17 +67,19 @@ static inline void mix_audio(struct audio_output_data *mixes, obs_source_t *sour
 		total_floats -= start_point;
 	}
 
+	/* mixes that are inactive or that the source is not assigned to are
+	 * either silent or never read, so don't bother summing them */
+	mixers &= source->audio_mixers;
+
 	for (size_t mix_idx = 0; mix_idx < MAX_AUDIO_MIXES; mix_idx++) {
-		for (size_t ch = 0; ch < channels; ch++) {
-			register float *mix = mixes[mix_idx].data[ch];
-			register float *aud = source->audio_output_buf[mix_idx][ch];
-			register float *end;
+		if ((mixers & (1 << mix_idx)) == 0)
+			continue;
 
-			mix += start_point;
-			end = aud + total_floats;
+		for (size_t ch = 0; ch < channels; ch++) {
+			float *mix = mixes[mix_idx].data[ch] + start_point;
+			const float *aud = source->audio_output_buf[mix_idx][ch];
 
-			while (aud < end)
-				*(mix++) += *(aud++);
+			mix_audio_channel(mix, aud, total_floats);
 		}
 	}
 }
@@ -275,6 +282,44 @@ static inline bool audio_buffering_maxed(struct obs_core_audio *audio)
 	return audio->total_buffering_ticks == audio->max_buffering_ticks;
 }
 
+static void audio_buffering_changed(struct obs_core_audio *audio, size_t sample_rate, int prev_ticks)
+{
+	struct obs_audio_buffering_change change;
+	int ticks = audio->total_buffering_ticks;
+	int ms = (int)(ticks * AUDIO_OUTPUT_FRAMES * 1000 / sample_rate);
+	int prev_ms = (int)(prev_ticks * AUDIO_OUTPUT_FRAMES * 1000 / sample_rate);
+	struct calldata cd;
+	uint8_t stack[128];
+
+	change.timestamp = os_gettime_ns();
+	change.buffering_ms = (uint32_t)ms;
+
+	pthread_mutex_lock(&audio->buffering_stats_mutex);
+
+	audio->buffering_stats_ticks = ticks;
+	if (ticks > audio->buffering_peak_ticks)
+		audio->buffering_peak_ticks = ticks;
+	if (ticks > prev_ticks)
+		audio->buffering_increases++;
+	else
+		audio->buffering_decreases++;
+
+	audio->buffering_history[audio->buffering_history_idx] = change;
+	audio->buffering_history_idx = (audio->buffering_history_idx + 1) % OBS_AUDIO_BUFFERING_HISTORY;
+	if (audio->buffering_history_num < OBS_AUDIO_BUFFERING_HISTORY)
+		audio->buffering_history_num++;
+
+	pthread_mutex_unlock(&audio->buffering_stats_mutex);
+
+	/* the amount of headroom sources have changes with the buffering */
+	audio->headroom_window_start = 0;
+
+	calldata_init_fixed(&cd, stack, sizeof(stack));
+	calldata_set_int(&cd, "buffering_ms", ms);
+	calldata_set_int(&cd, "prev_buffering_ms", prev_ms);
+	signal_handler_signal(obs->signals, "audio_buffering_changed", &cd);
+}
+
 static void set_fixed_audio_buffering(struct obs_core_audio *audio, size_t sample_rate, struct ts_info *ts)
 {
 	struct ts_info new_ts;
@@ -289,6 +334,7 @@ static void set_fixed_audio_buffering(struct obs_core_audio *audio, size_t sampl
 
 	ticks = audio->max_buffering_ticks - audio->total_buffering_ticks;
 	audio->total_buffering_ticks += ticks;
+	audio_buffering_changed(audio, sample_rate, audio->total_buffering_ticks - ticks);
 
 	total_ms = audio->total_buffering_ticks * AUDIO_OUTPUT_FRAMES * 1000 / sample_rate;
 
@@ -344,6 +390,8 @@ static void add_audio_buffering(struct obs_core_audio *audio, size_t sample_rate
 		blog(LOG_WARNING, "Max audio buffering reached!");
 	}
 
+	audio_buffering_changed(audio, sample_rate, audio->total_buffering_ticks - ticks);
+
 	ms = ticks * AUDIO_OUTPUT_FRAMES * 1000 / sample_rate;
 	total_ms = audio->total_buffering_ticks * AUDIO_OUTPUT_FRAMES * 1000 / sample_rate;
 
@@ -379,6 +427,60 @@ static void add_audio_buffering(struct obs_core_audio *audio, size_t sample_rate
 	*ts = new_ts;
 }
 
+/* how much audio a source has buffered past the end of the current tick */
+static void update_source_headroom(struct obs_core_audio *audio, struct obs_source *source, size_t sample_rate,
+				   const struct ts_info *ts)
+{
+	size_t frames = source->audio_input_buf[0].size / sizeof(float);
+	uint64_t headroom = 0;
+
+	if (source->info.audio_render || !source->audio_ts)
+		return;
+
+	/* sources without any audio have stopped rather than fallen behind,
+	 * but a source that only has part of a tick is late */
+	if (source->audio_pending) {
+		if (frames)
+			audio->tick_headroom = 0;
+		return;
+	}
+
+	uint64_t buffered_end = source->audio_ts + audio_frames_to_ns(sample_rate, frames);
+	if (buffered_end > ts->end)
+		headroom = buffered_end - ts->end;
+	if (headroom < audio->tick_headroom)
+		audio->tick_headroom = headroom;
+}
+
+/* how long all sources have to keep at least two ticks of audio ahead of the
+ * rendered tick before buffering is reduced by one tick */
+#define AUDIO_BUFFERING_REDUCE_WINDOW_NS 10000000000ULL
+
+static void reduce_audio_buffering(struct obs_core_audio *audio, size_t sample_rate, const struct ts_info *ts)
+{
+	uint64_t tick_ns = audio_frames_to_ns(sample_rate, AUDIO_OUTPUT_FRAMES);
+
+	if (audio->tick_headroom < audio->headroom_window_min)
+		audio->headroom_window_min = audio->tick_headroom;
+
+	if (!audio->headroom_window_start || ts->start < audio->headroom_window_start) {
+		audio->headroom_window_start = ts->start;
+		audio->headroom_window_min = UINT64_MAX;
+		return;
+	}
+
+	if (ts->start - audio->headroom_window_start < AUDIO_BUFFERING_REDUCE_WINDOW_NS)
+		return;
+
+	/* one tick to output right away and one to spare.  rather than
+	 * skipping audio, the already buffered tick is output immediately,
+	 * so output timestamps stay continuous */
+	if (audio->headroom_window_min >= tick_ns * 2)
+		audio_output_request_extra_tick(audio->audio);
+
+	audio->headroom_window_start = 0;
+}
+
 static bool audio_buffer_insufficient(struct obs_source *source, size_t sample_rate, uint64_t min_ts)
 {
 	size_t total_floats = AUDIO_OUTPUT_FRAMES;
@@ -442,10 +544,26 @@ static inline const char *calc_min_ts(struct obs_core_data *data, size_t sample_
 	return buffering_name;
 }
 
-static inline void release_audio_sources(struct obs_core_audio *audio)
+static void release_audio_sources(struct obs_core_audio *audio)
 {
-	for (size_t i = 0; i < audio->render_order.num; i++)
-		obs_source_release(audio->render_order.array[i]);
+	for (size_t i = 0; i < audio->render_order.num; i++) {
+		obs_source_t *source = audio->render_order.array[i];
+
+		os_atomic_set_bool(&source->audio_graph_ref, false);
+		obs_source_release(source);
+	}
+
+	da_resize(audio->render_order, 0);
+	da_resize(audio->root_nodes, 0);
+}
+
+/* called once the audio thread has stopped, so that the cached render order
+ * doesn't keep sources alive while they're being freed */
+void obs_audio_release_graph(struct obs_core_audio *audio)
+{
+	release_audio_sources(audio);
+	da_resize(audio->graph_level_ends, 0);
+	obs_audio_graph_changed();
 }
 
 static inline void execute_audio_tasks(void)
@@ -465,33 +583,105 @@ static inline void execute_audio_tasks(void)
 	}
 }
 
-bool audio_callback(void *param, uint64_t start_ts_in, uint64_t end_ts_in, uint64_t *out_ts, uint32_t mixers,
-		    struct audio_output_data *mixes)
+struct audio_graph_sort {
+	struct obs_core_audio *audio;
+	DARRAY(obs_source_t *) sidechains;
+};
+
+struct audio_input_enum {
+	audio_graph_visit_t visit;
+	void *param;
+};
+
+static int *source_audio_level(void *node)
 {
-	struct obs_core_data *data = &obs->data;
-	struct obs_core_audio *audio = &obs->audio;
-	struct obs_source *source;
-	size_t sample_rate = audio_output_get_sample_rate(audio->audio);
-	size_t channels = audio_output_get_channels(audio->audio);
-	struct ts_info ts = {start_ts_in, end_ts_in};
-	size_t audio_size;
-	uint64_t min_ts;
+	return &((obs_source_t *)node)->audio_graph_level;
+}
 
-	da_resize(audio->render_order, 0);
-	da_resize(audio->root_nodes, 0);
+static bool source_in_render_order(void *data, void *node)
+{
+	struct audio_graph_sort *sort = data;
+	return ((obs_source_t *)node)->audio_graph_mark == sort->audio->graph_mark;
+}
 
-	deque_push_back(&audio->buffered_timestamps, &ts, sizeof(ts));
-	deque_peek_front(&audio->buffered_timestamps, &ts, sizeof(ts));
-	min_ts = ts.start;
+static void enum_audio_input(obs_source_t *parent, obs_source_t *child, void *param)
+{
+	struct audio_input_enum *input = param;
+	input->visit(child, input->param);
 
-	audio_size = AUDIO_OUTPUT_FRAMES * sizeof(float);
+	UNUSED_PARAMETER(parent);
+}
 
-#if DEBUG_AUDIO == 1
-	blog(LOG_DEBUG, "ts %llu-%llu", ts.start, ts.end);
-#endif
+/* sources with an audio_render or audio_mix callback mix the output of their
+ * active children.  An audio_mix source also runs its filters while it is
+ * rendered, and those may take the audio of a sidechain, which is only sent
+ * to them while the sidechain renders if it's another audio_mix source. */
+static void enum_source_audio_inputs(void *data, void *node, audio_graph_visit_t visit, void *param)
+{
+	struct audio_graph_sort *sort = data;
+	obs_source_t *source = node;
+	struct audio_input_enum input = {visit, param};
 
-	/* ------------------------------------------------ */
-	/* build audio render order */
+	if (!source->info.audio_render && !source->info.audio_mix)
+		return;
+
+	obs_source_enum_active_sources(source, enum_audio_input, &input);
+
+	if (source->info.audio_mix) {
+		for (size_t i = 0; i < sort->sidechains.num; i++) {
+			if (sort->sidechains.array[i] != source)
+				visit(sort->sidechains.array[i], param);
+		}
+	}
+}
+
+static inline bool audio_captured(obs_source_t *source)
+{
+	bool captured;
+
+	pthread_mutex_lock(&source->audio_cb_mutex);
+	captured = source->audio_cb_list.num > 0;
+	pthread_mutex_unlock(&source->audio_cb_mutex);
+	return captured;
+}
+
+static void sort_audio_graph_levels(struct obs_core_audio *audio)
+{
+	struct audio_graph_sort sort = {audio};
+	struct audio_graph_ops ops = {&sort, source_audio_level, source_in_render_order, enum_source_audio_inputs};
+	DARRAY(obs_source_t *) sorted = {0};
+	size_t num = audio->render_order.num;
+	size_t levels;
+
+	for (size_t i = 0; i < num; i++) {
+		obs_source_t *source = audio->render_order.array[i];
+		if (source->info.audio_mix && audio_captured(source))
+			da_push_back(sort.sidechains, &source);
+	}
+
+	da_resize(sorted, num);
+	da_resize(audio->graph_level_ends, num);
+
+	levels = audio_graph_sort_levels(&ops, (void **)audio->render_order.array, num, (void **)sorted.array,
+					 audio->graph_level_ends.array);
+
+	da_resize(audio->graph_level_ends, levels);
+	da_move(audio->render_order, sorted);
+	da_free(sort.sidechains);
+}
+
+static void rebuild_audio_graph(struct obs_core_audio *audio)
+{
+	struct obs_core_data *data = &obs->data;
+	struct obs_source *source;
+
+	/* released first, so that sources only the old render order kept
+	 * alive are destroyed and gone from the audio source list */
+	release_audio_sources(audio);
+
+	/* a new mark makes every source look unvisited without having to
+	 * search the render order for each one */
+	audio->graph_mark++;
 
 	pthread_mutex_lock(&obs->video.mixes_mutex);
 	for (size_t j = 0; j < obs->video.mixes.num; j++) {
@@ -512,7 +702,9 @@ bool audio_callback(void *param, uint64_t start_ts_in, uint64_t end_ts_in, uint6
 			obs_source_enum_active_tree(source, push_audio_tree, audio);
 			push_audio_tree(NULL, source, audio);
 
-			if (obs->video.mixes.array[j] == obs->video.main_mix)
+			/* only mixed if the render order holds a reference */
+			if (obs->video.mixes.array[j] == obs->video.main_mix &&
+			    source->audio_graph_mark == audio->graph_mark)
 				da_push_back(audio->root_nodes, &source);
 		}
 		pthread_mutex_unlock(&view->channels_mutex);
@@ -529,39 +721,234 @@ bool audio_callback(void *param, uint64_t start_ts_in, uint64_t end_ts_in, uint6
 
 	pthread_mutex_unlock(&data->audio_sources_mutex);
 
-	/* ------------------------------------------------ */
-	/* render audio data */
-	for (size_t i = 0; i < audio->render_order.num; i++) {
-		obs_source_t *source = audio->render_order.array[i];
-		obs_source_audio_render(source, mixers, channels, sample_rate, audio_size);
-
-		/* if a source has gone backward in time and we can no
-		 * longer buffer, drop some or all of its audio */
-		if (audio_buffering_maxed(audio) && source->audio_ts != 0 && source->audio_ts < ts.start) {
-			if (source->info.audio_render) {
-				blog(LOG_DEBUG,
-				     "render audio source %s timestamp has "
-				     "gone backwards",
-				     obs_source_get_name(source));
-
-				/* just avoid further damage */
-				source->audio_pending = true;
+	sort_audio_graph_levels(audio);
+}
+
+static const char *build_audio_graph_name = "build_audio_graph";
+static const char *rebuild_audio_graph_name = "rebuild_audio_graph";
+
+static void build_audio_graph(struct obs_core_audio *audio)
+{
+	long generation = os_atomic_load_long(&audio->graph_generation);
+
+	profile_start(build_audio_graph_name);
+
+	/* a change is usually reported before it is fully applied (e.g. a
+	 * scene item is activated before it's visible), so also rebuild on
+	 * the tick after it */
+	if (generation != audio->graph_generation_built) {
+		audio->graph_generation_built = generation;
+		audio->graph_rebuild_ticks = 2;
+	}
+
+	if (audio->graph_rebuild_ticks > 0) {
+		profile_start(rebuild_audio_graph_name);
+		rebuild_audio_graph(audio);
+		profile_end(rebuild_audio_graph_name);
+
+		audio->graph_rebuild_ticks--;
+	}
+
+	profile_end(build_audio_graph_name);
+}
+
+struct audio_render_params {
+	uint32_t mixers;
+	size_t channels;
+	size_t sample_rate;
+	size_t size;
+	uint64_t ts;
+};
+
+static void render_audio_source(struct obs_core_audio *audio, obs_source_t *source,
+				const struct audio_render_params *params)
+{
+	const uint64_t start = source_profiler_source_audio_render_begin();
+
+	obs_source_audio_render(source, params->mixers, params->channels, params->sample_rate, params->size);
+
+	/* if a source has gone backward in time and we can no
+	 * longer buffer, drop some or all of its audio */
+	if (audio_buffering_maxed(audio) && source->audio_ts != 0 && source->audio_ts < params->ts) {
+		if (source->info.audio_render) {
+			blog(LOG_DEBUG,
+			     "render audio source %s timestamp has "
+			     "gone backwards",
+			     obs_source_get_name(source));
+
+			/* just avoid further damage */
+			source->audio_pending = true;
 #if DEBUG_AUDIO == 1
-				/* this should really be fixed */
-				assert(false);
+			/* this should really be fixed */
+			assert(false);
 #endif
-			} else {
-				pthread_mutex_lock(&source->audio_buf_mutex);
-				bool rerender = ignore_audio(source, channels, sample_rate, ts.start);
-				pthread_mutex_unlock(&source->audio_buf_mutex);
-
-				/* if we (potentially) recovered, re-render */
-				if (rerender)
-					obs_source_audio_render(source, mixers, channels, sample_rate, audio_size);
-			}
+		} else {
+			pthread_mutex_lock(&source->audio_buf_mutex);
+			bool rerender = ignore_audio(source, params->channels, params->sample_rate, params->ts);
+			pthread_mutex_unlock(&source->audio_buf_mutex);
+
+			/* if we (potentially) recovered, re-render */
+			if (rerender)
+				obs_source_audio_render(source, params->mixers, params->channels, params->sample_rate,
+							params->size);
+		}
+	}
+
+	source_profiler_source_audio_render_end(source, start);
+}
+
+/* One level of the render order, shared between the audio thread and the
+ * pool workers helping it.  Sources are claimed one at a time, so a worker
+ * that only gets to run after the level is done simply finds nothing left.
+ * The job is reference counted for those late workers. */
+struct audio_render_job {
+	volatile long refs;
+	volatile long next;
+	volatile long remaining;
+	long count;
+
+	struct obs_core_audio *audio;
+	obs_source_t **sources;
+	struct audio_render_params params;
+};
+
+static void audio_render_job_release(struct audio_render_job *job)
+{
+	if (os_atomic_dec_long(&job->refs) == 0)
+		bfree(job);
+}
+
+static void audio_render_job_run(struct audio_render_job *job)
+{
+	for (;;) {
+		long idx = os_atomic_inc_long(&job->next) - 1;
+		if (idx >= job->count)
+			break;
+
+		render_audio_source(job->audio, job->sources[idx], &job->params);
+
+		if (os_atomic_dec_long(&job->remaining) == 0)
+			os_event_signal(job->audio->render_done);
+	}
+}
+
+static void audio_render_task(void *param)
+{
+	struct audio_render_job *job = param;
+
+	audio_render_job_run(job);
+	audio_render_job_release(job);
+}
+
+static void render_audio_level_parallel(struct obs_core_audio *audio, obs_source_t **sources, size_t count,
+					size_t helpers, const struct audio_render_params *params)
+{
+	struct audio_render_job *job = bzalloc(sizeof(*job));
+
+	job->refs = (long)helpers + 1;
+	job->count = (long)count;
+	job->remaining = (long)count;
+	job->audio = audio;
+	job->sources = sources;
+	job->params = *params;
+
+	for (size_t i = 0; i < helpers; i++) {
+		if (!os_task_pool_queue_task(obs->task_pool, OS_TASK_PRIORITY_HIGH, audio_render_task, job))
+			audio_render_job_release(job);
+	}
+
+	/* the audio thread renders as well, and only waits for sources that
+	 * are still being rendered by a worker */
+	audio_render_job_run(job);
+	os_event_wait(audio->render_done);
+
+	audio_render_job_release(job);
+}
+
+static const char *render_audio_sources_name = "render_audio_sources";
+static const char *render_audio_sources_parallel_name = "render_audio_sources_parallel";
+
+static void render_audio_sources(struct obs_core_audio *audio, uint32_t mixers, size_t channels, size_t sample_rate,
+				 size_t size, uint64_t ts)
+{
+	struct audio_render_params params = {mixers, channels, sample_rate, size, ts};
+	struct os_task_pool_stats stats = {0};
+	bool parallel = os_atomic_load_bool(&obs->parallel_audio_render) && obs->task_pool;
+	size_t level_start = 0;
+
+	if (parallel) {
+		os_task_pool_get_stats(obs->task_pool, &stats);
+		parallel = stats.num_threads > 0;
+	}
+
+	if (!parallel) {
+		profile_start(render_audio_sources_name);
+		for (size_t i = 0; i < audio->render_order.num; i++)
+			render_audio_source(audio, audio->render_order.array[i], &params);
+		profile_end(render_audio_sources_name);
+		return;
+	}
+
+	profile_start(render_audio_sources_parallel_name);
+
+	for (size_t i = 0; i < audio->graph_level_ends.num; i++) {
+		size_t level_end = audio->graph_level_ends.array[i];
+		size_t count = level_end - level_start;
+		obs_source_t **sources = audio->render_order.array + level_start;
+
+		if (count == 1) {
+			render_audio_source(audio, sources[0], &params);
+		} else if (count > 1) {
+			size_t helpers = count - 1;
+			if (helpers > stats.num_threads)
+				helpers = stats.num_threads;
+
+			render_audio_level_parallel(audio, sources, count, helpers, &params);
 		}
+
+		level_start = level_end;
 	}
 
+	profile_end(render_audio_sources_parallel_name);
+}
+
+bool audio_callback(void *param, uint64_t start_ts_in, uint64_t end_ts_in, uint64_t *out_ts, uint32_t mixers,
+		    struct audio_output_data *mixes)
+{
+	struct obs_core_data *data = &obs->data;
+	struct obs_core_audio *audio = &obs->audio;
+	struct obs_source *source;
+	size_t sample_rate = audio_output_get_sample_rate(audio->audio);
+	size_t channels = audio_output_get_channels(audio->audio);
+	struct ts_info ts = {start_ts_in, end_ts_in};
+	bool extra_tick = start_ts_in == end_ts_in;
+	size_t audio_size;
+	uint64_t min_ts;
+
+	/* an extra tick outputs the next buffered tick early instead of
+	 * waiting for the next period, which reduces buffering by one tick */
+	if (extra_tick && (!audio->buffered_timestamps.size || audio->buffering_wait_ticks))
+		return false;
+
+	if (!extra_tick)
+		deque_push_back(&audio->buffered_timestamps, &ts, sizeof(ts));
+	deque_peek_front(&audio->buffered_timestamps, &ts, sizeof(ts));
+	min_ts = ts.start;
+
+	audio_size = AUDIO_OUTPUT_FRAMES * sizeof(float);
+
+#if DEBUG_AUDIO == 1
+	blog(LOG_DEBUG, "ts %llu-%llu", ts.start, ts.end);
+#endif
+
+	/* ------------------------------------------------ */
+	/* build audio render order */
+	build_audio_graph(audio);
+
+	/* ------------------------------------------------ */
+	/* render audio data */
+	render_audio_sources(audio, mixers, channels, sample_rate, audio_size, ts.start);
+
 	/* ------------------------------------------------ */
 	/* get minimum audio timestamp */
 	pthread_mutex_lock(&data->audio_sources_mutex);
@@ -590,7 +977,7 @@ bool audio_callback(void *param, uint64_t start_ts_in, uint64_t end_ts_in, uint6
 			pthread_mutex_lock(&source->audio_buf_mutex);
 
 			if (source->audio_output_buf[0][0] && source->audio_ts)
-				mix_audio(mixes, source, channels, sample_rate, &ts);
+				mix_audio(mixes, source, mixers, channels, sample_rate, &ts);
 
 			pthread_mutex_unlock(&source->audio_buf_mutex);
 		}
@@ -600,9 +987,12 @@ bool audio_callback(void *param, uint64_t start_ts_in, uint64_t end_ts_in, uint6
 	/* discard audio */
 	pthread_mutex_lock(&data->audio_sources_mutex);
 
+	audio->tick_headroom = UINT64_MAX;
+
 	source = data->first_audio_source;
 	while (source) {
 		pthread_mutex_lock(&source->audio_buf_mutex);
+		update_source_headroom(audio, source, sample_rate, &ts);
 		discard_audio(audio, source, channels, sample_rate, &ts);
 		pthread_mutex_unlock(&source->audio_buf_mutex);
 
@@ -611,14 +1001,24 @@ bool audio_callback(void *param, uint64_t start_ts_in, uint64_t end_ts_in, uint6
 
 	pthread_mutex_unlock(&data->audio_sources_mutex);
 
-	/* ------------------------------------------------ */
-	/* release audio sources */
-	release_audio_sources(audio);
-
 	deque_pop_front(&audio->buffered_timestamps, NULL, sizeof(ts));
 
 	*out_ts = ts.start;
 
+	if (extra_tick) {
+		audio->total_buffering_ticks--;
+		audio_buffering_changed(audio, sample_rate, audio->total_buffering_ticks + 1);
+
+		blog(LOG_INFO,
+		     "removing %d milliseconds of audio buffering, total "
+		     "audio buffering is now %d milliseconds",
+		     (int)(AUDIO_OUTPUT_FRAMES * 1000 / sample_rate),
+		     (int)(audio->total_buffering_ticks * AUDIO_OUTPUT_FRAMES * 1000 / sample_rate));
+	} else if (!audio->fixed_buffer && !audio->buffering_wait_ticks && audio->total_buffering_ticks > 0 &&
+		   os_atomic_load_bool(&obs->adaptive_audio_buffering)) {
+		reduce_audio_buffering(audio, sample_rate, &ts);
+	}
+
 	if (audio->buffering_wait_ticks) {
 		audio->buffering_wait_ticks--;
 		return false;
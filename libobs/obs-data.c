@@ -21,6 +21,7 @@
 #include "util/darray.h"
 #include "util/platform.h"
 #include "util/uthash.h"
+#include "util/array-serializer.h"
 #include "graphics/vec2.h"
 #include "graphics/vec3.h"
 #include "graphics/vec4.h"
@@ -29,10 +30,13 @@
 
 #include <jansson.h>
 
+struct obs_data_arena;
+
 struct obs_data_item {
 	volatile long ref;
 	const char *name;
 	struct obs_data *parent;
+	struct obs_data_arena *arena;
 	UT_hash_handle hh;
 	enum obs_data_type type;
 	size_t name_len;
@@ -48,6 +52,7 @@ struct obs_data {
 	volatile long ref;
 	char *json;
 	struct obs_data_item *items;
+	struct obs_data_arena *arena;
 };
 
 struct obs_data_array {
@@ -63,6 +68,135 @@ struct obs_data_number {
 	};
 };
 
+/* ------------------------------------------------------------------------- */
+/* Arena allocation
+ *
+ * Objects created with obs_data_create_arena() carve their items, and any
+ * child objects libobs creates on their behalf, out of a few shared blocks
+ * instead of allocating each one separately.  Every object and item placed
+ * in the arena holds a reference to it, and all blocks are freed together
+ * once the last of them is released.
+ *
+ * Nothing in an arena is ever reused; an item that outgrows its allocation
+ * is simply copied to a new one.  Once an arena reaches
+ * OBS_DATA_ARENA_MAX_SIZE further allocations go to the heap instead, which
+ * keeps the waste of a long-lived, frequently modified object bounded. */
+
+#define OBS_DATA_ARENA_MIN_BLOCK 4096
+#define OBS_DATA_ARENA_MAX_BLOCK 65536
+#define OBS_DATA_ARENA_MAX_SIZE (1024 * 1024)
+
+struct obs_data_arena_block {
+	struct obs_data_arena_block *next;
+};
+
+static inline size_t arena_align_size(size_t size)
+{
+	const size_t alignment = base_get_alignment();
+	return (size + alignment - 1) & ~(alignment - 1);
+}
+
+/* the first block directly follows the arena structure */
+struct obs_data_arena {
+	volatile long ref;
+	pthread_mutex_t mutex;
+	struct obs_data_arena_block *blocks;
+	uint8_t *cur;
+	size_t remaining;
+	size_t block_size;
+	size_t total_size;
+};
+
+static struct obs_data_arena *obs_data_arena_create(void)
+{
+	size_t header_size = arena_align_size(sizeof(struct obs_data_arena));
+	struct obs_data_arena *arena = bmalloc(header_size + OBS_DATA_ARENA_MIN_BLOCK);
+
+	memset(arena, 0, sizeof(struct obs_data_arena));
+	arena->ref = 1;
+	arena->cur = (uint8_t *)arena + header_size;
+	arena->remaining = OBS_DATA_ARENA_MIN_BLOCK;
+	arena->block_size = OBS_DATA_ARENA_MIN_BLOCK * 2;
+	arena->total_size = OBS_DATA_ARENA_MIN_BLOCK;
+
+	pthread_mutex_init_value(&arena->mutex);
+	if (pthread_mutex_init(&arena->mutex, NULL) != 0) {
+		bfree(arena);
+		return NULL;
+	}
+	return arena;
+}
+
+static void obs_data_arena_release(struct obs_data_arena *arena)
+{
+	if (os_atomic_dec_long(&arena->ref) != 0)
+		return;
+
+	struct obs_data_arena_block *block = arena->blocks;
+	while (block) {
+		struct obs_data_arena_block *next = block->next;
+		bfree(block);
+		block = next;
+	}
+
+	pthread_mutex_destroy(&arena->mutex);
+	bfree(arena);
+}
+
+/* returns zeroed memory and takes a reference on the arena, or NULL if the
+ * allocation should go to the heap instead */
+static void *obs_data_arena_alloc(struct obs_data_arena *arena, size_t size)
+{
+	size_t header_size = arena_align_size(sizeof(struct obs_data_arena_block));
+	uint8_t *ptr = NULL;
+
+	size = arena_align_size(size);
+	if (size > OBS_DATA_ARENA_MAX_BLOCK / 4)
+		return NULL;
+
+	pthread_mutex_lock(&arena->mutex);
+
+	if (size > arena->remaining && arena->total_size < OBS_DATA_ARENA_MAX_SIZE) {
+		struct obs_data_arena_block *block = bmalloc(header_size + arena->block_size);
+		block->next = arena->blocks;
+		arena->blocks = block;
+
+		arena->cur = (uint8_t *)block + header_size;
+		arena->remaining = arena->block_size;
+		arena->total_size += arena->block_size;
+
+		if (arena->block_size < OBS_DATA_ARENA_MAX_BLOCK)
+			arena->block_size *= 2;
+	}
+
+	if (size <= arena->remaining) {
+		ptr = arena->cur;
+		arena->cur += size;
+		arena->remaining -= size;
+		os_atomic_inc_long(&arena->ref);
+	}
+
+	pthread_mutex_unlock(&arena->mutex);
+
+	if (ptr)
+		memset(ptr, 0, size);
+	return ptr;
+}
+
+/* creates an object in the same arena as its parent, if any */
+static obs_data_t *obs_data_create_in(struct obs_data_arena *arena)
+{
+	struct obs_data *data = arena ? obs_data_arena_alloc(arena, sizeof(struct obs_data)) : NULL;
+
+	if (data)
+		data->arena = arena;
+	else
+		data = bzalloc(sizeof(struct obs_data));
+
+	data->ref = 1;
+	return data;
+}
+
 /* ------------------------------------------------------------------------- */
 /* Item structure, designed to be one allocation only */
 
@@ -261,10 +395,11 @@ static inline void item_autoselect_data_addref(struct obs_data_item *item)
 	}
 }
 
-static struct obs_data_item *obs_data_item_create(const char *name, const void *data, size_t size,
-						  enum obs_data_type type, bool default_data, bool autoselect_data)
+static struct obs_data_item *obs_data_item_create(struct obs_data_arena *arena, const char *name, const void *data,
+						  size_t size, enum obs_data_type type, bool default_data,
+						  bool autoselect_data)
 {
-	struct obs_data_item *item;
+	struct obs_data_item *item = NULL;
 	size_t name_size, total_size;
 
 	if (!name || !data)
@@ -273,7 +408,10 @@ static struct obs_data_item *obs_data_item_create(const char *name, const void *
 	name_size = get_name_align_size(name);
 	total_size = name_size + sizeof(struct obs_data_item) + size;
 
-	item = bzalloc(total_size);
+	if (arena && (item = obs_data_arena_alloc(arena, total_size)))
+		item->arena = arena;
+	else
+		item = bzalloc(total_size);
 
 	item->capacity = total_size;
 	item->type = type;
@@ -329,7 +467,19 @@ static struct obs_data_item *obs_data_item_ensure_capacity(struct obs_data_item
 	struct obs_data *parent = item->parent;
 	obs_data_item_detach(item);
 
-	new_item = brealloc(item, new_size);
+	if (item->arena) {
+		struct obs_data_arena *arena = item->arena;
+
+		void *mem = obs_data_arena_alloc(arena, new_size);
+
+		new_item = mem ? mem : bmalloc(new_size);
+		memcpy(new_item, item, item->capacity);
+		new_item->arena = mem ? arena : NULL;
+		obs_data_arena_release(arena);
+	} else {
+		new_item = brealloc(item, new_size);
+	}
+
 	new_item->capacity = new_size;
 	new_item->name = get_item_name(new_item);
 
@@ -347,7 +497,11 @@ static inline void obs_data_item_destroy(struct obs_data_item *item)
 	item_default_data_release(item);
 	item_autoselect_data_release(item);
 	obs_data_item_detach(item);
-	bfree(item);
+
+	if (item->arena)
+		obs_data_arena_release(item->arena);
+	else
+		bfree(item);
 }
 
 static inline void move_data(obs_data_item_t *old_item, void *old_data, obs_data_item_t *item, void *data, size_t len)
@@ -454,7 +608,7 @@ static inline void obs_data_add_json_object_data(obs_data_t *data, json_t *jobj)
 
 static inline void obs_data_add_json_object(obs_data_t *data, const char *key, json_t *jobj)
 {
-	obs_data_t *sub_obj = obs_data_create();
+	obs_data_t *sub_obj = obs_data_create_in(data->arena);
 
 	obs_data_add_json_object_data(sub_obj, jobj);
 	obs_data_set_obj(data, key, sub_obj);
@@ -473,7 +627,7 @@ static void obs_data_add_json_array(obs_data_t *data, const char *key, json_t *j
 		if (!json_is_object(jitem))
 			continue;
 
-		item = obs_data_create();
+		item = obs_data_create_in(data->arena);
 		obs_data_add_json_object_data(item, jitem);
 		obs_data_array_push_back(array, item);
 		obs_data_release(item);
@@ -583,6 +737,250 @@ static json_t *obs_data_to_json(obs_data_t *data, bool with_defaults)
 	return json;
 }
 
+/* ------------------------------------------------------------------------- */
+/* Binary snapshot format
+ *
+ * Little-endian, no alignment padding, so it can be read straight out of a
+ * single buffer without tokenizing:
+ *
+ *   header: "OBSD" u32(version)
+ *   object: u32(count) item[count]
+ *   item:   u8(type) string(name) value
+ *   string: u32(len) bytes[len] '\0'
+ *   value:  string | u8(num type) u64(int or double bits) | u8(bool) |
+ *           object | u32(count) object[count]
+ *
+ * Only user values are stored, same as obs_data_save_json(). */
+
+#define OBS_DATA_BINARY_MAGIC "OBSD"
+#define OBS_DATA_BINARY_VERSION 1
+
+static void obs_data_write_binary(struct serializer *s, obs_data_t *data);
+
+static inline void write_binary_string(struct serializer *s, const char *str)
+{
+	uint32_t len = (uint32_t)strlen(str);
+
+	s_wl32(s, len);
+	s_write(s, str, len + 1);
+}
+
+static inline void write_binary_number(struct serializer *s, obs_data_item_t *item)
+{
+	enum obs_data_number_type type = obs_data_item_numtype(item);
+
+	s_w8(s, (uint8_t)type);
+	if (type == OBS_DATA_NUM_INT)
+		s_wl64(s, (uint64_t)obs_data_item_get_int(item));
+	else
+		s_wld(s, obs_data_item_get_double(item));
+}
+
+static inline void write_binary_obj(struct serializer *s, obs_data_item_t *item)
+{
+	obs_data_t *obj = obs_data_item_get_obj(item);
+	obs_data_write_binary(s, obj);
+	obs_data_release(obj);
+}
+
+static inline void write_binary_array(struct serializer *s, obs_data_item_t *item)
+{
+	obs_data_array_t *array = obs_data_item_get_array(item);
+	size_t count = obs_data_array_count(array);
+
+	s_wl32(s, (uint32_t)count);
+
+	for (size_t idx = 0; idx < count; idx++) {
+		obs_data_t *sub_item = obs_data_array_item(array, idx);
+		obs_data_write_binary(s, sub_item);
+		obs_data_release(sub_item);
+	}
+
+	obs_data_array_release(array);
+}
+
+static void obs_data_write_binary(struct serializer *s, obs_data_t *data)
+{
+	obs_data_item_t *item = NULL;
+	obs_data_item_t *temp = NULL;
+	uint32_t count = 0;
+
+	if (!data) {
+		s_wl32(s, 0);
+		return;
+	}
+
+	HASH_ITER (hh, data->items, item, temp) {
+		if (obs_data_item_has_user_value(item))
+			count++;
+	}
+
+	s_wl32(s, count);
+
+	HASH_ITER (hh, data->items, item, temp) {
+		enum obs_data_type type = obs_data_item_gettype(item);
+
+		if (!obs_data_item_has_user_value(item))
+			continue;
+
+		s_w8(s, (uint8_t)type);
+		write_binary_string(s, get_item_name(item));
+
+		if (type == OBS_DATA_STRING)
+			write_binary_string(s, obs_data_item_get_string(item));
+		else if (type == OBS_DATA_NUMBER)
+			write_binary_number(s, item);
+		else if (type == OBS_DATA_BOOLEAN)
+			s_w8(s, obs_data_item_get_bool(item));
+		else if (type == OBS_DATA_OBJECT)
+			write_binary_obj(s, item);
+		else if (type == OBS_DATA_ARRAY)
+			write_binary_array(s, item);
+	}
+}
+
+struct binary_reader {
+	const uint8_t *data;
+	size_t size;
+	size_t pos;
+	bool error;
+};
+
+static inline const uint8_t *read_binary_bytes(struct binary_reader *r, size_t size)
+{
+	const uint8_t *ptr;
+
+	if (r->error || size > r->size - r->pos) {
+		r->error = true;
+		return NULL;
+	}
+
+	ptr = r->data + r->pos;
+	r->pos += size;
+	return ptr;
+}
+
+static inline uint8_t read_binary_u8(struct binary_reader *r)
+{
+	const uint8_t *ptr = read_binary_bytes(r, 1);
+	return ptr ? *ptr : 0;
+}
+
+static inline uint32_t read_binary_u32(struct binary_reader *r)
+{
+	const uint8_t *ptr = read_binary_bytes(r, 4);
+	if (!ptr)
+		return 0;
+
+	return (uint32_t)ptr[0] | ((uint32_t)ptr[1] << 8) | ((uint32_t)ptr[2] << 16) | ((uint32_t)ptr[3] << 24);
+}
+
+static inline uint64_t read_binary_u64(struct binary_reader *r)
+{
+	uint64_t lo = read_binary_u32(r);
+	uint64_t hi = read_binary_u32(r);
+	return lo | (hi << 32);
+}
+
+/* strings are stored null-terminated, so they are used in place */
+static inline const char *read_binary_string(struct binary_reader *r)
+{
+	uint32_t len = read_binary_u32(r);
+	const char *str = (const char *)read_binary_bytes(r, (size_t)len + 1);
+
+	if (str && str[len] != 0) {
+		r->error = true;
+		return NULL;
+	}
+
+	return str;
+}
+
+static bool obs_data_read_binary(struct binary_reader *r, obs_data_t *data, int depth);
+
+static inline void read_binary_obj(struct binary_reader *r, obs_data_t *data, const char *name, int depth)
+{
+	obs_data_t *obj = obs_data_create_in(data->arena);
+
+	if (obs_data_read_binary(r, obj, depth + 1))
+		obs_data_set_obj(data, name, obj);
+	obs_data_release(obj);
+}
+
+static inline void read_binary_array(struct binary_reader *r, obs_data_t *data, const char *name, int depth)
+{
+	obs_data_array_t *array = obs_data_array_create();
+	uint32_t count = read_binary_u32(r);
+
+	/* every object takes at least four bytes */
+	if (count > (r->size - r->pos) / 4)
+		r->error = true;
+	else
+		da_reserve(array->objects, count);
+
+	for (uint32_t i = 0; i < count && !r->error; i++) {
+		obs_data_t *item = obs_data_create_in(data->arena);
+		if (obs_data_read_binary(r, item, depth + 1))
+			obs_data_array_push_back(array, item);
+		obs_data_release(item);
+	}
+
+	if (!r->error)
+		obs_data_set_array(data, name, array);
+	obs_data_array_release(array);
+}
+
+static bool obs_data_read_binary(struct binary_reader *r, obs_data_t *data, int depth)
+{
+	uint32_t count = read_binary_u32(r);
+
+	/* the writer never nests this deep; guard against corrupt files */
+	if (depth > 256)
+		r->error = true;
+
+	for (uint32_t i = 0; i < count && !r->error; i++) {
+		enum obs_data_type type = (enum obs_data_type)read_binary_u8(r);
+		const char *name = read_binary_string(r);
+
+		if (r->error)
+			break;
+
+		if (type == OBS_DATA_STRING) {
+			const char *val = read_binary_string(r);
+			if (val)
+				obs_data_set_string(data, name, val);
+
+		} else if (type == OBS_DATA_NUMBER) {
+			uint8_t num_type = read_binary_u8(r);
+			uint64_t val = read_binary_u64(r);
+
+			if (num_type == OBS_DATA_NUM_INT) {
+				obs_data_set_int(data, name, (long long)val);
+			} else if (num_type == OBS_DATA_NUM_DOUBLE) {
+				double d;
+				memcpy(&d, &val, sizeof(d));
+				obs_data_set_double(data, name, d);
+			} else {
+				r->error = true;
+			}
+
+		} else if (type == OBS_DATA_BOOLEAN) {
+			obs_data_set_bool(data, name, read_binary_u8(r) != 0);
+
+		} else if (type == OBS_DATA_OBJECT) {
+			read_binary_obj(r, data, name, depth);
+
+		} else if (type == OBS_DATA_ARRAY) {
+			read_binary_array(r, data, name, depth);
+
+		} else {
+			r->error = true;
+		}
+	}
+
+	return !r->error;
+}
+
 /* ------------------------------------------------------------------------- */
 
 obs_data_t *obs_data_create()
@@ -593,6 +991,19 @@ obs_data_t *obs_data_create()
 	return data;
 }
 
+obs_data_t *obs_data_create_arena()
+{
+	struct obs_data_arena *arena = obs_data_arena_create();
+	obs_data_t *data;
+
+	if (!arena)
+		return obs_data_create();
+
+	data = obs_data_create_in(arena);
+	obs_data_arena_release(arena);
+	return data;
+}
+
 obs_data_t *obs_data_create_from_json(const char *json_string)
 {
 	obs_data_t *data = obs_data_create();
@@ -657,6 +1068,59 @@ obs_data_t *obs_data_create_from_json_file_safe(const char *json_file, const cha
 	return file_data;
 }
 
+obs_data_t *obs_data_create_from_binary(const void *binary, size_t size)
+{
+	struct binary_reader reader = {binary, size, 0, false};
+	const uint8_t *magic = read_binary_bytes(&reader, 4);
+	uint32_t version = read_binary_u32(&reader);
+	obs_data_t *data;
+
+	if (!magic || memcmp(magic, OBS_DATA_BINARY_MAGIC, 4) != 0 || version != OBS_DATA_BINARY_VERSION) {
+		blog(LOG_ERROR, "obs-data.c: [obs_data_create_from_binary] "
+				"Invalid header or unsupported version");
+		return NULL;
+	}
+
+	data = obs_data_create();
+
+	if (!obs_data_read_binary(&reader, data, 0)) {
+		blog(LOG_ERROR,
+		     "obs-data.c: [obs_data_create_from_binary] "
+		     "Failed reading binary data at offset %zu",
+		     reader.pos);
+		obs_data_release(data);
+		data = NULL;
+	}
+
+	return data;
+}
+
+obs_data_t *obs_data_create_from_binary_file(const char *binary_file)
+{
+	FILE *f = os_fopen(binary_file, "rb");
+	obs_data_t *data = NULL;
+	uint8_t *file_data;
+	int64_t size;
+
+	if (!f)
+		return NULL;
+
+	size = os_fgetsize(f);
+	if (size <= 0) {
+		fclose(f);
+		return NULL;
+	}
+
+	/* one read of the whole file, parsed in place */
+	file_data = bmalloc((size_t)size);
+	if (fread(file_data, 1, (size_t)size, f) == (size_t)size)
+		data = obs_data_create_from_binary(file_data, (size_t)size);
+
+	bfree(file_data);
+	fclose(f);
+	return data;
+}
+
 void obs_data_addref(obs_data_t *data)
 {
 	if (data)
@@ -674,7 +1138,11 @@ static inline void obs_data_destroy(struct obs_data *data)
 
 	/* NOTE: don't use bfree for json text, allocated by json */
 	free(data->json);
-	bfree(data);
+
+	if (data->arena)
+		obs_data_arena_release(data->arena);
+	else
+		bfree(data);
 }
 
 void obs_data_release(obs_data_t *data)
@@ -767,6 +1235,45 @@ bool obs_data_save_json_pretty_safe(obs_data_t *data, const char *file, const ch
 	return false;
 }
 
+static inline void obs_data_get_binary(obs_data_t *data, struct array_output_data *output)
+{
+	struct serializer s;
+
+	array_output_serializer_init(&s, output);
+	s_write(&s, OBS_DATA_BINARY_MAGIC, 4);
+	s_wl32(&s, OBS_DATA_BINARY_VERSION);
+	obs_data_write_binary(&s, data);
+}
+
+bool obs_data_save_binary(obs_data_t *data, const char *file)
+{
+	struct array_output_data output;
+	bool success;
+
+	if (!data)
+		return false;
+
+	obs_data_get_binary(data, &output);
+	success = os_quick_write_utf8_file(file, (const char *)output.bytes.array, output.bytes.num, false);
+	array_output_serializer_free(&output);
+	return success;
+}
+
+bool obs_data_save_binary_safe(obs_data_t *data, const char *file, const char *temp_ext, const char *backup_ext)
+{
+	struct array_output_data output;
+	bool success;
+
+	if (!data)
+		return false;
+
+	obs_data_get_binary(data, &output);
+	success = os_quick_write_utf8_file_safe(file, (const char *)output.bytes.array, output.bytes.num, false,
+						temp_ext, backup_ext);
+	array_output_serializer_free(&output);
+	return success;
+}
+
 static void get_defaults_array_cb(obs_data_t *data, void *vp)
 {
 	obs_data_array_t *defs = (obs_data_array_t *)vp;
@@ -779,7 +1286,7 @@ static void get_defaults_array_cb(obs_data_t *data, void *vp)
 
 obs_data_t *obs_data_get_defaults(obs_data_t *data)
 {
-	obs_data_t *defaults = obs_data_create();
+	obs_data_t *defaults = obs_data_create_in(data ? data->arena : NULL);
 
 	if (!data)
 		return defaults;
@@ -868,7 +1375,7 @@ static void set_item_data(struct obs_data *data, struct obs_data_item **item, co
 	obs_data_item_t *new_item = NULL;
 
 	if ((!item || !*item) && data) {
-		new_item = obs_data_item_create(name, ptr, size, type, default_data, autoselect_data);
+		new_item = obs_data_item_create(data->arena, name, ptr, size, type, default_data, autoselect_data);
 		new_item->parent = data;
 		HASH_ADD_STR(data->items, name, new_item);
 
@@ -936,7 +1443,7 @@ static void copy_obj(struct obs_data *data, const char *name, struct obs_data *o
 		     void (*callback)(obs_data_t *, const char *, obs_data_t *))
 {
 	if (obj) {
-		obs_data_t *new_obj = obs_data_create();
+		obs_data_t *new_obj = obs_data_create_in(data->arena);
 		obs_data_apply(new_obj, obj);
 		callback(data, name, new_obj);
 		obs_data_release(new_obj);
@@ -951,7 +1458,7 @@ static void copy_array(struct obs_data *data, const char *name, struct obs_data_
 		da_reserve(new_array->objects, array->objects.num);
 
 		for (size_t i = 0; i < array->objects.num; i++) {
-			obs_data_t *new_obj = obs_data_create();
+			obs_data_t *new_obj = obs_data_create_in(data->arena);
 			obs_data_t *obj = array->objects.array[i];
 
 			obs_data_apply(new_obj, obj);
@@ -1821,7 +2328,7 @@ typedef void (*set_obj_t)(obs_data_t *, const char *, obs_data_t *);
 
 static inline void set_vec2(obs_data_t *data, const char *name, const struct vec2 *val, set_obj_t set_obj)
 {
-	obs_data_t *obj = obs_data_create();
+	obs_data_t *obj = obs_data_create_in(data ? data->arena : NULL);
 	obs_data_set_double(obj, "x", val->x);
 	obs_data_set_double(obj, "y", val->y);
 	set_obj(data, name, obj);
@@ -1830,7 +2337,7 @@ static inline void set_vec2(obs_data_t *data, const char *name, const struct vec
 
 static inline void set_vec3(obs_data_t *data, const char *name, const struct vec3 *val, set_obj_t set_obj)
 {
-	obs_data_t *obj = obs_data_create();
+	obs_data_t *obj = obs_data_create_in(data ? data->arena : NULL);
 	obs_data_set_double(obj, "x", val->x);
 	obs_data_set_double(obj, "y", val->y);
 	obs_data_set_double(obj, "z", val->z);
@@ -1840,7 +2347,7 @@ static inline void set_vec3(obs_data_t *data, const char *name, const struct vec
 
 static inline void set_vec4(obs_data_t *data, const char *name, const struct vec4 *val, set_obj_t set_obj)
 {
-	obs_data_t *obj = obs_data_create();
+	obs_data_t *obj = obs_data_create_in(data ? data->arena : NULL);
 	obs_data_set_double(obj, "x", val->x);
 	obs_data_set_double(obj, "y", val->y);
 	obs_data_set_double(obj, "z", val->z);
@@ -1851,7 +2358,7 @@ static inline void set_vec4(obs_data_t *data, const char *name, const struct vec
 
 static inline void set_quat(obs_data_t *data, const char *name, const struct quat *val, set_obj_t set_obj)
 {
-	obs_data_t *obj = obs_data_create();
+	obs_data_t *obj = obs_data_create_in(data ? data->arena : NULL);
 	obs_data_set_double(obj, "x", val->x);
 	obs_data_set_double(obj, "y", val->y);
 	obs_data_set_double(obj, "z", val->z);
@@ -435,7 +435,7 @@ void obs_encoder_set_name(obs_encoder_t *encoder, const char *name)
 
 static inline obs_data_t *get_defaults(const struct obs_encoder_info *info)
 {
-	obs_data_t *settings = obs_data_create();
+	obs_data_t *settings = obs_data_create_arena();
 	if (info->get_defaults) {
 		info->get_defaults(settings);
 	}
@@ -0,0 +1,175 @@
+/******************************************************************************
+    Copyright (C) 2023 by Lain Bailey <lain@obsproject.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+#include "util/darray.h"
+#include "obs.h"
+
+/*
+ * Packet ordering for interleaved outputs.
+ *
+ * Packets are ordered by dts_usec.  For equal timestamps, video comes before
+ * audio, video packets are ordered by track index, and audio packets stay in
+ * the order they arrived in.
+ *
+ * While an output is starting up, the packets are kept in a sorted array (see
+ * interleave_sorted_insert_idx) because the start-up code needs to walk them
+ * in order.  Once started, only the earliest packet is ever looked at, so
+ * they are kept in a binary heap instead, which keeps insertion and removal at
+ * O(log n) when many tracks are buffered at once.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct interleaved_packet {
+	struct encoder_packet packet;
+	uint64_t seq;
+};
+
+struct interleave_heap {
+	DARRAY(struct interleaved_packet) packets;
+	uint64_t next_seq;
+};
+
+/* returns the index at which a packet should be inserted in a sorted array */
+static inline size_t interleave_sorted_insert_idx(const struct encoder_packet *array, size_t num,
+						   const struct encoder_packet *out)
+{
+	size_t idx;
+	for (idx = 0; idx < num; idx++) {
+		const struct encoder_packet *cur_packet = array + idx;
+
+		// sort video packets with same DTS by track index,
+		// to prevent the pruning logic from removing additional
+		// video tracks
+		if (out->dts_usec == cur_packet->dts_usec && out->type == OBS_ENCODER_VIDEO &&
+		    cur_packet->type == OBS_ENCODER_VIDEO && out->track_idx > cur_packet->track_idx)
+			continue;
+
+		if (out->dts_usec == cur_packet->dts_usec && out->type == OBS_ENCODER_VIDEO) {
+			break;
+		} else if (out->dts_usec < cur_packet->dts_usec) {
+			break;
+		}
+	}
+
+	return idx;
+}
+
+/* same order as interleave_sorted_insert_idx: a video packet is inserted in
+ * front of any with the same timestamp and track, an audio packet behind any
+ * with the same timestamp, which is what the sequence number reproduces */
+static inline bool interleaved_packet_before(const struct interleaved_packet *a, const struct interleaved_packet *b)
+{
+	bool a_video = a->packet.type == OBS_ENCODER_VIDEO;
+	bool b_video = b->packet.type == OBS_ENCODER_VIDEO;
+
+	if (a->packet.dts_usec != b->packet.dts_usec)
+		return a->packet.dts_usec < b->packet.dts_usec;
+	if (a_video != b_video)
+		return a_video;
+	if (!a_video)
+		return a->seq < b->seq;
+	if (a->packet.track_idx != b->packet.track_idx)
+		return a->packet.track_idx < b->packet.track_idx;
+	return a->seq > b->seq;
+}
+
+static inline void interleave_heap_free(struct interleave_heap *heap)
+{
+	da_free(heap->packets);
+	heap->next_seq = 0;
+}
+
+static inline size_t interleave_heap_count(const struct interleave_heap *heap)
+{
+	return heap->packets.num;
+}
+
+/* returns the earliest packet without removing it */
+static inline struct encoder_packet *interleave_heap_peek(struct interleave_heap *heap)
+{
+	return heap->packets.num ? &heap->packets.array[0].packet : NULL;
+}
+
+static inline void interleave_heap_push(struct interleave_heap *heap, const struct encoder_packet *packet)
+{
+	struct interleaved_packet *array;
+	struct interleaved_packet entry;
+	size_t idx = heap->packets.num;
+
+	entry.packet = *packet;
+	entry.seq = heap->next_seq++;
+
+	da_push_back(heap->packets, &entry);
+	array = heap->packets.array;
+
+	while (idx > 0) {
+		size_t parent = (idx - 1) / 2;
+		if (!interleaved_packet_before(&entry, &array[parent]))
+			break;
+
+		array[idx] = array[parent];
+		idx = parent;
+	}
+
+	array[idx] = entry;
+}
+
+/* removes the earliest packet */
+static inline bool interleave_heap_pop(struct interleave_heap *heap, struct encoder_packet *out)
+{
+	struct interleaved_packet *array = heap->packets.array;
+	struct interleaved_packet last;
+	size_t num = heap->packets.num;
+	size_t idx = 0;
+
+	if (!num)
+		return false;
+
+	if (out)
+		*out = array[0].packet;
+
+	last = array[--num];
+	heap->packets.num = num;
+
+	if (!num)
+		return true;
+
+	for (;;) {
+		size_t child = idx * 2 + 1;
+		if (child >= num)
+			break;
+		if (child + 1 < num && interleaved_packet_before(&array[child + 1], &array[child]))
+			child++;
+		if (!interleaved_packet_before(&array[child], &last))
+			break;
+
+		array[idx] = array[child];
+		idx = child;
+	}
+
+	array[idx] = last;
+	return true;
+}
+
+#ifdef __cplusplus
+}
+#endif
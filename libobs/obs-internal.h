@@ -38,6 +38,7 @@
 #include "media-io/audio-io.h"
 
 #include "obs.h"
+#include "obs-interleave.h"
 
 #include <obsversion.h>
 #include <caption/caption.h>
@@ -318,6 +319,24 @@ struct obs_core_video_mix {
 extern struct obs_core_video_mix *obs_create_video_mix(struct obs_video_info *ovi);
 extern void obs_free_video_mix(struct obs_core_video_mix *video);
 
+/* IDs of the effect params set on the per-frame draw paths */
+struct obs_effect_param_ids {
+	gs_param_id_t image;
+	gs_param_id_t multiplier;
+	gs_param_id_t color_matrix;
+	gs_param_id_t color_range_min;
+	gs_param_id_t color_range_max;
+	gs_param_id_t base_dimension;
+	gs_param_id_t base_dimension_i;
+	gs_param_id_t color_vec0;
+	gs_param_id_t color_vec1;
+	gs_param_id_t color_vec2;
+	gs_param_id_t width_i;
+	gs_param_id_t height_i;
+	gs_param_id_t sdr_white_nits_over_maximum;
+	gs_param_id_t hdr_lw;
+};
+
 struct obs_core_video {
 	graphics_t *graphics;
 	gs_effect_t *default_effect;
@@ -332,6 +351,7 @@ struct obs_core_video {
 	gs_effect_t *bilinear_lowres_effect;
 	gs_effect_t *premultiplied_alpha_effect;
 	gs_samplerstate_t *point_sampler;
+	struct obs_effect_param_ids param_ids;
 
 	uint64_t video_time;
 	uint64_t video_frame_interval_ns;
@@ -375,9 +395,22 @@ struct audio_monitor;
 struct obs_core_audio {
 	audio_t *audio;
 
+	/* both hold a reference to their sources and are kept between ticks,
+	 * they are only rebuilt when the source tree changes (see
+	 * obs_audio_graph_changed) */
 	DARRAY(struct obs_source *) render_order;
 	DARRAY(struct obs_source *) root_nodes;
 
+	/* the render order is sorted by level, where sources that render
+	 * their children's audio are always on a later level than those
+	 * children, so each level can be rendered in parallel */
+	DARRAY(size_t) graph_level_ends;
+	volatile long graph_generation;
+	long graph_generation_built;
+	int graph_rebuild_ticks;
+	uint64_t graph_mark;
+	os_event_t *render_done;
+
 	uint64_t buffered_ts;
 	struct deque buffered_timestamps;
 	uint64_t buffering_wait_ticks;
@@ -385,6 +418,21 @@ struct obs_core_audio {
 	int max_buffering_ticks;
 	bool fixed_buffer;
 
+	/* adaptive buffering: the lowest amount of audio any source had
+	 * buffered past the rendered tick since the window started */
+	uint64_t headroom_window_start;
+	uint64_t headroom_window_min;
+	uint64_t tick_headroom;
+
+	pthread_mutex_t buffering_stats_mutex;
+	int buffering_stats_ticks;
+	int buffering_peak_ticks;
+	uint32_t buffering_increases;
+	uint32_t buffering_decreases;
+	struct obs_audio_buffering_change buffering_history[OBS_AUDIO_BUFFERING_HISTORY];
+	size_t buffering_history_idx;
+	size_t buffering_history_num;
+
 	pthread_mutex_t monitoring_mutex;
 	DARRAY(struct audio_monitor *) monitors;
 	char *monitoring_device_name;
@@ -482,6 +530,7 @@ struct obs_core {
 
 	signal_handler_t *signals;
 	proc_handler_t *procs;
+	signal_t *source_volume_signal;
 
 	char *locale;
 	char *module_config_path;
@@ -495,13 +544,24 @@ struct obs_core {
 	struct obs_core_data data;
 	struct obs_core_hotkeys hotkeys;
 
+	os_task_pool_t *task_pool;
 	os_task_queue_t *destruction_task_thread;
+	volatile bool parallel_audio_render;
+	volatile bool adaptive_audio_buffering;
 
 	obs_task_handler_t ui_task_handler;
 };
 
 extern struct obs_core *obs;
 
+/* call whenever the set of sources the audio thread renders may have
+ * changed: sources activating, deactivating or changing parents, output
+ * channels changing, or audio sources being created or destroyed */
+static inline void obs_audio_graph_changed(void)
+{
+	os_atomic_inc_long(&obs->audio.graph_generation);
+}
+
 struct obs_graphics_context {
 	uint64_t last_time;
 	uint64_t interval;
@@ -522,6 +582,7 @@ extern gs_effect_t *obs_load_effect(gs_effect_t **effect, const char *file);
 
 extern bool audio_callback(void *param, uint64_t start_ts_in, uint64_t end_ts_in, uint64_t *out_ts, uint32_t mixers,
 			   struct audio_output_data *mixes);
+extern void obs_audio_release_graph(struct obs_core_audio *audio);
 
 extern struct obs_core_video_mix *get_mix_for_video(video_t *video);
 
@@ -750,6 +811,10 @@ struct obs_source {
 	bool muted;
 	struct obs_source *next_audio_source;
 	struct obs_source **prev_next_audio_source;
+	uint64_t audio_graph_mark;
+	int audio_graph_level;
+	/* referenced by the cached audio render order */
+	volatile bool audio_graph_ref;
 	uint64_t audio_ts;
 	struct deque audio_input_buf[MAX_AUDIO_CHANNELS];
 	size_t last_audio_input_buf_size;
@@ -768,6 +833,7 @@ struct obs_source {
 	uint32_t audio_mixers;
 	float user_volume;
 	float volume;
+	signal_t *volume_signal;
 	int64_t sync_offset;
 	int64_t last_sync_offset;
 	float balance;
@@ -1095,7 +1161,9 @@ struct obs_output {
 	pthread_t end_data_capture_thread;
 	os_event_t *stopping_event;
 	pthread_mutex_t interleaved_mutex;
+	/* sorted while starting up, moved to the heap once started */
 	DARRAY(struct encoder_packet) interleaved_packets;
+	struct interleave_heap interleaved_heap;
 	int stop_code;
 
 	int reconnect_retry_sec;
@@ -1384,5 +1452,10 @@ extern uint64_t source_profiler_source_render_begin(gs_timer_t **timer);
 /* Submit start timestamp and GPU timer after rendering source */
 extern void source_profiler_source_render_end(obs_source_t *source, uint64_t start, gs_timer_t *timer);
 
+/* Get timestamp for start of audio render (may be called from any thread) */
+extern uint64_t source_profiler_source_audio_render_begin(void);
+/* Submit start timestamp after rendering source audio */
+extern void source_profiler_source_audio_render_end(obs_source_t *source, uint64_t start);
+
 /* Remove source from profiler hashmaps */
 extern void source_profiler_remove_source(obs_source_t *source);
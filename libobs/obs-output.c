@@ -228,9 +228,15 @@ fail:
 
 static inline void free_packets(struct obs_output *output)
 {
+	struct encoder_packet packet;
+
 	for (size_t i = 0; i < output->interleaved_packets.num; i++)
 		obs_encoder_packet_release(output->interleaved_packets.array + i);
 	da_free(output->interleaved_packets);
+
+	while (interleave_heap_pop(&output->interleaved_heap, &packet))
+		obs_encoder_packet_release(&packet);
+	interleave_heap_free(&output->interleaved_heap);
 }
 
 static inline void clear_raw_audio_buffers(obs_output_t *output)
@@ -544,7 +550,7 @@ uint32_t obs_get_output_flags(const char *id)
 
 static inline obs_data_t *get_defaults(const struct obs_output_info *info)
 {
-	obs_data_t *settings = obs_data_create();
+	obs_data_t *settings = obs_data_create_arena();
 	if (info->get_defaults)
 		info->get_defaults(settings);
 	return settings;
@@ -1646,17 +1652,21 @@ static bool add_caption(struct obs_output *output, struct encoder_packet *out)
 
 static inline void send_interleaved(struct obs_output *output)
 {
-	struct encoder_packet out = output->interleaved_packets.array[0];
+	struct encoder_packet *next = interleave_heap_peek(&output->interleaved_heap);
 	struct encoder_packet_time ept_local = {0};
 	bool found_ept = false;
+	struct encoder_packet out;
+
+	if (!next)
+		return;
 
 	/* do not send an interleaved packet if there's no packet of the
 	 * opposing type of a higher timestamp in the interleave buffer.
 	 * this ensures that the timestamps are monotonic */
-	if (!has_higher_opposing_ts(output, &out))
+	if (!has_higher_opposing_ts(output, next))
 		return;
 
-	da_erase(output->interleaved_packets, 0);
+	interleave_heap_pop(&output->interleaved_heap, &out);
 
 	if (out.type == OBS_ENCODER_VIDEO) {
 		output->total_frames++;
@@ -2024,42 +2034,21 @@ static bool initialize_interleaved_packets(struct obs_output *output)
 
 static inline void insert_interleaved_packet(struct obs_output *output, struct encoder_packet *out)
 {
-	size_t idx;
-	for (idx = 0; idx < output->interleaved_packets.num; idx++) {
-		struct encoder_packet *cur_packet;
-		cur_packet = output->interleaved_packets.array + idx;
-
-		// sort video packets with same DTS by track index,
-		// to prevent the pruning logic from removing additional
-		// video tracks
-		if (out->dts_usec == cur_packet->dts_usec && out->type == OBS_ENCODER_VIDEO &&
-		    cur_packet->type == OBS_ENCODER_VIDEO && out->track_idx > cur_packet->track_idx)
-			continue;
-
-		if (out->dts_usec == cur_packet->dts_usec && out->type == OBS_ENCODER_VIDEO) {
-			break;
-		} else if (out->dts_usec < cur_packet->dts_usec) {
-			break;
-		}
-	}
-
+	size_t idx = interleave_sorted_insert_idx(output->interleaved_packets.array, output->interleaved_packets.num, out);
 	da_insert(output->interleaved_packets, idx, out);
 }
 
+/* offsets have just been applied to the start-up packets, so they are
+ * reinserted in their existing order, now into the heap used from here on */
 static void resort_interleaved_packets(struct obs_output *output)
 {
-	DARRAY(struct encoder_packet) old_array;
-
-	old_array.da = output->interleaved_packets.da;
-	memset(&output->interleaved_packets, 0, sizeof(output->interleaved_packets));
-
-	for (size_t i = 0; i < old_array.num; i++) {
-		set_higher_ts(output, &old_array.array[i]);
+	for (size_t i = 0; i < output->interleaved_packets.num; i++) {
+		set_higher_ts(output, &output->interleaved_packets.array[i]);
 
-		insert_interleaved_packet(output, &old_array.array[i]);
+		interleave_heap_push(&output->interleaved_heap, &output->interleaved_packets.array[i]);
 	}
 
-	da_free(old_array);
+	da_free(output->interleaved_packets);
 }
 
 static void discard_unused_audio_packets(struct obs_output *output, int64_t dts_usec)
@@ -2198,12 +2187,16 @@ static void interleave_packets(void *data, struct encoder_packet *packet, struct
 		*output_packet_time = *packet_time;
 	}
 
-	if (was_started)
+	if (was_started) {
+		if (output->interleaved_packets.num)
+			resort_interleaved_packets(output);
+
 		apply_interleaved_packet_offset(output, &out, output_packet_time);
-	else
+		interleave_heap_push(&output->interleaved_heap, &out);
+	} else {
 		check_received(output, packet);
-
-	insert_interleaved_packet(output, &out);
+		insert_interleaved_packet(output, &out);
+	}
 
 	received_video = true;
 	for (size_t i = 0; i < MAX_OUTPUT_VIDEO_ENCODERS; i++) {
@@ -162,6 +162,7 @@ static void *scene_create(obs_data_t *settings, struct obs_source *source)
 	}
 
 	signal_handler_add_array(obs_source_get_signal_handler(source), obs_scene_signals);
+	scene->item_transform_signal = signal_handler_get_signal(source->context.signals, "item_transform");
 
 	if (pthread_mutex_init_recursive(&scene->audio_mutex) != 0) {
 		blog(LOG_ERROR, "scene_create: Couldn't initialize audio "
@@ -693,7 +694,8 @@ static void update_item_transform(struct obs_scene_item *item, bool update_tex)
 
 	calldata_init_fixed(&params, stack, sizeof(stack));
 	calldata_set_ptr(&params, "item", item);
-	signal_parent(item->parent, "item_transform", &params);
+	calldata_set_ptr(&params, "scene", item->parent);
+	signal_handler_emit(item->parent->source->context.signals, item->parent->item_transform_signal, &params);
 
 	if (!update_tex)
 		return;
@@ -746,6 +748,7 @@ static void render_item_texture(struct obs_scene_item *item, enum gs_color_space
 
 	GS_DEBUG_MARKER_BEGIN(GS_DEBUG_COLOR_ITEM_TEXTURE, "render_item_texture");
 
+	const struct obs_effect_param_ids *ids = &obs->video.param_ids;
 	gs_effect_t *effect = obs->video.default_effect;
 	enum obs_scale_type type = item->scale_filter;
 	uint32_t cx = gs_texture_get_width(tex);
@@ -754,7 +757,7 @@ static void render_item_texture(struct obs_scene_item *item, enum gs_color_space
 	bool upscale = false;
 	if (type != OBS_SCALE_DISABLE) {
 		if (type == OBS_SCALE_POINT) {
-			gs_eparam_t *image = gs_effect_get_param_by_name(effect, "image");
+			gs_eparam_t *image = gs_effect_get_param_by_id(effect, ids->image);
 			gs_effect_set_next_sampler(image, obs->video.point_sampler);
 
 		} else if (!close_float(item->output_scale.x, 1.0f, EPSILON) ||
@@ -770,14 +773,14 @@ static void render_item_texture(struct obs_scene_item *item, enum gs_color_space
 				upscale = (item->output_scale.x >= 1.0f) && (item->output_scale.y >= 1.0f);
 			}
 
-			gs_eparam_t *const scale_param = gs_effect_get_param_by_name(effect, "base_dimension");
+			gs_eparam_t *const scale_param = gs_effect_get_param_by_id(effect, ids->base_dimension);
 			if (scale_param) {
 				struct vec2 base_res = {(float)cx, (float)cy};
 
 				gs_effect_set_vec2(scale_param, &base_res);
 			}
 
-			gs_eparam_t *const scale_i_param = gs_effect_get_param_by_name(effect, "base_dimension_i");
+			gs_eparam_t *const scale_i_param = gs_effect_get_param_by_id(effect, ids->base_dimension_i);
 			if (scale_i_param) {
 				struct vec2 base_res_i = {1.0f / (float)cx, 1.0f / (float)cy};
 
@@ -856,7 +859,7 @@ static void render_item_texture(struct obs_scene_item *item, enum gs_color_space
 		}
 	}
 
-	gs_eparam_t *const multiplier_param = gs_effect_get_param_by_name(effect, "multiplier");
+	gs_eparam_t *const multiplier_param = gs_effect_get_param_by_id(effect, ids->multiplier);
 	if (multiplier_param)
 		gs_effect_set_float(multiplier_param, multiplier);
 
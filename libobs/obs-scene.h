@@ -124,4 +124,6 @@ struct obs_scene {
 	struct obs_scene_item *first_item;
 
 	DARRAY(struct scene_source_mix) mix_sources;
+
+	signal_t *item_transform_signal;
 };
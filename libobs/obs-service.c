@@ -113,7 +113,7 @@ const char *obs_service_get_name(const obs_service_t *service)
 
 static inline obs_data_t *get_defaults(const struct obs_service_info *info)
 {
-	obs_data_t *settings = obs_data_create();
+	obs_data_t *settings = obs_data_create_arena();
 	if (info->get_defaults)
 		info->get_defaults(settings);
 	return settings;
@@ -121,7 +121,11 @@ bool obs_source_init_context(struct obs_source *source, obs_data_t *settings, co
 	if (!obs_context_data_init(&source->context, OBS_OBJ_TYPE_SOURCE, settings, name, uuid, hotkey_data, private))
 		return false;
 
-	return signal_handler_add_array(source->context.signals, source_signals);
+	if (!signal_handler_add_array(source->context.signals, source_signals))
+		return false;
+
+	source->volume_signal = signal_handler_get_signal(source->context.signals, "volume");
+	return true;
 }
 
 const char *obs_source_get_display_name(const char *id)
@@ -230,6 +234,7 @@ static void obs_source_init_finalize(struct obs_source *source)
 		obs->data.first_audio_source = source;
 
 		pthread_mutex_unlock(&obs->data.audio_sources_mutex);
+		obs_audio_graph_changed();
 	}
 
 	if (!source->context.private) {
@@ -603,6 +608,7 @@ void obs_source_destroy(struct obs_source *source)
 		*source->prev_next_audio_source = source->next_audio_source;
 		if (source->next_audio_source)
 			source->next_audio_source->prev_next_audio_source = source->prev_next_audio_source;
+		obs_audio_graph_changed();
 	}
 	pthread_mutex_unlock(&obs->data.audio_sources_mutex);
 
@@ -722,9 +728,16 @@ void obs_source_release(obs_source_t *source)
 		return;
 
 	obs_weak_source_t *control = get_weak(source);
-	if (obs_ref_release(&control->ref)) {
+	long refs = os_atomic_dec_long(&control->ref.refs);
+
+	if (refs == -1) {
 		obs_source_destroy(source);
 		obs_weak_source_release(control);
+
+	} else if (refs == 0 && os_atomic_load_bool(&source->audio_graph_ref)) {
+		/* only the audio render order still holds the source, have
+		 * it dropped so that the source can be destroyed */
+		obs_audio_graph_changed();
 	}
 }
 
@@ -806,7 +819,7 @@ bool obs_source_removed(const obs_source_t *source)
 
 static inline obs_data_t *get_defaults(const struct obs_source_info *info)
 {
-	obs_data_t *settings = obs_data_create();
+	obs_data_t *settings = obs_data_create_arena();
 	if (info->get_defaults2)
 		info->get_defaults2(info->type_data, settings);
 	else if (info->get_defaults)
@@ -1095,6 +1108,7 @@ void obs_source_activate(obs_source_t *source, enum view_type type)
 	if (type == MAIN_VIEW) {
 		os_atomic_inc_long(&source->activate_refs);
 		obs_source_enum_active_tree(source, activate_tree, NULL);
+		obs_audio_graph_changed();
 	}
 }
 
@@ -1112,6 +1126,7 @@ void obs_source_deactivate(obs_source_t *source, enum view_type type)
 		if (os_atomic_load_long(&source->activate_refs) > 0) {
 			os_atomic_dec_long(&source->activate_refs);
 			obs_source_enum_active_tree(source, deactivate_tree, NULL);
+			obs_audio_graph_changed();
 		}
 	}
 }
@@ -3358,9 +3373,11 @@ static void clean_cache(obs_source_t *source)
 
 #define MAX_ASYNC_FRAMES 30
 //if return value is not null then do (os_atomic_dec_long(&output->refs) == 0) && obs_source_frame_destroy(output)
-static inline struct obs_source_frame *cache_video(struct obs_source *source, const struct obs_source_frame *frame)
+static struct obs_source_frame *get_async_cache_frame(struct obs_source *source, enum video_format format,
+						       uint32_t width, uint32_t height, bool full_range, uint8_t trc)
 {
 	struct obs_source_frame *new_frame = NULL;
+	enum convert_type prev, cur;
 
 	pthread_mutex_lock(&source->async_mutex);
 
@@ -3371,16 +3388,18 @@ static inline struct obs_source_frame *cache_video(struct obs_source *source, co
 		return NULL;
 	}
 
-	if (async_texture_changed(source, frame)) {
+	prev = get_convert_type(source->async_cache_format, source->async_cache_full_range, source->async_cache_trc);
+	cur = get_convert_type(format, full_range, trc);
+
+	if (source->async_cache_width != width || source->async_cache_height != height || prev != cur) {
 		free_async_cache(source);
-		source->async_cache_width = frame->width;
-		source->async_cache_height = frame->height;
+		source->async_cache_width = width;
+		source->async_cache_height = height;
 	}
 
-	const enum video_format format = frame->format;
 	source->async_cache_format = format;
-	source->async_cache_full_range = frame->full_range;
-	source->async_cache_trc = frame->trc;
+	source->async_cache_full_range = full_range;
+	source->async_cache_trc = trc;
 
 	for (size_t i = 0; i < source->async_cache.num; i++) {
 		struct async_frame *af = &source->async_cache.array[i];
@@ -3398,7 +3417,7 @@ static inline struct obs_source_frame *cache_video(struct obs_source *source, co
 	if (!new_frame) {
 		struct async_frame new_af;
 
-		new_frame = obs_source_frame_create(format, frame->width, frame->height);
+		new_frame = obs_source_frame_create(format, width, height);
 		new_af.frame = new_frame;
 		new_af.used = true;
 		new_af.unused_count = 0;
@@ -3411,11 +3430,32 @@ static inline struct obs_source_frame *cache_video(struct obs_source *source, co
 
 	pthread_mutex_unlock(&source->async_mutex);
 
-	copy_frame_data(new_frame, frame);
+	return new_frame;
+}
+
+static inline struct obs_source_frame *cache_video(struct obs_source *source, const struct obs_source_frame *frame)
+{
+	struct obs_source_frame *new_frame = get_async_cache_frame(source, frame->format, frame->width, frame->height,
+								    frame->full_range, frame->trc);
+
+	if (new_frame)
+		copy_frame_data(new_frame, frame);
 
 	return new_frame;
 }
 
+static void push_async_frame(obs_source_t *source, struct obs_source_frame *output)
+{
+	pthread_mutex_lock(&source->async_mutex);
+	if (os_atomic_dec_long(&output->refs) == 0) {
+		obs_source_frame_destroy(output);
+	} else {
+		da_push_back(source->async_frames, &output);
+		source->async_active = true;
+	}
+	pthread_mutex_unlock(&source->async_mutex);
+}
+
 static void obs_source_output_video_internal(obs_source_t *source, const struct obs_source_frame *frame)
 {
 	if (!obs_source_valid(source, "obs_source_output_video"))
@@ -3433,19 +3473,73 @@ static void obs_source_output_video_internal(obs_source_t *source, const struct
 	source_profiler_async_frame_received(source);
 
 	struct obs_source_frame *output = cache_video(source, frame);
+	if (output)
+		push_async_frame(source, output);
+}
+
+struct obs_source_frame *obs_source_acquire_output_frame(obs_source_t *source, enum video_format format,
+							 uint32_t width, uint32_t height)
+{
+	struct obs_source_frame *frame;
+
+	if (!obs_source_valid(source, "obs_source_acquire_output_frame"))
+		return NULL;
+	if (destroying(source) || format == VIDEO_FORMAT_NONE || !width || !height)
+		return NULL;
+
+	/* range/trc aren't known until the frame is filled in, so keep the
+	 * current ones and let commit sort out any change */
+	frame = get_async_cache_frame(source, format, width, height, source->async_cache_full_range,
+				      source->async_cache_trc);
+	if (!frame)
+		return NULL;
+
+	frame->timestamp = 0;
+	frame->full_range = !format_is_yuv(format);
+	frame->max_luminance = 0;
+	frame->flip = false;
+	frame->flags = 0;
+	frame->trc = VIDEO_TRC_DEFAULT;
+	return frame;
+}
+
+void obs_source_commit_output_frame(obs_source_t *source, struct obs_source_frame *frame)
+{
+	if (!frame)
+		return;
+	if (!obs_source_valid(source, "obs_source_commit_output_frame") || destroying(source)) {
+		obs_source_discard_output_frame(source, frame);
+		return;
+	}
+
+	source_profiler_async_frame_received(source);
 
-	/* ------------------------------------------- */
 	pthread_mutex_lock(&source->async_mutex);
-	if (output) {
-		if (os_atomic_dec_long(&output->refs) == 0) {
-			obs_source_frame_destroy(output);
-			output = NULL;
-		} else {
-			da_push_back(source->async_frames, &output);
-			source->async_active = true;
-		}
+
+	if (async_texture_changed(source, frame)) {
+		/* the range or transfer changed after the frame was acquired;
+		 * start a new cache with this frame, giving it the reference
+		 * the old cache held */
+		free_async_cache(source);
+		source->async_cache_width = frame->width;
+		source->async_cache_height = frame->height;
+		source->async_cache_format = frame->format;
+		source->async_cache_full_range = frame->full_range;
+		source->async_cache_trc = frame->trc;
+
+		struct async_frame af = {.frame = frame, .used = true};
+		da_push_back(source->async_cache, &af);
+		os_atomic_inc_long(&frame->refs);
 	}
+
 	pthread_mutex_unlock(&source->async_mutex);
+
+	push_async_frame(source, frame);
+}
+
+void obs_source_discard_output_frame(obs_source_t *source, struct obs_source_frame *frame)
+{
+	obs_source_release_frame(source, frame);
 }
 
 void obs_source_output_video(obs_source_t *source, const struct obs_source_frame *frame)
@@ -4376,9 +4470,9 @@ void obs_source_set_volume(obs_source_t *source, float volume)
 		calldata_set_ptr(&data, "source", source);
 		calldata_set_float(&data, "volume", volume);
 
-		signal_handler_signal(source->context.signals, "volume", &data);
+		signal_handler_emit(source->context.signals, source->volume_signal, &data);
 		if (!source->context.private)
-			signal_handler_signal(obs->signals, "source_volume", &data);
+			signal_handler_emit(obs->signals, obs->source_volume_signal, &data);
 
 		volume = (float)calldata_float(&data, "volume");
 
@@ -4568,6 +4662,7 @@ bool obs_source_add_active_child(obs_source_t *parent, obs_source_t *child)
 		obs_source_activate(child, type);
 	}
 
+	obs_audio_graph_changed();
 	return true;
 }
 
@@ -4583,6 +4678,8 @@ void obs_source_remove_active_child(obs_source_t *parent, obs_source_t *child)
 		type = (i < parent->activate_refs) ? MAIN_VIEW : AUX_VIEW;
 		obs_source_deactivate(child, type);
 	}
+
+	obs_audio_graph_changed();
 }
 
 void obs_source_save(obs_source_t *source)
@@ -4727,9 +4824,10 @@ void obs_source_draw_set_color_matrix(const struct matrix4 *color_matrix, const
 	if (!color_range_max)
 		color_range_max = &color_range_max_def;
 
-	matrix = gs_effect_get_param_by_name(effect, "color_matrix");
-	range_min = gs_effect_get_param_by_name(effect, "color_range_min");
-	range_max = gs_effect_get_param_by_name(effect, "color_range_max");
+	const struct obs_effect_param_ids *ids = &obs->video.param_ids;
+	matrix = gs_effect_get_param_by_id(effect, ids->color_matrix);
+	range_min = gs_effect_get_param_by_id(effect, ids->color_range_min);
+	range_max = gs_effect_get_param_by_id(effect, ids->color_range_max);
 
 	gs_effect_set_matrix4(matrix, color_matrix);
 	gs_effect_set_val(range_min, color_range_min, sizeof(float) * 3);
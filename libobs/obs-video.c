@@ -344,15 +344,16 @@ static void render_convert_texture(struct obs_core_video_mix *video, gs_texture_
 {
 	profile_start(render_convert_texture_name);
 
+	const struct obs_effect_param_ids *ids = &obs->video.param_ids;
 	gs_effect_t *effect = obs->video.conversion_effect;
-	gs_eparam_t *color_vec0 = gs_effect_get_param_by_name(effect, "color_vec0");
-	gs_eparam_t *color_vec1 = gs_effect_get_param_by_name(effect, "color_vec1");
-	gs_eparam_t *color_vec2 = gs_effect_get_param_by_name(effect, "color_vec2");
-	gs_eparam_t *image = gs_effect_get_param_by_name(effect, "image");
-	gs_eparam_t *width_i = gs_effect_get_param_by_name(effect, "width_i");
-	gs_eparam_t *height_i = gs_effect_get_param_by_name(effect, "height_i");
-	gs_eparam_t *sdr_white_nits_over_maximum = gs_effect_get_param_by_name(effect, "sdr_white_nits_over_maximum");
-	gs_eparam_t *hdr_lw = gs_effect_get_param_by_name(effect, "hdr_lw");
+	gs_eparam_t *color_vec0 = gs_effect_get_param_by_id(effect, ids->color_vec0);
+	gs_eparam_t *color_vec1 = gs_effect_get_param_by_id(effect, ids->color_vec1);
+	gs_eparam_t *color_vec2 = gs_effect_get_param_by_id(effect, ids->color_vec2);
+	gs_eparam_t *image = gs_effect_get_param_by_id(effect, ids->image);
+	gs_eparam_t *width_i = gs_effect_get_param_by_id(effect, ids->width_i);
+	gs_eparam_t *height_i = gs_effect_get_param_by_id(effect, ids->height_i);
+	gs_eparam_t *sdr_white_nits_over_maximum = gs_effect_get_param_by_id(effect, ids->sdr_white_nits_over_maximum);
+	gs_eparam_t *hdr_lw = gs_effect_get_param_by_id(effect, ids->hdr_lw);
 
 	struct vec4 vec0, vec1, vec2;
 	vec4_set(&vec0, video->color_matrix[4], video->color_matrix[5], video->color_matrix[6], video->color_matrix[7]);
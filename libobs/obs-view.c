@@ -104,6 +104,7 @@ void obs_view_set_source(obs_view_t *view, uint32_t channel, obs_source_t *sourc
 	view->channels[channel] = source;
 
 	pthread_mutex_unlock(&view->channels_mutex);
+	obs_audio_graph_changed();
 
 	if (source)
 		obs_source_activate(source, AUX_VIEW);
@@ -157,6 +158,7 @@ static inline void set_main_mix()
 	if (idx != DARRAY_INVALID)
 		mix = obs->video.mixes.array[idx];
 	obs->video.main_mix = mix;
+	obs_audio_graph_changed();
 }
 
 video_t *obs_view_add(obs_view_t *view)
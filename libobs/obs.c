@@ -41,6 +41,9 @@ static inline void make_video_info(struct video_output_info *vi, struct obs_vide
 	vi->range = ovi->range;
 	vi->colorspace = ovi->colorspace;
 	vi->cache_size = 6;
+
+	/* picked per input from the frame size */
+	vi->scale_threads = 0;
 }
 
 static inline void calc_gpu_conversion_sizes(struct obs_core_video_mix *video)
@@ -476,6 +479,24 @@ gs_effect_t *obs_load_effect(gs_effect_t **effect, const char *file)
 
 static const char *shader_comp_name = "shader compilation";
 static const char *obs_init_graphics_name = "obs_init_graphics";
+static void obs_init_param_ids(struct obs_effect_param_ids *ids)
+{
+	ids->image = gs_effect_param_id("image");
+	ids->multiplier = gs_effect_param_id("multiplier");
+	ids->color_matrix = gs_effect_param_id("color_matrix");
+	ids->color_range_min = gs_effect_param_id("color_range_min");
+	ids->color_range_max = gs_effect_param_id("color_range_max");
+	ids->base_dimension = gs_effect_param_id("base_dimension");
+	ids->base_dimension_i = gs_effect_param_id("base_dimension_i");
+	ids->color_vec0 = gs_effect_param_id("color_vec0");
+	ids->color_vec1 = gs_effect_param_id("color_vec1");
+	ids->color_vec2 = gs_effect_param_id("color_vec2");
+	ids->width_i = gs_effect_param_id("width_i");
+	ids->height_i = gs_effect_param_id("height_i");
+	ids->sdr_white_nits_over_maximum = gs_effect_param_id("sdr_white_nits_over_maximum");
+	ids->hdr_lw = gs_effect_param_id("hdr_lw");
+}
+
 static int obs_init_graphics(struct obs_video_info *ovi)
 {
 	struct obs_core_video *video = &obs->video;
@@ -501,6 +522,8 @@ static int obs_init_graphics(struct obs_video_info *ovi)
 		}
 	}
 
+	obs_init_param_ids(&video->param_ids);
+
 	profile_start(shader_comp_name);
 	gs_enter_context(video->graphics);
 
@@ -860,11 +883,16 @@ static bool obs_init_audio(struct audio_output_info *ai)
 	int errorcode;
 
 	pthread_mutex_init_value(&audio->monitoring_mutex);
+	pthread_mutex_init_value(&audio->buffering_stats_mutex);
 
 	if (pthread_mutex_init_recursive(&audio->monitoring_mutex) != 0)
 		return false;
+	if (pthread_mutex_init(&audio->buffering_stats_mutex, NULL) != 0)
+		return false;
 	if (pthread_mutex_init(&audio->task_mutex, NULL) != 0)
 		return false;
+	if (os_event_init(&audio->render_done, OS_EVENT_TYPE_AUTO) != 0)
+		return false;
 
 	struct obs_task_info audio_init = {.task = set_audio_thread};
 	deque_push_back(&audio->tasks, &audio_init, sizeof(audio_init));
@@ -872,6 +900,9 @@ static bool obs_init_audio(struct audio_output_info *ai)
 	audio->monitoring_device_name = bstrdup("Default");
 	audio->monitoring_device_id = bstrdup("default");
 
+	/* the render order is built on the first tick */
+	audio->graph_rebuild_ticks = 1;
+
 	errorcode = audio_output_open(&audio->audio, ai);
 	if (errorcode == AUDIO_OUTPUT_SUCCESS)
 		return true;
@@ -891,6 +922,8 @@ static void stop_audio(void)
 		audio_output_close(audio->audio);
 		audio->audio = NULL;
 	}
+
+	obs_audio_release_graph(audio);
 }
 
 static void obs_free_audio(void)
@@ -899,9 +932,11 @@ static void obs_free_audio(void)
 	if (audio->audio)
 		audio_output_close(audio->audio);
 
+	obs_audio_release_graph(audio);
 	deque_free(&audio->buffered_timestamps);
 	da_free(audio->render_order);
 	da_free(audio->root_nodes);
+	da_free(audio->graph_level_ends);
 
 	da_free(audio->monitors);
 	bfree(audio->monitoring_device_name);
@@ -909,6 +944,8 @@ static void obs_free_audio(void)
 	deque_free(&audio->tasks);
 	pthread_mutex_destroy(&audio->task_mutex);
 	pthread_mutex_destroy(&audio->monitoring_mutex);
+	pthread_mutex_destroy(&audio->buffering_stats_mutex);
+	os_event_destroy(audio->render_done);
 
 	memset(audio, 0, sizeof(struct obs_core_audio));
 }
@@ -1048,6 +1085,8 @@ static const char *obs_signals[] = {
 
 	"void channel_change(int channel, in out ptr source, ptr prev_source)",
 
+	"void audio_buffering_changed(int buffering_ms, int prev_buffering_ms)",
+
 	"void hotkey_layout_change()",
 	"void hotkey_register(ptr hotkey)",
 	"void hotkey_unregister(ptr hotkey)",
@@ -1066,7 +1105,11 @@ static inline bool obs_init_handlers(void)
 	if (!obs->procs)
 		return false;
 
-	return signal_handler_add_array(obs->signals, obs_signals);
+	if (!signal_handler_add_array(obs->signals, obs_signals))
+		return false;
+
+	obs->source_volume_signal = signal_handler_get_signal(obs->signals, "source_volume");
+	return true;
 }
 
 static pthread_once_t obs_pthread_once_init_token = PTHREAD_ONCE_INIT;
@@ -1184,7 +1227,11 @@ static bool obs_init(const char *locale, const char *module_config_path, profile
 	if (!obs_init_hotkeys())
 		return false;
 
-	obs->destruction_task_thread = os_task_queue_create();
+	obs->task_pool = os_task_pool_create(0);
+	if (!obs->task_pool)
+		return false;
+
+	obs->destruction_task_thread = os_task_queue_create_pooled(obs->task_pool, OS_TASK_PRIORITY_NORMAL);
 	if (!obs->destruction_task_thread)
 		return false;
 
@@ -1360,6 +1407,7 @@ void obs_shutdown(void)
 	obs_free_audio();
 	obs_free_video();
 	os_task_queue_destroy(obs->destruction_task_thread);
+	os_task_pool_destroy(obs->task_pool);
 	obs_free_hotkeys();
 	obs_free_graphics();
 	proc_handler_destroy(obs->procs);
@@ -1626,6 +1674,56 @@ bool obs_get_audio_info2(struct obs_audio_info2 *oai2)
 	}
 }
 
+void obs_set_adaptive_audio_buffering(bool enable)
+{
+	if (!obs)
+		return;
+
+	os_atomic_set_bool(&obs->adaptive_audio_buffering, enable);
+}
+
+bool obs_adaptive_audio_buffering_enabled(void)
+{
+	return obs ? os_atomic_load_bool(&obs->adaptive_audio_buffering) : false;
+}
+
+static inline uint32_t buffering_ticks_to_ms(int ticks, uint32_t samples_per_sec)
+{
+	return (uint32_t)(ticks * AUDIO_OUTPUT_FRAMES * SEC_TO_MSEC / samples_per_sec);
+}
+
+bool obs_get_audio_buffering_stats(struct obs_audio_buffering_stats *stats)
+{
+	struct obs_core_audio *audio = &obs->audio;
+	struct obs_audio_info oai;
+
+	if (!obs_get_audio_info(&oai) || !stats || !audio->audio)
+		return false;
+
+	memset(stats, 0, sizeof(*stats));
+
+	pthread_mutex_lock(&audio->buffering_stats_mutex);
+
+	stats->buffering_ms = buffering_ticks_to_ms(audio->buffering_stats_ticks, oai.samples_per_sec);
+	stats->max_buffering_ms = buffering_ticks_to_ms(audio->max_buffering_ticks, oai.samples_per_sec);
+	if (audio->fixed_buffer)
+		stats->min_buffering_ms = stats->max_buffering_ms;
+	stats->peak_buffering_ms = buffering_ticks_to_ms(audio->buffering_peak_ticks, oai.samples_per_sec);
+	stats->increases = audio->buffering_increases;
+	stats->decreases = audio->buffering_decreases;
+	stats->num_changes = audio->buffering_history_num;
+
+	for (size_t i = 0; i < audio->buffering_history_num; i++) {
+		size_t idx = (audio->buffering_history_idx + OBS_AUDIO_BUFFERING_HISTORY -
+			      audio->buffering_history_num + i) %
+			     OBS_AUDIO_BUFFERING_HISTORY;
+		stats->changes[i] = audio->buffering_history[idx];
+	}
+
+	pthread_mutex_unlock(&audio->buffering_stats_mutex);
+	return true;
+}
+
 bool obs_enum_source_types(size_t idx, const char **id)
 {
 	if (idx >= obs->source_types.num)
@@ -3186,6 +3284,24 @@ void obs_queue_task(enum obs_task_type type, obs_task_t task, void *param, bool
 	}
 }
 
+os_task_pool_t *obs_get_task_pool(void)
+{
+	return obs->task_pool;
+}
+
+void obs_set_parallel_audio_render(bool enable)
+{
+	if (!obs)
+		return;
+
+	os_atomic_set_bool(&obs->parallel_audio_render, enable);
+}
+
+bool obs_parallel_audio_render_enabled(void)
+{
+	return obs ? os_atomic_load_bool(&obs->parallel_audio_render) : false;
+}
+
 bool obs_wait_for_destroy_queue(void)
 {
 	struct task_wait_info info = {0};
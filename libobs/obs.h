@@ -20,6 +20,7 @@
 #include "util/c99defs.h"
 #include "util/bmem.h"
 #include "util/profiler.h"
+#include "util/task.h"
 #include "util/text-lookup.h"
 #include "graphics/graphics.h"
 #include "graphics/vec2.h"
@@ -446,6 +447,40 @@ EXPORT bool obs_get_audio_info(struct obs_audio_info *oai);
  */
 EXPORT bool obs_get_audio_info2(struct obs_audio_info2 *oai2);
 
+/**
+ * Allows dynamically increasing audio buffering to be reduced again once all
+ * sources have consistently been delivering their audio early enough for a
+ * while.  Has no effect with fixed buffering.  Off by default.
+ */
+EXPORT void obs_set_adaptive_audio_buffering(bool enable);
+EXPORT bool obs_adaptive_audio_buffering_enabled(void);
+
+#define OBS_AUDIO_BUFFERING_HISTORY 32
+
+struct obs_audio_buffering_change {
+	uint64_t timestamp;
+	uint32_t buffering_ms;
+};
+
+struct obs_audio_buffering_stats {
+	uint32_t buffering_ms;
+	/* what audio is buffered by when nothing is late, the maximum with
+	 * fixed buffering */
+	uint32_t min_buffering_ms;
+	uint32_t max_buffering_ms;
+	uint32_t peak_buffering_ms;
+	uint32_t increases;
+	uint32_t decreases;
+
+	/* most recent changes, oldest first */
+	size_t num_changes;
+	struct obs_audio_buffering_change changes[OBS_AUDIO_BUFFERING_HISTORY];
+};
+
+/** Gets the current audio buffering and its recent changes, returns false if
+ * no audio */
+EXPORT bool obs_get_audio_buffering_stats(struct obs_audio_buffering_stats *stats);
+
 /**
  * Opens a plugin module directly from a specific path.
  *
@@ -858,6 +893,16 @@ EXPORT bool obs_in_task_thread(enum obs_task_type type);
 
 EXPORT bool obs_wait_for_destroy_queue(void);
 
+/** Shared worker threads for plugins, use a pooled task queue
+ * (os_task_queue_create_pooled) for tasks that have to run in order */
+EXPORT os_task_pool_t *obs_get_task_pool(void);
+
+/** Renders the audio of independent sources concurrently on the task pool.
+ * Sources that render their children's audio (scenes, transitions) wait for
+ * their children.  Off by default. */
+EXPORT void obs_set_parallel_audio_render(bool enable);
+EXPORT bool obs_parallel_audio_render_enabled(void);
+
 typedef void (*obs_task_handler_t)(obs_task_t task, void *param, bool wait);
 EXPORT void obs_set_ui_task_handler(obs_task_handler_t handler);
 
@@ -1330,6 +1375,22 @@ EXPORT void obs_source_draw(gs_texture_t *image, int x, int y, uint32_t cx, uint
 EXPORT void obs_source_output_video(obs_source_t *source, const struct obs_source_frame *frame);
 EXPORT void obs_source_output_video2(obs_source_t *source, const struct obs_source_frame2 *frame);
 
+/**
+ * Gets a frame from the source's async frame pool to capture or decode into
+ * directly, avoiding the copy made by obs_source_output_video.  The data
+ * pointers and line sizes of the frame must not be changed.  Returns NULL if
+ * no frame is available.  Every acquired frame must be passed to either
+ * obs_source_commit_output_frame or obs_source_discard_output_frame.
+ */
+EXPORT struct obs_source_frame *obs_source_acquire_output_frame(obs_source_t *source, enum video_format format,
+								uint32_t width, uint32_t height);
+
+/** Outputs a frame acquired with obs_source_acquire_output_frame */
+EXPORT void obs_source_commit_output_frame(obs_source_t *source, struct obs_source_frame *frame);
+
+/** Returns a frame acquired with obs_source_acquire_output_frame unused */
+EXPORT void obs_source_discard_output_frame(obs_source_t *source, struct obs_source_frame *frame);
+
 EXPORT void obs_source_set_async_rotation(obs_source_t *source, long rotation);
 
 EXPORT void obs_source_output_cea708(obs_source_t *source, const struct obs_source_cea_708 *captions);
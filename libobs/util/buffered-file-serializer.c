@@ -14,17 +14,198 @@
  * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
  */
 
+#if defined(__linux__)
+#define _GNU_SOURCE
+#endif
+
 #include "buffered-file-serializer.h"
 
 #include <inttypes.h>
 
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/uio.h>
+#endif
+
+#ifdef HAVE_LINUX_IO_URING
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
 #include "platform.h"
 #include "threading.h"
 #include "deque.h"
+#include "darray.h"
 #include "dstr.h"
 
 static const size_t DEFAULT_BUF_SIZE = 256ULL * 1048576ULL; // 256 MiB
 static const size_t DEFAULT_CHUNK_SIZE = 1048576;           // 1 MiB
+static const size_t DEFAULT_QUEUE_DEPTH = 4;
+
+#define MAX_QUEUE_DEPTH 64
+#define IO_ALIGNMENT 4096
+
+#ifndef _WIN32
+static inline size_t max(size_t a, size_t b)
+{
+	return a > b ? a : b;
+}
+
+static inline size_t min(size_t a, size_t b)
+{
+	return a < b ? a : b;
+}
+#endif
+
+/* ========================================================================== */
+/* io_uring submission/completion rings                                       */
+
+#ifdef HAVE_LINUX_IO_URING
+struct io_ring {
+	int fd;
+
+	unsigned *sq_tail;
+	unsigned *sq_mask;
+	unsigned *sq_array;
+	struct io_uring_sqe *sqes;
+
+	unsigned *cq_head;
+	unsigned *cq_tail;
+	unsigned *cq_mask;
+	struct io_uring_cqe *cqes;
+
+	void *sq_ptr;
+	void *cq_ptr;
+	size_t sq_size;
+	size_t cq_size;
+	size_t sqes_size;
+};
+
+static void io_ring_free(struct io_ring *ring)
+{
+	if (ring->sqes)
+		munmap(ring->sqes, ring->sqes_size);
+	if (ring->cq_ptr && ring->cq_ptr != ring->sq_ptr)
+		munmap(ring->cq_ptr, ring->cq_size);
+	if (ring->sq_ptr)
+		munmap(ring->sq_ptr, ring->sq_size);
+	if (ring->fd != -1)
+		close(ring->fd);
+
+	memset(ring, 0, sizeof(*ring));
+	ring->fd = -1;
+}
+
+static bool io_ring_init(struct io_ring *ring, unsigned entries)
+{
+	struct io_uring_params params = {0};
+	void *ptr;
+
+	memset(ring, 0, sizeof(*ring));
+
+	ring->fd = (int)syscall(__NR_io_uring_setup, entries, &params);
+	if (ring->fd < 0) {
+		ring->fd = -1;
+		return false;
+	}
+
+	ring->sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+	ring->cq_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+	ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+
+	if (params.features & IORING_FEAT_SINGLE_MMAP)
+		ring->sq_size = ring->cq_size = max(ring->sq_size, ring->cq_size);
+
+	ptr = mmap(NULL, ring->sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd,
+		   IORING_OFF_SQ_RING);
+	if (ptr == MAP_FAILED)
+		goto fail;
+	ring->sq_ptr = ptr;
+
+	if (params.features & IORING_FEAT_SINGLE_MMAP) {
+		ring->cq_ptr = ring->sq_ptr;
+	} else {
+		ptr = mmap(NULL, ring->cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd,
+			   IORING_OFF_CQ_RING);
+		if (ptr == MAP_FAILED)
+			goto fail;
+		ring->cq_ptr = ptr;
+	}
+
+	ptr = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd,
+		   IORING_OFF_SQES);
+	if (ptr == MAP_FAILED)
+		goto fail;
+	ring->sqes = ptr;
+
+	ring->sq_tail = (unsigned *)((uint8_t *)ring->sq_ptr + params.sq_off.tail);
+	ring->sq_mask = (unsigned *)((uint8_t *)ring->sq_ptr + params.sq_off.ring_mask);
+	ring->sq_array = (unsigned *)((uint8_t *)ring->sq_ptr + params.sq_off.array);
+	ring->cq_head = (unsigned *)((uint8_t *)ring->cq_ptr + params.cq_off.head);
+	ring->cq_tail = (unsigned *)((uint8_t *)ring->cq_ptr + params.cq_off.tail);
+	ring->cq_mask = (unsigned *)((uint8_t *)ring->cq_ptr + params.cq_off.ring_mask);
+	ring->cqes = (struct io_uring_cqe *)((uint8_t *)ring->cq_ptr + params.cq_off.cqes);
+	return true;
+
+fail:
+	io_ring_free(ring);
+	return false;
+}
+
+static int io_ring_enter(struct io_ring *ring, unsigned to_submit, unsigned min_complete, unsigned flags)
+{
+	int ret;
+
+	do {
+		ret = (int)syscall(__NR_io_uring_enter, ring->fd, to_submit, min_complete, flags, NULL, 0);
+	} while (ret < 0 && errno == EINTR);
+
+	return ret;
+}
+
+static bool io_ring_submit_writev(struct io_ring *ring, int fd, const struct iovec *iov, uint64_t offset,
+				  uint64_t user_data)
+{
+	unsigned tail = *ring->sq_tail;
+	unsigned idx = tail & *ring->sq_mask;
+	struct io_uring_sqe *sqe = &ring->sqes[idx];
+
+	memset(sqe, 0, sizeof(*sqe));
+	sqe->opcode = IORING_OP_WRITEV;
+	sqe->fd = fd;
+	sqe->addr = (uint64_t)(uintptr_t)iov;
+	sqe->len = 1;
+	sqe->off = offset;
+	sqe->user_data = user_data;
+
+	ring->sq_array[idx] = idx;
+	__atomic_store_n(ring->sq_tail, tail + 1, __ATOMIC_RELEASE);
+
+	if (io_ring_enter(ring, 1, 0, 0) == 1)
+		return true;
+
+	// Not consumed by the kernel, take it back so it isn't submitted with
+	// a later request
+	__atomic_store_n(ring->sq_tail, tail, __ATOMIC_RELEASE);
+	return false;
+}
+
+static bool io_ring_pop_cqe(struct io_ring *ring, struct io_uring_cqe *cqe)
+{
+	unsigned head = *ring->cq_head;
+
+	if (head == __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE))
+		return false;
+
+	*cqe = ring->cqes[head & *ring->cq_mask];
+	__atomic_store_n(ring->cq_head, head + 1, __ATOMIC_RELEASE);
+	return true;
+}
+#endif
 
 /* ========================================================================== */
 /* Buffered writer based on ffmpeg-mux implementation                         */
@@ -34,6 +215,29 @@ struct io_header {
 	uint64_t data_length;
 };
 
+/* A contiguous piece of the file, written with a single request. Several of
+ * these can be in flight at once while the I/O thread fills the next one. */
+struct io_chunk {
+	unsigned char *mem;
+	unsigned char *data;
+	size_t used;
+	size_t written;
+	uint64_t offset;
+	uint64_t submit_time;
+	bool direct;
+#ifdef HAVE_LINUX_IO_URING
+	struct iovec iov;
+#endif
+};
+
+enum io_backend {
+	IO_BACKEND_STDIO,
+	IO_BACKEND_PWRITEV,
+	IO_BACKEND_IO_URING,
+};
+
+static const char *backend_names[] = {"stdio", "pwritev", "io_uring"};
+
 struct io_buffer {
 	bool active;
 	bool shutdown_requested;
@@ -42,12 +246,42 @@ struct io_buffer {
 	os_event_t *new_data_available_event;
 	pthread_t io_thread;
 	pthread_mutex_t data_mutex;
-	FILE *output_file;
 	struct deque data;
 	uint64_t next_pos;
 
+	/* Sync requests and the last one completed, protected by data_mutex */
+	uint64_t sync_requested;
+	uint64_t sync_completed;
+	os_event_t *sync_event;
+
 	size_t buffer_size;
 	size_t chunk_size;
+	size_t queue_depth;
+	bool direct_io;
+
+	enum io_backend backend;
+#ifdef _WIN32
+	FILE *output_file;
+#else
+	int fd;
+	int direct_fd;
+#endif
+#ifdef HAVE_LINUX_IO_URING
+	struct io_ring ring;
+#endif
+
+	/* only used by the I/O thread */
+	struct io_chunk *chunks;
+	DARRAY(struct io_chunk *) free_chunks;
+	DARRAY(struct io_chunk *) pending;
+	size_t in_flight;
+	uint64_t submitted_end;
+
+	pthread_mutex_t stats_mutex;
+	struct buffered_file_serializer_stats stats;
+	uint64_t submissions;
+	uint64_t in_flight_sum;
+	uint64_t latency_sum;
 };
 
 struct file_output_data {
@@ -55,32 +289,348 @@ struct file_output_data {
 	struct io_buffer io;
 };
 
+static void complete_chunk(struct io_buffer *io, struct io_chunk *chunk)
+{
+	uint64_t latency = os_gettime_ns() - chunk->submit_time;
+
+	pthread_mutex_lock(&io->stats_mutex);
+	io->stats.writes++;
+	io->stats.bytes_written += chunk->used;
+	if (chunk->direct)
+		io->stats.direct_writes++;
+	if (latency > io->stats.max_write_latency_ns)
+		io->stats.max_write_latency_ns = latency;
+	io->latency_sum += latency;
+	pthread_mutex_unlock(&io->stats_mutex);
+
+	chunk->used = 0;
+	io->in_flight--;
+	da_push_back(io->free_chunks, &chunk);
+}
+
+#ifndef _WIN32
+static inline bool is_aligned(uint64_t val)
+{
+	return (val & (IO_ALIGNMENT - 1)) == 0;
+}
+
+static inline bool use_direct_fd(struct io_buffer *io, const void *data, uint64_t offset, size_t size)
+{
+	return io->direct_fd != -1 && is_aligned((uintptr_t)data) && is_aligned(offset) && is_aligned(size);
+}
+
+/* Several direct writes may be in flight when the first one is rejected, and
+ * each of them ends up here */
+static void disable_direct_io(struct file_output_data *out)
+{
+	if (out->io.direct_fd == -1)
+		return;
+
+	blog(LOG_WARNING, "Direct I/O rejected for '%s', falling back to buffered writes", out->filename.array);
+	close(out->io.direct_fd);
+	out->io.direct_fd = -1;
+}
+#endif
+
+#ifdef HAVE_LINUX_IO_URING
+/* The chunk is counted as in flight until its request completes, or here if
+ * the kernel never took it */
+static bool ring_submit(struct file_output_data *out, struct io_chunk *chunk)
+{
+	struct io_buffer *io = &out->io;
+	unsigned char *data = chunk->data + chunk->written;
+	uint64_t offset = chunk->offset + chunk->written;
+	size_t size = chunk->used - chunk->written;
+
+	chunk->direct = use_direct_fd(io, data, offset, size);
+	chunk->iov.iov_base = data;
+	chunk->iov.iov_len = size;
+
+	if (!io_ring_submit_writev(&io->ring, chunk->direct ? io->direct_fd : io->fd, &chunk->iov, offset,
+				   (uint64_t)(chunk - io->chunks))) {
+		blog(LOG_ERROR, "Error submitting write to '%s': %s", out->filename.array, strerror(errno));
+		io->in_flight--;
+		return false;
+	}
+
+	return true;
+}
+
+/* Waits for at least one write to complete, resubmitting short writes */
+static bool ring_wait(struct file_output_data *out)
+{
+	struct io_buffer *io = &out->io;
+	struct io_uring_cqe cqe;
+
+	if (io_ring_enter(&io->ring, 0, 1, IORING_ENTER_GETEVENTS) < 0) {
+		blog(LOG_ERROR, "Error waiting for writes to '%s': %s", out->filename.array, strerror(errno));
+		return false;
+	}
+
+	while (io_ring_pop_cqe(&io->ring, &cqe)) {
+		struct io_chunk *chunk = &io->chunks[cqe.user_data];
+		size_t remaining = chunk->used - chunk->written;
+
+		if (cqe.res == -EINTR || cqe.res == -EAGAIN) {
+			if (!ring_submit(out, chunk))
+				return false;
+
+		} else if (cqe.res == -EINVAL && chunk->direct) {
+			disable_direct_io(out);
+			if (!ring_submit(out, chunk))
+				return false;
+
+		} else if (cqe.res <= 0) {
+			blog(LOG_ERROR, "Error writing to '%s': %s", out->filename.array,
+			     strerror(cqe.res ? -cqe.res : ENOSPC));
+			io->in_flight--;
+			return false;
+
+		} else if ((size_t)cqe.res < remaining) {
+			chunk->written += (size_t)cqe.res;
+			if (!ring_submit(out, chunk))
+				return false;
+
+		} else {
+			complete_chunk(io, chunk);
+		}
+	}
+
+	return true;
+}
+
+/* Outstanding requests still reference the chunks, so they have to finish
+ * before anything is freed, even after an error */
+static void ring_drain(struct io_buffer *io)
+{
+	struct io_uring_cqe cqe;
+
+	while (io->in_flight) {
+		if (io_ring_enter(&io->ring, 0, 1, IORING_ENTER_GETEVENTS) < 0)
+			break;
+		while (io_ring_pop_cqe(&io->ring, &cqe))
+			io->in_flight--;
+	}
+}
+#endif
+
+#ifdef _WIN32
+static bool write_pending(struct file_output_data *out)
+{
+	struct io_buffer *io = &out->io;
+
+	for (size_t i = 0; i < io->pending.num; i++) {
+		struct io_chunk *chunk = io->pending.array[i];
+
+		if (i == 0)
+			os_fseeki64(io->output_file, chunk->offset, SEEK_SET);
+
+		size_t bytes_written = fwrite(chunk->data, 1, chunk->used, io->output_file);
+		if (bytes_written != chunk->used) {
+			blog(LOG_ERROR, "Error writing to '%s': %s (%zu != %zu)\n", out->filename.array,
+			     strerror(errno), bytes_written, chunk->used);
+			return false;
+		}
+
+		complete_chunk(io, chunk);
+	}
+
+	da_resize(io->pending, 0);
+	return true;
+}
+#else
+/* Writes all pending chunks, which are contiguous, with a single call */
+static bool write_pending(struct file_output_data *out)
+{
+	struct io_buffer *io = &out->io;
+	struct iovec iov[MAX_QUEUE_DEPTH];
+	struct iovec *cur = iov;
+	int num = (int)io->pending.num;
+	bool direct;
+
+	if (!num)
+		return true;
+
+	uint64_t offset = io->pending.array[0]->offset;
+	direct = use_direct_fd(io, io->pending.array[0]->data, offset, 0);
+
+	for (int i = 0; i < num; i++) {
+		struct io_chunk *chunk = io->pending.array[i];
+
+		iov[i].iov_base = chunk->data;
+		iov[i].iov_len = chunk->used;
+		direct = direct && is_aligned(chunk->used);
+	}
+
+	while (num) {
+		ssize_t ret = pwritev(direct ? io->direct_fd : io->fd, cur, num, (off_t)offset);
+
+		if (ret < 0 && errno == EINTR)
+			continue;
+		if (ret < 0 && errno == EINVAL && direct) {
+			disable_direct_io(out);
+			direct = false;
+			continue;
+		}
+		if (ret <= 0) {
+			blog(LOG_ERROR, "Error writing to '%s': %s", out->filename.array,
+			     strerror(ret ? errno : ENOSPC));
+			return false;
+		}
+
+		// Skip over what was written, a short write may leave the
+		// remainder unaligned
+		offset += (uint64_t)ret;
+		while (num && (size_t)ret >= cur->iov_len) {
+			ret -= (ssize_t)cur->iov_len;
+			cur++;
+			num--;
+		}
+		if (num) {
+			cur->iov_base = (uint8_t *)cur->iov_base + ret;
+			cur->iov_len -= (size_t)ret;
+			direct = direct && is_aligned((uintptr_t)cur->iov_base) && is_aligned(offset);
+		}
+	}
+
+	for (size_t i = 0; i < io->pending.num; i++) {
+		io->pending.array[i]->direct = direct;
+		complete_chunk(io, io->pending.array[i]);
+	}
+
+	da_resize(io->pending, 0);
+	return true;
+}
+#endif
+
+static bool wait_for_writes(struct file_output_data *out, bool all)
+{
+#ifdef HAVE_LINUX_IO_URING
+	if (out->io.backend == IO_BACKEND_IO_URING) {
+		while (out->io.in_flight && (all || !out->io.free_chunks.num)) {
+			if (!ring_wait(out))
+				return false;
+		}
+		return true;
+	}
+#endif
+
+	UNUSED_PARAMETER(all);
+	return write_pending(out);
+}
+
+static bool submit_chunk(struct file_output_data *out, struct io_chunk *chunk)
+{
+	struct io_buffer *io = &out->io;
+
+	// Requests may complete in any order, so a discontinuous write (i.e.
+	// the muxer seeking back to patch a header) has to wait for everything
+	// before it in case it overlaps
+	if (chunk->offset != io->submitted_end && !wait_for_writes(out, true))
+		return false;
+
+	chunk->written = 0;
+	chunk->direct = false;
+	chunk->submit_time = os_gettime_ns();
+	io->submitted_end = chunk->offset + chunk->used;
+	io->in_flight++;
+
+	pthread_mutex_lock(&io->stats_mutex);
+	io->submissions++;
+	io->in_flight_sum += io->in_flight;
+	if (io->in_flight > io->stats.max_in_flight)
+		io->stats.max_in_flight = io->in_flight;
+	pthread_mutex_unlock(&io->stats_mutex);
+
+#ifdef HAVE_LINUX_IO_URING
+	if (io->backend == IO_BACKEND_IO_URING)
+		return ring_submit(out, chunk);
+#endif
+
+	da_push_back(io->pending, &chunk);
+	return true;
+}
+
+/* Makes everything up to and including the chunk being filled durable.  The
+ * chunk is written as it is but kept, so that it is written again once it is
+ * full and doesn't throw off the alignment of later chunks. */
+static bool sync_output(struct file_output_data *out, struct io_chunk *chunk)
+{
+	struct io_buffer *io = &out->io;
+
+	if (!wait_for_writes(out, true))
+		return false;
+
+#ifdef _WIN32
+	if (chunk->used) {
+		os_fseeki64(io->output_file, chunk->offset, SEEK_SET);
+		if (fwrite(chunk->data, 1, chunk->used, io->output_file) != chunk->used)
+			goto fail;
+	}
+
+	if (fflush(io->output_file) != 0 || _commit(_fileno(io->output_file)) != 0)
+		goto fail;
+#else
+	size_t written = 0;
+
+	while (written < chunk->used) {
+		ssize_t ret = pwrite(io->fd, chunk->data + written, chunk->used - written,
+				     (off_t)(chunk->offset + written));
+
+		if (ret < 0 && errno == EINTR)
+			continue;
+		if (ret <= 0) {
+			errno = ret ? errno : ENOSPC;
+			goto fail;
+		}
+
+		written += (size_t)ret;
+	}
+
+#ifdef __linux__
+	if (fdatasync(io->fd) != 0)
+		goto fail;
+#else
+	if (fsync(io->fd) != 0)
+		goto fail;
+#endif
+#endif
+
+	return true;
+
+fail:
+	blog(LOG_ERROR, "Error syncing '%s': %s", out->filename.array, strerror(errno));
+	return false;
+}
+
+static struct io_chunk *acquire_chunk(struct file_output_data *out)
+{
+	struct io_buffer *io = &out->io;
+	struct io_chunk *chunk;
+
+	if (!io->free_chunks.num && !wait_for_writes(out, false))
+		return NULL;
+
+	chunk = io->free_chunks.array[io->free_chunks.num - 1];
+	da_pop_back(io->free_chunks);
+	return chunk;
+}
+
 static void *io_thread(void *opaque)
 {
 	struct file_output_data *out = opaque;
 	os_set_thread_name("buffered writer i/o thread");
 
-	// Chunk collects the writes into a larger batch
-	size_t chunk_used = 0;
 	size_t chunk_size = out->io.chunk_size;
+	struct io_chunk *chunk = acquire_chunk(out);
 
-	unsigned char *chunk = bmalloc(chunk_size);
-	if (!chunk) {
-		os_atomic_set_bool(&out->io.output_error, true);
-		fprintf(stderr, "Error allocating memory for output\n");
-		goto error;
-	}
+	// Header of the write currently being copied, a single write may be
+	// split across several chunks
+	struct io_header header = {0};
 
 	bool shutting_down;
-	bool want_seek = false;
-	bool force_flush_chunk = false;
-
-	// current_seek_position is a virtual position updated as we read from
-	// the buffer, if it becomes discontinuous due to a seek request we
-	// flush the chunk. next_seek_position is the actual offset we should
-	// seek to when we write the chunk.
-	uint64_t current_seek_position = 0;
-	uint64_t next_seek_position;
+	bool flush_chunk = false;
+	uint64_t sync_request = 0;
 
 	for (;;) {
 		// Wait for data to be written to the buffer
@@ -93,64 +643,52 @@ static void *io_thread(void *opaque)
 			shutting_down = os_atomic_load_bool(&out->io.shutdown_requested);
 
 			// Fetch as many writes as possible from the deque
-			// and fill up our local chunk. This may involve
-			// seeking, so take care of that as well.
-			for (;;) {
-				size_t available = out->io.data.size;
-
-				// Buffer is empty (now) or was already empty (we got
-				// woken up to exit)
-				if (!available)
-					break;
-
-				// Get seek offset and data size
-				struct io_header header;
-				deque_peek_front(&out->io.data, &header, sizeof(header));
+			// and fill up the current chunk. Each chunk carries
+			// its own file offset, so a seek just starts a new one.
+			while (!flush_chunk) {
+				if (!header.data_length) {
+					// Buffer is empty (now) or was already empty
+					// (we got woken up to exit)
+					if (!out->io.data.size)
+						break;
 
-				// Do we need to seek?
-				if (header.seek_offset != current_seek_position) {
+					deque_pop_front(&out->io.data, &header, sizeof(header));
+				}
 
+				if (header.seek_offset != chunk->offset + chunk->used) {
 					// If there's already part of a chunk pending,
-					// flush it at the current offset. Similarly,
-					// if we already plan to seek, then seek.
-					if (chunk_used || want_seek) {
-						force_flush_chunk = true;
+					// flush it at its own offset first
+					if (chunk->used) {
+						flush_chunk = true;
 						break;
 					}
 
-					// Mark that we need to seek and where to
-					want_seek = true;
-					next_seek_position = header.seek_offset;
-
-					// Update our virtual position
-					current_seek_position = header.seek_offset;
+					chunk->offset = header.seek_offset;
 				}
 
-				// Make sure there's enough room for the data, if
-				// not then force a flush
-				if (header.data_length + chunk_used > chunk_size) {
-					force_flush_chunk = true;
-					break;
-				}
+				size_t size = min((size_t)header.data_length, chunk_size - chunk->used);
+				deque_pop_front(&out->io.data, chunk->data + chunk->used, size);
 
-				// Remove header that we already read
-				deque_pop_front(&out->io.data, NULL, sizeof(header));
+				chunk->used += size;
+				header.seek_offset += size;
+				header.data_length -= size;
 
-				// Copy from the buffer to our local chunk
-				deque_pop_front(&out->io.data, chunk + chunk_used, header.data_length);
-
-				// Update offsets
-				chunk_used += header.data_length;
-				current_seek_position += header.data_length;
+				flush_chunk = chunk->used == chunk_size;
 			}
 
 			// Signal that there is more room in the buffer
 			os_event_signal(out->io.buffer_space_available_event);
 
+			// Everything queued before a sync request has been taken
+			// out of the buffer once it is empty
+			sync_request = out->io.sync_requested;
+
 			// Try to avoid lots of small writes unless this was the final
-			// data left in the buffer. The buffer might be entirely empty
-			// if we were woken up to exit.
-			if (!force_flush_chunk && (!chunk_used || (chunk_used < 65536 && !shutting_down))) {
+			// data left in the buffer. With direct I/O partial chunks are
+			// held back entirely so that writes stay aligned. The buffer
+			// might be entirely empty if we were woken up to exit.
+			if (!flush_chunk &&
+			    (!chunk->used || (!shutting_down && (out->io.direct_io || chunk->used < 65536)))) {
 				os_event_reset(out->io.new_data_available_event);
 				pthread_mutex_unlock(&out->io.data_mutex);
 				break;
@@ -158,36 +696,25 @@ static void *io_thread(void *opaque)
 
 			pthread_mutex_unlock(&out->io.data_mutex);
 
-			// Seek if we need to
-			if (want_seek) {
-				os_fseeki64(out->io.output_file, next_seek_position, SEEK_SET);
-
-				// Update the next virtual position, making sure to take
-				// into account the size of the chunk we're about to write.
-				current_seek_position = next_seek_position + chunk_used;
-
-				want_seek = false;
+			// Hand the chunk off and start filling the next one
+			if (!submit_chunk(out, chunk))
+				goto error;
 
-				// If we did a seek but do not have any data left to write
-				// return to the start of the loop.
-				if (!chunk_used) {
-					force_flush_chunk = false;
-					continue;
-				}
-			}
+			chunk = acquire_chunk(out);
+			if (!chunk)
+				goto error;
 
-			// Write the current chunk to the output file
-			size_t bytes_written = fwrite(chunk, 1, chunk_used, out->io.output_file);
-			if (bytes_written != chunk_used) {
-				blog(LOG_ERROR, "Error writing to '%s': %s (%zu != %zu)\n", out->filename.array,
-				     strerror(errno), bytes_written, chunk_used);
-				os_atomic_set_bool(&out->io.output_error, true);
+			flush_chunk = false;
+		}
 
+		if (sync_request != out->io.sync_completed) {
+			if (!sync_output(out, chunk))
 				goto error;
-			}
 
-			chunk_used = 0;
-			force_flush_chunk = false;
+			pthread_mutex_lock(&out->io.data_mutex);
+			out->io.sync_completed = sync_request;
+			os_event_signal(out->io.sync_event);
+			pthread_mutex_unlock(&out->io.data_mutex);
 		}
 
 		// If this was the last chunk, time to exit
@@ -195,11 +722,31 @@ static void *io_thread(void *opaque)
 			break;
 	}
 
+	if (wait_for_writes(out, true))
+		goto close;
+
 error:
-	if (chunk)
-		bfree(chunk);
+	os_atomic_set_bool(&out->io.output_error, true);
 
+	// Don't leave the writer waiting for space that will never free up
+	os_event_signal(out->io.buffer_space_available_event);
+	os_event_signal(out->io.sync_event);
+
+close:
+#ifdef HAVE_LINUX_IO_URING
+	if (out->io.backend == IO_BACKEND_IO_URING) {
+		ring_drain(&out->io);
+		io_ring_free(&out->io.ring);
+	}
+#endif
+
+#ifdef _WIN32
 	fclose(out->io.output_file);
+#else
+	if (out->io.direct_fd != -1)
+		close(out->io.direct_fd);
+	close(out->io.fd);
+#endif
 	return NULL;
 }
 
@@ -234,18 +781,6 @@ static int64_t file_output_seek(void *opaque, int64_t offset, enum serialize_see
 	return (int64_t)out->io.next_pos;
 }
 
-#ifndef _WIN32
-static inline size_t max(size_t a, size_t b)
-{
-	return a > b ? a : b;
-}
-
-static inline size_t min(size_t a, size_t b)
-{
-	return a < b ? a : b;
-}
-#endif
-
 static size_t file_output_write(void *opaque, const void *buf, size_t buf_size)
 {
 	struct file_output_data *out = opaque;
@@ -271,8 +806,14 @@ static size_t file_output_write(void *opaque, const void *buf, size_t buf_size)
 
 		if (free_space < next_chunk_size + sizeof(struct io_header)) {
 			blog(LOG_DEBUG, "Waiting for I/O thread...");
-			// No space, wait for the I/O thread to make space
+			// No space, wait for the I/O thread to make space.  The
+			// error is checked again after the reset, in case the
+			// thread failed and signaled since the check above.
 			os_event_reset(out->io.buffer_space_available_event);
+			if (os_atomic_load_bool(&out->io.output_error)) {
+				pthread_mutex_unlock(&out->io.data_mutex);
+				return 0;
+			}
 			pthread_mutex_unlock(&out->io.data_mutex);
 			os_event_wait(out->io.buffer_space_available_event);
 			continue;
@@ -319,12 +860,94 @@ static int64_t file_output_get_pos(void *opaque)
 	return (int64_t)out->io.next_pos;
 }
 
+bool buffered_file_serializer_sync(struct serializer *s)
+{
+	struct file_output_data *out = s->data;
+	uint64_t request;
+	bool success;
+
+	if (!out || !out->io.active)
+		return false;
+
+	pthread_mutex_lock(&out->io.data_mutex);
+
+	request = ++out->io.sync_requested;
+	os_event_signal(out->io.new_data_available_event);
+
+	while (out->io.sync_completed < request && !os_atomic_load_bool(&out->io.output_error)) {
+		pthread_mutex_unlock(&out->io.data_mutex);
+		os_event_wait(out->io.sync_event);
+		pthread_mutex_lock(&out->io.data_mutex);
+	}
+
+	success = out->io.sync_completed >= request;
+	pthread_mutex_unlock(&out->io.data_mutex);
+	return success;
+}
+
 bool buffered_file_serializer_init_defaults(struct serializer *s, const char *path)
 {
 	return buffered_file_serializer_init(s, path, 0, 0);
 }
 
 bool buffered_file_serializer_init(struct serializer *s, const char *path, size_t max_bufsize, size_t chunk_size)
+{
+	return buffered_file_serializer_init_ex(s, path, max_bufsize, chunk_size, 0, false);
+}
+
+static bool open_output(struct io_buffer *io, const char *path, bool direct_io)
+{
+#ifdef _WIN32
+	UNUSED_PARAMETER(direct_io);
+
+	io->output_file = os_fopen(path, "wb");
+	io->backend = IO_BACKEND_STDIO;
+	return !!io->output_file;
+#else
+	io->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+	io->direct_fd = -1;
+	if (io->fd == -1)
+		return false;
+
+#ifdef O_DIRECT
+	// Aligned chunks are written through a second descriptor that
+	// bypasses the page cache, anything else goes through the first one
+	if (direct_io) {
+		io->direct_fd = open(path, O_WRONLY | O_DIRECT | O_CLOEXEC);
+		if (io->direct_fd == -1)
+			blog(LOG_WARNING, "Unable to open '%s' for direct I/O: %s", path, strerror(errno));
+	}
+#else
+	UNUSED_PARAMETER(direct_io);
+#endif
+
+	io->backend = IO_BACKEND_PWRITEV;
+
+#ifdef HAVE_LINUX_IO_URING
+	if (io_ring_init(&io->ring, (unsigned)io->queue_depth))
+		io->backend = IO_BACKEND_IO_URING;
+	else
+		blog(LOG_DEBUG, "io_uring unavailable (%s), using pwritev", strerror(errno));
+#endif
+
+	return true;
+#endif
+}
+
+static void free_chunks(struct io_buffer *io)
+{
+	if (io->chunks) {
+		for (size_t i = 0; i < io->queue_depth; i++)
+			bfree(io->chunks[i].mem);
+		bfree(io->chunks);
+	}
+
+	da_free(io->free_chunks);
+	da_free(io->pending);
+}
+
+bool buffered_file_serializer_init_ex(struct serializer *s, const char *path, size_t max_bufsize, size_t chunk_size,
+				      size_t queue_depth, bool direct_io)
 {
 	struct file_output_data *out;
 
@@ -332,21 +955,49 @@ bool buffered_file_serializer_init(struct serializer *s, const char *path, size_
 
 	dstr_init_copy(&out->filename, path);
 
-	out->io.output_file = os_fopen(path, "wb");
-	if (!out->io.output_file)
-		return false;
-
 	out->io.buffer_size = max_bufsize ? max_bufsize : DEFAULT_BUF_SIZE;
 	out->io.chunk_size = chunk_size ? chunk_size : DEFAULT_CHUNK_SIZE;
+	out->io.queue_depth = queue_depth ? min(queue_depth, MAX_QUEUE_DEPTH) : DEFAULT_QUEUE_DEPTH;
+
+	if (!open_output(&out->io, path, direct_io)) {
+		dstr_free(&out->filename);
+		bfree(out);
+		return false;
+	}
+
+#ifndef _WIN32
+	// Full chunks have to be aligned for direct I/O to be used at all
+	out->io.direct_io = out->io.direct_fd != -1;
+	if (out->io.direct_io)
+		out->io.chunk_size = (out->io.chunk_size + IO_ALIGNMENT - 1) & ~(size_t)(IO_ALIGNMENT - 1);
+#endif
+
+	out->io.chunks = bzalloc(out->io.queue_depth * sizeof(struct io_chunk));
+	for (size_t i = 0; i < out->io.queue_depth; i++) {
+		struct io_chunk *chunk = &out->io.chunks[i];
+
+		chunk->mem = bmalloc(out->io.chunk_size + IO_ALIGNMENT);
+		chunk->data = (unsigned char *)(((uintptr_t)chunk->mem + IO_ALIGNMENT - 1) &
+						~(uintptr_t)(IO_ALIGNMENT - 1));
+		da_push_back(out->io.free_chunks, &chunk);
+	}
+
+	da_reserve(out->io.pending, out->io.queue_depth);
+
+	out->io.stats.backend = backend_names[out->io.backend];
+	out->io.stats.queue_depth = out->io.queue_depth;
+	out->io.stats.direct_io = out->io.direct_io;
 
 	// Start at 1MB, this can grow up to max_bufsize depending
 	// on how fast data is going in and out.
 	deque_reserve(&out->io.data, 1048576);
 
 	pthread_mutex_init(&out->io.data_mutex, NULL);
+	pthread_mutex_init(&out->io.stats_mutex, NULL);
 
 	os_event_init(&out->io.buffer_space_available_event, OS_EVENT_TYPE_AUTO);
 	os_event_init(&out->io.new_data_available_event, OS_EVENT_TYPE_AUTO);
+	os_event_init(&out->io.sync_event, OS_EVENT_TYPE_AUTO);
 
 	pthread_create(&out->io.io_thread, NULL, io_thread, out);
 
@@ -360,6 +1011,25 @@ bool buffered_file_serializer_init(struct serializer *s, const char *path, size_
 	return true;
 }
 
+bool buffered_file_serializer_get_stats(struct serializer *s, struct buffered_file_serializer_stats *stats)
+{
+	struct file_output_data *out = s->data;
+
+	if (!out || !out->io.active)
+		return false;
+
+	pthread_mutex_lock(&out->io.stats_mutex);
+
+	*stats = out->io.stats;
+	if (out->io.submissions)
+		stats->avg_in_flight = (double)out->io.in_flight_sum / (double)out->io.submissions;
+	if (stats->writes)
+		stats->avg_write_latency_ns = out->io.latency_sum / stats->writes;
+
+	pthread_mutex_unlock(&out->io.stats_mutex);
+	return true;
+}
+
 void buffered_file_serializer_free(struct serializer *s)
 {
 	struct file_output_data *out = s->data;
@@ -368,6 +1038,8 @@ void buffered_file_serializer_free(struct serializer *s)
 		return;
 
 	if (out->io.active) {
+		struct buffered_file_serializer_stats stats;
+
 		os_atomic_set_bool(&out->io.shutdown_requested, true);
 
 		// Wakes up the I/O thread and waits for it to finish
@@ -376,14 +1048,26 @@ void buffered_file_serializer_free(struct serializer *s)
 		pthread_mutex_unlock(&out->io.data_mutex);
 		pthread_join(out->io.io_thread, NULL);
 
+		buffered_file_serializer_get_stats(s, &stats);
+		blog(LOG_INFO,
+		     "Buffered writer for '%s' (%s%s): %" PRIu64 " writes, %.1f MiB, "
+		     "queue depth avg %.2f max %zu/%zu, write latency avg %.2f ms max %.2f ms",
+		     out->filename.array, stats.backend, stats.direct_io ? ", direct" : "", stats.writes,
+		     (double)stats.bytes_written / 1048576.0, stats.avg_in_flight, stats.max_in_flight,
+		     stats.queue_depth, (double)stats.avg_write_latency_ns / 1000000.0,
+		     (double)stats.max_write_latency_ns / 1000000.0);
+
+		os_event_destroy(out->io.sync_event);
 		os_event_destroy(out->io.new_data_available_event);
 		os_event_destroy(out->io.buffer_space_available_event);
 
+		pthread_mutex_destroy(&out->io.stats_mutex);
 		pthread_mutex_destroy(&out->io.data_mutex);
 
 		blog(LOG_DEBUG, "Final buffer capacity: %zu KiB", out->io.data.capacity / 1024);
 
 		deque_free(&out->io.data);
+		free_chunks(&out->io);
 	}
 
 	dstr_free(&out->filename);
@@ -25,8 +25,32 @@ extern "C" {
 EXPORT bool buffered_file_serializer_init_defaults(struct serializer *s, const char *path);
 EXPORT bool buffered_file_serializer_init(struct serializer *s, const char *path, size_t max_bufsize,
 					  size_t chunk_size);
+EXPORT bool buffered_file_serializer_init_ex(struct serializer *s, const char *path, size_t max_bufsize,
+					     size_t chunk_size, size_t queue_depth, bool direct_io);
 EXPORT void buffered_file_serializer_free(struct serializer *s);
 
+/* Waits until everything written before the call is on disk.  May be called
+ * from another thread than the one writing, but only one at a time. */
+EXPORT bool buffered_file_serializer_sync(struct serializer *s);
+
+struct buffered_file_serializer_stats {
+	const char *backend;
+	size_t queue_depth;
+	bool direct_io;
+
+	uint64_t writes;
+	uint64_t bytes_written;
+	uint64_t direct_writes;
+
+	size_t max_in_flight;
+	double avg_in_flight;
+
+	uint64_t avg_write_latency_ns;
+	uint64_t max_write_latency_ns;
+};
+
+EXPORT bool buffered_file_serializer_get_stats(struct serializer *s, struct buffered_file_serializer_stats *stats);
+
 #ifdef __cplusplus
 }
 #endif
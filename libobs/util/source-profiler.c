@@ -69,6 +69,10 @@ struct profiler_entry {
 	struct ucirclebuf async_frame_ts;
 	/* Timestamps of last N async frames rendered */
 	struct ucirclebuf async_rendered_ts;
+	/* Audio render times for last N audio ticks, locked by audio_mutex
+	 * since the audio workers only hold hm_rwlock for reading */
+	struct ucirclebuf audio_render;
+	pthread_mutex_t audio_mutex;
 
 	UT_hash_handle hh;
 };
@@ -174,6 +178,8 @@ static struct profiler_entry *entry_create(const uintptr_t key)
 	ucirclebuf_init(&ent->render_gpu_sum, profiler_samples);
 	ucirclebuf_init(&ent->async_frame_ts, profiler_samples);
 	ucirclebuf_init(&ent->async_rendered_ts, profiler_samples);
+	ucirclebuf_init(&ent->audio_render, profiler_samples);
+	pthread_mutex_init(&ent->audio_mutex, NULL);
 	return ent;
 }
 
@@ -186,6 +192,8 @@ static void entry_destroy(struct profiler_entry *entry)
 	ucirclebuf_free(&entry->render_gpu_sum);
 	ucirclebuf_free(&entry->async_frame_ts);
 	ucirclebuf_free(&entry->async_rendered_ts);
+	ucirclebuf_free(&entry->audio_render);
+	pthread_mutex_destroy(&entry->audio_mutex);
 	bfree(entry);
 }
 
@@ -478,6 +486,38 @@ void source_profiler_source_render_end(obs_source_t *source, uint64_t start, gs_
 	}
 }
 
+uint64_t source_profiler_source_audio_render_begin(void)
+{
+	if (!enabled)
+		return 0;
+
+	return os_gettime_ns();
+}
+
+void source_profiler_source_audio_render_end(obs_source_t *source, uint64_t start)
+{
+	if (!enabled || !start)
+		return;
+
+	const uint64_t delta = os_gettime_ns() - start;
+
+	/* Audio is rendered outside of the graphics thread (and possibly on
+	 * several threads at once), so write directly to the entry rather than
+	 * using the frame samples.  The map itself is only read here, taking
+	 * it for writing would serialize the audio workers. */
+	pthread_rwlock_rdlock(&hm_rwlock);
+
+	struct profiler_entry *ent;
+	HASH_FIND_PTR(hm_entries, &source, ent);
+	if (ent) {
+		pthread_mutex_lock(&ent->audio_mutex);
+		ucirclebuf_push(&ent->audio_render, delta);
+		pthread_mutex_unlock(&ent->audio_mutex);
+	}
+
+	pthread_rwlock_unlock(&hm_rwlock);
+}
+
 static void task_delete_source(void *key)
 {
 	struct source_samples *smp;
@@ -487,7 +527,7 @@ static void task_delete_source(void *key)
 		source_samples_destroy(smp);
 	}
 
-	pthread_rwlock_rdlock(&hm_rwlock);
+	pthread_rwlock_wrlock(&hm_rwlock);
 	struct profiler_entry *ent = NULL;
 	HASH_FIND_PTR(hm_entries, &key, ent);
 	if (ent) {
@@ -560,6 +600,27 @@ static inline void calculate_render(struct profiler_entry *ent, struct profiler_
 	}
 }
 
+static inline void calculate_audio_render(struct profiler_entry *ent, struct profiler_result *result)
+{
+	size_t idx = 0;
+	uint64_t sum = 0;
+
+	pthread_mutex_lock(&ent->audio_mutex);
+
+	for (; idx < ent->audio_render.num; idx++) {
+		const uint64_t delta = ent->audio_render.array[idx];
+		if (delta > result->audio_render_max)
+			result->audio_render_max = delta;
+
+		sum += delta;
+	}
+
+	pthread_mutex_unlock(&ent->audio_mutex);
+
+	if (idx)
+		result->audio_render_avg = sum / idx;
+}
+
 static inline void calculate_fps(const struct ucirclebuf *frames, double *avg, uint64_t *best, uint64_t *worst)
 {
 	uint64_t deltas = 0, delta_sum = 0, best_delta = 0, worst_delta = 0;
@@ -605,6 +666,7 @@ bool source_profiler_fill_result(obs_source_t *source, struct profiler_result *r
 	if (ent) {
 		calculate_tick(ent, result);
 		calculate_render(ent, result);
+		calculate_audio_render(ent, result);
 
 		if (is_async_video_source(source)) {
 			calculate_fps(&ent->async_frame_ts, &result->async_input, &result->async_input_best,
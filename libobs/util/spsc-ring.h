@@ -0,0 +1,194 @@
+/*
+ * Copyright (c) 2023 Lain Bailey <lain@obsproject.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#pragma once
+
+#include "c99defs.h"
+#include <string.h>
+#include <assert.h>
+
+#include "bmem.h"
+#include "threading.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Lock-free single-producer/single-consumer ring buffer
+ *
+ * Meant for streams of samples (e.g. planar float audio) that one thread
+ * writes and another reads, without either of them taking a lock.  Sizes are
+ * in bytes, the same as with struct deque, so it can be used in place of a
+ * deque that is only pushed to the back and popped from the front.
+ *
+ * Unlike a deque the ring does not grow: the capacity is fixed when it's
+ * initialized, and a push that doesn't fit fails instead.
+ *
+ * Only one thread may call the producer functions (push) and only one thread
+ * the consumer functions (peek/pop) at a time.  The size functions can be
+ * called from either thread, and are exact for the calling side: the producer
+ * may see less free space and the consumer less data than there actually is,
+ * never more.
+ */
+
+#define SPSC_RING_CACHE_LINE 64
+
+struct spsc_ring {
+	uint8_t *data;
+	size_t capacity;
+
+	/* positions run from 0 to capacity * 2, so that a full ring can be
+	 * told apart from an empty one */
+	char pad0[SPSC_RING_CACHE_LINE];
+	volatile long read_pos;
+	long cached_write_pos;
+
+	char pad1[SPSC_RING_CACHE_LINE];
+	volatile long write_pos;
+	long cached_read_pos;
+
+	char pad2[SPSC_RING_CACHE_LINE];
+};
+
+/* capacity is rounded up to a power of two, and can be at most 512 MiB */
+static inline bool spsc_ring_init(struct spsc_ring *ring, size_t capacity)
+{
+	size_t size = 1;
+
+	memset(ring, 0, sizeof(struct spsc_ring));
+
+	if (!capacity || capacity > ((size_t)1 << 29))
+		return false;
+
+	while (size < capacity)
+		size <<= 1;
+
+	ring->data = (uint8_t *)bmalloc(size);
+	ring->capacity = size;
+	return true;
+}
+
+static inline void spsc_ring_free(struct spsc_ring *ring)
+{
+	bfree(ring->data);
+	memset(ring, 0, sizeof(struct spsc_ring));
+}
+
+static inline size_t spsc_ring_pos_diff(const struct spsc_ring *ring, long end, long start)
+{
+	return (size_t)(end - start) & (ring->capacity * 2 - 1);
+}
+
+static inline long spsc_ring_pos_add(const struct spsc_ring *ring, long pos, size_t size)
+{
+	return (long)(((size_t)pos + size) & (ring->capacity * 2 - 1));
+}
+
+/* bytes available to the consumer */
+static inline size_t spsc_ring_size(const struct spsc_ring *ring)
+{
+	long read_pos = os_atomic_load_long(&ring->read_pos);
+	long write_pos = os_atomic_load_long(&ring->write_pos);
+	return spsc_ring_pos_diff(ring, write_pos, read_pos);
+}
+
+/* bytes available to the producer */
+static inline size_t spsc_ring_free_space(const struct spsc_ring *ring)
+{
+	return ring->capacity - spsc_ring_size(ring);
+}
+
+static inline void spsc_ring_copy_in(struct spsc_ring *ring, long pos, const void *data, size_t size)
+{
+	size_t offset = (size_t)pos & (ring->capacity - 1);
+	size_t first = ring->capacity - offset;
+
+	if (first > size)
+		first = size;
+
+	if (data) {
+		memcpy(ring->data + offset, data, first);
+		memcpy(ring->data, (const uint8_t *)data + first, size - first);
+	} else {
+		memset(ring->data + offset, 0, first);
+		memset(ring->data, 0, size - first);
+	}
+}
+
+static inline void spsc_ring_copy_out(const struct spsc_ring *ring, long pos, void *data, size_t size)
+{
+	size_t offset = (size_t)pos & (ring->capacity - 1);
+	size_t first = ring->capacity - offset;
+
+	if (first > size)
+		first = size;
+
+	memcpy(data, ring->data + offset, first);
+	memcpy((uint8_t *)data + first, ring->data, size - first);
+}
+
+/* producer: fails without writing anything if there isn't enough space */
+static inline bool spsc_ring_push_back(struct spsc_ring *ring, const void *data, size_t size)
+{
+	long write_pos = ring->write_pos;
+
+	if (spsc_ring_pos_diff(ring, write_pos, ring->cached_read_pos) + size > ring->capacity) {
+		ring->cached_read_pos = os_atomic_load_long(&ring->read_pos);
+		if (spsc_ring_pos_diff(ring, write_pos, ring->cached_read_pos) + size > ring->capacity)
+			return false;
+	}
+
+	spsc_ring_copy_in(ring, write_pos, data, size);
+	os_atomic_store_long(&ring->write_pos, spsc_ring_pos_add(ring, write_pos, size));
+	return true;
+}
+
+static inline bool spsc_ring_push_back_zero(struct spsc_ring *ring, size_t size)
+{
+	return spsc_ring_push_back(ring, NULL, size);
+}
+
+/* consumer: returns false without reading anything if there isn't enough
+ * data */
+static inline bool spsc_ring_peek_front(struct spsc_ring *ring, void *data, size_t size)
+{
+	long read_pos = ring->read_pos;
+
+	if (spsc_ring_pos_diff(ring, ring->cached_write_pos, read_pos) < size) {
+		ring->cached_write_pos = os_atomic_load_long(&ring->write_pos);
+		if (spsc_ring_pos_diff(ring, ring->cached_write_pos, read_pos) < size)
+			return false;
+	}
+
+	if (data)
+		spsc_ring_copy_out(ring, read_pos, data, size);
+	return true;
+}
+
+/* consumer: data can be NULL to discard */
+static inline bool spsc_ring_pop_front(struct spsc_ring *ring, void *data, size_t size)
+{
+	if (!spsc_ring_peek_front(ring, data, size))
+		return false;
+
+	os_atomic_store_long(&ring->read_pos, spsc_ring_pos_add(ring, ring->read_pos, size));
+	return true;
+}
+
+#ifdef __cplusplus
+}
+#endif
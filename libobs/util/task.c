@@ -1,7 +1,49 @@
+#include <inttypes.h>
+#include <string.h>
+
 #include "task.h"
 #include "bmem.h"
 #include "threading.h"
 #include "deque.h"
+#include "platform.h"
+#include "profiler.h"
+
+/* stop markers are kept apart from the real tasks so that they are only
+ * picked up once everything else has been taken */
+#define STOP_SLOT OS_TASK_PRIORITY_COUNT
+
+struct os_task_worker {
+	struct os_task_pool *pool;
+	size_t idx;
+	pthread_t thread;
+
+	pthread_mutex_t mutex;
+	struct deque tasks[OS_TASK_PRIORITY_COUNT + 1];
+};
+
+struct os_task_pool {
+	/* all workers are allocated up front, but their threads are only
+	 * started once the ones already running can't keep up */
+	struct os_task_worker *workers;
+	size_t num_workers;
+	volatile long num_started;
+	volatile long active;
+	pthread_mutex_t start_mutex;
+	bool stopping;
+	os_sem_t *sem;
+
+	/* workers waiting on a pooled queue from inside a task sleep here
+	 * until more work is queued or the queue finishes */
+	pthread_mutex_t help_mutex;
+	pthread_cond_t help_cond;
+	long help_seq;
+	volatile long helpers;
+
+	volatile long next_worker;
+	volatile long queued[OS_TASK_PRIORITY_COUNT];
+	volatile long executed[OS_TASK_PRIORITY_COUNT];
+	volatile long steals;
+};
 
 struct os_task_queue {
 	pthread_t thread;
@@ -14,6 +56,12 @@ struct os_task_queue {
 
 	pthread_mutex_t mutex;
 	struct deque tasks;
+
+	/* pooled queues only */
+	struct os_task_pool *pool;
+	enum os_task_priority priority;
+	bool scheduled;
+	volatile long refs;
 };
 
 struct os_task_info {
@@ -23,8 +71,17 @@ struct os_task_info {
 
 static THREAD_LOCAL bool exit_thread = false;
 static THREAD_LOCAL long thread_id = 0;
+static THREAD_LOCAL struct os_task_worker *current_worker = NULL;
 static volatile long thread_id_counter = 1;
 
+static const char *priority_names[] = {
+	"os_task_pool: high priority task",
+	"os_task_pool: normal priority task",
+	"os_task_pool: background task",
+};
+
+static const char *stolen_task_name = "stolen";
+
 static void *tiny_tubular_task_thread(void *param);
 
 os_task_queue_t *os_task_queue_create(void)
@@ -54,6 +111,66 @@ fail1:
 	return NULL;
 }
 
+os_task_queue_t *os_task_queue_create_pooled(os_task_pool_t *pool, enum os_task_priority priority)
+{
+	if (!pool || (size_t)priority >= OS_TASK_PRIORITY_COUNT)
+		return NULL;
+
+	struct os_task_queue *tq = bzalloc(sizeof(*tq));
+	tq->id = os_atomic_inc_long(&thread_id_counter);
+	tq->pool = pool;
+	tq->priority = priority;
+	tq->refs = 1;
+
+	if (pthread_mutex_init(&tq->mutex, NULL) != 0)
+		goto fail1;
+	if (os_event_init(&tq->wait_event, OS_EVENT_TYPE_AUTO) != 0)
+		goto fail2;
+
+	return tq;
+
+fail2:
+	pthread_mutex_destroy(&tq->mutex);
+fail1:
+	bfree(tq);
+	return NULL;
+}
+
+static void os_task_queue_release(struct os_task_queue *tq)
+{
+	if (os_atomic_dec_long(&tq->refs) != 0)
+		return;
+
+	os_event_destroy(tq->wait_event);
+	pthread_mutex_destroy(&tq->mutex);
+	deque_free(&tq->tasks);
+	bfree(tq);
+}
+
+static void run_pooled_task(void *param);
+
+/* must be called with the queue mutex held, returns true if the queue has to
+ * be scheduled on its pool afterwards */
+static bool push_task(struct os_task_queue *tq, const struct os_task_info *ti)
+{
+	deque_push_back(&tq->tasks, ti, sizeof(*ti));
+
+	if (!tq->pool || tq->scheduled)
+		return false;
+
+	tq->scheduled = true;
+	os_atomic_inc_long(&tq->refs);
+	return true;
+}
+
+static void signal_task(struct os_task_queue *tq, bool schedule)
+{
+	if (!tq->pool)
+		os_sem_post(tq->sem);
+	else if (schedule)
+		os_task_pool_queue_task(tq->pool, tq->priority, run_pooled_task, tq);
+}
+
 bool os_task_queue_queue_task(os_task_queue_t *tq, os_task_t task, void *param)
 {
 	struct os_task_info ti = {
@@ -65,16 +182,21 @@ bool os_task_queue_queue_task(os_task_queue_t *tq, os_task_t task, void *param)
 		return false;
 
 	pthread_mutex_lock(&tq->mutex);
-	deque_push_back(&tq->tasks, &ti, sizeof(ti));
+	bool schedule = push_task(tq, &ti);
 	pthread_mutex_unlock(&tq->mutex);
-	os_sem_post(tq->sem);
+	signal_task(tq, schedule);
 	return true;
 }
 
+static void wake_helpers(struct os_task_pool *pool);
+
 static void wait_for_thread(void *data)
 {
 	os_task_queue_t *tq = data;
 	os_event_signal(tq->wait_event);
+
+	if (tq->pool)
+		wake_helpers(tq->pool);
 }
 
 static void stop_thread(void *unused)
@@ -88,6 +210,12 @@ void os_task_queue_destroy(os_task_queue_t *tq)
 	if (!tq)
 		return;
 
+	if (tq->pool) {
+		os_task_queue_wait(tq);
+		os_task_queue_release(tq);
+		return;
+	}
+
 	os_task_queue_queue_task(tq, stop_thread, NULL);
 	pthread_join(tq->thread, NULL);
 	os_event_destroy(tq->wait_event);
@@ -97,6 +225,8 @@ void os_task_queue_destroy(os_task_queue_t *tq)
 	bfree(tq);
 }
 
+static void help_pool_until(struct os_task_worker *worker, os_event_t *event);
+
 bool os_task_queue_wait(os_task_queue_t *tq)
 {
 	if (!tq)
@@ -110,11 +240,18 @@ bool os_task_queue_wait(os_task_queue_t *tq)
 	pthread_mutex_lock(&tq->mutex);
 	tq->waiting = true;
 	tq->tasks_processed = false;
-	deque_push_back(&tq->tasks, &ti, sizeof(ti));
+	bool schedule = push_task(tq, &ti);
 	pthread_mutex_unlock(&tq->mutex);
 
-	os_sem_post(tq->sem);
-	os_event_wait(tq->wait_event);
+	signal_task(tq, schedule);
+
+	if (tq->pool && current_worker && current_worker->pool == tq->pool) {
+		/* blocking a worker on work queued on its own pool could
+		 * stall the pool, so run other tasks in the meantime */
+		help_pool_until(current_worker, tq->wait_event);
+	} else {
+		os_event_wait(tq->wait_event);
+	}
 
 	pthread_mutex_lock(&tq->mutex);
 	bool tasks_processed = tq->tasks_processed;
@@ -162,3 +299,377 @@ static void *tiny_tubular_task_thread(void *param)
 
 	return NULL;
 }
+
+/* Runs a single task of a pooled queue. Only one of these is queued on the
+ * pool per task queue at any time, which is what keeps the tasks in order. */
+static void run_pooled_task(void *param)
+{
+	struct os_task_queue *tq = param;
+	struct os_task_info ti;
+	long prev_thread_id = thread_id;
+
+	pthread_mutex_lock(&tq->mutex);
+	deque_pop_front(&tq->tasks, &ti, sizeof(ti));
+	if (tq->tasks.size && ti.task == wait_for_thread) {
+		deque_push_back(&tq->tasks, &ti, sizeof(ti));
+		deque_pop_front(&tq->tasks, &ti, sizeof(ti));
+	}
+	if (tq->waiting) {
+		if (ti.task == wait_for_thread) {
+			tq->waiting = false;
+		} else {
+			tq->tasks_processed = true;
+		}
+	}
+	pthread_mutex_unlock(&tq->mutex);
+
+	thread_id = tq->id;
+	ti.task(ti.param);
+	thread_id = prev_thread_id;
+
+	pthread_mutex_lock(&tq->mutex);
+	bool more = tq->tasks.size != 0;
+	if (!more)
+		tq->scheduled = false;
+	pthread_mutex_unlock(&tq->mutex);
+
+	/* requeue at the back of the pool so that one busy queue does not
+	 * hold a worker to itself */
+	if (more)
+		os_task_pool_queue_task(tq->pool, tq->priority, run_pooled_task, tq);
+	else
+		os_task_queue_release(tq);
+}
+
+/* ------------------------------------------------------------------------- */
+/* Work-stealing pool */
+
+static bool pop_task(struct os_task_worker *worker, size_t slot, struct os_task_info *ti)
+{
+	bool found = false;
+
+	pthread_mutex_lock(&worker->mutex);
+	if (worker->tasks[slot].size) {
+		deque_pop_front(&worker->tasks[slot], ti, sizeof(*ti));
+		found = true;
+	}
+	pthread_mutex_unlock(&worker->mutex);
+
+	return found;
+}
+
+/* Takes the highest priority task available, from the worker's own queues
+ * first and from the other workers' queues otherwise */
+static bool find_task(struct os_task_worker *worker, size_t num_slots, struct os_task_info *ti, size_t *slot,
+		      bool *stolen)
+{
+	struct os_task_pool *pool = worker->pool;
+
+	for (size_t i = 0; i < num_slots; i++) {
+		if (pop_task(worker, i, ti)) {
+			*slot = i;
+			*stolen = false;
+			return true;
+		}
+
+		for (size_t j = 1; j < pool->num_workers; j++) {
+			struct os_task_worker *victim = &pool->workers[(worker->idx + j) % pool->num_workers];
+
+			if (pop_task(victim, i, ti)) {
+				*slot = i;
+				*stolen = true;
+				return true;
+			}
+		}
+	}
+
+	return false;
+}
+
+static void run_task(struct os_task_pool *pool, const struct os_task_info *ti, size_t slot, bool stolen)
+{
+	os_atomic_dec_long(&pool->queued[slot]);
+
+	if (stolen)
+		os_atomic_inc_long(&pool->steals);
+
+	profile_start(priority_names[slot]);
+	if (stolen)
+		profile_start(stolen_task_name);
+
+	ti->task(ti->param);
+
+	if (stolen)
+		profile_end(stolen_task_name);
+	profile_end(priority_names[slot]);
+
+	os_atomic_inc_long(&pool->executed[slot]);
+}
+
+static void wake_helpers(struct os_task_pool *pool)
+{
+	if (!os_atomic_load_long(&pool->helpers))
+		return;
+
+	pthread_mutex_lock(&pool->help_mutex);
+	pool->help_seq++;
+	pthread_cond_broadcast(&pool->help_cond);
+	pthread_mutex_unlock(&pool->help_mutex);
+}
+
+/* Runs tasks of the pool until the event is signaled, sleeping while there
+ * is nothing to run.  The sequence number is taken before looking for work,
+ * so a task queued after that wakes the helper up again. */
+static void help_pool_until(struct os_task_worker *worker, os_event_t *event)
+{
+	struct os_task_pool *pool = worker->pool;
+
+	os_atomic_inc_long(&pool->helpers);
+
+	while (os_event_try(event) != 0) {
+		struct os_task_info ti;
+		size_t slot;
+		bool stolen;
+
+		pthread_mutex_lock(&pool->help_mutex);
+		long seq = pool->help_seq;
+		pthread_mutex_unlock(&pool->help_mutex);
+
+		if (find_task(worker, OS_TASK_PRIORITY_COUNT, &ti, &slot, &stolen)) {
+			run_task(pool, &ti, slot, stolen);
+			continue;
+		}
+		if (os_event_try(event) == 0)
+			break;
+
+		pthread_mutex_lock(&pool->help_mutex);
+		while (pool->help_seq == seq)
+			pthread_cond_wait(&pool->help_cond, &pool->help_mutex);
+		pthread_mutex_unlock(&pool->help_mutex);
+	}
+
+	os_atomic_dec_long(&pool->helpers);
+}
+
+static void *task_pool_thread(void *param)
+{
+	struct os_task_worker *worker = param;
+	struct os_task_pool *pool = worker->pool;
+
+	current_worker = worker;
+	os_set_thread_name("libobs: task pool worker");
+
+	for (;;) {
+		struct os_task_info ti;
+		size_t slot;
+		bool stolen;
+
+		if (os_sem_wait(pool->sem) != 0)
+			break;
+
+		/* another worker may have already taken the task this
+		 * wakeup was for */
+		if (!find_task(worker, OS_TASK_PRIORITY_COUNT + 1, &ti, &slot, &stolen))
+			continue;
+		if (slot == STOP_SLOT)
+			break;
+
+		os_atomic_inc_long(&pool->active);
+		run_task(pool, &ti, slot, stolen);
+		os_atomic_dec_long(&pool->active);
+	}
+
+	return NULL;
+}
+
+static bool start_worker(struct os_task_pool *pool)
+{
+	struct os_task_worker *worker = &pool->workers[pool->num_started];
+
+	if (pthread_create(&worker->thread, NULL, task_pool_thread, worker) != 0) {
+		blog(LOG_WARNING, "Task pool: failed to start worker thread %zu", worker->idx);
+		return false;
+	}
+
+	os_atomic_inc_long(&pool->num_started);
+	return true;
+}
+
+/* Starts another worker if more tasks are queued than there are idle workers
+ * to take them.  The counts are read without a lock, so this only decides
+ * whether to start a thread, the workers that are running always get to
+ * every task eventually. */
+static void start_worker_if_busy(struct os_task_pool *pool)
+{
+	long started = os_atomic_load_long(&pool->num_started);
+	long queued = 0;
+
+	if ((size_t)started >= pool->num_workers)
+		return;
+
+	for (size_t i = 0; i < OS_TASK_PRIORITY_COUNT; i++)
+		queued += os_atomic_load_long(&pool->queued[i]);
+	if (queued <= started - os_atomic_load_long(&pool->active))
+		return;
+
+	pthread_mutex_lock(&pool->start_mutex);
+	if (!pool->stopping && (size_t)pool->num_started < pool->num_workers)
+		start_worker(pool);
+	pthread_mutex_unlock(&pool->start_mutex);
+}
+
+static void push_pool_task(struct os_task_pool *pool, size_t slot, const struct os_task_info *ti)
+{
+	struct os_task_worker *worker = current_worker;
+
+	/* tasks queued from a worker stay on that worker unless stolen */
+	if (!worker || worker->pool != pool) {
+		long idx = os_atomic_inc_long(&pool->next_worker);
+		long started = os_atomic_load_long(&pool->num_started);
+		worker = &pool->workers[(unsigned long)idx % (unsigned long)started];
+	}
+
+	pthread_mutex_lock(&worker->mutex);
+	deque_push_back(&worker->tasks[slot], ti, sizeof(*ti));
+	pthread_mutex_unlock(&worker->mutex);
+
+	os_sem_post(pool->sem);
+
+	if (slot != STOP_SLOT) {
+		wake_helpers(pool);
+		start_worker_if_busy(pool);
+	}
+}
+
+os_task_pool_t *os_task_pool_create(size_t num_threads)
+{
+	struct os_task_pool *pool = bzalloc(sizeof(*pool));
+
+	if (!num_threads) {
+		int cores = os_get_logical_cores();
+		num_threads = cores > 3 ? (size_t)cores - 1 : 2;
+	}
+
+	if (os_sem_init(&pool->sem, 0) != 0) {
+		bfree(pool);
+		return NULL;
+	}
+
+	pthread_mutex_init(&pool->start_mutex, NULL);
+	pthread_mutex_init(&pool->help_mutex, NULL);
+	pthread_cond_init(&pool->help_cond, NULL);
+
+	pool->workers = bzalloc(num_threads * sizeof(struct os_task_worker));
+
+	for (size_t i = 0; i < num_threads; i++) {
+		struct os_task_worker *worker = &pool->workers[i];
+
+		worker->pool = pool;
+		worker->idx = i;
+		pthread_mutex_init(&worker->mutex, NULL);
+	}
+
+	pool->num_workers = num_threads;
+
+	/* one worker is always there so that queued tasks are guaranteed
+	 * to run, the rest are started on demand */
+	if (!start_worker(pool)) {
+		os_task_pool_destroy(pool);
+		return NULL;
+	}
+
+	return pool;
+}
+
+void os_task_pool_destroy(os_task_pool_t *pool)
+{
+	struct os_task_info stop = {NULL, NULL};
+	struct os_task_pool_stats stats;
+
+	if (!pool)
+		return;
+
+	pthread_mutex_lock(&pool->start_mutex);
+	pool->stopping = true;
+	size_t num_started = (size_t)pool->num_started;
+	pthread_mutex_unlock(&pool->start_mutex);
+
+	for (size_t i = 0; i < num_started; i++)
+		push_pool_task(pool, STOP_SLOT, &stop);
+	for (size_t i = 0; i < num_started; i++)
+		pthread_join(pool->workers[i].thread, NULL);
+
+	os_task_pool_get_stats(pool, &stats);
+
+	/* anything that was queued while the workers were stopping, which may
+	 * queue more tasks in turn */
+	for (bool ran = true; ran;) {
+		ran = false;
+
+		for (size_t i = 0; i < pool->num_workers; i++) {
+			struct os_task_worker *worker = &pool->workers[i];
+			struct os_task_info ti;
+
+			for (size_t slot = 0; slot < OS_TASK_PRIORITY_COUNT; slot++) {
+				while (pop_task(worker, slot, &ti)) {
+					ti.task(ti.param);
+					ran = true;
+				}
+			}
+		}
+	}
+
+	blog(LOG_INFO,
+	     "Task pool: %zu threads, %" PRIu64 "/%" PRIu64 "/%" PRIu64 " high/normal/background tasks, %" PRIu64
+	     " stolen",
+	     stats.num_threads, stats.executed[OS_TASK_PRIORITY_HIGH], stats.executed[OS_TASK_PRIORITY_NORMAL],
+	     stats.executed[OS_TASK_PRIORITY_BACKGROUND], stats.steals);
+
+	for (size_t i = 0; i < pool->num_workers; i++) {
+		struct os_task_worker *worker = &pool->workers[i];
+
+		for (size_t slot = 0; slot <= OS_TASK_PRIORITY_COUNT; slot++)
+			deque_free(&worker->tasks[slot]);
+		pthread_mutex_destroy(&worker->mutex);
+	}
+
+	pthread_cond_destroy(&pool->help_cond);
+	pthread_mutex_destroy(&pool->help_mutex);
+	pthread_mutex_destroy(&pool->start_mutex);
+	os_sem_destroy(pool->sem);
+	bfree(pool->workers);
+	bfree(pool);
+}
+
+bool os_task_pool_queue_task(os_task_pool_t *pool, enum os_task_priority priority, os_task_t task, void *param)
+{
+	struct os_task_info ti = {
+		task,
+		param,
+	};
+
+	if (!pool || !task || (size_t)priority >= OS_TASK_PRIORITY_COUNT)
+		return false;
+
+	os_atomic_inc_long(&pool->queued[priority]);
+	push_pool_task(pool, priority, &ti);
+	return true;
+}
+
+void os_task_pool_get_stats(os_task_pool_t *pool, struct os_task_pool_stats *stats)
+{
+	memset(stats, 0, sizeof(*stats));
+
+	if (!pool)
+		return;
+
+	stats->num_threads = (size_t)os_atomic_load_long(&pool->num_started);
+	stats->steals = (uint64_t)os_atomic_load_long(&pool->steals);
+
+	for (size_t i = 0; i < OS_TASK_PRIORITY_COUNT; i++) {
+		long queued = os_atomic_load_long(&pool->queued[i]);
+
+		stats->queued[i] = queued > 0 ? (size_t)queued : 0;
+		stats->executed[i] = (uint64_t)os_atomic_load_long(&pool->executed[i]);
+	}
+}
@@ -9,14 +9,49 @@ extern "C" {
 struct os_task_queue;
 typedef struct os_task_queue os_task_queue_t;
 
+struct os_task_pool;
+typedef struct os_task_pool os_task_pool_t;
+
 typedef void (*os_task_t)(void *param);
 
+enum os_task_priority {
+	/* work that real-time threads are waiting on */
+	OS_TASK_PRIORITY_HIGH,
+	OS_TASK_PRIORITY_NORMAL,
+	/* file I/O and other work nobody is waiting on */
+	OS_TASK_PRIORITY_BACKGROUND,
+
+	OS_TASK_PRIORITY_COUNT,
+};
+
+struct os_task_pool_stats {
+	size_t num_threads;
+	size_t queued[OS_TASK_PRIORITY_COUNT];
+	uint64_t executed[OS_TASK_PRIORITY_COUNT];
+	uint64_t steals;
+};
+
 EXPORT os_task_queue_t *os_task_queue_create(void);
 EXPORT bool os_task_queue_queue_task(os_task_queue_t *tt, os_task_t task, void *param);
 EXPORT void os_task_queue_destroy(os_task_queue_t *tt);
 EXPORT bool os_task_queue_wait(os_task_queue_t *tt);
 EXPORT bool os_task_queue_inside(os_task_queue_t *tt);
 
+/* Shared pool of up to num_threads worker threads, started as they are
+ * needed. Each worker has its own queues and takes work from the other
+ * workers once those are empty. Tasks queued directly on the pool run in no
+ * particular order, use a pooled task queue for tasks that have to run one at
+ * a time in FIFO order. */
+EXPORT os_task_pool_t *os_task_pool_create(size_t num_threads);
+EXPORT void os_task_pool_destroy(os_task_pool_t *pool);
+EXPORT bool os_task_pool_queue_task(os_task_pool_t *pool, enum os_task_priority priority, os_task_t task,
+				    void *param);
+EXPORT void os_task_pool_get_stats(os_task_pool_t *pool, struct os_task_pool_stats *stats);
+
+/* Task queue that runs its tasks in order on a pool instead of its own
+ * thread */
+EXPORT os_task_queue_t *os_task_queue_create_pooled(os_task_pool_t *pool, enum os_task_priority priority);
+
 #ifdef __cplusplus
 }
 #endif
@@ -26,6 +26,11 @@ static inline long os_atomic_dec_long(volatile long *val)
 	return __atomic_sub_fetch(val, 1, __ATOMIC_SEQ_CST);
 }
 
+static inline long os_atomic_add_long(volatile long *val, long add)
+{
+	return __atomic_add_fetch(val, add, __ATOMIC_SEQ_CST);
+}
+
 static inline void os_atomic_store_long(volatile long *ptr, long val)
 {
 	__atomic_store_n(ptr, val, __ATOMIC_SEQ_CST);
@@ -75,3 +80,13 @@ static inline bool os_atomic_load_bool(const volatile bool *ptr)
 {
 	return __atomic_load_n(ptr, __ATOMIC_SEQ_CST);
 }
+
+static inline void *os_atomic_exchange_ptr(void *volatile *ptr, void *val)
+{
+	return __atomic_exchange_n(ptr, val, __ATOMIC_SEQ_CST);
+}
+
+static inline void *os_atomic_load_ptr(void *const volatile *ptr)
+{
+	return __atomic_load_n(ptr, __ATOMIC_SEQ_CST);
+}
@@ -0,0 +1,545 @@
+/*
+ * Copyright (c) 2023 Lain Bailey <lain@obsproject.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "ffmpeg-mux-shm.h"
+
+#include <util/c99defs.h>
+
+#ifdef __linux__
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+
+#include <util/bmem.h>
+#include <util/platform.h>
+#include <util/threading.h>
+
+#define FFM_SHM_MAGIC 0x6d6d6666 /* "ffmm" */
+#define FFM_SHM_VERSION 1
+#define FFM_SHM_CACHE_LINE 64
+
+/* how often a waiting side wakes up to check whether the other one is gone */
+#define WAIT_TIMEOUT_MS 100
+/* how long the helper gets to attach before the writer gives up on it */
+#define ATTACH_TIMEOUT_NS (10ULL * 1000000000ULL)
+
+/*
+ * Lives in the first page of the shared memory, the data area follows.
+ *
+ * Positions only ever grow (modulo the range of long), the offset in the data
+ * area is the position masked with the capacity.  data_seq and space_seq are
+ * futex words, only bumped and woken when the other side has said it's
+ * waiting.
+ */
+struct ffm_shm_header {
+	uint32_t magic;
+	uint32_t version;
+	uint64_t capacity;
+
+	/* held by the helper while it's attached.  it's robust, so it is
+	 * released when the helper exits without detaching, which is how the
+	 * writer notices that nobody is reading anymore. */
+	pthread_mutex_t reader_mutex;
+	volatile long attached;
+	volatile long closed;
+
+	char pad0[FFM_SHM_CACHE_LINE];
+	volatile long write_pos;
+	uint32_t data_seq;
+	volatile long reader_waiting;
+
+	char pad1[FFM_SHM_CACHE_LINE];
+	volatile long read_pos;
+	uint32_t space_seq;
+	volatile long writer_waiting;
+};
+
+struct ffm_shm {
+	struct ffm_shm_header *header;
+	size_t header_size;
+	uint8_t *data;
+	size_t capacity;
+	char name[64];
+
+	bool writer;
+
+	/* writer */
+	uint64_t create_time;
+	bool unlinked;
+	bool reader_gone;
+
+	/* reader */
+	pid_t parent;
+	bool locked;
+};
+
+static volatile long shm_counter = 0;
+
+static inline void futex_wait(uint32_t *addr, uint32_t val)
+{
+	struct timespec timeout = {0, WAIT_TIMEOUT_MS * 1000000L};
+	syscall(SYS_futex, addr, FUTEX_WAIT, val, &timeout, NULL, 0);
+}
+
+static inline void futex_wake(uint32_t *addr)
+{
+	syscall(SYS_futex, addr, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+}
+
+/* called after publishing a new position, wakes the other side if it's (about
+ * to be) waiting on it */
+static inline void notify(uint32_t *seq, volatile long *waiting)
+{
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+	if (os_atomic_load_long(waiting)) {
+		__atomic_add_fetch(seq, 1, __ATOMIC_SEQ_CST);
+		futex_wake(seq);
+	}
+}
+
+static inline size_t used_space(const struct ffm_shm *shm)
+{
+	const struct ffm_shm_header *header = shm->header;
+	return (size_t)((unsigned long)os_atomic_load_long(&header->write_pos) -
+			(unsigned long)os_atomic_load_long(&header->read_pos));
+}
+
+static inline uint8_t *pos_ptr(const struct ffm_shm *shm, long pos)
+{
+	return shm->data + ((size_t)pos & (shm->capacity - 1));
+}
+
+/* ------------------------------------------------------------------------- */
+
+static bool map_ring(struct ffm_shm *shm, int fd)
+{
+	uint8_t *area;
+
+	/* reserve twice the capacity, then map the data area into both
+	 * halves */
+	area = mmap(NULL, shm->capacity * 2, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (area == MAP_FAILED)
+		return false;
+
+	for (size_t i = 0; i < 2; i++) {
+		void *half = mmap(area + shm->capacity * i, shm->capacity, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED,
+				  fd, (off_t)shm->header_size);
+		if (half == MAP_FAILED) {
+			munmap(area, shm->capacity * 2);
+			return false;
+		}
+	}
+
+	shm->data = area;
+	return true;
+}
+
+static void unmap_ring(struct ffm_shm *shm)
+{
+	if (shm->data)
+		munmap(shm->data, shm->capacity * 2);
+	if (shm->header)
+		munmap(shm->header, shm->header_size);
+}
+
+static inline size_t get_header_size(void)
+{
+	size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+	return (sizeof(struct ffm_shm_header) + page_size - 1) & ~(page_size - 1);
+}
+
+struct ffm_shm *ffm_shm_create(size_t capacity)
+{
+	struct ffm_shm *shm = bzalloc(sizeof(struct ffm_shm));
+	size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+	pthread_mutexattr_t attr;
+	int fd;
+
+	/* a power of two, so positions can be masked */
+	shm->capacity = page_size;
+	while (shm->capacity < capacity)
+		shm->capacity <<= 1;
+
+	shm->header_size = get_header_size();
+	shm->writer = true;
+
+	snprintf(shm->name, sizeof(shm->name), "/obs-ffmpeg-mux-%d-%ld", (int)getpid(),
+		 os_atomic_inc_long(&shm_counter));
+
+	fd = shm_open(shm->name, O_RDWR | O_CREAT | O_EXCL, 0600);
+	if (fd == -1)
+		goto fail;
+
+	if (ftruncate(fd, (off_t)(shm->header_size + shm->capacity)) != 0)
+		goto fail_unlink;
+
+	shm->header = mmap(NULL, shm->header_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (shm->header == MAP_FAILED) {
+		shm->header = NULL;
+		goto fail_unlink;
+	}
+
+	if (!map_ring(shm, fd))
+		goto fail_unlink;
+
+	close(fd);
+	fd = -1;
+
+	pthread_mutexattr_init(&attr);
+	pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+	pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+	int ret = pthread_mutex_init(&shm->header->reader_mutex, &attr);
+	pthread_mutexattr_destroy(&attr);
+
+	if (ret != 0)
+		goto fail_unlink;
+
+	shm->header->magic = FFM_SHM_MAGIC;
+	shm->header->version = FFM_SHM_VERSION;
+	shm->header->capacity = shm->capacity;
+	shm->create_time = os_gettime_ns();
+	return shm;
+
+fail_unlink:
+	if (fd != -1)
+		close(fd);
+	shm_unlink(shm->name);
+fail:
+	unmap_ring(shm);
+	bfree(shm);
+	return NULL;
+}
+
+const char *ffm_shm_name(const struct ffm_shm *shm)
+{
+	return shm->name;
+}
+
+size_t ffm_shm_capacity(const struct ffm_shm *shm)
+{
+	return shm->capacity;
+}
+
+static bool reader_alive(struct ffm_shm *shm)
+{
+	struct ffm_shm_header *header = shm->header;
+
+	if (shm->reader_gone)
+		return false;
+
+	if (!os_atomic_load_long(&header->attached)) {
+		if (os_gettime_ns() - shm->create_time < ATTACH_TIMEOUT_NS)
+			return true;
+
+		shm->reader_gone = true;
+		return false;
+	}
+
+	/* nobody else needs to open it anymore, so don't leave it behind if
+	 * obs crashes */
+	if (!shm->unlinked) {
+		shm_unlink(shm->name);
+		shm->unlinked = true;
+	}
+
+	int ret = pthread_mutex_trylock(&header->reader_mutex);
+	if (ret == EBUSY)
+		return true;
+
+	if (ret == EOWNERDEAD)
+		pthread_mutex_consistent(&header->reader_mutex);
+	if (ret == 0 || ret == EOWNERDEAD)
+		pthread_mutex_unlock(&header->reader_mutex);
+
+	shm->reader_gone = true;
+	return false;
+}
+
+static bool writer_wait(struct ffm_shm *shm, size_t size)
+{
+	struct ffm_shm_header *header = shm->header;
+
+	for (;;) {
+		if (shm->capacity - used_space(shm) >= size)
+			return true;
+		if (!reader_alive(shm))
+			return false;
+
+		uint32_t seq = __atomic_load_n(&header->space_seq, __ATOMIC_SEQ_CST);
+		os_atomic_set_long(&header->writer_waiting, 1);
+
+		if (shm->capacity - used_space(shm) < size)
+			futex_wait(&header->space_seq, seq);
+
+		os_atomic_set_long(&header->writer_waiting, 0);
+	}
+}
+
+bool ffm_shm_write(struct ffm_shm *shm, const void *data, size_t size)
+{
+	struct ffm_shm_header *header = shm->header;
+	const uint8_t *bytes = data;
+
+	if (!reader_alive(shm))
+		return false;
+
+	while (size) {
+		/* large writes go in parts, so that the reader can start on
+		 * them before the whole thing fits */
+		size_t part = size < shm->capacity / 4 ? size : shm->capacity / 4;
+		long pos = header->write_pos;
+
+		if (!writer_wait(shm, part))
+			return false;
+
+		memcpy(pos_ptr(shm, pos), bytes, part);
+		os_atomic_store_long(&header->write_pos, (long)((unsigned long)pos + part));
+		notify(&header->data_seq, &header->reader_waiting);
+
+		bytes += part;
+		size -= part;
+	}
+
+	return true;
+}
+
+void ffm_shm_close(struct ffm_shm *shm)
+{
+	struct ffm_shm_header *header = shm->header;
+
+	os_atomic_set_long(&header->closed, 1);
+	__atomic_add_fetch(&header->data_seq, 1, __ATOMIC_SEQ_CST);
+	futex_wake(&header->data_seq);
+}
+
+/* ------------------------------------------------------------------------- */
+
+struct ffm_shm *ffm_shm_open(const char *name)
+{
+	struct ffm_shm *shm = bzalloc(sizeof(struct ffm_shm));
+	struct stat st;
+	int fd;
+
+	shm->header_size = get_header_size();
+	snprintf(shm->name, sizeof(shm->name), "%s", name);
+
+	fd = shm_open(shm->name, O_RDWR, 0);
+	if (fd == -1)
+		goto fail;
+
+	if (fstat(fd, &st) != 0 || (size_t)st.st_size < shm->header_size)
+		goto fail;
+
+	shm->header = mmap(NULL, shm->header_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (shm->header == MAP_FAILED) {
+		shm->header = NULL;
+		goto fail;
+	}
+
+	if (shm->header->magic != FFM_SHM_MAGIC || shm->header->version != FFM_SHM_VERSION)
+		goto fail;
+
+	shm->capacity = (size_t)shm->header->capacity;
+	if (!shm->capacity || (shm->capacity & (shm->capacity - 1)) != 0 ||
+	    (size_t)st.st_size < shm->header_size + shm->capacity)
+		goto fail;
+
+	if (!map_ring(shm, fd))
+		goto fail;
+
+	close(fd);
+
+	int ret = pthread_mutex_lock(&shm->header->reader_mutex);
+	if (ret == EOWNERDEAD)
+		pthread_mutex_consistent(&shm->header->reader_mutex);
+	else if (ret != 0) {
+		unmap_ring(shm);
+		bfree(shm);
+		return NULL;
+	}
+
+	shm->locked = true;
+	shm->parent = getppid();
+	os_atomic_set_long(&shm->header->attached, 1);
+	return shm;
+
+fail:
+	if (fd != -1)
+		close(fd);
+	unmap_ring(shm);
+	bfree(shm);
+	return NULL;
+}
+
+static bool reader_wait(struct ffm_shm *shm, size_t size)
+{
+	struct ffm_shm_header *header = shm->header;
+
+	for (;;) {
+		if (used_space(shm) >= size)
+			return true;
+		if (os_atomic_load_long(&header->closed))
+			return used_space(shm) >= size;
+
+		/* obs is gone without closing the ring */
+		if (getppid() != shm->parent)
+			return false;
+
+		uint32_t seq = __atomic_load_n(&header->data_seq, __ATOMIC_SEQ_CST);
+		os_atomic_set_long(&header->reader_waiting, 1);
+
+		if (used_space(shm) < size && !os_atomic_load_long(&header->closed))
+			futex_wait(&header->data_seq, seq);
+
+		os_atomic_set_long(&header->reader_waiting, 0);
+	}
+}
+
+const uint8_t *ffm_shm_peek(struct ffm_shm *shm, size_t size)
+{
+	if (size > shm->capacity || !reader_wait(shm, size))
+		return NULL;
+
+	return pos_ptr(shm, shm->header->read_pos);
+}
+
+void ffm_shm_consume(struct ffm_shm *shm, size_t size)
+{
+	struct ffm_shm_header *header = shm->header;
+
+	os_atomic_store_long(&header->read_pos, (long)((unsigned long)header->read_pos + size));
+	notify(&header->space_seq, &header->writer_waiting);
+}
+
+size_t ffm_shm_read(struct ffm_shm *shm, void *data, size_t size)
+{
+	uint8_t *bytes = data;
+	size_t total = size;
+
+	while (size) {
+		if (!reader_wait(shm, 1))
+			return 0;
+
+		size_t available = used_space(shm);
+		size_t part = size < available ? size : available;
+
+		memcpy(bytes, pos_ptr(shm, shm->header->read_pos), part);
+		ffm_shm_consume(shm, part);
+
+		bytes += part;
+		size -= part;
+	}
+
+	return total;
+}
+
+/* ------------------------------------------------------------------------- */
+
+void ffm_shm_destroy(struct ffm_shm *shm)
+{
+	if (!shm)
+		return;
+
+	if (shm->writer) {
+		if (!os_atomic_load_long(&shm->header->closed))
+			ffm_shm_close(shm);
+		if (!shm->unlinked)
+			shm_unlink(shm->name);
+	} else if (shm->locked) {
+		pthread_mutex_unlock(&shm->header->reader_mutex);
+	}
+
+	unmap_ring(shm);
+	bfree(shm);
+}
+
+#else
+
+struct ffm_shm *ffm_shm_create(size_t capacity)
+{
+	UNUSED_PARAMETER(capacity);
+	return NULL;
+}
+
+const char *ffm_shm_name(const struct ffm_shm *shm)
+{
+	UNUSED_PARAMETER(shm);
+	return NULL;
+}
+
+bool ffm_shm_write(struct ffm_shm *shm, const void *data, size_t size)
+{
+	UNUSED_PARAMETER(shm);
+	UNUSED_PARAMETER(data);
+	UNUSED_PARAMETER(size);
+	return false;
+}
+
+void ffm_shm_close(struct ffm_shm *shm)
+{
+	UNUSED_PARAMETER(shm);
+}
+
+struct ffm_shm *ffm_shm_open(const char *name)
+{
+	UNUSED_PARAMETER(name);
+	return NULL;
+}
+
+size_t ffm_shm_read(struct ffm_shm *shm, void *data, size_t size)
+{
+	UNUSED_PARAMETER(shm);
+	UNUSED_PARAMETER(data);
+	UNUSED_PARAMETER(size);
+	return 0;
+}
+
+const uint8_t *ffm_shm_peek(struct ffm_shm *shm, size_t size)
+{
+	UNUSED_PARAMETER(shm);
+	UNUSED_PARAMETER(size);
+	return NULL;
+}
+
+void ffm_shm_consume(struct ffm_shm *shm, size_t size)
+{
+	UNUSED_PARAMETER(shm);
+	UNUSED_PARAMETER(size);
+}
+
+size_t ffm_shm_capacity(const struct ffm_shm *shm)
+{
+	UNUSED_PARAMETER(shm);
+	return 0;
+}
+
+void ffm_shm_destroy(struct ffm_shm *shm)
+{
+	UNUSED_PARAMETER(shm);
+}
+
+#endif
@@ -0,0 +1,73 @@
+/*
+ * Copyright (c) 2023 Lain Bailey <lain@obsproject.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Shared memory ring buffer between obs and obs-ffmpeg-mux
+ *
+ * Carries the same byte stream that would otherwise be written to the stdin
+ * pipe of the helper process: obs creates the ring and passes its name on the
+ * command line, the helper attaches to it and reads from it instead of stdin.
+ * The pipe is still created, and used as the transport if the ring cannot be
+ * created.
+ *
+ * The data area is mapped twice back to back, so every read and write of up
+ * to the capacity is contiguous and packet data can be handed to FFmpeg
+ * straight out of the ring.  Waiting for data or space uses futexes, so
+ * neither side makes a system call while the other one keeps up.
+ *
+ * Only implemented on Linux, ffm_shm_create() returns NULL elsewhere.
+ */
+
+/* already far more than a pipe buffers, larger rings are slower as they fall
+ * out of the cache.  packets that don't fit are still sent, just copied out
+ * on the other side. */
+#define FFM_SHM_DEFAULT_CAPACITY (4 * 1024 * 1024)
+
+struct ffm_shm;
+
+/* obs side: creates the ring, capacity is rounded up to a power of two of at
+ * least the page size */
+struct ffm_shm *ffm_shm_create(size_t capacity);
+const char *ffm_shm_name(const struct ffm_shm *shm);
+
+/* blocks while the ring is full, returns false if the reader is gone */
+bool ffm_shm_write(struct ffm_shm *shm, const void *data, size_t size);
+
+/* signals end of stream, the reader still gets everything written so far */
+void ffm_shm_close(struct ffm_shm *shm);
+
+/* helper side: attaches to the ring created by obs */
+struct ffm_shm *ffm_shm_open(const char *name);
+
+/* same as reading from stdin: returns size, or 0 at the end of the stream */
+size_t ffm_shm_read(struct ffm_shm *shm, void *data, size_t size);
+
+/* waits for size bytes and returns a pointer to them in the ring, which stays
+ * valid until ffm_shm_consume() is called.  returns NULL at the end of the
+ * stream or if size is larger than the capacity. */
+const uint8_t *ffm_shm_peek(struct ffm_shm *shm, size_t size);
+void ffm_shm_consume(struct ffm_shm *shm, size_t size);
+
+size_t ffm_shm_capacity(const struct ffm_shm *shm);
+
+/* both sides: unmaps the ring (and removes it on the obs side) */
+void ffm_shm_destroy(struct ffm_shm *shm);
@@ -25,6 +25,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include "ffmpeg-mux.h"
+#include "ffmpeg-mux-shm.h"
 
 #include <util/threading.h>
 #include <util/platform.h>
@@ -44,6 +45,7 @@
 /* ------------------------------------------------------------------------- */
 
 static char *global_stream_key = "";
+static struct ffm_shm *global_shm = NULL;
 
 struct resize_buf {
 	uint8_t *buf;
@@ -98,6 +100,7 @@ struct main_params {
 	char *acodec;
 	char *muxer_settings;
 	int codec_tag;
+	char *shm_name;
 };
 
 struct audio_params {
@@ -410,6 +413,9 @@ static bool init_params(int *argc, char ***argv, struct main_params *params, str
 
 	get_opt_str(argc, argv, &params->muxer_settings, "muxer settings");
 
+	if (*argc)
+		get_opt_str(argc, argv, &params->shm_name, "shared memory name");
+
 	return true;
 }
 
@@ -600,6 +606,9 @@ static size_t safe_read(void *vdata, size_t size)
 	uint8_t *data = vdata;
 	size_t total = size;
 
+	if (global_shm)
+		return ffm_shm_read(global_shm, vdata, size);
+
 	while (size > 0) {
 		size_t in_size = fread(data, 1, size, stdin);
 		if (in_size == 0)
@@ -994,6 +1003,15 @@ static int ffmpeg_mux_init_internal(struct ffmpeg_mux *ffm, int argc, char *argv
 	if (!init_params(&argc, &argv, &ffm->params, &ffm->audio))
 		return FFM_ERROR;
 
+	/* stays attached when the file changes */
+	if (ffm->params.shm_name && *ffm->params.shm_name && !global_shm) {
+		global_shm = ffm_shm_open(ffm->params.shm_name);
+		if (!global_shm) {
+			fprintf(stderr, "Couldn't open shared memory '%s'\n", ffm->params.shm_name);
+			return FFM_ERROR;
+		}
+	}
+
 	if (ffm->params.tracks) {
 		ffm->audio_header = calloc(ffm->params.tracks, sizeof(*ffm->audio_header));
 	}
@@ -1165,6 +1183,7 @@ int main(int argc, char *argv[])
 	ret = ffmpeg_mux_init(&ffm, argc, argv);
 	if (ret != FFM_SUCCESS) {
 		fprintf(stderr, "Couldn't initialize muxer\n");
+		ffm_shm_destroy(global_shm);
 		return ret;
 	}
 
@@ -1174,6 +1193,20 @@ int main(int argc, char *argv[])
 			continue;
 		}
 
+		/* FFmpeg copies the data of packets that aren't refcounted, so
+		 * they can be passed to it straight from shared memory */
+		if (global_shm && info.size <= ffm_shm_capacity(global_shm)) {
+			uint8_t *data = (uint8_t *)ffm_shm_peek(global_shm, info.size);
+
+			if (data) {
+				fail = !ffmpeg_mux_packet(&ffm, data, &info);
+				ffm_shm_consume(global_shm, info.size);
+			} else {
+				fail = true;
+			}
+			continue;
+		}
+
 		resize_buf_resize(&rb, info.size);
 
 		if (safe_read(rb.buf, info.size) == info.size) {
@@ -1184,6 +1217,7 @@ int main(int argc, char *argv[])
 	}
 
 	ffmpeg_mux_free(&ffm);
+	ffm_shm_destroy(global_shm);
 	resize_buf_free(&rb);
 	resize_buf_free(&rb_filename);
 
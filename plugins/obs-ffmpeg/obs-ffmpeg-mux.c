@@ -15,6 +15,7 @@
     along with this program.  If not, see <http://www.gnu.org/licenses/>.
 ******************************************************************************/
 #include "ffmpeg-mux/ffmpeg-mux.h"
+#include "ffmpeg-mux/ffmpeg-mux-shm.h"
 #include "obs-ffmpeg-mux.h"
 #include "obs-ffmpeg-formats.h"
 
@@ -73,7 +74,7 @@ static void ffmpeg_mux_destroy(void *data)
 	da_free(stream->mux_packets);
 	deque_free(&stream->packets);
 
-	os_process_pipe_destroy(stream->pipe);
+	stop_pipe(stream);
 	dstr_free(&stream->path);
 	dstr_free(&stream->printable_path);
 	dstr_free(&stream->stream_key);
@@ -300,14 +301,56 @@ static void build_command_line(struct ffmpeg_muxer *stream, os_process_args_t **
 
 	add_stream_key(*args, stream);
 	add_muxer_params(*args, stream);
+
+	if (stream->shm)
+		os_process_args_add_arg(*args, ffm_shm_name(stream->shm));
 }
 
 void start_pipe(struct ffmpeg_muxer *stream, const char *path)
 {
 	os_process_args_t *args = NULL;
+
+	/* packets go through shared memory if possible, the pipe is only
+	 * used to start and stop the process then */
+	stream->shm = ffm_shm_create(FFM_SHM_DEFAULT_CAPACITY);
+#ifdef __linux__
+	if (!stream->shm)
+		warn("Failed to create shared memory, sending packets through the pipe");
+#endif
+
 	build_command_line(stream, &args, path);
 	stream->pipe = os_process_pipe_create2(args, "w");
 	os_process_args_destroy(args);
+
+	if (!stream->pipe) {
+		ffm_shm_destroy(stream->shm);
+		stream->shm = NULL;
+	}
+}
+
+int stop_pipe(struct ffmpeg_muxer *stream)
+{
+	int ret;
+
+	/* lets the helper finish up what is still in the ring, the pipe
+	 * waits for it to exit */
+	if (stream->shm)
+		ffm_shm_close(stream->shm);
+
+	ret = os_process_pipe_destroy(stream->pipe);
+	stream->pipe = NULL;
+
+	ffm_shm_destroy(stream->shm);
+	stream->shm = NULL;
+	return ret;
+}
+
+static bool write_data(struct ffmpeg_muxer *stream, const void *data, size_t size)
+{
+	if (stream->shm)
+		return ffm_shm_write(stream->shm, data, size);
+
+	return os_process_pipe_write(stream->pipe, data, size) == size;
 }
 
 static void set_file_not_readable_error(struct ffmpeg_muxer *stream, obs_data_t *settings, const char *path)
@@ -466,8 +509,7 @@ int deactivate(struct ffmpeg_muxer *stream, int code)
 	}
 
 	if (active(stream)) {
-		ret = os_process_pipe_destroy(stream->pipe);
-		stream->pipe = NULL;
+		ret = stop_pipe(stream);
 
 		os_atomic_set_bool(&stream->active, false);
 		os_atomic_set_bool(&stream->sent_headers, false);
@@ -603,7 +645,6 @@ static void generate_filename(struct ffmpeg_muxer *stream, struct dstr *dst, boo
 bool write_packet(struct ffmpeg_muxer *stream, struct encoder_packet *packet)
 {
 	bool is_video = packet->type == OBS_ENCODER_VIDEO;
-	size_t ret;
 
 	struct ffm_packet_info info = {.pts = packet->pts,
 				       .dts = packet->dts,
@@ -622,16 +663,14 @@ bool write_packet(struct ffmpeg_muxer *stream, struct encoder_packet *packet)
 		}
 	}
 
-	ret = os_process_pipe_write(stream->pipe, (const uint8_t *)&info, sizeof(info));
-	if (ret != sizeof(info)) {
-		warn("os_process_pipe_write for info structure failed");
+	if (!write_data(stream, &info, sizeof(info))) {
+		warn("Writing info structure failed");
 		signal_failure(stream);
 		return false;
 	}
 
-	ret = os_process_pipe_write(stream->pipe, packet->data, packet->size);
-	if (ret != packet->size) {
-		warn("os_process_pipe_write for packet data failed");
+	if (!write_data(stream, packet->data, packet->size)) {
+		warn("Writing packet data failed");
 		signal_failure(stream);
 		return false;
 	}
@@ -711,20 +750,17 @@ static inline bool should_split(struct ffmpeg_muxer *stream, struct encoder_pack
 
 static bool send_new_filename(struct ffmpeg_muxer *stream, const char *filename)
 {
-	size_t ret;
 	uint32_t size = (uint32_t)strlen(filename);
 	struct ffm_packet_info info = {.type = FFM_PACKET_CHANGE_FILE, .size = size};
 
-	ret = os_process_pipe_write(stream->pipe, (const uint8_t *)&info, sizeof(info));
-	if (ret != sizeof(info)) {
-		warn("os_process_pipe_write for info structure failed");
+	if (!write_data(stream, &info, sizeof(info))) {
+		warn("Writing info structure failed");
 		signal_failure(stream);
 		return false;
 	}
 
-	ret = os_process_pipe_write(stream->pipe, (const uint8_t *)filename, size);
-	if (ret != size) {
-		warn("os_process_pipe_write for packet data failed");
+	if (!write_data(stream, filename, size)) {
+		warn("Writing file name failed");
 		signal_failure(stream);
 		return false;
 	}
@@ -1118,8 +1154,7 @@ static void *replay_buffer_mux_thread(void *data)
 	info("Wrote replay buffer to '%s'", stream->path.array);
 
 error:
-	os_process_pipe_destroy(stream->pipe);
-	stream->pipe = NULL;
+	stop_pipe(stream);
 	if (error) {
 		for (size_t i = 0; i < stream->mux_packets.num; i++)
 			obs_encoder_packet_release(&stream->mux_packets.array[i]);
@@ -77,3 +77,13 @@ extern void flv_packet_audio_start(struct encoder_packet *packet, enum audio_id_
 				   size_t idx);
 extern void flv_packet_audio_frames(struct encoder_packet *packet, enum audio_id_t codec, int32_t dts_offset,
 				    uint8_t **output, size_t *size, size_t idx);
+
+/* Only the FLV tag header and the bytes in front of the packet data, for
+ * sending the packet data without copying it.  The rest of the tag is the
+ * packet data followed by the 4 byte previous tag size. */
+struct serializer;
+extern void flv_packet_mux_header(struct serializer *s, struct encoder_packet *packet, int32_t dts_offset);
+extern void flv_packet_frames_header(struct serializer *s, struct encoder_packet *packet, enum video_id_t codec,
+				     int32_t dts_offset, size_t idx);
+extern void flv_packet_audio_frames_header(struct serializer *s, struct encoder_packet *packet, enum audio_id_t codec,
+					   int32_t dts_offset, size_t idx);
@@ -39,6 +39,10 @@
 #define MSG_NOSIGNAL 0
 #endif
 
+#if !defined(_WIN32) && !defined(IOV_MAX)
+#define IOV_MAX 1024
+#endif
+
 #ifdef CRYPTO
 
 #ifdef __APPLE__
@@ -5393,3 +5397,213 @@ RTMP_Write(RTMP *r, const char *buf, int size, int streamIdx)
     }
     return size+s2;
 }
+
+/* OBS: encodes the chunk headers for the message in an FLV tag like
+ * RTMP_Write() and RTMP_SendPacket() would, without sending anything.  tag
+ * is the 11 byte FLV tag header.  header needs RTMP_MAX_HEADER_SIZE bytes and
+ * gets the header of the first chunk, contHeader the header of the type 3
+ * chunks that follow (up to 7 bytes).  The channel state is updated as if the
+ * message had been sent, so it has to be sent next.  Returns the size of the
+ * first header, or 0 on error. */
+int
+RTMP_EncodeTagHeader(RTMP *r, const char *tag, int streamIdx,
+                     char *header, char *contHeader, int *contSize,
+                     uint32_t *bodySize)
+{
+    RTMPPacket packet = {0};
+    const RTMPPacket *prevPacket;
+    uint32_t last = 0, t;
+    int nSize, cSize = 0;
+    char *hptr, *hend = header + RTMP_MAX_HEADER_SIZE, c;
+
+    packet.m_nChannel = 0x04;	/* source channel */
+    packet.m_nInfoField2 = r->Link.streams[streamIdx].id;
+    packet.m_packetType = tag[0];
+    packet.m_nBodySize = AMF_DecodeInt24(tag + 1);
+    packet.m_nTimeStamp = AMF_DecodeInt24(tag + 4);
+    packet.m_nTimeStamp |= (uint32_t)(uint8_t)tag[7] << 24;
+
+    if (((packet.m_packetType == RTMP_PACKET_TYPE_AUDIO
+            || packet.m_packetType == RTMP_PACKET_TYPE_VIDEO) &&
+            !packet.m_nTimeStamp) || packet.m_packetType == RTMP_PACKET_TYPE_INFO)
+        packet.m_headerType = RTMP_PACKET_SIZE_LARGE;
+    else
+        packet.m_headerType = RTMP_PACKET_SIZE_MEDIUM;
+
+    if (packet.m_nChannel >= r->m_channelsAllocatedOut)
+    {
+        int n = packet.m_nChannel + 10;
+        RTMPPacket **packets = realloc(r->m_vecChannelsOut, sizeof(RTMPPacket*) * n);
+        if (!packets)
+        {
+            free(r->m_vecChannelsOut);
+            r->m_vecChannelsOut = NULL;
+            r->m_channelsAllocatedOut = 0;
+            return 0;
+        }
+        r->m_vecChannelsOut = packets;
+        memset(r->m_vecChannelsOut + r->m_channelsAllocatedOut, 0, sizeof(RTMPPacket*) * (n - r->m_channelsAllocatedOut));
+        r->m_channelsAllocatedOut = n;
+    }
+
+    /* same header compression as RTMP_SendPacket() */
+    prevPacket = r->m_vecChannelsOut[packet.m_nChannel];
+    if (prevPacket && packet.m_headerType != RTMP_PACKET_SIZE_LARGE)
+    {
+        if (prevPacket->m_nBodySize == packet.m_nBodySize
+                && prevPacket->m_packetType == packet.m_packetType
+                && packet.m_headerType == RTMP_PACKET_SIZE_MEDIUM)
+            packet.m_headerType = RTMP_PACKET_SIZE_SMALL;
+
+        uint32_t delta = packet.m_nTimeStamp - prevPacket->m_nTimeStamp;
+        if (delta == prevPacket->m_nLastWireTimeStamp
+            && packet.m_headerType == RTMP_PACKET_SIZE_SMALL)
+            packet.m_headerType = RTMP_PACKET_SIZE_MINIMUM;
+        last = prevPacket->m_nTimeStamp;
+    }
+
+    nSize = packetSize[packet.m_headerType];
+    t = packet.m_nTimeStamp - last;
+    packet.m_nLastWireTimeStamp = t;
+
+    if (packet.m_nChannel > 319)
+        cSize = 2;
+    else if (packet.m_nChannel > 63)
+        cSize = 1;
+
+    hptr = header;
+    c = packet.m_headerType << 6;
+    switch (cSize)
+    {
+    case 0:
+        c |= packet.m_nChannel;
+        break;
+    case 1:
+        break;
+    case 2:
+        c |= 1;
+        break;
+    }
+    *hptr++ = c;
+    if (cSize)
+    {
+        int tmp = packet.m_nChannel - 64;
+        *hptr++ = tmp & 0xff;
+        if (cSize == 2)
+            *hptr++ = tmp >> 8;
+    }
+
+    if (nSize > 1)
+        hptr = AMF_EncodeInt24(hptr, hend, t > 0xffffff ? 0xffffff : t);
+
+    if (nSize > 4)
+    {
+        hptr = AMF_EncodeInt24(hptr, hend, packet.m_nBodySize);
+        *hptr++ = packet.m_packetType;
+    }
+
+    if (nSize > 8)
+        hptr += EncodeInt32LE(hptr, packet.m_nInfoField2);
+
+    if (nSize > 1 && t >= 0xffffff)
+        hptr = AMF_EncodeInt32(hptr, hend, t);
+
+    /* type 3 chunks for the rest of the body */
+    contHeader[0] = (0xc0 | c);
+    *contSize = 1;
+    if (cSize)
+    {
+        int tmp = packet.m_nChannel - 64;
+        contHeader[(*contSize)++] = tmp & 0xff;
+        if (cSize == 2)
+            contHeader[(*contSize)++] = tmp >> 8;
+    }
+    if (t >= 0xffffff)
+    {
+        AMF_EncodeInt32(contHeader + *contSize, contHeader + *contSize + 4, t);
+        *contSize += 4;
+    }
+
+    if (!r->m_vecChannelsOut[packet.m_nChannel])
+        r->m_vecChannelsOut[packet.m_nChannel] = malloc(sizeof(RTMPPacket));
+    if (!r->m_vecChannelsOut[packet.m_nChannel])
+        return 0;
+    memcpy(r->m_vecChannelsOut[packet.m_nChannel], &packet, sizeof(RTMPPacket));
+
+    *bodySize = packet.m_nBodySize;
+    return (int)(hptr - header);
+}
+
+#ifndef _WIN32
+/* OBS: like WriteN() for data in several parts, iov is modified.  Returns -1
+ * on error, otherwise the number of sendmsg() calls made with MSG_ZEROCOPY,
+ * each of which gets a completion notification.  If the kernel runs out of
+ * memory for those, the rest is sent without MSG_ZEROCOPY. */
+int
+RTMP_Writev(RTMP *r, struct iovec *iov, int iovcnt, int flags)
+{
+    struct linger l;
+    int calls = 0;
+
+    while (iovcnt > 0)
+    {
+        struct msghdr msg = {0};
+        ssize_t nBytes;
+
+        msg.msg_iov = iov;
+        msg.msg_iovlen = iovcnt < IOV_MAX ? iovcnt : IOV_MAX;
+
+        nBytes = sendmsg(r->m_sb.sb_socket, &msg, MSG_NOSIGNAL | flags);
+        if (nBytes < 0)
+        {
+            int sockerr = GetSockError();
+
+#ifdef MSG_ZEROCOPY
+            if (sockerr == ENOBUFS && (flags & MSG_ZEROCOPY))
+            {
+                flags &= ~MSG_ZEROCOPY;
+                continue;
+            }
+#endif
+
+            RTMP_Log(RTMP_LOGERROR, "%s, RTMP send error %d", __FUNCTION__, sockerr);
+
+            if (sockerr == EINTR && !RTMP_ctrlC)
+                continue;
+
+            r->last_error_code = sockerr;
+
+            /* see WriteN() */
+            l.l_onoff = 1;
+            l.l_linger = 0;
+            setsockopt(r->m_sb.sb_socket, SOL_SOCKET, SO_LINGER, (char *)&l, sizeof(l));
+            RTMPSockBuf_Close(&r->m_sb);
+
+            RTMP_Close(r);
+            return -1;
+        }
+
+        if (nBytes == 0)
+            return -1;
+
+#ifdef MSG_ZEROCOPY
+        if (flags & MSG_ZEROCOPY)
+            calls++;
+#endif
+
+        while (iovcnt > 0 && (size_t)nBytes >= iov->iov_len)
+        {
+            nBytes -= iov->iov_len;
+            iov++;
+            iovcnt--;
+        }
+        if (iovcnt > 0)
+        {
+            iov->iov_base = (char *)iov->iov_base + nBytes;
+            iov->iov_len -= nBytes;
+        }
+    }
+
+    return calls;
+}
+#endif
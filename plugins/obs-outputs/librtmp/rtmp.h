@@ -43,6 +43,7 @@
 #include <ws2tcpip.h>
 #else
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <netinet/in.h>
 #define SOCKET int
 #endif
@@ -544,6 +545,14 @@ extern "C"
     int RTMP_Read(RTMP *r, char *buf, int size);
     int RTMP_Write(RTMP *r, const char *buf, int size, int streamIdx);
 
+    /* OBS: for sending media without copying it, see rtmp-batch.c */
+    int RTMP_EncodeTagHeader(RTMP *r, const char *tag, int streamIdx,
+                             char *header, char *contHeader, int *contSize,
+                             uint32_t *bodySize);
+#ifndef _WIN32
+    int RTMP_Writev(RTMP *r, struct iovec *iov, int iovcnt, int flags);
+#endif
+
 #ifdef USE_HASHSWF
     /* hashswf.c */
     int RTMP_HashSWF(const char *url, unsigned int *size, unsigned char *hash,
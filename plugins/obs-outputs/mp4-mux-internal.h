@@ -18,10 +18,13 @@
 #pragma once
 
 #include "mp4-mux.h"
+#include "mp4-sample-table.h"
 
 #include <util/darray.h>
+#include <util/dstr.h>
 #include <util/deque.h>
 #include <util/serializer.h>
+#include <util/threading.h>
 
 /* Flavour for target compatibility */
 enum mp4_flavour {
@@ -58,9 +61,8 @@ enum mp4_codec {
 	CODEC_TEXT,
 };
 
-struct chunk {
-	uint64_t offset;
-	uint32_t size;
+struct chunk_run {
+	uint32_t first;
 	uint32_t samples;
 };
 
@@ -108,20 +110,36 @@ struct mp4_track {
 	/* deque of encoder_packet belonging to this track */
 	struct deque packets;
 
-	/* Sample sizes (fixed for PCM) */
-	uint32_t sample_size;
-	DARRAY(uint32_t) sample_sizes;
-	/* Data chunks in file containing samples for this track */
-	DARRAY(struct chunk) chunks;
-	/* Time delta between samples */
-	DARRAY(struct sample_delta) deltas;
+	/* The tables below are kept in compact form (see mp4-sample-table.h),
+	 * runs are stored as (count, value) pairs.  The last run of each table
+	 * is kept separately until it ends, since it may still grow. */
 
-	/* Sample CT-DT offset, i.e. DTS-PTS offset (Video only) */
+	/* Sample sizes (fixed for PCM), as difference to the previous size */
+	uint32_t sample_size;
+	struct sample_table sample_sizes;
+	uint32_t last_sample_size;
+	/* File offsets of the data chunks containing samples for this track,
+	 * as difference to the previous offset */
+	struct sample_table chunk_offsets;
+	uint64_t last_chunk_offset;
+	/* Runs of chunks with the same number of samples */
+	struct sample_table chunk_runs;
+	struct chunk_run cur_chunk_run;
+	uint32_t last_chunk_run_first;
+	/* Time delta between samples, as runs */
+	struct sample_table deltas;
+	struct sample_delta cur_delta;
+
+	/* Sample CT-DT offset, i.e. DTS-PTS offset (Video only), as runs */
 	bool needs_ctts;
 	int32_t dts_offset;
-	DARRAY(struct sample_offset) offsets;
-	/* Sync samples, i.e. keyframes (Video only) */
-	DARRAY(uint32_t) sync_samples;
+	struct sample_table offsets;
+	struct sample_offset cur_offset;
+	int32_t first_offset;
+	/* Sync samples, i.e. keyframes (Video only), as difference to the
+	 * previous sync sample */
+	struct sample_table sync_samples;
+	uint32_t last_sync_sample;
 
 	/* Temporary array with information about the samples to be included
 	 * in the next fragment. */
@@ -148,6 +166,25 @@ struct mp4_mux {
 	/* Offset of placeholder atom/box to contain final mdat header */
 	size_t placeholder_offset;
 
+	/* Directory sample tables are moved to, if enabled */
+	struct dstr spill_dir;
+
+	/* Checkpoint file for recovering unfinished files, if enabled.  They
+	 * are built on the packet thread and written on their own thread, once
+	 * the data they refer to is on disk. */
+	struct dstr checkpoint_path;
+	uint64_t checkpoint_interval;
+	uint64_t next_checkpoint;
+	mp4_mux_sync_t checkpoint_sync;
+	/* mux->serializer is swapped out while boxes are built in memory */
+	struct serializer *file_serializer;
+	bool checkpoint_thread_active;
+	volatile bool checkpoint_stop;
+	pthread_t checkpoint_thread;
+	pthread_mutex_t checkpoint_mutex;
+	os_event_t *checkpoint_event;
+	DARRAY(uint8_t) checkpoint_data;
+
 	uint8_t track_ctr;
 	/* Audio/Video tracks */
 	DARRAY(struct mp4_track) tracks;
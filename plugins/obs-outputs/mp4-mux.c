@@ -27,8 +27,15 @@
 #include <util/platform.h>
 #include <util/array-serializer.h>
 
+#include <inttypes.h>
 #include <time.h>
 
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
 /*
  * (Mostly) compliant MP4 muxer for fun and profit.
  * Based on ISO/IEC 14496-12 and FFmpeg's libavformat/movenc.c ([L]GPL)
@@ -142,6 +149,22 @@ static size_t mp4_write_free(struct mp4_mux *mux)
 	return 16;
 }
 
+/// 8.1.1 Media Data Box (header only, covering everything up to the end of
+/// the written data)
+static void mp4_write_mdat_header(struct serializer *s, uint64_t data_size)
+{
+	/* If data is more than 4 GiB the mdat header becomes 16 bytes, hence
+	 * why we create a 16-byte placeholder "free" box at the start. */
+	if (data_size > UINT32_MAX) {
+		s_wb32(s, 1); // 1 = use "largesize" field instead
+		s_write(s, "mdat", 4);
+		s_wb64(s, data_size); // largesize (64-bit)
+	} else {
+		s_wb32(s, (uint32_t)data_size);
+		s_write(s, "mdat", 4);
+	}
+}
+
 /// 8.2.2 Movie Header Box
 static size_t mp4_write_mvhd(struct mp4_mux *mux)
 {
@@ -1113,19 +1136,27 @@ static size_t mp4_write_stts(struct mp4_mux *mux, struct mp4_track *track, bool
 	}
 
 	int64_t start = serializer_get_pos(s);
-	struct sample_delta *arr = track->deltas.array;
-	size_t num = track->deltas.num;
+	struct sample_table_reader reader;
+	size_t stored = (size_t)track->deltas.num / 2;
+	size_t num = stored + (track->cur_delta.count ? 1 : 0);
 
 	write_fullbox(s, 0, "stts", 0, 0);
 
 	s_wb32(s, (uint32_t)num); // entry_count
 
+	sample_table_reader_init(&reader, &track->deltas);
+
 	for (size_t idx = 0; idx < num; idx++) {
-		struct sample_delta *smp = &arr[idx];
+		struct sample_delta smp = track->cur_delta;
+
+		if (idx < stored) {
+			smp.count = (uint32_t)sample_table_read(&reader);
+			smp.delta = (uint32_t)sample_table_read(&reader);
+		}
 
-		uint64_t delta = util_mul_div64(smp->delta, track->timescale, track->timebase_den);
+		uint64_t delta = util_mul_div64(smp.delta, track->timescale, track->timebase_den);
 
-		s_wb32(s, smp->count);      // sample_count
+		s_wb32(s, smp.count);       // sample_count
 		s_wb32(s, (uint32_t)delta); // sample_delta
 	}
 
@@ -1136,7 +1167,9 @@ static size_t mp4_write_stts(struct mp4_mux *mux, struct mp4_track *track, bool
 static size_t mp4_write_stss(struct mp4_mux *mux, struct mp4_track *track)
 {
 	struct serializer *s = mux->serializer;
+	struct sample_table_reader reader;
 	uint32_t num = (uint32_t)track->sync_samples.num;
+	uint32_t sample = 0;
 
 	if (!num)
 		return 0;
@@ -1147,8 +1180,12 @@ static size_t mp4_write_stss(struct mp4_mux *mux, struct mp4_track *track)
 	write_fullbox(s, size, "stss", 0, 0);
 	s_wb32(s, num); // entry_count
 
-	for (size_t idx = 0; idx < num; idx++)
-		s_wb32(s, track->sync_samples.array[idx]); // sample_number
+	sample_table_reader_init(&reader, &track->sync_samples);
+
+	for (size_t idx = 0; idx < num; idx++) {
+		sample += (uint32_t)sample_table_read(&reader);
+		s_wb32(s, sample); // sample_number
+	}
 
 	return size;
 }
@@ -1157,7 +1194,9 @@ static size_t mp4_write_stss(struct mp4_mux *mux, struct mp4_track *track)
 static size_t mp4_write_ctts(struct mp4_mux *mux, struct mp4_track *track)
 {
 	struct serializer *s = mux->serializer;
-	uint32_t num = (uint32_t)track->offsets.num;
+	struct sample_table_reader reader;
+	uint32_t stored = (uint32_t)(track->offsets.num / 2);
+	uint32_t num = stored + (track->cur_offset.count ? 1 : 0);
 
 	uint8_t version = mux->flags & MP4_USE_NEGATIVE_CTS ? 1 : 0;
 
@@ -1167,12 +1206,20 @@ static size_t mp4_write_ctts(struct mp4_mux *mux, struct mp4_track *track)
 
 	s_wb32(s, num); // entry_count
 
+	sample_table_reader_init(&reader, &track->offsets);
+
 	for (size_t idx = 0; idx < num; idx++) {
-		int64_t offset = (int64_t)track->offsets.array[idx].offset * (int64_t)track->timescale /
-				 (int64_t)track->timebase_den;
+		struct sample_offset smp = track->cur_offset;
 
-		s_wb32(s, track->offsets.array[idx].count); // sample_count
-		s_wb32(s, (uint32_t)offset);                // sample_offset
+		if (idx < stored) {
+			smp.count = (uint32_t)sample_table_read(&reader);
+			smp.offset = (int32_t)sample_table_read_signed(&reader);
+		}
+
+		int64_t offset = (int64_t)smp.offset * (int64_t)track->timescale / (int64_t)track->timebase_den;
+
+		s_wb32(s, smp.count);        // sample_count
+		s_wb32(s, (uint32_t)offset); // sample_offset
 	}
 
 	return size;
@@ -1189,28 +1236,10 @@ static size_t mp4_write_stsc(struct mp4_mux *mux, struct mp4_track *track, bool
 		return 16;
 	}
 
-	struct chunk *arr = track->chunks.array;
-	size_t arr_num = track->chunks.num;
-
-	/* Compress into array with counter for repeating chunk sizes */
-	DARRAY(struct chunk_run {
-		uint32_t first;
-		uint32_t samples;
-	}) chunk_runs;
-
-	da_init(chunk_runs);
-
-	for (size_t idx = 0; idx < arr_num; idx++) {
-		struct chunk *chk = &arr[idx];
-
-		if (!chunk_runs.num || chunk_runs.array[chunk_runs.num - 1].samples != chk->samples) {
-			struct chunk_run *cr = da_push_back_new(chunk_runs);
-			cr->samples = chk->samples;
-			cr->first = (uint32_t)idx + 1; // ISO-BMFF is 1-indexed
-		}
-	}
-
-	uint32_t num = (uint32_t)chunk_runs.num;
+	struct sample_table_reader reader;
+	uint32_t stored = (uint32_t)(track->chunk_runs.num / 2);
+	uint32_t num = stored + (track->cur_chunk_run.first ? 1 : 0);
+	uint32_t first = 0;
 
 	/* 16 byte FullBox header + 12-bytes (u32+u32+u32) per chunk run */
 	uint32_t size = 16 + 12 * num;
@@ -1218,14 +1247,21 @@ static size_t mp4_write_stsc(struct mp4_mux *mux, struct mp4_track *track, bool
 
 	s_wb32(s, num); // entry_count
 
+	sample_table_reader_init(&reader, &track->chunk_runs);
+
 	for (size_t idx = 0; idx < num; idx++) {
-		struct chunk_run *cr = &chunk_runs.array[idx];
-		s_wb32(s, cr->first);   // first_chunk
-		s_wb32(s, cr->samples); // samples_per_chunk
-		s_wb32(s, 1);           // sample_description_index
-	}
+		struct chunk_run cr = track->cur_chunk_run;
 
-	da_free(chunk_runs);
+		if (idx < stored) {
+			first += (uint32_t)sample_table_read(&reader);
+			cr.first = first;
+			cr.samples = (uint32_t)sample_table_read(&reader);
+		}
+
+		s_wb32(s, cr.first);   // first_chunk
+		s_wb32(s, cr.samples); // samples_per_chunk
+		s_wb32(s, 1);          // sample_description_index
+	}
 
 	return size;
 }
@@ -1261,11 +1297,17 @@ static size_t mp4_write_stsz(struct mp4_mux *mux, struct mp4_track *track, bool
 		s_wb32(s, track->sample_size);       // sample_size
 		s_wb32(s, (uint32_t)track->samples); // sample_count
 	} else {
+		struct sample_table_reader reader;
+		uint32_t size = 0;
+
 		s_wb32(s, 0);                                 // sample_size
 		s_wb32(s, (uint32_t)track->sample_sizes.num); // sample_count
 
+		sample_table_reader_init(&reader, &track->sample_sizes);
+
 		for (size_t idx = 0; idx < track->sample_sizes.num; idx++) {
-			s_wb32(s, track->sample_sizes.array[idx]); // entry_size
+			size += (uint32_t)sample_table_read_signed(&reader);
+			s_wb32(s, size); // entry_size
 		}
 	}
 
@@ -1283,12 +1325,12 @@ static size_t mp4_write_stco(struct mp4_mux *mux, struct mp4_track *track, bool
 		return 16;
 	}
 
-	struct chunk *arr = track->chunks.array;
-	uint32_t num = (uint32_t)track->chunks.num;
+	struct sample_table_reader reader;
+	uint32_t num = (uint32_t)track->chunk_offsets.num;
+	uint64_t offset = 0;
 
-	uint64_t last_off = arr[num - 1].offset;
 	uint32_t size;
-	bool co64 = last_off > UINT32_MAX;
+	bool co64 = track->last_chunk_offset > UINT32_MAX;
 
 	/* When using 64-bit offsets we write 8-bytes (u64) per chunk,
 	 * otherwise 4-bytes (u32). */
@@ -1302,11 +1344,15 @@ static size_t mp4_write_stco(struct mp4_mux *mux, struct mp4_track *track, bool
 
 	s_wb32(s, num); // entry_count
 
+	sample_table_reader_init(&reader, &track->chunk_offsets);
+
 	for (size_t idx = 0; idx < num; idx++) {
+		offset += sample_table_read(&reader);
+
 		if (co64)
-			s_wb64(s, arr[idx].offset); // chunk_offset
+			s_wb64(s, offset); // chunk_offset
 		else
-			s_wb32(s, (uint32_t)arr[idx].offset); // chunk_offset
+			s_wb32(s, (uint32_t)offset); // chunk_offset
 	}
 
 	return size;
@@ -1368,9 +1414,22 @@ static size_t mp4_write_sbgp_sbgp_opus(struct mp4_mux *mux, struct mp4_track *tr
 	uint16_t preroll_count = 0;
 	int64_t preroll_remaining = opus_preroll;
 
-	for (size_t i = 0; i < track->deltas.num && preroll_remaining > 0; i++) {
-		for (uint32_t j = 0; j < track->deltas.array[i].count && preroll_remaining > 0; j++) {
-			preroll_remaining -= track->deltas.array[i].delta;
+	struct sample_table_reader reader;
+	size_t stored = (size_t)track->deltas.num / 2;
+	size_t num = stored + (track->cur_delta.count ? 1 : 0);
+
+	sample_table_reader_init(&reader, &track->deltas);
+
+	for (size_t i = 0; i < num && preroll_remaining > 0; i++) {
+		struct sample_delta smp = track->cur_delta;
+
+		if (i < stored) {
+			smp.count = (uint32_t)sample_table_read(&reader);
+			smp.delta = (uint32_t)sample_table_read(&reader);
+		}
+
+		for (uint32_t j = 0; j < smp.count && preroll_remaining > 0; j++) {
+			preroll_remaining -= smp.delta;
 			preroll_count++;
 		}
 	}
@@ -1596,9 +1655,8 @@ static size_t mp4_write_elst(struct mp4_mux *mux, struct mp4_track *track)
 		 * using b-frames). */
 		int64_t dts_offset = 0;
 
-		if (track->offsets.num) {
-			struct sample_offset sample = track->offsets.array[0];
-			dts_offset = sample.offset;
+		if (track->offsets.num || track->cur_offset.count) {
+			dts_offset = track->first_offset;
 		} else if (track->packets.size) {
 			/* If no offset data exists yet (i.e. when writing the
 			 * incomplete moov in a fragmented file) use the raw
@@ -1669,7 +1727,7 @@ static size_t mp4_write_trak(struct mp4_mux *mux, struct mp4_track *track, bool
 	int64_t start = serializer_get_pos(s);
 
 	/* If track has no data, omit it from full moov. */
-	if (!fragmented && !track->chunks.num)
+	if (!fragmented && !track->chunk_offsets.num)
 		return 0;
 
 	write_box(s, 0, "trak");
@@ -1681,7 +1739,8 @@ static size_t mp4_write_trak(struct mp4_mux *mux, struct mp4_track *track, bool
 	mp4_write_edts(mux, track);
 
 	// tref
-	if (mux->chapter_track && track->type != TRACK_CHAPTERS)
+	if (mux->chapter_track && track->type != TRACK_CHAPTERS &&
+	    (fragmented || mux->chapter_track->chunk_offsets.num))
 		mp4_write_tref(mux);
 
 	// mdia
@@ -2265,7 +2324,7 @@ static void process_packets(struct mp4_mux *mux, struct mp4_track *track, uint64
 
 		/* When using negative CTS, subtract DTS-PTS offset. */
 		if (track->type == TRACK_VIDEO && mux->flags & MP4_USE_NEGATIVE_CTS) {
-			if (!track->offsets.num)
+			if (!track->offsets.num && !track->cur_offset.count)
 				track->dts_offset = offset;
 
 			offset -= track->dts_offset;
@@ -2293,38 +2352,47 @@ static void process_packets(struct mp4_mux *mux, struct mp4_track *track, uint64
 
 		track->samples += sample_count;
 
-		/* If delta (duration) matche sprevious, increment counter,
-		 * otherwise create a new entry. */
-		if (track->deltas.num == 0 || track->deltas.array[track->deltas.num - 1].delta != duration) {
-			struct sample_delta *new = da_push_back_new(track->deltas);
-			new->delta = duration;
-			new->count = sample_count;
-		} else {
-			track->deltas.array[track->deltas.num - 1].count += sample_count;
+		/* If delta (duration) matches previous, increment counter,
+		 * otherwise store the run and start a new one. */
+		if (track->cur_delta.count && track->cur_delta.delta != duration) {
+			sample_table_push(&track->deltas, track->cur_delta.count);
+			sample_table_push(&track->deltas, track->cur_delta.delta);
+			track->cur_delta.count = 0;
 		}
 
-		if (!track->sample_size)
-			da_push_back(track->sample_sizes, &size);
+		track->cur_delta.delta = duration;
+		track->cur_delta.count += sample_count;
+
+		if (!track->sample_size) {
+			sample_table_push_signed(&track->sample_sizes, (int64_t)size - (int64_t)track->last_sample_size);
+			track->last_sample_size = size;
+		}
 
 		if (track->type != TRACK_VIDEO)
 			continue;
 
-		if (pkt->keyframe)
-			da_push_back(track->sync_samples, &track->samples);
+		if (pkt->keyframe) {
+			sample_table_push(&track->sync_samples, track->samples - track->last_sync_sample);
+			track->last_sync_sample = (uint32_t)track->samples;
+		}
 
 		/* Only require ctts box if offet is non-zero */
 		if (offset && !track->needs_ctts)
 			track->needs_ctts = true;
 
-		/* If dts-pts offset matche sprevious, increment counter,
-		 * otherwise create a new entry. */
-		if (track->offsets.num == 0 || track->offsets.array[track->offsets.num - 1].offset != offset) {
-			struct sample_offset *new = da_push_back_new(track->offsets);
-			new->offset = offset;
-			new->count = 1;
-		} else {
-			track->offsets.array[track->offsets.num - 1].count += 1;
+		/* If dts-pts offset matches previous, increment counter,
+		 * otherwise store the run and start a new one. */
+		if (!track->offsets.num && !track->cur_offset.count)
+			track->first_offset = offset;
+
+		if (track->cur_offset.count && track->cur_offset.offset != offset) {
+			sample_table_push(&track->offsets, track->cur_offset.count);
+			sample_table_push_signed(&track->offsets, track->cur_offset.offset);
+			track->cur_offset.count = 0;
 		}
+
+		track->cur_offset.offset = offset;
+		track->cur_offset.count += 1;
 	}
 }
 
@@ -2337,9 +2405,8 @@ static void write_packets(struct mp4_mux *mux, struct mp4_track *track)
 	if (!count || !track->fragment_samples.num)
 		return;
 
-	struct chunk *chk = da_push_back_new(track->chunks);
-	chk->offset = serializer_get_pos(s);
-	chk->samples = (uint32_t)track->fragment_samples.num;
+	uint64_t offset = (uint64_t)serializer_get_pos(s);
+	uint32_t samples = (uint32_t)track->fragment_samples.num;
 
 	for (size_t i = 0; i < track->fragment_samples.num; i++) {
 		struct encoder_packet pkt;
@@ -2348,11 +2415,27 @@ static void write_packets(struct mp4_mux *mux, struct mp4_track *track)
 		obs_encoder_packet_release(&pkt);
 	}
 
-	chk->size = (uint32_t)(serializer_get_pos(s) - chk->offset);
-
 	/* Fixup sample count for fixed-size codecs */
 	if (track->sample_size)
-		chk->samples = chk->size / track->sample_size;
+		samples = (uint32_t)((uint64_t)serializer_get_pos(s) - offset) / track->sample_size;
+
+	sample_table_push(&track->chunk_offsets, offset - track->last_chunk_offset);
+	track->last_chunk_offset = offset;
+
+	/* Start a new run if the number of samples differs from the previous
+	 * chunk (ISO-BMFF chunk numbers are 1-indexed). */
+	if (!track->cur_chunk_run.first || track->cur_chunk_run.samples != samples) {
+		uint32_t first = (uint32_t)track->chunk_offsets.num;
+
+		if (track->cur_chunk_run.first) {
+			sample_table_push(&track->chunk_runs, track->cur_chunk_run.first - track->last_chunk_run_first);
+			sample_table_push(&track->chunk_runs, track->cur_chunk_run.samples);
+			track->last_chunk_run_first = track->cur_chunk_run.first;
+		}
+
+		track->cur_chunk_run.first = first;
+		track->cur_chunk_run.samples = samples;
+	}
 
 	da_clear(track->fragment_samples);
 }
@@ -2442,6 +2525,200 @@ static void mp4_flush_fragment(struct mp4_mux *mux)
 	mux->next_frag_pts = 0;
 }
 
+/* ========================================================================== */
+/* Checkpoints                                                                */
+
+/* A checkpoint file contains a "ckpt" box with the size of the data written
+ * so far, followed by the ftyp and moov boxes the file would have if it was
+ * finalised at that point.  Recovering an unfinished file only needs to write
+ * those boxes, rather than parsing and remuxing all of its fragments.
+ *
+ * The packet thread only builds checkpoints.  The checkpoint thread waits for
+ * the data up to data_end to be on disk before replacing the previous
+ * checkpoint, so the one on disk never refers to data that could be lost. */
+
+#define CHECKPOINT_VERSION 1
+#define CHECKPOINT_HEADER_SIZE 28
+
+/* The moov grows with the recording, so the time between checkpoints is at
+ * least this many times the time it took to build the last one */
+#define CHECKPOINT_MAX_LOAD 100
+
+static void mp4_write_ckpt(struct mp4_mux *mux, uint64_t data_end)
+{
+	struct serializer *s = mux->serializer;
+
+	write_box(s, CHECKPOINT_HEADER_SIZE, "ckpt");
+	s_wb32(s, CHECKPOINT_VERSION);
+	s_wb64(s, data_end);                 // end of fragments written so far
+	s_wb64(s, mux->placeholder_offset); // offset of mdat placeholder
+}
+
+static void mp4_write_checkpoint(struct mp4_mux *mux)
+{
+	struct serializer *s = mux->serializer;
+	uint64_t start = os_gettime_ns();
+
+	if (!mux->checkpoint_thread_active || start < mux->next_checkpoint)
+		return;
+
+	struct serializer cs;
+	struct array_output_data ao;
+	array_output_serializer_init(&cs, &ao);
+
+	mux->serializer = &cs;
+
+	/* Must only be called right after a fragment has been written, so
+	 * that the file position is the end of the last complete fragment. */
+	mp4_write_ckpt(mux, (uint64_t)serializer_get_pos(s));
+	mp4_write_ftyp(mux, false);
+	mp4_write_moov(mux, false);
+
+	mux->serializer = s;
+
+	/* Replaces one that hasn't been written yet */
+	pthread_mutex_lock(&mux->checkpoint_mutex);
+	da_move(mux->checkpoint_data, ao.bytes);
+	pthread_mutex_unlock(&mux->checkpoint_mutex);
+
+	os_event_signal(mux->checkpoint_event);
+
+	uint64_t end = os_gettime_ns();
+	uint64_t interval = (end - start) * CHECKPOINT_MAX_LOAD;
+	mux->next_checkpoint = end + (interval > mux->checkpoint_interval ? interval : mux->checkpoint_interval);
+}
+
+static inline bool sync_file(FILE *f)
+{
+	if (fflush(f) != 0)
+		return false;
+#ifdef _WIN32
+	return _commit(_fileno(f)) == 0;
+#else
+	return fsync(fileno(f)) == 0;
+#endif
+}
+
+/* Written next to the previous one and moved into place once it is on disk,
+ * so there is always a complete checkpoint under the real name */
+static bool write_checkpoint_file(const char *path, const uint8_t *data, size_t size)
+{
+	struct dstr temp_path = {0};
+	bool success;
+	FILE *f;
+
+	dstr_printf(&temp_path, "%s.tmp", path);
+
+	f = os_fopen(temp_path.array, "wb");
+	if (!f) {
+		dstr_free(&temp_path);
+		return false;
+	}
+
+	success = fwrite(data, 1, size, f) == size && sync_file(f);
+	success = fclose(f) == 0 && success;
+	success = success && os_rename(temp_path.array, path) == 0;
+
+	if (!success)
+		os_unlink(temp_path.array);
+
+	dstr_free(&temp_path);
+	return success;
+}
+
+static void *checkpoint_thread(void *data)
+{
+	struct mp4_mux *mux = data;
+
+	os_set_thread_name("mp4 checkpoint thread");
+
+	for (;;) {
+		os_event_wait(mux->checkpoint_event);
+		if (os_atomic_load_bool(&mux->checkpoint_stop))
+			break;
+
+		DARRAY(uint8_t) ckpt = {0};
+
+		pthread_mutex_lock(&mux->checkpoint_mutex);
+		da_move(ckpt, mux->checkpoint_data);
+		pthread_mutex_unlock(&mux->checkpoint_mutex);
+
+		if (!ckpt.num)
+			continue;
+
+		/* Everything up to the checkpoint's data_end was written
+		 * before it was built */
+		if (!mux->checkpoint_sync(mux->file_serializer)) {
+			warn("Failed to sync '%s', no further checkpoints will be written",
+			     mux->checkpoint_path.array);
+			da_free(ckpt);
+			break;
+		}
+
+		if (!write_checkpoint_file(mux->checkpoint_path.array, ckpt.array, ckpt.num))
+			warn("Failed to write checkpoint '%s'", mux->checkpoint_path.array);
+
+		da_free(ckpt);
+	}
+
+	return NULL;
+}
+
+/* The serializer must not be used by the checkpoint thread anymore once the
+ * file is finalised or closed.  Checkpoints not written yet are dropped. */
+static void mp4_stop_checkpoints(struct mp4_mux *mux)
+{
+	if (!mux->checkpoint_thread_active)
+		return;
+
+	os_atomic_set_bool(&mux->checkpoint_stop, true);
+	os_event_signal(mux->checkpoint_event);
+	pthread_join(mux->checkpoint_thread, NULL);
+
+	os_event_destroy(mux->checkpoint_event);
+	pthread_mutex_destroy(&mux->checkpoint_mutex);
+	da_free(mux->checkpoint_data);
+	mux->checkpoint_thread_active = false;
+}
+
+static inline uint32_t rb32(const uint8_t *ptr)
+{
+	return ((uint32_t)ptr[0] << 24) | ((uint32_t)ptr[1] << 16) | ((uint32_t)ptr[2] << 8) | ptr[3];
+}
+
+static inline uint64_t rb64(const uint8_t *ptr)
+{
+	return ((uint64_t)rb32(ptr) << 32) | rb32(ptr + 4);
+}
+
+static uint8_t *read_checkpoint(const char *checkpoint_path, size_t *size)
+{
+	FILE *f = os_fopen(checkpoint_path, "rb");
+	uint8_t *data = NULL;
+
+	if (!f)
+		return NULL;
+
+	int64_t file_size = os_fgetsize(f);
+	if (file_size > CHECKPOINT_HEADER_SIZE && (uint64_t)file_size <= SIZE_MAX) {
+		*size = (size_t)file_size;
+		data = bmalloc(*size);
+
+		if (fread(data, 1, *size, f) != *size) {
+			bfree(data);
+			data = NULL;
+		}
+	}
+
+	fclose(f);
+	return data;
+}
+
+static bool write_at(FILE *f, uint64_t offset, const void *data, size_t size)
+{
+	return os_fseeki64(f, (int64_t)offset, SEEK_SET) == 0 && fwrite(data, 1, size, f) == size;
+}
+
 /* ========================================================================== */
 /* Track object functions                                                     */
 
@@ -2512,6 +2789,13 @@ static inline void add_track(struct mp4_mux *mux, obs_encoder_t *enc)
 	track->codec = get_codec(enc);
 	track->track_id = ++mux->track_ctr;
 
+	sample_table_init(&track->sample_sizes, NULL);
+	sample_table_init(&track->chunk_offsets, NULL);
+	sample_table_init(&track->chunk_runs, NULL);
+	sample_table_init(&track->deltas, NULL);
+	sample_table_init(&track->offsets, NULL);
+	sample_table_init(&track->sync_samples, NULL);
+
 	/* Set timebase/timescale */
 	if (track->type == TRACK_VIDEO) {
 		video_t *video = obs_encoder_video(enc);
@@ -2572,11 +2856,12 @@ static inline void free_track(struct mp4_track *track)
 	free_packets(&track->packets);
 	deque_free(&track->packets);
 
-	da_free(track->sample_sizes);
-	da_free(track->chunks);
-	da_free(track->deltas);
-	da_free(track->offsets);
-	da_free(track->sync_samples);
+	sample_table_free(&track->sample_sizes);
+	sample_table_free(&track->chunk_offsets);
+	sample_table_free(&track->chunk_runs);
+	sample_table_free(&track->deltas);
+	sample_table_free(&track->offsets);
+	sample_table_free(&track->sync_samples);
 	da_free(track->fragment_samples);
 }
 
@@ -2612,12 +2897,16 @@ struct mp4_mux *mp4_mux_create(obs_output_t *output, struct serializer *serializ
 
 void mp4_mux_destroy(struct mp4_mux *mux)
 {
+	mp4_stop_checkpoints(mux);
+
 	for (size_t i = 0; i < mux->tracks.num; i++)
 		free_track(&mux->tracks.array[i]);
 
 	free_track(mux->chapter_track);
 	bfree(mux->chapter_track);
 	da_free(mux->tracks);
+	dstr_free(&mux->spill_dir);
+	dstr_free(&mux->checkpoint_path);
 	bfree(mux);
 }
 
@@ -2646,8 +2935,10 @@ bool mp4_mux_submit_packet(struct mp4_mux *mux, struct encoder_packet *pkt)
 
 	/* If all tracks have caught up to the keyframe we want to fragment on,
 	 * flush the current fragment to disk. */
-	if (fragment_ready)
+	if (fragment_ready) {
 		mp4_flush_fragment(mux);
+		mp4_write_checkpoint(mux);
+	}
 
 	if (type == OBS_ENCODER_AUDIO) {
 		obs_encoder_packet_ref(&parsed_packet, pkt);
@@ -2695,6 +2986,8 @@ bool mp4_mux_finalise(struct mp4_mux *mux)
 {
 	struct serializer *s = mux->serializer;
 
+	mp4_stop_checkpoints(mux);
+
 	/* Flush remaining audio/video samples as final fragment. */
 	info("Flushing final fragment...");
 
@@ -2739,17 +3032,154 @@ bool mp4_mux_finalise(struct mp4_mux *mux)
 	size_t data_size = data_end - mux->placeholder_offset;
 	serializer_seek(s, (int64_t)mux->placeholder_offset, SERIALIZE_SEEK_START);
 
-	/* If data is more than 4 GiB the mdat header becomes 16 bytes, hence
-	 * why we create a 16-byte placeholder "free" box at the start. */
-	if (data_size > UINT32_MAX) {
-		s_wb32(s, 1); // 1 = use "largesize" field instead
-		s_write(s, "mdat", 4);
-		s_wb64(s, data_size); // largesize (64-bit)
-	} else {
-		s_wb32(s, (uint32_t)data_size);
-		s_write(s, "mdat", 4);
-	}
+	mp4_write_mdat_header(s, data_size);
 
 	info("Final mdat size: %zu KiB", data_size / 1024);
 	return true;
 }
+
+void mp4_mux_spill_sample_tables(struct mp4_mux *mux, const char *dir)
+{
+	dstr_copy(&mux->spill_dir, dir);
+
+	for (size_t i = 0; i < mux->tracks.num; i++) {
+		struct mp4_track *track = &mux->tracks.array[i];
+
+		track->sample_sizes.spill_dir = mux->spill_dir.array;
+		track->chunk_offsets.spill_dir = mux->spill_dir.array;
+		track->chunk_runs.spill_dir = mux->spill_dir.array;
+		track->deltas.spill_dir = mux->spill_dir.array;
+		track->offsets.spill_dir = mux->spill_dir.array;
+		track->sync_samples.spill_dir = mux->spill_dir.array;
+	}
+}
+
+void mp4_mux_enable_checkpoints(struct mp4_mux *mux, const char *checkpoint_path, uint32_t interval_sec,
+				mp4_mux_sync_t sync)
+{
+	if (mux->checkpoint_thread_active)
+		return;
+
+	dstr_copy(&mux->checkpoint_path, checkpoint_path);
+	mux->checkpoint_interval = (uint64_t)interval_sec * 1000000000ULL;
+	mux->next_checkpoint = os_gettime_ns() + mux->checkpoint_interval;
+	mux->checkpoint_sync = sync;
+	mux->file_serializer = mux->serializer;
+	mux->checkpoint_stop = false;
+
+	if (pthread_mutex_init(&mux->checkpoint_mutex, NULL) != 0)
+		return;
+	if (os_event_init(&mux->checkpoint_event, OS_EVENT_TYPE_AUTO) != 0) {
+		pthread_mutex_destroy(&mux->checkpoint_mutex);
+		return;
+	}
+	if (pthread_create(&mux->checkpoint_thread, NULL, checkpoint_thread, mux) != 0) {
+		warn("Failed to create checkpoint thread");
+		os_event_destroy(mux->checkpoint_event);
+		pthread_mutex_destroy(&mux->checkpoint_mutex);
+		return;
+	}
+
+	mux->checkpoint_thread_active = true;
+}
+
+bool mp4_mux_recover(const char *path, const char *checkpoint_path)
+{
+	uint8_t *ckpt = NULL;
+	size_t ckpt_size = 0;
+	FILE *f = NULL;
+	bool success = false;
+
+	ckpt = read_checkpoint(checkpoint_path, &ckpt_size);
+	if (!ckpt) {
+		blog(LOG_WARNING, "[mp4 muxer] Unable to read checkpoint '%s'", checkpoint_path);
+		return false;
+	}
+
+	/* ckpt header, followed by ftyp and moov */
+	if (rb32(ckpt) != CHECKPOINT_HEADER_SIZE || memcmp(ckpt + 4, "ckpt", 4) != 0 ||
+	    rb32(ckpt + 8) != CHECKPOINT_VERSION) {
+		blog(LOG_WARNING, "[mp4 muxer] Invalid checkpoint '%s'", checkpoint_path);
+		goto fail;
+	}
+
+	uint64_t data_end = rb64(ckpt + 12);
+	uint64_t placeholder_offset = rb64(ckpt + 20);
+
+	const uint8_t *ftyp = ckpt + CHECKPOINT_HEADER_SIZE;
+	size_t remaining = ckpt_size - CHECKPOINT_HEADER_SIZE;
+	uint32_t ftyp_size = remaining >= 8 ? rb32(ftyp) : 0;
+
+	if (ftyp_size < 8 || (size_t)ftyp_size + 8 > remaining || memcmp(ftyp + 4, "ftyp", 4) != 0) {
+		blog(LOG_WARNING, "[mp4 muxer] Invalid checkpoint '%s'", checkpoint_path);
+		goto fail;
+	}
+
+	const uint8_t *moov = ftyp + ftyp_size;
+	size_t moov_size = remaining - ftyp_size;
+
+	if (rb32(moov) != moov_size || memcmp(moov + 4, "moov", 4) != 0 || placeholder_offset < ftyp_size ||
+	    placeholder_offset + 16 > data_end) {
+		blog(LOG_WARNING, "[mp4 muxer] Invalid checkpoint '%s'", checkpoint_path);
+		goto fail;
+	}
+
+	f = os_fopen(path, "r+b");
+	if (!f) {
+		blog(LOG_WARNING, "[mp4 muxer] Unable to open '%s' for recovery", path);
+		goto fail;
+	}
+
+	/* Data written after the checkpoint may be incomplete and is dropped,
+	 * but everything up to the checkpoint has to be there. */
+	int64_t file_size = os_fgetsize(f);
+	uint8_t header[8];
+
+	if (file_size < 0 || (uint64_t)file_size < data_end || fread(header, 1, 8, f) != 8 ||
+	    rb32(header) != ftyp_size || memcmp(header + 4, "ftyp", 4) != 0) {
+		blog(LOG_WARNING, "[mp4 muxer] '%s' does not match checkpoint '%s'", path, checkpoint_path);
+		goto fail;
+	}
+
+	struct serializer s;
+	struct array_output_data ao;
+	array_output_serializer_init(&s, &ao);
+
+	mp4_write_mdat_header(&s, data_end - placeholder_offset);
+
+	/* Anything after the moov becomes a free box, so the file does not
+	 * need to be truncated. */
+	uint64_t moov_end = data_end + moov_size;
+	uint64_t trailing = (uint64_t)file_size > moov_end ? (uint64_t)file_size - moov_end : 0;
+	uint8_t free_box[16];
+	size_t free_box_size = 0;
+
+	if (trailing) {
+		struct serializer fs;
+		struct array_output_data fao;
+		array_output_serializer_init(&fs, &fao);
+
+		write_box(&fs, trailing < 8 ? 8 : trailing, "free");
+		free_box_size = fao.bytes.num;
+		memcpy(free_box, fao.bytes.array, free_box_size);
+
+		array_output_serializer_free(&fao);
+	}
+
+	success = write_at(f, 0, ftyp, ftyp_size) && write_at(f, placeholder_offset, ao.bytes.array, ao.bytes.num) &&
+		  write_at(f, data_end, moov, moov_size) &&
+		  (!free_box_size || write_at(f, moov_end, free_box, free_box_size)) && fflush(f) == 0;
+
+	array_output_serializer_free(&ao);
+
+	if (success)
+		blog(LOG_INFO, "[mp4 muxer] Recovered '%s' (%" PRIu64 " KiB of data)", path, data_end / 1024);
+	else
+		blog(LOG_WARNING, "[mp4 muxer] Failed to write recovered file '%s'", path);
+
+fail:
+	if (f)
+		fclose(f);
+	bfree(ckpt);
+	return success;
+}
@@ -38,3 +38,18 @@ void mp4_mux_destroy(struct mp4_mux *mux);
 bool mp4_mux_submit_packet(struct mp4_mux *mux, struct encoder_packet *pkt);
 bool mp4_mux_add_chapter(struct mp4_mux *mux, int64_t dts_usec, const char *name);
 bool mp4_mux_finalise(struct mp4_mux *mux);
+
+/* Moves sample tables to temporary files in dir instead of keeping them in
+ * memory for the whole recording, usually the directory of the recording */
+void mp4_mux_spill_sample_tables(struct mp4_mux *mux, const char *dir);
+
+/* Waits until everything written to the serializer so far is on disk.  Called
+ * from another thread than the one submitting packets. */
+typedef bool (*mp4_mux_sync_t)(struct serializer *s);
+
+/* Periodically writes a checkpoint of the file written so far, which
+ * mp4_mux_recover() can use to turn the file into a regular MP4 file should
+ * the recording not be finalised (e.g. after a crash). */
+void mp4_mux_enable_checkpoints(struct mp4_mux *mux, const char *checkpoint_path, uint32_t interval_sec,
+				mp4_mux_sync_t sync);
+bool mp4_mux_recover(const char *path, const char *checkpoint_path);
@@ -45,6 +45,8 @@ struct mp4_output {
 	/* File serializer buffer configuration */
 	size_t buffer_size;
 	size_t chunk_size;
+	size_t queue_depth;
+	bool direct_io;
 	struct serializer serializer;
 
 	volatile bool active;
@@ -59,6 +61,10 @@ struct mp4_output {
 	struct mp4_mux *muxer;
 	int flags;
 
+	/* Seconds between checkpoints for recovery, 0 if disabled */
+	uint32_t checkpoint_interval;
+	bool spill_sample_tables;
+
 	int64_t last_dts_usec;
 	DARRAY(struct chapter) chapters;
 
@@ -179,6 +185,43 @@ static void mp4_add_chapter_proc(void *data, calldata_t *cd)
 	pthread_mutex_unlock(&out->mutex);
 }
 
+static inline void get_checkpoint_path(struct dstr *dst, const char *path)
+{
+	dstr_copy(dst, path);
+	dstr_cat(dst, ".checkpoint");
+}
+
+static inline void get_directory(struct dstr *dst, const char *path)
+{
+	dstr_copy(dst, path);
+	dstr_replace(dst, "\\", "/");
+
+	char *slash = dst->array ? strrchr(dst->array, '/') : NULL;
+	if (slash)
+		*slash = 0;
+	else
+		dstr_copy(dst, ".");
+}
+
+static void recover_file_proc(void *data, calldata_t *cd)
+{
+	struct dstr checkpoint_path = {0};
+	const char *path = calldata_string(cd, "path");
+	bool success = false;
+
+	UNUSED_PARAMETER(data);
+
+	if (path && *path) {
+		get_checkpoint_path(&checkpoint_path, path);
+		success = mp4_mux_recover(path, checkpoint_path.array);
+		if (success)
+			os_unlink(checkpoint_path.array);
+		dstr_free(&checkpoint_path);
+	}
+
+	calldata_set_bool(cd, "success", success);
+}
+
 static void split_file_proc(void *data, calldata_t *cd)
 {
 	struct mp4_output *out = data;
@@ -202,6 +245,7 @@ static void *mp4_output_create(obs_data_t *settings, obs_output_t *output)
 	proc_handler_t *ph = obs_output_get_proc_handler(output);
 	proc_handler_add(ph, "void split_file(out bool split_file_enabled)", split_file_proc, out);
 	proc_handler_add(ph, "void add_chapter(string chapter_name)", mp4_add_chapter_proc, out);
+	proc_handler_add(ph, "void recover_file(string path, out bool success)", recover_file_proc, out);
 
 	UNUSED_PARAMETER(settings);
 	return out;
@@ -221,6 +265,9 @@ static void parse_custom_options(struct mp4_output *out, const char *opts_str)
 
 	struct obs_options opts = obs_parse_options(opts_str);
 
+	out->checkpoint_interval = 0;
+	out->spill_sample_tables = false;
+
 	for (size_t i = 0; i < opts.count; i++) {
 		struct obs_option opt = opts.options[i];
 
@@ -232,10 +279,18 @@ static void parse_custom_options(struct mp4_output *out, const char *opts_str)
 			apply_flag(&flags, opt.value, MP4_USE_MDTA_KEY_VALUE);
 		} else if (strcmp(opt.name, "use_negative_cts") == 0) {
 			apply_flag(&flags, opt.value, MP4_USE_NEGATIVE_CTS);
+		} else if (strcmp(opt.name, "spill_sample_tables") == 0) {
+			out->spill_sample_tables = !!atoi(opt.value);
+		} else if (strcmp(opt.name, "checkpoint_interval") == 0) {
+			out->checkpoint_interval = (uint32_t)strtoul(opt.value, 0, 10);
 		} else if (strcmp(opt.name, "buffer_size") == 0) {
 			out->buffer_size = strtoull(opt.value, 0, 10) * 1048576ULL;
 		} else if (strcmp(opt.name, "chunk_size") == 0) {
 			out->chunk_size = strtoull(opt.value, 0, 10) * 1048576ULL;
+		} else if (strcmp(opt.name, "queue_depth") == 0) {
+			out->queue_depth = strtoull(opt.value, 0, 10);
+		} else if (strcmp(opt.name, "direct_io") == 0) {
+			out->direct_io = !!atoi(opt.value);
 		} else {
 			blog(LOG_WARNING, "Unknown muxer option: %s = %s", opt.name, opt.value);
 		}
@@ -248,6 +303,42 @@ static void parse_custom_options(struct mp4_output *out, const char *opts_str)
 
 static void generate_filename(struct mp4_output *out, struct dstr *dst, bool overwrite);
 
+static void create_muxer(struct mp4_output *out)
+{
+	out->muxer = mp4_mux_create(out->output, &out->serializer, out->flags);
+
+	/* next to the recording, as the system's temporary directory may be
+	 * too small for the tables of a long recording */
+	if (out->spill_sample_tables) {
+		struct dstr dir = {0};
+		get_directory(&dir, out->path.array);
+		mp4_mux_spill_sample_tables(out->muxer, dir.array);
+		dstr_free(&dir);
+	}
+
+	if (out->checkpoint_interval) {
+		struct dstr checkpoint_path = {0};
+		get_checkpoint_path(&checkpoint_path, out->path.array);
+		mp4_mux_enable_checkpoints(out->muxer, checkpoint_path.array, out->checkpoint_interval,
+					   buffered_file_serializer_sync);
+		dstr_free(&checkpoint_path);
+	}
+}
+
+/* Only called once the file has been finalised and closed */
+static void remove_checkpoint(struct mp4_output *out)
+{
+	struct dstr checkpoint_path = {0};
+
+	if (!out->checkpoint_interval)
+		return;
+
+	get_checkpoint_path(&checkpoint_path, out->path.array);
+	if (os_file_exists(checkpoint_path.array))
+		os_unlink(checkpoint_path.array);
+	dstr_free(&checkpoint_path);
+}
+
 static bool mp4_output_start(void *data)
 {
 	struct mp4_output *out = data;
@@ -281,13 +372,14 @@ static bool mp4_output_start(void *data)
 
 	obs_data_release(settings);
 
-	if (!buffered_file_serializer_init(&out->serializer, out->path.array, out->buffer_size, out->chunk_size)) {
+	if (!buffered_file_serializer_init_ex(&out->serializer, out->path.array, out->buffer_size, out->chunk_size,
+					      out->queue_depth, out->direct_io)) {
 		warn("Unable to open MP4 file '%s'", out->path.array);
 		return false;
 	}
 
 	/* Initialise muxer and start capture */
-	out->muxer = mp4_mux_create(out->output, &out->serializer, out->flags);
+	create_muxer(out);
 	os_atomic_set_bool(&out->active, true);
 	obs_output_begin_data_capture(out->output, 0);
 
@@ -393,6 +485,7 @@ static bool change_file(struct mp4_output *out, struct encoder_packet *pkt)
 	/* flush/close file and destroy old muxer */
 	buffered_file_serializer_free(&out->serializer);
 	mp4_mux_destroy(out->muxer);
+	remove_checkpoint(out);
 
 	for (size_t i = 0; i < out->chapters.num; i++)
 		bfree(out->chapters.array[i].name);
@@ -405,12 +498,13 @@ static bool change_file(struct mp4_output *out, struct encoder_packet *pkt)
 	generate_filename(out, &out->path, out->allow_overwrite);
 	info("Changing output file to '%s'", out->path.array);
 
-	if (!buffered_file_serializer_init(&out->serializer, out->path.array, out->buffer_size, out->chunk_size)) {
+	if (!buffered_file_serializer_init_ex(&out->serializer, out->path.array, out->buffer_size, out->chunk_size,
+					      out->queue_depth, out->direct_io)) {
 		warn("Unable to open MP4 file '%s'", out->path.array);
 		return false;
 	}
 
-	out->muxer = mp4_mux_create(out->output, &out->serializer, out->flags);
+	create_muxer(out);
 
 	calldata_t cd = {0};
 	signal_handler_t *sh = obs_output_get_signal_handler(out->output);
@@ -461,6 +555,7 @@ static void mp4_output_actual_stop(struct mp4_output *out, int code)
 
 	/* Flush/close output file and destroy muxer */
 	buffered_file_serializer_free(&out->serializer);
+	remove_checkpoint(out);
 	obs_queue_task(OBS_TASK_DESTROY, mp4_mux_destroy_task, out->muxer, false);
 	out->muxer = NULL;
 
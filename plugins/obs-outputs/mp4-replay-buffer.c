@@ -0,0 +1,648 @@
+/******************************************************************************
+    Copyright (C) 2024 by Dennis Sädtler <dennis@obsproject.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include "mp4-mux.h"
+#include "replay-ring.h"
+
+#include <inttypes.h>
+
+#include <obs-module.h>
+#include <obs-hotkey.h>
+#include <util/darray.h>
+#include <util/deque.h>
+#include <util/dstr.h>
+#include <util/file-serializer.h>
+#include <util/platform.h>
+#include <util/threading.h>
+
+#define do_log(level, format, ...) \
+	blog(level, "[mp4 replay buffer: '%s'] " format, obs_output_get_name(rb->output), ##__VA_ARGS__)
+
+#define warn(format, ...) do_log(LOG_WARNING, format, ##__VA_ARGS__)
+#define info(format, ...) do_log(LOG_INFO, format, ##__VA_ARGS__)
+
+/*
+ * Replay buffer that saves with the native MP4 muxer on a background thread,
+ * rather than through an obs-ffmpeg-mux process.
+ *
+ * Saving only takes new references to the buffered packets, so the packet
+ * data is not copied, and the buffer keeps accepting and purging packets
+ * while the file is written.
+ *
+ * With "spill_to_disk" enabled, only the newest packets (up to "memory_mb")
+ * are kept in memory.  The data of older packets is moved to a ring file of
+ * "max_size_mb", and read back one packet at a time while saving.
+ */
+
+struct replay_packet {
+	struct encoder_packet pkt;
+	/* If spilled, pkt.data is NULL and the data is in the ring */
+	bool spilled;
+	uint64_t ring_pos;
+};
+
+struct mp4_replay_buffer {
+	obs_output_t *output;
+	obs_hotkey_id hotkey;
+
+	volatile bool active;
+	volatile bool stopping;
+	int64_t stop_ts;
+	uint64_t total_bytes;
+
+	/* Buffered packets */
+	struct deque packets;
+	int64_t cur_size;
+	int64_t cur_time;
+	int64_t max_size;
+	int64_t max_time;
+	/* Sequence number of the first buffered packet */
+	uint64_t first_seq;
+	/* Sequence numbers of the buffered video keyframes, i.e. GOP starts */
+	struct deque keyframes;
+
+	/* Disk spilling, the first num_spilled packets are in the ring */
+	struct replay_ring ring;
+	size_t num_spilled;
+	int64_t hot_size;
+	int64_t max_hot_size;
+
+	/* System time (usec) of the save request, 0 if none is pending */
+	int64_t save_ts;
+
+	/* Save thread */
+	pthread_t save_thread;
+	bool save_thread_joinable;
+	volatile bool saving;
+	DARRAY(struct replay_packet) save_packets;
+	struct dstr path;
+	uint64_t save_requested_ns;
+	volatile long last_save_latency_ms;
+};
+
+static inline bool stopping(struct mp4_replay_buffer *rb)
+{
+	return os_atomic_load_bool(&rb->stopping);
+}
+
+static inline bool active(struct mp4_replay_buffer *rb)
+{
+	return os_atomic_load_bool(&rb->active);
+}
+
+static void generate_filename(struct mp4_replay_buffer *rb, struct dstr *dst)
+{
+	obs_data_t *settings = obs_output_get_settings(rb->output);
+	const char *dir = obs_data_get_string(settings, "directory");
+	const char *fmt = obs_data_get_string(settings, "format");
+	const char *ext = obs_data_get_string(settings, "extension");
+	bool space = obs_data_get_bool(settings, "allow_spaces");
+
+	char *filename = os_generate_formatted_filename(ext, space, fmt);
+
+	dstr_copy(dst, dir);
+	dstr_replace(dst, "\\", "/");
+	if (dstr_end(dst) != '/')
+		dstr_cat_ch(dst, '/');
+	dstr_cat(dst, filename);
+
+	char *slash = strrchr(dst->array, '/');
+	if (slash) {
+		*slash = 0;
+		os_mkdirs(dst->array);
+		*slash = '/';
+	}
+
+	bfree(filename);
+	obs_data_release(settings);
+}
+
+static void mp4_replay_buffer_clear(struct mp4_replay_buffer *rb)
+{
+	while (rb->packets.size > 0) {
+		struct replay_packet rp;
+		deque_pop_front(&rb->packets, &rp, sizeof(rp));
+		obs_encoder_packet_release(&rp.pkt);
+	}
+
+	deque_free(&rb->packets);
+	deque_free(&rb->keyframes);
+	rb->cur_size = 0;
+	rb->cur_time = 0;
+	rb->save_ts = 0;
+	rb->first_seq = 0;
+	rb->num_spilled = 0;
+	rb->hot_size = 0;
+}
+
+/* ------------------------------------------------------------------------- */
+
+static inline size_t num_keyframes(struct mp4_replay_buffer *rb)
+{
+	return rb->keyframes.size / sizeof(uint64_t);
+}
+
+static void release_save_packets(struct mp4_replay_buffer *rb)
+{
+	for (size_t i = 0; i < rb->save_packets.num; i++)
+		obs_encoder_packet_release(&rb->save_packets.array[i].pkt);
+	da_free(rb->save_packets);
+}
+
+/* Reads a spilled packet back into a new reference counted buffer */
+static bool load_spilled_packet(struct mp4_replay_buffer *rb, struct replay_packet *rp)
+{
+	long *p_refs = bmalloc(rp->pkt.size + sizeof(long));
+	uint8_t *data = (uint8_t *)(p_refs + 1);
+
+	if (!replay_ring_read(&rb->ring, rp->ring_pos, data, rp->pkt.size)) {
+		bfree(p_refs);
+		return false;
+	}
+
+	*p_refs = 1;
+	rp->pkt.data = data;
+	rp->spilled = false;
+
+	/* Everything before the next spilled packet may be overwritten now */
+	replay_ring_pin(&rb->ring, rp->ring_pos + rp->pkt.size);
+	return true;
+}
+
+static void *save_thread(void *data)
+{
+	struct mp4_replay_buffer *rb = data;
+	uint64_t start = os_gettime_ns();
+	struct serializer s;
+	bool success = false;
+
+	os_set_thread_name("mp4 replay buffer save thread");
+
+	if (file_output_serializer_init(&s, rb->path.array)) {
+		struct mp4_mux *mux = mp4_mux_create(rb->output, &s, MP4_USE_NEGATIVE_CTS);
+
+		success = true;
+
+		/* Spilled packets are only read when submitted, the muxer holds
+		 * on to them until the end of the fragment (GOP). */
+		for (size_t i = 0; i < rb->save_packets.num; i++) {
+			struct replay_packet *rp = &rb->save_packets.array[i];
+
+			if (rp->spilled && !load_spilled_packet(rb, rp)) {
+				warn("Failed to read packet from replay ring");
+				success = false;
+				break;
+			}
+
+			mp4_mux_submit_packet(mux, &rp->pkt);
+			obs_encoder_packet_release(&rp->pkt);
+		}
+
+		success = mp4_mux_finalise(mux) && success && serializer_get_pos(&s) != -1;
+
+		file_output_serializer_free(&s);
+		mp4_mux_destroy(mux);
+	} else {
+		warn("Unable to open MP4 file '%s'", rb->path.array);
+	}
+
+	if (replay_ring_active(&rb->ring))
+		replay_ring_unpin(&rb->ring);
+	release_save_packets(rb);
+
+	uint64_t end = os_gettime_ns();
+	long latency_ms = (long)((end - rb->save_requested_ns) / 1000000);
+
+	if (success) {
+		info("Wrote replay buffer to '%s' in %" PRIu64 " ms (%ld ms after the save was requested)",
+		     rb->path.array, (end - start) / 1000000, latency_ms);
+		os_atomic_set_long(&rb->last_save_latency_ms, latency_ms);
+	} else {
+		warn("Failed to write replay buffer to '%s'", rb->path.array);
+	}
+
+	os_atomic_set_bool(&rb->saving, false);
+
+	if (success) {
+		calldata_t cd = {0};
+		signal_handler_t *sh = obs_output_get_signal_handler(rb->output);
+		signal_handler_signal(sh, "saved", &cd);
+	}
+
+	return NULL;
+}
+
+static void mp4_replay_buffer_save(struct mp4_replay_buffer *rb)
+{
+	const size_t size = sizeof(struct replay_packet);
+	size_t num_packets = rb->packets.size / size;
+	size_t first = 0;
+
+	bool found_video[MAX_OUTPUT_VIDEO_ENCODERS] = {0};
+	bool found_audio[MAX_OUTPUT_AUDIO_ENCODERS] = {0};
+	int64_t video_pts_offsets[MAX_OUTPUT_VIDEO_ENCODERS] = {0};
+	int64_t audio_dts_offsets[MAX_OUTPUT_AUDIO_ENCODERS] = {0};
+
+	/* Start at the first GOP, found with the keyframe index */
+	if (num_keyframes(rb)) {
+		uint64_t *seq = deque_data(&rb->keyframes, 0);
+		first = (size_t)(*seq - rb->first_seq);
+	}
+
+	da_reserve(rb->save_packets, num_packets - first);
+
+	/* Reference the buffered packets, with timestamps starting at zero */
+	for (size_t i = first; i < num_packets; i++) {
+		struct replay_packet *rp = deque_data(&rb->packets, i * size);
+		struct replay_packet *save = da_push_back_new(rb->save_packets);
+		struct encoder_packet *ref = &save->pkt;
+
+		obs_encoder_packet_ref(ref, &rp->pkt);
+		save->spilled = rp->spilled;
+		save->ring_pos = rp->ring_pos;
+
+		/* Keep the ring from overwriting spilled data until it's read */
+		if (rp->spilled && save == rb->save_packets.array)
+			replay_ring_pin(&rb->ring, rp->ring_pos);
+
+		if (ref->type == OBS_ENCODER_VIDEO) {
+			if (!found_video[ref->track_idx]) {
+				found_video[ref->track_idx] = true;
+				video_pts_offsets[ref->track_idx] = ref->pts;
+			}
+
+			ref->dts -= video_pts_offsets[ref->track_idx];
+			ref->pts -= video_pts_offsets[ref->track_idx];
+		} else {
+			if (!found_audio[ref->track_idx]) {
+				found_audio[ref->track_idx] = true;
+				audio_dts_offsets[ref->track_idx] = ref->dts;
+			}
+
+			ref->dts -= audio_dts_offsets[ref->track_idx];
+			ref->pts -= audio_dts_offsets[ref->track_idx];
+		}
+	}
+
+	generate_filename(rb, &rb->path);
+
+	os_atomic_set_bool(&rb->saving, true);
+	rb->save_thread_joinable = pthread_create(&rb->save_thread, NULL, save_thread, rb) == 0;
+	if (!rb->save_thread_joinable) {
+		warn("Failed to create save thread");
+
+		if (replay_ring_active(&rb->ring))
+			replay_ring_unpin(&rb->ring);
+		release_save_packets(rb);
+
+		os_atomic_set_bool(&rb->saving, false);
+	}
+}
+
+/* ------------------------------------------------------------------------- */
+
+static const char *mp4_replay_buffer_name(void *unused)
+{
+	UNUSED_PARAMETER(unused);
+	return obs_module_text("MP4ReplayBuffer");
+}
+
+static void mp4_replay_buffer_hotkey(void *data, obs_hotkey_id id, obs_hotkey_t *hotkey, bool pressed)
+{
+	UNUSED_PARAMETER(id);
+	UNUSED_PARAMETER(hotkey);
+
+	if (!pressed)
+		return;
+
+	struct mp4_replay_buffer *rb = data;
+
+	if (active(rb)) {
+		obs_encoder_t *vencoder = obs_output_get_video_encoder(rb->output);
+		if (obs_encoder_paused(vencoder)) {
+			info("Could not save buffer because encoders paused");
+			return;
+		}
+
+		rb->save_requested_ns = os_gettime_ns();
+		rb->save_ts = (int64_t)(rb->save_requested_ns / 1000);
+	}
+}
+
+static void save_replay_proc(void *data, calldata_t *cd)
+{
+	mp4_replay_buffer_hotkey(data, 0, NULL, true);
+	UNUSED_PARAMETER(cd);
+}
+
+static void get_last_replay(void *data, calldata_t *cd)
+{
+	struct mp4_replay_buffer *rb = data;
+	if (!os_atomic_load_bool(&rb->saving))
+		calldata_set_string(cd, "path", rb->path.array);
+}
+
+static void get_last_replay_latency(void *data, calldata_t *cd)
+{
+	struct mp4_replay_buffer *rb = data;
+	calldata_set_int(cd, "latency_ms", os_atomic_load_long(&rb->last_save_latency_ms));
+}
+
+static void *mp4_replay_buffer_create(obs_data_t *settings, obs_output_t *output)
+{
+	struct mp4_replay_buffer *rb = bzalloc(sizeof(struct mp4_replay_buffer));
+	rb->output = output;
+
+	rb->hotkey = obs_hotkey_register_output(output, "ReplayBuffer.Save", obs_module_text("MP4ReplayBuffer.Save"),
+						mp4_replay_buffer_hotkey, rb);
+
+	proc_handler_t *ph = obs_output_get_proc_handler(output);
+	proc_handler_add(ph, "void save()", save_replay_proc, rb);
+	proc_handler_add(ph, "void get_last_replay(out string path)", get_last_replay, rb);
+	proc_handler_add(ph, "void get_last_replay_latency(out int latency_ms)", get_last_replay_latency, rb);
+
+	signal_handler_t *sh = obs_output_get_signal_handler(output);
+	signal_handler_add(sh, "void saved()");
+
+	UNUSED_PARAMETER(settings);
+	return rb;
+}
+
+static void mp4_replay_buffer_destroy(void *data)
+{
+	struct mp4_replay_buffer *rb = data;
+
+	if (rb->hotkey)
+		obs_hotkey_unregister(rb->hotkey);
+
+	mp4_replay_buffer_clear(rb);
+	if (rb->save_thread_joinable)
+		pthread_join(rb->save_thread, NULL);
+
+	replay_ring_free(&rb->ring);
+	dstr_free(&rb->path);
+	bfree(rb);
+}
+
+static bool mp4_replay_buffer_start(void *data)
+{
+	struct mp4_replay_buffer *rb = data;
+
+	if (!obs_output_can_begin_data_capture(rb->output, 0))
+		return false;
+	if (!obs_output_initialize_encoders(rb->output, 0))
+		return false;
+
+	obs_data_t *s = obs_output_get_settings(rb->output);
+	rb->max_time = obs_data_get_int(s, "max_time_sec") * 1000000LL;
+	rb->max_size = obs_data_get_int(s, "max_size_mb") * (1024 * 1024);
+	rb->max_hot_size = obs_data_get_int(s, "memory_mb") * (1024 * 1024);
+	bool spill = obs_data_get_bool(s, "spill_to_disk");
+
+	/* next to the saved replays, as the system's temporary directory may
+	 * be too small or in memory */
+	struct dstr dir = {0};
+	dstr_copy(&dir, obs_data_get_string(s, "directory"));
+	dstr_replace(&dir, "\\", "/");
+	if (dstr_is_empty(&dir))
+		dstr_copy(&dir, ".");
+	obs_data_release(s);
+
+	if (spill && !rb->max_size) {
+		warn("Spilling to disk requires a maximum size, keeping packets in memory");
+	} else if (spill && rb->max_hot_size < rb->max_size) {
+		os_mkdirs(dir.array);
+		if (replay_ring_init(&rb->ring, dir.array, (uint64_t)rb->max_size))
+			info("Keeping up to %" PRId64 " MiB in memory, the rest on disk",
+			     rb->max_hot_size / (1024 * 1024));
+		else
+			warn("Failed to create replay ring, keeping packets in memory");
+	}
+
+	dstr_free(&dir);
+
+	os_atomic_set_bool(&rb->stopping, false);
+	os_atomic_set_bool(&rb->active, true);
+	rb->total_bytes = 0;
+	obs_output_begin_data_capture(rb->output, 0);
+
+	return true;
+}
+
+static void mp4_replay_buffer_stop(void *data, uint64_t ts)
+{
+	struct mp4_replay_buffer *rb = data;
+	rb->stop_ts = (int64_t)ts / 1000;
+	os_atomic_set_bool(&rb->stopping, true);
+}
+
+static void deactivate(struct mp4_replay_buffer *rb, int code)
+{
+	if (code)
+		obs_output_signal_stop(rb->output, code);
+	else
+		obs_output_end_data_capture(rb->output);
+
+	os_atomic_set_bool(&rb->active, false);
+	os_atomic_set_bool(&rb->stopping, false);
+	mp4_replay_buffer_clear(rb);
+
+	/* A save that's still running may be reading from the ring */
+	if (replay_ring_active(&rb->ring)) {
+		if (rb->save_thread_joinable) {
+			pthread_join(rb->save_thread, NULL);
+			rb->save_thread_joinable = false;
+		}
+
+		replay_ring_free(&rb->ring);
+	}
+}
+
+static void purge_front(struct mp4_replay_buffer *rb)
+{
+	struct replay_packet rp;
+
+	if (!rb->packets.size)
+		return;
+
+	deque_pop_front(&rb->packets, &rp, sizeof(rp));
+	rb->first_seq++;
+
+	if (rp.spilled) {
+		replay_ring_release(&rb->ring, rp.ring_pos + rp.pkt.size);
+		rb->num_spilled--;
+	} else {
+		rb->hot_size -= (int64_t)rp.pkt.size;
+	}
+
+	if (!rb->packets.size) {
+		rb->cur_size = 0;
+		rb->cur_time = 0;
+	} else {
+		struct replay_packet *first = deque_data(&rb->packets, 0);
+		rb->cur_time = first->pkt.dts_usec;
+		rb->cur_size -= (int64_t)rp.pkt.size;
+	}
+
+	obs_encoder_packet_release(&rp.pkt);
+}
+
+/* Purges the first GOP, up to the second keyframe in the index */
+static inline void purge(struct mp4_replay_buffer *rb)
+{
+	uint64_t end = rb->first_seq + rb->packets.size / sizeof(struct replay_packet);
+
+	if (num_keyframes(rb) > 1) {
+		uint64_t seq;
+		deque_pop_front(&rb->keyframes, NULL, sizeof(seq));
+		deque_peek_front(&rb->keyframes, &seq, sizeof(seq));
+		end = seq;
+	} else {
+		deque_free(&rb->keyframes);
+	}
+
+	while (rb->first_seq < end)
+		purge_front(rb);
+}
+
+static inline void mp4_replay_buffer_purge(struct mp4_replay_buffer *rb, struct encoder_packet *pkt)
+{
+	if (rb->max_size) {
+		if (!rb->packets.size || num_keyframes(rb) <= 2)
+			return;
+
+		while ((rb->cur_size + (int64_t)pkt->size) > rb->max_size && num_keyframes(rb) > 2)
+			purge(rb);
+	}
+
+	if (!rb->packets.size || num_keyframes(rb) <= 2)
+		return;
+
+	while ((pkt->dts_usec - rb->cur_time) > rb->max_time && num_keyframes(rb) > 2)
+		purge(rb);
+}
+
+/* Moves the oldest packets in memory to the ring until the memory limit is
+ * met.  The newest packet always stays in memory.  If the ring is full (a
+ * save is still reading from it), packets stay in memory for now. */
+static void spill_packets(struct mp4_replay_buffer *rb)
+{
+	size_t num_packets = rb->packets.size / sizeof(struct replay_packet);
+
+	while (rb->hot_size > rb->max_hot_size && rb->num_spilled + 1 < num_packets) {
+		struct replay_packet *rp = deque_data(&rb->packets, rb->num_spilled * sizeof(struct replay_packet));
+
+		if (!replay_ring_write(&rb->ring, rp->pkt.data, rp->pkt.size, &rp->ring_pos))
+			break;
+
+		rb->hot_size -= (int64_t)rp->pkt.size;
+		rb->num_spilled++;
+
+		struct encoder_packet spilled = rp->pkt;
+		obs_encoder_packet_release(&rp->pkt);
+		rp->pkt = spilled;
+		rp->pkt.data = NULL;
+		rp->spilled = true;
+	}
+}
+
+static void mp4_replay_buffer_packet(void *data, struct encoder_packet *packet)
+{
+	struct mp4_replay_buffer *rb = data;
+	struct replay_packet rp = {0};
+	struct encoder_packet *pkt = &rp.pkt;
+
+	if (!active(rb))
+		return;
+
+	/* encoder failure */
+	if (!packet) {
+		deactivate(rb, OBS_OUTPUT_ENCODE_ERROR);
+		return;
+	}
+
+	if (stopping(rb) && packet->sys_dts_usec >= rb->stop_ts) {
+		deactivate(rb, 0);
+		return;
+	}
+
+	mp4_replay_buffer_purge(rb, packet);
+
+	obs_encoder_packet_ref(pkt, packet);
+
+	if (!rb->packets.size)
+		rb->cur_time = pkt->dts_usec;
+	rb->cur_size += pkt->size;
+	rb->hot_size += pkt->size;
+	rb->total_bytes += pkt->size;
+
+	if (pkt->type == OBS_ENCODER_VIDEO && pkt->keyframe) {
+		uint64_t seq = rb->first_seq + rb->packets.size / sizeof(struct replay_packet);
+		deque_push_back(&rb->keyframes, &seq, sizeof(seq));
+	}
+
+	deque_push_back(&rb->packets, &rp, sizeof(rp));
+
+	if (replay_ring_active(&rb->ring))
+		spill_packets(rb);
+
+	if (rb->save_ts && pkt->sys_dts_usec >= rb->save_ts) {
+		/* Keep the request pending until the previous save is done */
+		if (os_atomic_load_bool(&rb->saving))
+			return;
+
+		if (rb->save_thread_joinable) {
+			pthread_join(rb->save_thread, NULL);
+			rb->save_thread_joinable = false;
+		}
+
+		rb->save_ts = 0;
+		mp4_replay_buffer_save(rb);
+	}
+}
+
+static uint64_t mp4_replay_buffer_total_bytes(void *data)
+{
+	struct mp4_replay_buffer *rb = data;
+	return rb->total_bytes;
+}
+
+static void mp4_replay_buffer_defaults(obs_data_t *s)
+{
+	obs_data_set_default_int(s, "max_time_sec", 15);
+	obs_data_set_default_int(s, "max_size_mb", 500);
+	obs_data_set_default_string(s, "format", "%CCYY-%MM-%DD %hh-%mm-%ss");
+	obs_data_set_default_string(s, "extension", "mp4");
+	obs_data_set_default_bool(s, "allow_spaces", true);
+	obs_data_set_default_bool(s, "spill_to_disk", false);
+	obs_data_set_default_int(s, "memory_mb", 64);
+}
+
+struct obs_output_info mp4_replay_buffer_info = {
+	.id = "mp4_replay_buffer",
+	.flags = OBS_OUTPUT_AV | OBS_OUTPUT_ENCODED | OBS_OUTPUT_MULTI_TRACK_AV | OBS_OUTPUT_CAN_PAUSE,
+	.encoded_video_codecs = "h264;hevc;av1",
+	.encoded_audio_codecs = "aac",
+	.get_name = mp4_replay_buffer_name,
+	.create = mp4_replay_buffer_create,
+	.destroy = mp4_replay_buffer_destroy,
+	.start = mp4_replay_buffer_start,
+	.stop = mp4_replay_buffer_stop,
+	.encoded_packet = mp4_replay_buffer_packet,
+	.get_total_bytes = mp4_replay_buffer_total_bytes,
+	.get_defaults = mp4_replay_buffer_defaults,
+};
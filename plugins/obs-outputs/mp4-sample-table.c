@@ -0,0 +1,143 @@
+/******************************************************************************
+    Copyright (C) 2024 by Dennis Sädtler <dennis@obsproject.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include "mp4-sample-table.h"
+#include "temp-file.h"
+
+#include <util/base.h>
+#include <util/platform.h>
+
+void sample_table_init(struct sample_table *table, const char *spill_dir)
+{
+	memset(table, 0, sizeof(struct sample_table));
+	table->spill_dir = spill_dir;
+}
+
+void sample_table_free(struct sample_table *table)
+{
+	if (table->file)
+		fclose(table->file);
+
+	da_free(table->data);
+	memset(table, 0, sizeof(struct sample_table));
+}
+
+static void sample_table_spill(struct sample_table *table)
+{
+	if (!table->file) {
+		table->file = temp_file_create(table->spill_dir, "sample-table");
+
+		if (!table->file) {
+			blog(LOG_WARNING, "[mp4 muxer] Failed to create temporary file "
+					  "for sample table in '%s', keeping it in memory",
+			     table->spill_dir);
+			table->spill_dir = NULL;
+			return;
+		}
+	}
+
+	os_fseeki64(table->file, 0, SEEK_END);
+
+	if (fwrite(table->data.array, 1, table->data.num, table->file) != table->data.num) {
+		blog(LOG_WARNING, "[mp4 muxer] Failed to write sample table to "
+				  "temporary file, keeping it in memory");
+		os_fseeki64(table->file, (int64_t)table->file_size, SEEK_SET);
+		table->spill_dir = NULL;
+		return;
+	}
+
+	table->file_size += table->data.num;
+	da_resize(table->data, 0);
+}
+
+void sample_table_push(struct sample_table *table, uint64_t val)
+{
+	uint8_t bytes[10];
+	size_t size = 0;
+
+	do {
+		uint8_t byte = val & 0x7F;
+		val >>= 7;
+		if (val)
+			byte |= 0x80;
+		bytes[size++] = byte;
+	} while (val);
+
+	da_push_back_array(table->data, bytes, size);
+	table->num++;
+
+	if (table->spill_dir && table->data.num >= SAMPLE_TABLE_SPILL_SIZE)
+		sample_table_spill(table);
+}
+
+void sample_table_reader_init(struct sample_table_reader *reader, const struct sample_table *table)
+{
+	reader->table = table;
+	reader->file_pos = 0;
+	reader->data_pos = 0;
+	reader->buf_pos = 0;
+	reader->buf_size = 0;
+}
+
+static inline bool sample_table_read_byte(struct sample_table_reader *reader, uint8_t *byte)
+{
+	const struct sample_table *table = reader->table;
+
+	if (reader->file_pos < table->file_size) {
+		if (reader->buf_pos == reader->buf_size) {
+			uint64_t remaining = table->file_size - reader->file_pos;
+			size_t size = remaining < sizeof(reader->buf) ? (size_t)remaining : sizeof(reader->buf);
+
+			os_fseeki64(table->file, (int64_t)reader->file_pos, SEEK_SET);
+			reader->buf_size = fread(reader->buf, 1, size, table->file);
+			reader->buf_pos = 0;
+
+			if (!reader->buf_size)
+				return false;
+		}
+
+		*byte = reader->buf[reader->buf_pos++];
+		if (reader->buf_pos == reader->buf_size) {
+			reader->file_pos += reader->buf_size;
+			reader->buf_pos = reader->buf_size = 0;
+		}
+		return true;
+	}
+
+	if (reader->data_pos < table->data.num) {
+		*byte = table->data.array[reader->data_pos++];
+		return true;
+	}
+
+	return false;
+}
+
+uint64_t sample_table_read(struct sample_table_reader *reader)
+{
+	uint64_t val = 0;
+	unsigned shift = 0;
+	uint8_t byte;
+
+	while (shift < 64 && sample_table_read_byte(reader, &byte)) {
+		val |= (uint64_t)(byte & 0x7F) << shift;
+		if (!(byte & 0x80))
+			break;
+		shift += 7;
+	}
+
+	return val;
+}
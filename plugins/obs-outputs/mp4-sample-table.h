@@ -0,0 +1,85 @@
+/******************************************************************************
+    Copyright (C) 2024 by Dennis Sädtler <dennis@obsproject.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+#include <stdio.h>
+
+#include <util/c99defs.h>
+#include <util/darray.h>
+
+/*
+ * Append-only list of integers for the sample tables of a track.
+ *
+ * Values are stored as variable length integers (7 bits per byte), so the
+ * small numbers that make up most of the tables (size differences between
+ * samples, run lengths, keyframe distances) only take one or two bytes.
+ * Callers encode the values as differences/runs where that makes them small.
+ *
+ * With a spill directory, the encoded data is moved to a temporary file in
+ * it every SAMPLE_TABLE_SPILL_SIZE bytes, so memory use stays the same no
+ * matter how long the recording is.  Tables are only read back in order, when
+ * the moov is written.
+ */
+
+#define SAMPLE_TABLE_SPILL_SIZE (256 * 1024)
+
+struct sample_table {
+	DARRAY(uint8_t) data;
+	/* Number of values in the table */
+	uint64_t num;
+
+	/* Not owned by the table, NULL to keep everything in memory */
+	const char *spill_dir;
+	FILE *file;
+	uint64_t file_size;
+};
+
+struct sample_table_reader {
+	const struct sample_table *table;
+	uint64_t file_pos;
+	size_t data_pos;
+
+	uint8_t buf[4096];
+	size_t buf_pos;
+	size_t buf_size;
+};
+
+void sample_table_init(struct sample_table *table, const char *spill_dir);
+void sample_table_free(struct sample_table *table);
+void sample_table_push(struct sample_table *table, uint64_t val);
+
+/* Bytes of memory used by the table */
+static inline size_t sample_table_memory(const struct sample_table *table)
+{
+	return table->data.capacity;
+}
+
+static inline void sample_table_push_signed(struct sample_table *table, int64_t val)
+{
+	/* zigzag encoding, so that small negative values stay small */
+	sample_table_push(table, ((uint64_t)val << 1) ^ (uint64_t)(val >> 63));
+}
+
+void sample_table_reader_init(struct sample_table_reader *reader, const struct sample_table *table);
+uint64_t sample_table_read(struct sample_table_reader *reader);
+
+static inline int64_t sample_table_read_signed(struct sample_table_reader *reader)
+{
+	uint64_t val = sample_table_read(reader);
+	return (int64_t)(val >> 1) ^ -(int64_t)(val & 1);
+}
@@ -16,6 +16,10 @@ extern struct obs_output_info rtmp_output_info;
 extern struct obs_output_info null_output_info;
 extern struct obs_output_info flv_output_info;
 extern struct obs_output_info mp4_output_info;
+extern struct obs_output_info mp4_replay_buffer_info;
+#ifdef __linux__
+extern struct obs_output_info rtmp_multi_output_info;
+#endif
 
 #if defined(_WIN32) && defined(MBEDTLS_THREADING_ALT)
 void mbed_mutex_init(mbedtls_threading_mutex_t *m)
@@ -63,6 +67,10 @@ bool obs_module_load(void)
 	obs_register_output(&null_output_info);
 	obs_register_output(&flv_output_info);
 	obs_register_output(&mp4_output_info);
+	obs_register_output(&mp4_replay_buffer_info);
+#ifdef __linux__
+	obs_register_output(&rtmp_multi_output_info);
+#endif
 	return true;
 }
 
@@ -0,0 +1,140 @@
+/******************************************************************************
+    Copyright (C) 2024 by Dennis Sädtler <dennis@obsproject.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include "replay-ring.h"
+#include "temp-file.h"
+
+#include <inttypes.h>
+#include <string.h>
+
+#include <util/base.h>
+#include <util/platform.h>
+
+bool replay_ring_init(struct replay_ring *ring, const char *dir, uint64_t size)
+{
+	memset(ring, 0, sizeof(struct replay_ring));
+
+	if (!size || pthread_mutex_init(&ring->mutex, NULL) != 0)
+		return false;
+
+	ring->file = temp_file_create(dir, "replay-ring");
+	if (!ring->file) {
+		blog(LOG_WARNING, "[replay ring] Failed to create temporary file in '%s'", dir);
+		goto fail;
+	}
+
+	/* Allocate the whole file up front, so that running out of disk space
+	 * shows up now rather than while recording. */
+	if (!temp_file_allocate(ring->file, size)) {
+		blog(LOG_WARNING, "[replay ring] Failed to allocate %" PRIu64 " MiB in '%s'", size / (1024 * 1024),
+		     dir);
+		fclose(ring->file);
+		ring->file = NULL;
+		goto fail;
+	}
+
+	ring->size = size;
+	return true;
+
+fail:
+	pthread_mutex_destroy(&ring->mutex);
+	return false;
+}
+
+void replay_ring_free(struct replay_ring *ring)
+{
+	if (!ring->file)
+		return;
+
+	fclose(ring->file);
+	pthread_mutex_destroy(&ring->mutex);
+	memset(ring, 0, sizeof(struct replay_ring));
+}
+
+/* Splits an access at the end of the file into two */
+static bool ring_io(struct replay_ring *ring, uint64_t pos, uint8_t *data, size_t size, bool write)
+{
+	while (size) {
+		uint64_t offset = pos % ring->size;
+		size_t part = (size_t)(ring->size - offset < size ? ring->size - offset : size);
+
+		if (os_fseeki64(ring->file, (int64_t)offset, SEEK_SET) != 0)
+			return false;
+		if (write ? fwrite(data, 1, part, ring->file) != part : fread(data, 1, part, ring->file) != part)
+			return false;
+
+		pos += part;
+		data += part;
+		size -= part;
+	}
+
+	return true;
+}
+
+bool replay_ring_write(struct replay_ring *ring, const void *data, size_t size, uint64_t *pos)
+{
+	bool success = false;
+
+	pthread_mutex_lock(&ring->mutex);
+
+	uint64_t oldest = ring->pinned && ring->pin < ring->tail ? ring->pin : ring->tail;
+
+	if (ring->head + size - oldest <= ring->size) {
+		success = ring_io(ring, ring->head, (uint8_t *)data, size, true);
+		if (success) {
+			*pos = ring->head;
+			ring->head += size;
+		}
+	}
+
+	pthread_mutex_unlock(&ring->mutex);
+	return success;
+}
+
+bool replay_ring_read(struct replay_ring *ring, uint64_t pos, void *data, size_t size)
+{
+	pthread_mutex_lock(&ring->mutex);
+
+	/* Writes go through the same FILE, flush them before reading */
+	bool success = fflush(ring->file) == 0 && ring_io(ring, pos, data, size, false);
+
+	pthread_mutex_unlock(&ring->mutex);
+	return success;
+}
+
+void replay_ring_release(struct replay_ring *ring, uint64_t pos)
+{
+	pthread_mutex_lock(&ring->mutex);
+	if (pos > ring->tail)
+		ring->tail = pos;
+	pthread_mutex_unlock(&ring->mutex);
+}
+
+void replay_ring_pin(struct replay_ring *ring, uint64_t pos)
+{
+	pthread_mutex_lock(&ring->mutex);
+	ring->pinned = true;
+	ring->pin = pos;
+	pthread_mutex_unlock(&ring->mutex);
+}
+
+void replay_ring_unpin(struct replay_ring *ring)
+{
+	pthread_mutex_lock(&ring->mutex);
+	ring->pinned = false;
+	pthread_mutex_unlock(&ring->mutex);
+}
@@ -0,0 +1,70 @@
+/******************************************************************************
+    Copyright (C) 2024 by Dennis Sädtler <dennis@obsproject.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+#include <stdio.h>
+
+#include <util/c99defs.h>
+#include <util/threading.h>
+
+/*
+ * Fixed-size ring buffer in a temporary file, for packet data the replay
+ * buffer moves out of memory.  The file is created in the given directory
+ * and all of its space is reserved up front.
+ *
+ * Positions are logical byte offsets that only ever grow, the position in the
+ * file is the position modulo the size of the ring.  Data is written at the
+ * head and released from the tail in the same order.  A reader (the save
+ * thread) can pin a position, so that data from there on is not overwritten
+ * even if it has been released in the meantime.
+ *
+ * Writing happens on the packet thread and reading on the save thread, file
+ * access is serialised with the mutex.
+ */
+
+struct replay_ring {
+	FILE *file;
+	uint64_t size;
+
+	uint64_t head;
+	uint64_t tail;
+
+	bool pinned;
+	uint64_t pin;
+
+	pthread_mutex_t mutex;
+};
+
+bool replay_ring_init(struct replay_ring *ring, const char *dir, uint64_t size);
+void replay_ring_free(struct replay_ring *ring);
+
+/* Returns false if there is not enough free space in the ring */
+bool replay_ring_write(struct replay_ring *ring, const void *data, size_t size, uint64_t *pos);
+bool replay_ring_read(struct replay_ring *ring, uint64_t pos, void *data, size_t size);
+
+/* Releases all data before the given position */
+void replay_ring_release(struct replay_ring *ring, uint64_t pos);
+
+/* Keeps data from the given position on, until unpinned */
+void replay_ring_pin(struct replay_ring *ring, uint64_t pos);
+void replay_ring_unpin(struct replay_ring *ring);
+
+static inline bool replay_ring_active(const struct replay_ring *ring)
+{
+	return ring->file != NULL;
+}
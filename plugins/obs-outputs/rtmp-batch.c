@@ -0,0 +1,323 @@
+/******************************************************************************
+    Copyright (C) 2023 by Lain Bailey <lain@obsproject.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#ifndef _WIN32
+#include "rtmp-batch.h"
+
+#include <errno.h>
+#include <netinet/in.h>
+
+#if defined(__linux__) && defined(MSG_ZEROCOPY) && defined(SO_ZEROCOPY)
+#include <linux/errqueue.h>
+#define HAVE_ZEROCOPY
+#endif
+
+/* below this the kernel copies anyway, and the completion costs more than
+ * the copy would */
+#define ZEROCOPY_MIN_SIZE (16 * 1024)
+
+#define FLV_TAG_HEADER_SIZE 11
+
+/* either bytes in the headers buffer, or packet data */
+struct rtmp_batch_part {
+	const uint8_t *data;
+	size_t offset;
+	size_t size;
+};
+
+/* a batch sent with MSG_ZEROCOPY, kept until the kernel is done with it */
+struct rtmp_batch_pending {
+	uint32_t end_id;
+	DARRAY(uint8_t) headers;
+	DARRAY(struct encoder_packet) packets;
+};
+
+static void release_packets(struct encoder_packet *packets, size_t num)
+{
+	for (size_t i = 0; i < num; i++)
+		obs_encoder_packet_release(&packets[i]);
+}
+
+bool rtmp_batch_init(struct rtmp_batch *batch, RTMP *rtmp, bool zerocopy)
+{
+	memset(batch, 0, sizeof(*batch));
+	batch->rtmp = rtmp;
+	array_output_serializer_init(&batch->tag, &batch->tag_data);
+
+#ifdef HAVE_ZEROCOPY
+	if (zerocopy) {
+		int one = 1;
+		if (setsockopt(rtmp->m_sb.sb_socket, SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one)) == 0) {
+			batch->zerocopy = true;
+		} else {
+			blog(LOG_WARNING, "[rtmp batch] MSG_ZEROCOPY not supported (%d), copying instead", errno);
+		}
+	}
+#else
+	UNUSED_PARAMETER(zerocopy);
+#endif
+
+	return true;
+}
+
+static void free_pending(struct rtmp_batch *batch, struct rtmp_batch_pending *pending)
+{
+	release_packets(pending->packets.array, pending->packets.num);
+
+	/* reuse the buffers if the batch has none */
+	if (!batch->headers.capacity) {
+		da_clear(pending->headers);
+		da_move(batch->headers, pending->headers);
+	}
+	if (!batch->packets.capacity) {
+		da_clear(pending->packets);
+		da_move(batch->packets, pending->packets);
+	}
+
+	da_free(pending->headers);
+	da_free(pending->packets);
+}
+
+void rtmp_batch_free(struct rtmp_batch *batch)
+{
+	/* the socket is closed by now, whatever the kernel still holds is
+	 * pinned by it and not affected by freeing the packets */
+	while (batch->pending.size) {
+		struct rtmp_batch_pending pending;
+		deque_pop_front(&batch->pending, &pending, sizeof(pending));
+		free_pending(batch, &pending);
+	}
+	deque_free(&batch->pending);
+
+	release_packets(batch->packets.array, batch->packets.num);
+
+	array_output_serializer_free(&batch->tag_data);
+	da_free(batch->headers);
+	da_free(batch->parts);
+	da_free(batch->packets);
+	da_free(batch->iov);
+	memset(batch, 0, sizeof(*batch));
+}
+
+struct serializer *rtmp_batch_tag(struct rtmp_batch *batch)
+{
+	array_output_serializer_reset(&batch->tag_data);
+	return &batch->tag;
+}
+
+static void add_bytes(struct rtmp_batch *batch, const void *data, size_t size)
+{
+	struct rtmp_batch_part *last = batch->parts.num ? da_end(batch->parts) : NULL;
+	size_t offset = batch->headers.num;
+
+	da_push_back_array(batch->headers, (const uint8_t *)data, size);
+	batch->size += size;
+
+	if (last && !last->data && last->offset + last->size == offset) {
+		last->size += size;
+	} else {
+		struct rtmp_batch_part *part = da_push_back_new(batch->parts);
+		part->offset = offset;
+		part->size = size;
+	}
+}
+
+static void add_data(struct rtmp_batch *batch, const uint8_t *data, size_t size)
+{
+	struct rtmp_batch_part *part = da_push_back_new(batch->parts);
+	part->data = data;
+	part->size = size;
+	batch->size += size;
+}
+
+struct chunker {
+	size_t chunk_size;
+	size_t left;
+	char cont_header[8];
+	int cont_size;
+};
+
+/* splits message body data into chunks, with a type 3 header in front of
+ * every chunk after the first one */
+static void add_body(struct rtmp_batch *batch, struct chunker *c, const uint8_t *data, size_t size, bool copy)
+{
+	while (size) {
+		if (!c->left) {
+			add_bytes(batch, c->cont_header, (size_t)c->cont_size);
+			c->left = c->chunk_size;
+		}
+
+		size_t part = size < c->left ? size : c->left;
+
+		if (copy)
+			add_bytes(batch, data, part);
+		else
+			add_data(batch, data, part);
+
+		data += part;
+		size -= part;
+		c->left -= part;
+	}
+}
+
+bool rtmp_batch_add(struct rtmp_batch *batch, struct encoder_packet *packet)
+{
+	const uint8_t *tag = batch->tag_data.bytes.array;
+	size_t tag_size = batch->tag_data.bytes.num;
+	char header[RTMP_MAX_HEADER_SIZE];
+	struct chunker c = {0};
+	uint32_t body_size;
+	int header_size = 0;
+
+	/* packets without data don't get a tag, and RTMP_Write() sends
+	 * nothing for them either */
+	if (!tag_size) {
+		obs_encoder_packet_release(packet);
+		return true;
+	}
+
+	if (tag_size >= FLV_TAG_HEADER_SIZE)
+		header_size = RTMP_EncodeTagHeader(batch->rtmp, (const char *)tag, 0, header, c.cont_header,
+						   &c.cont_size, &body_size);
+
+	if (!header_size || body_size != tag_size - FLV_TAG_HEADER_SIZE + packet->size) {
+		blog(LOG_ERROR, "[rtmp batch] Invalid FLV tag");
+		obs_encoder_packet_release(packet);
+		return false;
+	}
+
+	c.chunk_size = (size_t)batch->rtmp->m_outChunkSize;
+	c.left = c.chunk_size;
+
+	add_bytes(batch, header, (size_t)header_size);
+	add_body(batch, &c, tag + FLV_TAG_HEADER_SIZE, tag_size - FLV_TAG_HEADER_SIZE, true);
+	add_body(batch, &c, packet->data, packet->size, false);
+
+	da_push_back(batch->packets, packet);
+	return true;
+}
+
+#ifdef HAVE_ZEROCOPY
+/* releases every pending batch whose sends all have completed, ids are
+ * completed in order on TCP */
+static void release_completed(struct rtmp_batch *batch, uint32_t completed)
+{
+	while (batch->pending.size) {
+		struct rtmp_batch_pending *pending = deque_data(&batch->pending, 0);
+		if ((int32_t)(pending->end_id - completed) > 0)
+			break;
+
+		struct rtmp_batch_pending front;
+		deque_pop_front(&batch->pending, &front, sizeof(front));
+		free_pending(batch, &front);
+	}
+}
+
+static void read_completions(struct rtmp_batch *batch)
+{
+	for (;;) {
+		char control[128];
+		struct msghdr msg = {0};
+		struct cmsghdr *cmsg;
+
+		msg.msg_control = control;
+		msg.msg_controllen = sizeof(control);
+
+		if (recvmsg(batch->rtmp->m_sb.sb_socket, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0)
+			break;
+
+		for (cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+			struct sock_extended_err *err;
+
+			if (!(cmsg->cmsg_level == IPPROTO_IP && cmsg->cmsg_type == IP_RECVERR) &&
+			    !(cmsg->cmsg_level == IPPROTO_IPV6 && cmsg->cmsg_type == IPV6_RECVERR))
+				continue;
+
+			err = (struct sock_extended_err *)CMSG_DATA(cmsg);
+			if (err->ee_errno != 0 || err->ee_origin != SO_EE_ORIGIN_ZEROCOPY)
+				continue;
+
+			/* the kernel had to copy anyway (loopback, or a device
+			 * without scatter-gather), so stop asking */
+			if (batch->zerocopy && (err->ee_code & SO_EE_CODE_ZEROCOPY_COPIED)) {
+				blog(LOG_INFO, "[rtmp batch] MSG_ZEROCOPY falls back to copying, disabling it");
+				batch->zerocopy = false;
+			}
+
+			release_completed(batch, err->ee_data + 1);
+		}
+	}
+}
+#endif
+
+static void reset_batch(struct rtmp_batch *batch)
+{
+	da_clear(batch->headers);
+	da_clear(batch->parts);
+	da_clear(batch->packets);
+	batch->size = 0;
+}
+
+int rtmp_batch_send(struct rtmp_batch *batch)
+{
+	int size = (int)batch->size;
+	int flags = 0;
+	int calls;
+
+	if (!batch->parts.num)
+		return 0;
+
+	da_resize(batch->iov, batch->parts.num);
+	for (size_t i = 0; i < batch->parts.num; i++) {
+		struct rtmp_batch_part *part = &batch->parts.array[i];
+		struct iovec *iov = &batch->iov.array[i];
+
+		iov->iov_base = part->data ? (void *)part->data : batch->headers.array + part->offset;
+		iov->iov_len = part->size;
+	}
+
+#ifdef HAVE_ZEROCOPY
+	if (batch->zerocopy && batch->size >= ZEROCOPY_MIN_SIZE)
+		flags |= MSG_ZEROCOPY;
+#endif
+
+	calls = RTMP_Writev(batch->rtmp, batch->iov.array, (int)batch->iov.num, flags);
+
+#ifdef HAVE_ZEROCOPY
+	if (calls > 0) {
+		struct rtmp_batch_pending pending = {0};
+
+		batch->zerocopy_next_id += (uint32_t)calls;
+		pending.end_id = batch->zerocopy_next_id;
+		da_move(pending.headers, batch->headers);
+		da_move(pending.packets, batch->packets);
+		deque_push_back(&batch->pending, &pending, sizeof(pending));
+	}
+#endif
+
+	release_packets(batch->packets.array, batch->packets.num);
+	reset_batch(batch);
+
+#ifdef HAVE_ZEROCOPY
+	if (batch->pending.size)
+		read_completions(batch);
+#endif
+
+	return calls < 0 ? -1 : size;
+}
+
+#endif
@@ -0,0 +1,89 @@
+/******************************************************************************
+    Copyright (C) 2023 by Lain Bailey <lain@obsproject.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+#ifndef _WIN32
+
+#include <obs-module.h>
+#include <util/darray.h>
+#include <util/deque.h>
+#include <util/serializer.h>
+#include <util/array-serializer.h>
+#include <sys/uio.h>
+
+#include "librtmp/rtmp.h"
+
+/*
+ * Sends several packets with one system call, without copying their data.
+ *
+ * RTMP_Write() copies every FLV tag into a buffer of its own, and
+ * RTMP_SendPacket() then writes each chunk of it to the socket separately.
+ * Here the chunk headers and the bytes in front of the packet data are
+ * written to a small buffer instead, and the packet data is referenced in
+ * place, so that the whole batch goes out with a single sendmsg().
+ *
+ * With MSG_ZEROCOPY the kernel sends straight from the packet data as well.
+ * The packets are then kept until the kernel reports that it is done with
+ * them, which is checked after every send.
+ *
+ * Only for plain TCP on the send thread, not for RTMPS or HTTP tunnelling.
+ */
+
+#define RTMP_BATCH_MAX_SIZE (1024 * 1024)
+#define RTMP_BATCH_MAX_PACKETS 64
+
+struct rtmp_batch_part;
+
+struct rtmp_batch {
+	RTMP *rtmp;
+
+	/* FLV tag of the packet being added */
+	struct array_output_data tag_data;
+	struct serializer tag;
+
+	/* chunk headers and other small bytes, parts refer to them by offset */
+	DARRAY(uint8_t) headers;
+	DARRAY(struct rtmp_batch_part) parts;
+	DARRAY(struct encoder_packet) packets;
+	DARRAY(struct iovec) iov;
+	size_t size;
+
+	bool zerocopy;
+	uint32_t zerocopy_next_id;
+	struct deque pending;
+};
+
+bool rtmp_batch_init(struct rtmp_batch *batch, RTMP *rtmp, bool zerocopy);
+void rtmp_batch_free(struct rtmp_batch *batch);
+
+/* Returns an empty serializer for the FLV tag of the next packet, which
+ * stops right in front of the packet data (see flv_packet_mux_header()) */
+struct serializer *rtmp_batch_tag(struct rtmp_batch *batch);
+
+/* Adds the packet with the tag written above, and takes the reference to it */
+bool rtmp_batch_add(struct rtmp_batch *batch, struct encoder_packet *packet);
+
+/* Returns the number of bytes sent, or -1 if the connection failed */
+int rtmp_batch_send(struct rtmp_batch *batch);
+
+static inline bool rtmp_batch_full(const struct rtmp_batch *batch)
+{
+	return batch->size >= RTMP_BATCH_MAX_SIZE || batch->packets.num >= RTMP_BATCH_MAX_PACKETS;
+}
+
+#endif
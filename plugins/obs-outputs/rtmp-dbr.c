@@ -0,0 +1,327 @@
+/******************************************************************************
+    Copyright (C) 2023 by Lain Bailey <lain@obsproject.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include "rtmp-dbr.h"
+
+#include <string.h>
+
+#ifdef __linux__
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <linux/tcp.h>
+#endif
+
+#define MSEC_TO_NSEC 1000000ULL
+#define SEC_TO_NSEC 1000000000ULL
+
+/* windows of the filters */
+#define BW_WINDOW_NS (2000ULL * MSEC_TO_NSEC)
+#define BW_SHORT_WINDOW_NS (500ULL * MSEC_TO_NSEC)
+#define MIN_RTT_WINDOW_NS (10000ULL * MSEC_TO_NSEC)
+#define SEND_MIN_WINDOW_NS (1000ULL * MSEC_TO_NSEC)
+#define SEND_MAX_WINDOW_NS (2000ULL * MSEC_TO_NSEC)
+
+/* queueing delay that lowers the bitrate, and below which it may go up */
+#define DECREASE_TRIGGER_USEC 200000
+#define INCREASE_TRIGGER_USEC 50000
+
+#define DECREASE_INTERVAL_NS (500ULL * MSEC_TO_NSEC)
+#define PROBE_INTERVAL_NS (1000ULL * MSEC_TO_NSEC)
+#define PROBE_HOLD_NS (2000ULL * MSEC_TO_NSEC)
+
+#define MIN_BITRATE 50
+
+/* pace at 1.25x the bandwidth, like BBR's probing gain, but never below
+ * twice the stream's bitrate so pacing alone can't build a queue */
+#define PACING_GAIN_NUM 5
+#define PACING_GAIN_DEN 4
+#define PACING_BURST_NS (10ULL * MSEC_TO_NSEC)
+#define PACING_MAX_SLEEP_NS (100ULL * MSEC_TO_NSEC)
+
+struct bw_sample {
+	uint64_t ts;
+	uint64_t rate;
+	bool app_limited;
+};
+
+struct send_sample {
+	uint64_t beg;
+	uint64_t end;
+	size_t size;
+};
+
+void dbr_estimator_init(struct dbr_estimator *dbr, long orig_bitrate, long audio_bitrate, uint64_t now)
+{
+	memset(dbr, 0, sizeof(*dbr));
+	dbr->orig_bitrate = orig_bitrate;
+	dbr->audio_bitrate = audio_bitrate;
+	dbr->cur_bitrate = orig_bitrate;
+	dbr->next_probe_ts = now + PROBE_INTERVAL_NS;
+}
+
+void dbr_estimator_free(struct dbr_estimator *dbr)
+{
+	deque_free(&dbr->bw_samples);
+	deque_free(&dbr->sends);
+}
+
+static void prune_bw_samples(struct dbr_estimator *dbr, uint64_t now)
+{
+	struct bw_sample *front;
+
+	while (dbr->bw_samples.size) {
+		front = deque_data(&dbr->bw_samples, 0);
+		if (front->ts + BW_WINDOW_NS > now)
+			break;
+		deque_pop_front(&dbr->bw_samples, NULL, sizeof(*front));
+	}
+}
+
+static void add_bw_sample(struct dbr_estimator *dbr, uint64_t ts, uint64_t rate, bool app_limited)
+{
+	struct bw_sample sample = {ts, rate, app_limited};
+
+	prune_bw_samples(dbr, ts);
+	if (rate)
+		deque_push_back(&dbr->bw_samples, &sample, sizeof(sample));
+}
+
+static void add_rtt_sample(struct dbr_estimator *dbr, uint64_t ts, uint32_t rtt_usec)
+{
+	if (!rtt_usec)
+		return;
+
+	if (!dbr->min_rtt_usec || rtt_usec <= dbr->min_rtt_usec || ts >= dbr->min_rtt_ts + MIN_RTT_WINDOW_NS) {
+		dbr->min_rtt_usec = rtt_usec;
+		dbr->min_rtt_ts = ts;
+	}
+
+	if (dbr->srtt_usec)
+		dbr->srtt_usec = (dbr->srtt_usec * 7 + rtt_usec) / 8;
+	else
+		dbr->srtt_usec = rtt_usec;
+}
+
+void dbr_estimator_add_sample(struct dbr_estimator *dbr, const struct dbr_sample *sample)
+{
+	dbr->have_socket_samples = true;
+	dbr->notsent_bytes = sample->notsent_bytes;
+
+	add_bw_sample(dbr, sample->ts, sample->delivery_rate, sample->app_limited);
+	add_rtt_sample(dbr, sample->ts, sample->rtt_usec);
+}
+
+/* Without socket statistics, the rate at which sends complete over the last
+ * couple of seconds is used instead.  If the sends barely blocked, the socket
+ * took everything the stream had to give, so the rate is app limited. */
+void dbr_estimator_add_send(struct dbr_estimator *dbr, uint64_t beg, uint64_t end, size_t size)
+{
+	struct send_sample back = {beg, end, size};
+	struct send_sample *front;
+	uint64_t dur;
+
+	if (dbr->have_socket_samples)
+		return;
+
+	deque_push_back(&dbr->sends, &back, sizeof(back));
+	dbr->sends_size += size;
+	dbr->sends_blocked_ns += end - beg;
+
+	front = deque_data(&dbr->sends, 0);
+	while (end - front->beg > SEND_MAX_WINDOW_NS && dbr->sends.size > sizeof(*front)) {
+		dbr->sends_size -= front->size;
+		dbr->sends_blocked_ns -= front->end - front->beg;
+		deque_pop_front(&dbr->sends, NULL, sizeof(*front));
+		front = deque_data(&dbr->sends, 0);
+	}
+
+	dur = end - front->beg;
+	if (dur < SEND_MIN_WINDOW_NS)
+		return;
+
+	add_bw_sample(dbr, end, dbr->sends_size * 8 * SEC_TO_NSEC / dur, dbr->sends_blocked_ns < dur / 2);
+}
+
+static uint64_t max_bandwidth(struct dbr_estimator *dbr, uint64_t since, bool *saturated)
+{
+	size_t count = dbr->bw_samples.size / sizeof(struct bw_sample);
+	uint64_t max_rate = 0;
+
+	if (saturated)
+		*saturated = false;
+
+	for (size_t i = count; i > 0; i--) {
+		struct bw_sample *sample = deque_data(&dbr->bw_samples, (i - 1) * sizeof(*sample));
+		if (sample->ts < since)
+			break;
+		if (sample->rate > max_rate)
+			max_rate = sample->rate;
+		if (saturated && !sample->app_limited)
+			*saturated = true;
+	}
+
+	return max_rate;
+}
+
+uint64_t dbr_estimator_bandwidth(struct dbr_estimator *dbr, uint64_t now)
+{
+	prune_bw_samples(dbr, now);
+	return max_bandwidth(dbr, 0, NULL);
+}
+
+static inline uint64_t total_bitrate(struct dbr_estimator *dbr)
+{
+	return (uint64_t)(dbr->cur_bitrate + dbr->audio_bitrate) * 1000;
+}
+
+/* how long the data in the socket and on the network waits behind other data,
+ * on top of what is still buffered in the output */
+static int64_t network_queue_usec(struct dbr_estimator *dbr, uint64_t bandwidth)
+{
+	uint64_t drain_rate = bandwidth ? bandwidth : total_bitrate(dbr);
+	int64_t queue = 0;
+
+	if (dbr->srtt_usec > dbr->min_rtt_usec)
+		queue += dbr->srtt_usec - dbr->min_rtt_usec;
+	if (drain_rate)
+		queue += (int64_t)((uint64_t)dbr->notsent_bytes * 8 * 1000000 / drain_rate);
+
+	return queue;
+}
+
+static inline long bits_to_video_kbps(struct dbr_estimator *dbr, uint64_t bits)
+{
+	return (long)(bits / 1000) - dbr->audio_bitrate;
+}
+
+long dbr_estimator_update(struct dbr_estimator *dbr, int64_t queue_usec, uint64_t now)
+{
+	uint64_t bandwidth, short_bandwidth;
+	long new_bitrate = dbr->cur_bitrate;
+	bool saturated;
+
+	prune_bw_samples(dbr, now);
+	bandwidth = max_bandwidth(dbr, 0, &saturated);
+	queue_usec += network_queue_usec(dbr, bandwidth);
+
+	if (queue_usec >= DECREASE_TRIGGER_USEC) {
+		if (now < dbr->last_decrease_ts + DECREASE_INTERVAL_NS)
+			return 0;
+
+		/* still draining after the last decrease */
+		if (queue_usec < dbr->last_decrease_queue_usec && now < dbr->last_decrease_ts + PROBE_HOLD_NS)
+			return 0;
+
+		/* drain the queue by going a bit below what the link has
+		 * delivered recently, which matters after the link slowed
+		 * down and the older samples are still higher */
+		short_bandwidth = max_bandwidth(dbr, now - BW_SHORT_WINDOW_NS, NULL);
+		if (!short_bandwidth)
+			short_bandwidth = bandwidth;
+
+		new_bitrate = dbr->cur_bitrate * 9 / 10;
+		if (short_bandwidth) {
+			long drain_bitrate = bits_to_video_kbps(dbr, short_bandwidth * 85 / 100);
+			if (drain_bitrate < new_bitrate)
+				new_bitrate = drain_bitrate;
+		}
+		if (new_bitrate < dbr->cur_bitrate / 2)
+			new_bitrate = dbr->cur_bitrate / 2;
+
+		dbr->last_decrease_ts = now;
+		dbr->last_decrease_queue_usec = queue_usec;
+		dbr->next_probe_ts = now + PROBE_HOLD_NS;
+
+	} else if (queue_usec < INCREASE_TRIGGER_USEC && now >= dbr->next_probe_ts) {
+		new_bitrate = dbr->cur_bitrate + dbr->orig_bitrate / 20;
+
+		/* don't go much past what the link has shown it can carry,
+		 * unless it was never the bottleneck */
+		if (saturated) {
+			long max_bitrate = bits_to_video_kbps(dbr, bandwidth * 11 / 10);
+			if (max_bitrate < new_bitrate)
+				new_bitrate = max_bitrate > dbr->cur_bitrate ? max_bitrate : dbr->cur_bitrate;
+		}
+
+		dbr->next_probe_ts = now + PROBE_INTERVAL_NS;
+	}
+
+	if (new_bitrate > dbr->orig_bitrate)
+		new_bitrate = dbr->orig_bitrate;
+	if (new_bitrate < MIN_BITRATE)
+		new_bitrate = MIN_BITRATE;
+
+	if (new_bitrate == dbr->cur_bitrate)
+		return 0;
+
+	dbr->cur_bitrate = new_bitrate;
+	return new_bitrate;
+}
+
+uint64_t dbr_estimator_pace(struct dbr_estimator *dbr, size_t size, uint64_t now)
+{
+	uint64_t rate = dbr_estimator_bandwidth(dbr, now) * PACING_GAIN_NUM / PACING_GAIN_DEN;
+	uint64_t min_rate = total_bitrate(dbr) * 2;
+
+	if (rate < min_rate)
+		rate = min_rate;
+	dbr->pacing_rate = rate;
+	if (!rate)
+		return now;
+
+	/* allow a small burst after being idle */
+	if (dbr->pace_next_ts + PACING_BURST_NS < now)
+		dbr->pace_next_ts = now - PACING_BURST_NS;
+
+	dbr->pace_next_ts += (uint64_t)size * 8 * SEC_TO_NSEC / rate;
+
+	if (dbr->pace_next_ts <= now)
+		return now;
+	if (dbr->pace_next_ts > now + PACING_MAX_SLEEP_NS)
+		return now + PACING_MAX_SLEEP_NS;
+	return dbr->pace_next_ts;
+}
+
+#ifdef __linux__
+bool dbr_socket_sample(int fd, uint64_t now, struct dbr_sample *sample)
+{
+	struct tcp_info info = {0};
+	socklen_t len = sizeof(info);
+
+	if (getsockopt(fd, IPPROTO_TCP, TCP_INFO, &info, &len) != 0)
+		return false;
+
+	/* kernels before 4.9 don't report the delivery rate */
+	if (len < offsetof(struct tcp_info, tcpi_delivery_rate) + sizeof(info.tcpi_delivery_rate))
+		return false;
+
+	sample->ts = now;
+	sample->delivery_rate = info.tcpi_delivery_rate * 8;
+	sample->app_limited = info.tcpi_delivery_rate_app_limited;
+	sample->rtt_usec = info.tcpi_rtt;
+	sample->notsent_bytes = info.tcpi_notsent_bytes;
+	return true;
+}
+#else
+bool dbr_socket_sample(int fd, uint64_t now, struct dbr_sample *sample)
+{
+	UNUSED_PARAMETER(fd);
+	UNUSED_PARAMETER(now);
+	UNUSED_PARAMETER(sample);
+	return false;
+}
+#endif
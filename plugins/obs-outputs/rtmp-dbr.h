@@ -0,0 +1,102 @@
+/******************************************************************************
+    Copyright (C) 2023 by Lain Bailey <lain@obsproject.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+#include <util/c99defs.h>
+#include <util/deque.h>
+
+/*
+ * Bandwidth estimate and pacing for dynamic bitrate, modeled after BBR.
+ *
+ * The bottleneck bandwidth is the highest delivery rate seen over the last
+ * couple of seconds, and the propagation delay the lowest round trip time.
+ * Delivery rates measured while the stream didn't have enough data to fill
+ * the link (app limited) only count if they are higher than the estimate.
+ * On Linux the samples come from TCP_INFO, elsewhere from how long sends
+ * block.
+ *
+ * The queueing delay is the duration of the packets waiting to be sent plus
+ * how much the round trip time is above the propagation delay.  Once it
+ * passes the trigger, the bitrate goes down to a little below the measured
+ * bandwidth, so the queue drains.  While there is no queue the bitrate is
+ * raised in small steps every second, up to the original bitrate or a little
+ * above what the link is known to deliver.
+ *
+ * Sends are paced at a multiple of the bandwidth, so a keyframe goes out
+ * over a few frame intervals instead of in one burst.
+ *
+ * Not thread safe, the caller locks.  Timestamps are in nanoseconds, bitrates
+ * passed to and returned to the encoder in kbps like its settings.
+ */
+
+struct dbr_sample {
+	uint64_t ts;
+	uint64_t delivery_rate; /* bits per second */
+	bool app_limited;
+	uint32_t rtt_usec; /* 0 if unknown */
+	uint32_t notsent_bytes;
+};
+
+struct dbr_estimator {
+	long orig_bitrate;
+	long audio_bitrate;
+	long cur_bitrate;
+
+	/* samples within the bandwidth window, oldest first */
+	struct deque bw_samples;
+
+	uint32_t srtt_usec;
+	uint32_t min_rtt_usec;
+	uint64_t min_rtt_ts;
+	uint32_t notsent_bytes;
+
+	/* sends within the fallback window, when there is no TCP_INFO */
+	struct deque sends;
+	uint64_t sends_size;
+	uint64_t sends_blocked_ns;
+	bool have_socket_samples;
+
+	uint64_t last_decrease_ts;
+	int64_t last_decrease_queue_usec;
+	uint64_t next_probe_ts;
+
+	uint64_t pacing_rate; /* bits per second */
+	uint64_t pace_next_ts;
+};
+
+void dbr_estimator_init(struct dbr_estimator *dbr, long orig_bitrate, long audio_bitrate, uint64_t now);
+void dbr_estimator_free(struct dbr_estimator *dbr);
+
+/* Delivery rate and RTT of the connection, taken after a send */
+void dbr_estimator_add_sample(struct dbr_estimator *dbr, const struct dbr_sample *sample);
+
+/* A finished send of size bytes, which blocked from beg to end */
+void dbr_estimator_add_send(struct dbr_estimator *dbr, uint64_t beg, uint64_t end, size_t size);
+
+/* Called for every video frame with the duration of the packets waiting to be
+ * sent.  Returns the new video bitrate if it should change, otherwise 0. */
+long dbr_estimator_update(struct dbr_estimator *dbr, int64_t queue_usec, uint64_t now);
+
+/* After sending size bytes, returns when the next send may start */
+uint64_t dbr_estimator_pace(struct dbr_estimator *dbr, size_t size, uint64_t now);
+
+/* Current bottleneck bandwidth estimate in bits per second, 0 if unknown */
+uint64_t dbr_estimator_bandwidth(struct dbr_estimator *dbr, uint64_t now);
+
+/* Fills in a sample from TCP_INFO, only implemented on Linux */
+bool dbr_socket_sample(int fd, uint64_t now, struct dbr_sample *sample);
@@ -0,0 +1,772 @@
+/******************************************************************************
+    Copyright (C) 2023 by Lain Bailey <lain@obsproject.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#ifdef __linux__
+#include "rtmp-fanout.h"
+
+#include <util/darray.h>
+#include <util/deque.h>
+#include <util/threading.h>
+#include <util/platform.h>
+#include <util/bmem.h>
+#include <obs-nal.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+
+#define do_log(level, format, ...) blog(level, "[rtmp fanout] " format, ##__VA_ARGS__)
+
+#define warn(format, ...) do_log(LOG_WARNING, format, ##__VA_ARGS__)
+#define info(format, ...) do_log(LOG_INFO, format, ##__VA_ARGS__)
+
+/* a destination is refilled from the queue once less than this is waiting
+ * for its socket.  whatever is buffered can't be dropped anymore, so it is
+ * kept small. */
+#define OUT_BUFFER_SIZE (64 * 1024)
+
+/* unsent data the kernel may hold on to.  without a limit the send buffer
+ * grows to megabytes, which on a slow link is seconds of data that can no
+ * longer be dropped. */
+#define NOTSENT_LOWAT (64 * 1024)
+
+/* while stopping, how often to check the shutdown timeout */
+#define STOP_POLL_MS 100
+
+#define MAX_EVENTS 64
+
+enum dest_state {
+	DEST_SENDING,
+	DEST_FLUSHING,
+	DEST_DONE,
+	DEST_FAILED,
+};
+
+struct fanout_dest {
+	char *name;
+	RTMP *rtmp;
+	int fd;
+	enum dest_state state;
+	bool sent_headers;
+	bool polling_out;
+
+	/* sequence number of the next packet to send */
+	uint64_t next;
+
+	/* chunks written by librtmp, waiting for the socket */
+	struct deque out;
+
+	/* packets in the out buffer, for the lag */
+	struct deque buffered;
+
+	int min_priority;
+	int64_t lag_usec;
+	uint64_t total_bytes;
+	int dropped_frames;
+
+	/* copy for rtmp_fanout_get_stats(), protected by the mutex */
+	struct rtmp_fanout_stats stats;
+};
+
+struct buffered_packet {
+	uint64_t end;
+	int64_t dts_usec;
+};
+
+/* what the loop needs to know about the queue besides the packet */
+struct queue_info {
+	int64_t last_dts_usec;
+	int32_t start_dts_offset;
+	bool stopping;
+	int64_t stop_ts;
+	uint64_t shutdown_timeout_ts;
+};
+
+struct rtmp_fanout {
+	struct rtmp_fanout_info info;
+	DARRAY(uint8_t) footers;
+	DARRAY(struct fanout_dest *) dests;
+
+	pthread_t thread;
+	bool thread_active;
+	int epoll_fd;
+	int wake_fd;
+
+	pthread_mutex_t mutex;
+
+	/* everything below is protected by the mutex */
+	DARRAY(uint8_t) headers;
+	struct deque packets;
+	uint64_t first_seq;
+	bool got_first_packet;
+	bool running;
+	struct queue_info queue;
+};
+
+struct rtmp_fanout *rtmp_fanout_create(const struct rtmp_fanout_info *info)
+{
+	struct rtmp_fanout *fanout = bzalloc(sizeof(*fanout));
+
+	fanout->info = *info;
+	fanout->info.footers = NULL;
+	da_push_back_array(fanout->footers, info->footers, info->footers_size);
+
+	fanout->epoll_fd = -1;
+	fanout->wake_fd = -1;
+
+	if (pthread_mutex_init(&fanout->mutex, NULL) != 0) {
+		da_free(fanout->footers);
+		bfree(fanout);
+		return NULL;
+	}
+
+	fanout->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+	fanout->wake_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+	if (fanout->epoll_fd == -1 || fanout->wake_fd == -1) {
+		warn("Failed to create epoll instance: %d", errno);
+		rtmp_fanout_destroy(fanout);
+		return NULL;
+	}
+
+	struct epoll_event ev = {.events = EPOLLIN, .data.ptr = NULL};
+	if (epoll_ctl(fanout->epoll_fd, EPOLL_CTL_ADD, fanout->wake_fd, &ev) != 0) {
+		warn("Failed to add wake event: %d", errno);
+		rtmp_fanout_destroy(fanout);
+		return NULL;
+	}
+
+	return fanout;
+}
+
+static void close_dest(struct rtmp_fanout *fanout, struct fanout_dest *dest, bool graceful)
+{
+	RTMP *rtmp = dest->rtmp;
+
+	if (dest->fd == -1)
+		return;
+
+	epoll_ctl(fanout->epoll_fd, EPOLL_CTL_DEL, dest->fd, NULL);
+
+	rtmp->m_bCustomSend = false;
+	rtmp->m_customSendFunc = NULL;
+	rtmp->m_customSendParam = NULL;
+
+	if (graceful && !dest->out.size) {
+		/* the unpublish messages are small enough to be sent
+		 * blocking, like the stream output does */
+		int flags = fcntl(dest->fd, F_GETFL);
+		fcntl(dest->fd, F_SETFL, flags & ~O_NONBLOCK);
+	} else {
+		/* same as a failed send in librtmp: the remote side must not
+		 * see this as a clean shutdown */
+		struct linger l = {.l_onoff = 1, .l_linger = 0};
+		setsockopt(dest->fd, SOL_SOCKET, SO_LINGER, &l, sizeof(l));
+		RTMPSockBuf_Close(&rtmp->m_sb);
+		rtmp->m_sb.sb_socket = -1;
+	}
+
+	RTMP_Close(rtmp);
+	dest->fd = -1;
+}
+
+static void fail_dest(struct rtmp_fanout *fanout, struct fanout_dest *dest, const char *reason, int error)
+{
+	warn("Disconnected from %s: %s (%d)", dest->name, reason, error);
+	close_dest(fanout, dest, false);
+	dest->state = DEST_FAILED;
+}
+
+static void free_dest(struct rtmp_fanout *fanout, struct fanout_dest *dest)
+{
+	close_dest(fanout, dest, false);
+	RTMP_Free(dest->rtmp);
+	deque_free(&dest->out);
+	deque_free(&dest->buffered);
+	bfree(dest->name);
+	bfree(dest);
+}
+
+void rtmp_fanout_destroy(struct rtmp_fanout *fanout)
+{
+	if (!fanout)
+		return;
+
+	if (fanout->thread_active) {
+		rtmp_fanout_stop(fanout, 0);
+		pthread_join(fanout->thread, NULL);
+	}
+
+	for (size_t i = 0; i < fanout->dests.num; i++)
+		free_dest(fanout, fanout->dests.array[i]);
+	da_free(fanout->dests);
+
+	while (fanout->packets.size) {
+		struct encoder_packet packet;
+		deque_pop_front(&fanout->packets, &packet, sizeof(packet));
+		obs_encoder_packet_release(&packet);
+	}
+	deque_free(&fanout->packets);
+
+	if (fanout->wake_fd != -1)
+		close(fanout->wake_fd);
+	if (fanout->epoll_fd != -1)
+		close(fanout->epoll_fd);
+
+	pthread_mutex_destroy(&fanout->mutex);
+	da_free(fanout->headers);
+	da_free(fanout->footers);
+	bfree(fanout);
+}
+
+static int queue_data(RTMPSockBuf *sb, const char *data, int len, void *param)
+{
+	UNUSED_PARAMETER(sb);
+
+	struct fanout_dest *dest = param;
+	deque_push_back(&dest->out, data, (size_t)len);
+	return len;
+}
+
+bool rtmp_fanout_add(struct rtmp_fanout *fanout, const char *name, RTMP *rtmp)
+{
+	struct fanout_dest *dest;
+	int fd = rtmp->m_sb.sb_socket;
+	int lowat = NOTSENT_LOWAT;
+	int flags;
+
+	if (rtmp->Link.protocol & (RTMP_FEATURE_HTTP | RTMP_FEATURE_SSL)) {
+		warn("%s: only plain RTMP is supported", name);
+		RTMP_Close(rtmp);
+		RTMP_Free(rtmp);
+		return false;
+	}
+
+	dest = bzalloc(sizeof(*dest));
+	dest->name = bstrdup(name);
+	dest->rtmp = rtmp;
+	dest->fd = fd;
+	dest->stats.name = dest->name;
+
+	flags = fcntl(fd, F_GETFL);
+	if (flags == -1 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) == -1) {
+		warn("%s: failed to set non-blocking socket: %d", name, errno);
+		free_dest(fanout, dest);
+		return false;
+	}
+
+	if (setsockopt(fd, IPPROTO_TCP, TCP_NOTSENT_LOWAT, &lowat, sizeof(lowat)) != 0)
+		info("%s: TCP_NOTSENT_LOWAT not supported (%d)", name, errno);
+
+	struct epoll_event ev = {.events = EPOLLIN, .data.ptr = dest};
+	if (epoll_ctl(fanout->epoll_fd, EPOLL_CTL_ADD, fd, &ev) != 0) {
+		warn("%s: failed to add socket: %d", name, errno);
+		free_dest(fanout, dest);
+		return false;
+	}
+
+	rtmp->m_bCustomSend = true;
+	rtmp->m_customSendFunc = queue_data;
+	rtmp->m_customSendParam = dest;
+
+	da_push_back(fanout->dests, &dest);
+	return true;
+}
+
+size_t rtmp_fanout_num_dests(struct rtmp_fanout *fanout)
+{
+	return fanout->dests.num;
+}
+
+static inline void wake(struct rtmp_fanout *fanout)
+{
+	uint64_t one = 1;
+	if (write(fanout->wake_fd, &one, sizeof(one)) < 0 && errno != EAGAIN)
+		warn("Failed to wake the loop: %d", errno);
+}
+
+void rtmp_fanout_set_headers(struct rtmp_fanout *fanout, const uint8_t *data, size_t size)
+{
+	pthread_mutex_lock(&fanout->mutex);
+	da_resize(fanout->headers, 0);
+	da_push_back_array(fanout->headers, data, size);
+	pthread_mutex_unlock(&fanout->mutex);
+}
+
+void rtmp_fanout_push(struct rtmp_fanout *fanout, struct encoder_packet *packet)
+{
+	bool queued = false;
+
+	pthread_mutex_lock(&fanout->mutex);
+	if (fanout->running) {
+		if (!fanout->got_first_packet) {
+			fanout->queue.start_dts_offset = get_ms_time(packet, packet->dts);
+			fanout->got_first_packet = true;
+		}
+
+		if (packet->type == OBS_ENCODER_VIDEO)
+			fanout->queue.last_dts_usec = packet->dts_usec;
+
+		deque_push_back(&fanout->packets, packet, sizeof(*packet));
+		queued = true;
+	}
+	pthread_mutex_unlock(&fanout->mutex);
+
+	if (queued)
+		wake(fanout);
+	else
+		obs_encoder_packet_release(packet);
+}
+
+void rtmp_fanout_stop(struct rtmp_fanout *fanout, uint64_t ts)
+{
+	pthread_mutex_lock(&fanout->mutex);
+	if (!fanout->queue.stopping || !ts) {
+		fanout->queue.stopping = true;
+		fanout->queue.stop_ts = (int64_t)(ts / 1000ULL);
+		fanout->queue.shutdown_timeout_ts = ts + fanout->info.max_shutdown_time_ns;
+	}
+	pthread_mutex_unlock(&fanout->mutex);
+
+	wake(fanout);
+}
+
+void rtmp_fanout_get_stats(struct rtmp_fanout *fanout, size_t idx, struct rtmp_fanout_stats *stats)
+{
+	pthread_mutex_lock(&fanout->mutex);
+	*stats = fanout->dests.array[idx]->stats;
+	pthread_mutex_unlock(&fanout->mutex);
+}
+
+/* copies the packet, the data stays valid because only the loop releases
+ * packets */
+static bool peek_packet(struct rtmp_fanout *fanout, uint64_t seq, struct encoder_packet *packet,
+			struct queue_info *queue)
+{
+	bool found = false;
+
+	pthread_mutex_lock(&fanout->mutex);
+	size_t idx = (size_t)(seq - fanout->first_seq);
+	if (idx < fanout->packets.size / sizeof(*packet)) {
+		*packet = *(struct encoder_packet *)deque_data(&fanout->packets, idx * sizeof(*packet));
+		found = true;
+	}
+	*queue = fanout->queue;
+	pthread_mutex_unlock(&fanout->mutex);
+
+	return found;
+}
+
+/* enhanced RTMP for everything but the first H.264 track */
+static inline bool is_video_ex(struct rtmp_fanout *fanout, struct encoder_packet *packet)
+{
+	return packet->type == OBS_ENCODER_VIDEO &&
+	       (fanout->info.video_codec[packet->track_idx] != CODEC_H264 || packet->track_idx != 0);
+}
+
+static inline bool is_audio_ex(struct encoder_packet *packet)
+{
+	return packet->type == OBS_ENCODER_AUDIO && packet->track_idx != 0;
+}
+
+static bool write_flv(struct fanout_dest *dest, const uint8_t *data, size_t size)
+{
+	/* RTMP_Write() ends up in queue_data(), so this never blocks */
+	return !size || RTMP_Write(dest->rtmp, (const char *)data, (int)size, 0) >= 0;
+}
+
+static bool write_packet(struct rtmp_fanout *fanout, struct fanout_dest *dest, struct encoder_packet *packet,
+			 int32_t dts_offset)
+{
+	size_t idx = packet->track_idx;
+	uint8_t *data = NULL;
+	size_t size = 0;
+	bool success;
+
+	if (is_video_ex(fanout, packet)) {
+		flv_packet_frames(packet, fanout->info.video_codec[idx], dts_offset, &data, &size, idx);
+	} else if (is_audio_ex(packet)) {
+		flv_packet_audio_frames(packet, fanout->info.audio_codec[idx], dts_offset, &data, &size, idx);
+	} else {
+		flv_packet_mux(packet, dts_offset, &data, &size, false);
+	}
+
+	success = write_flv(dest, data, size);
+	bfree(data);
+
+	if (success && size) {
+		struct buffered_packet buffered = {dest->total_bytes + dest->out.size, packet->dts_usec};
+		deque_push_back(&dest->buffered, &buffered, sizeof(buffered));
+	}
+
+	return success;
+}
+
+static bool write_headers(struct rtmp_fanout *fanout, struct fanout_dest *dest)
+{
+	bool success;
+
+	pthread_mutex_lock(&fanout->mutex);
+	success = write_flv(dest, fanout->headers.array, fanout->headers.num);
+	pthread_mutex_unlock(&fanout->mutex);
+
+	dest->sent_headers = true;
+	return success;
+}
+
+/* the same as the stream output's frame dropping, but decided per packet
+ * when it is taken from the queue instead of on the whole buffer */
+static bool drop_packet(struct rtmp_fanout *fanout, struct fanout_dest *dest, struct encoder_packet *packet)
+{
+	int priority = 0;
+
+	if (dest->lag_usec > fanout->info.pframe_drop_threshold_usec)
+		priority = OBS_NAL_PRIORITY_HIGHEST;
+	else if (dest->lag_usec > fanout->info.drop_threshold_usec)
+		priority = OBS_NAL_PRIORITY_HIGH;
+
+	if (dest->min_priority < priority)
+		dest->min_priority = priority;
+
+	/* do not drop audio data or video keyframes */
+	if (packet->type != OBS_ENCODER_VIDEO)
+		return false;
+
+	if (packet->drop_priority < dest->min_priority) {
+		dest->dropped_frames++;
+		return true;
+	}
+
+	dest->min_priority = 0;
+	return false;
+}
+
+static inline bool can_shutdown(const struct queue_info *queue, struct encoder_packet *packet)
+{
+	return !queue->stop_ts || os_gettime_ns() >= queue->shutdown_timeout_ts || packet->sys_dts_usec >= queue->stop_ts;
+}
+
+static void finish_dest(struct rtmp_fanout *fanout, struct fanout_dest *dest)
+{
+	if (!write_flv(dest, fanout->footers.array, fanout->footers.num)) {
+		fail_dest(fanout, dest, "failed to write footers", 0);
+		return;
+	}
+
+	dest->state = DEST_FLUSHING;
+}
+
+/* how far the oldest packet that is not sent yet is behind the newest one,
+ * like the buffer duration of the stream output */
+static int64_t get_lag(struct fanout_dest *dest, const struct queue_info *queue, const struct encoder_packet *next)
+{
+	int64_t lag = 0;
+
+	if (dest->buffered.size) {
+		struct buffered_packet *oldest = deque_data(&dest->buffered, 0);
+		lag = queue->last_dts_usec - oldest->dts_usec;
+	} else if (next) {
+		lag = queue->last_dts_usec - next->dts_usec;
+	}
+
+	/* audio can be ahead of the last video frame */
+	return lag > 0 ? lag : 0;
+}
+
+static void fill_dest(struct rtmp_fanout *fanout, struct fanout_dest *dest)
+{
+	struct encoder_packet packet;
+	struct queue_info queue;
+
+	while (dest->state == DEST_SENDING) {
+		bool found = peek_packet(fanout, dest->next, &packet, &queue);
+
+		dest->lag_usec = get_lag(dest, &queue, found ? &packet : NULL);
+
+		if (!found) {
+			if (queue.stopping && !queue.stop_ts)
+				finish_dest(fanout, dest);
+			break;
+		}
+
+		if (queue.stopping && can_shutdown(&queue, &packet)) {
+			finish_dest(fanout, dest);
+			break;
+		}
+
+		if (fanout->info.max_lag_usec && dest->lag_usec > fanout->info.max_lag_usec) {
+			fail_dest(fanout, dest, "too far behind", (int)(dest->lag_usec / 1000));
+			break;
+		}
+
+		if (dest->out.size >= OUT_BUFFER_SIZE)
+			break;
+
+		if (!dest->sent_headers && !write_headers(fanout, dest)) {
+			fail_dest(fanout, dest, "failed to write headers", 0);
+			break;
+		}
+
+		dest->next++;
+
+		if (drop_packet(fanout, dest, &packet))
+			continue;
+
+		if (!write_packet(fanout, dest, &packet, queue.start_dts_offset)) {
+			fail_dest(fanout, dest, "failed to write packet", 0);
+			break;
+		}
+	}
+}
+
+static void poll_out(struct rtmp_fanout *fanout, struct fanout_dest *dest, bool enable)
+{
+	if (dest->polling_out == enable)
+		return;
+
+	struct epoll_event ev = {.events = EPOLLIN | (enable ? EPOLLOUT : 0), .data.ptr = dest};
+	epoll_ctl(fanout->epoll_fd, EPOLL_CTL_MOD, dest->fd, &ev);
+	dest->polling_out = enable;
+}
+
+/* returns true if everything was sent and there may be more to fill */
+static bool send_dest(struct rtmp_fanout *fanout, struct fanout_dest *dest)
+{
+	while (dest->out.size) {
+		size_t size = dest->out.capacity - dest->out.start_pos;
+		if (size > dest->out.size)
+			size = dest->out.size;
+
+		ssize_t ret = send(dest->fd, deque_data(&dest->out, 0), size, MSG_NOSIGNAL | MSG_DONTWAIT);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+				break;
+
+			fail_dest(fanout, dest, "send error", errno);
+			return false;
+		}
+
+		deque_pop_front(&dest->out, NULL, (size_t)ret);
+		dest->total_bytes += (uint64_t)ret;
+	}
+
+	while (dest->buffered.size) {
+		struct buffered_packet *buffered = deque_data(&dest->buffered, 0);
+		if (buffered->end > dest->total_bytes)
+			break;
+		deque_pop_front(&dest->buffered, NULL, sizeof(*buffered));
+	}
+
+	if (dest->state == DEST_FLUSHING && !dest->out.size) {
+		close_dest(fanout, dest, true);
+		dest->state = DEST_DONE;
+		info("Stopped streaming to %s", dest->name);
+		return false;
+	}
+
+	poll_out(fanout, dest, dest->out.size != 0);
+	return !dest->out.size && dest->state == DEST_SENDING;
+}
+
+/* EPOLLOUT is only armed while the out buffer isn't empty, so a destination
+ * that is behind is refilled until its socket is full, rather than waiting
+ * for the next packet to be pushed */
+static void service_dest(struct rtmp_fanout *fanout, struct fanout_dest *dest)
+{
+	for (;;) {
+		uint64_t next = dest->next;
+
+		fill_dest(fanout, dest);
+		if (dest->fd == -1 || !send_dest(fanout, dest) || dest->next == next)
+			break;
+	}
+}
+
+/* the server's acknowledgements and such are not needed, same as in the
+ * stream output */
+static void read_dest(struct rtmp_fanout *fanout, struct fanout_dest *dest)
+{
+	char buf[4096];
+
+	for (;;) {
+		ssize_t ret = recv(dest->fd, buf, sizeof(buf), MSG_DONTWAIT);
+		if (ret > 0)
+			continue;
+		if (ret < 0 && errno == EINTR)
+			continue;
+		if (ret < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+			return;
+
+		fail_dest(fanout, dest, ret ? "receive error" : "closed by server", ret ? errno : 0);
+		return;
+	}
+}
+
+static void release_packets(struct rtmp_fanout *fanout)
+{
+	uint64_t min_next = UINT64_MAX;
+
+	for (size_t i = 0; i < fanout->dests.num; i++) {
+		struct fanout_dest *dest = fanout->dests.array[i];
+		if (dest->state == DEST_SENDING && dest->next < min_next)
+			min_next = dest->next;
+	}
+
+	pthread_mutex_lock(&fanout->mutex);
+	while (fanout->packets.size && fanout->first_seq < min_next) {
+		struct encoder_packet packet;
+		deque_pop_front(&fanout->packets, &packet, sizeof(packet));
+		obs_encoder_packet_release(&packet);
+		fanout->first_seq++;
+	}
+	pthread_mutex_unlock(&fanout->mutex);
+}
+
+static void update_stats(struct rtmp_fanout *fanout)
+{
+	pthread_mutex_lock(&fanout->mutex);
+	for (size_t i = 0; i < fanout->dests.num; i++) {
+		struct fanout_dest *dest = fanout->dests.array[i];
+		struct rtmp_fanout_stats *stats = &dest->stats;
+		float congestion = 0.0f;
+
+		if (dest->lag_usec > 0 && fanout->info.drop_threshold_usec)
+			congestion = (float)dest->lag_usec / (float)fanout->info.drop_threshold_usec;
+
+		stats->active = dest->state == DEST_SENDING || dest->state == DEST_FLUSHING;
+		stats->lag_usec = dest->lag_usec;
+		stats->congestion = dest->min_priority > 0 ? 1.0f : congestion;
+		stats->total_bytes = dest->total_bytes;
+		stats->dropped_frames = dest->dropped_frames;
+		stats->packets = dest->next;
+	}
+	pthread_mutex_unlock(&fanout->mutex);
+}
+
+static void *fanout_thread(void *data)
+{
+	struct rtmp_fanout *fanout = data;
+	struct epoll_event events[MAX_EVENTS];
+	bool stopping = false;
+	bool timed_out = false;
+	bool failed = false;
+
+	os_set_thread_name("rtmp-fanout: loop");
+
+	for (;;) {
+		int timeout = stopping ? STOP_POLL_MS : -1;
+		int count = epoll_wait(fanout->epoll_fd, events, MAX_EVENTS, timeout);
+		size_t active = 0;
+
+		if (count < 0 && errno != EINTR) {
+			warn("epoll_wait failed: %d", errno);
+			break;
+		}
+
+		for (int i = 0; i < count; i++) {
+			struct fanout_dest *dest = events[i].data.ptr;
+
+			if (!dest) {
+				uint64_t value;
+				if (read(fanout->wake_fd, &value, sizeof(value)) < 0 && errno != EAGAIN)
+					warn("Failed to read wake event: %d", errno);
+				continue;
+			}
+
+			if (dest->fd != -1 && (events[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP)))
+				read_dest(fanout, dest);
+		}
+
+		for (size_t i = 0; i < fanout->dests.num; i++) {
+			struct fanout_dest *dest = fanout->dests.array[i];
+
+			service_dest(fanout, dest);
+
+			if (dest->state == DEST_SENDING || dest->state == DEST_FLUSHING)
+				active++;
+		}
+
+		release_packets(fanout);
+		update_stats(fanout);
+
+		pthread_mutex_lock(&fanout->mutex);
+		stopping = fanout->queue.stopping;
+		timed_out = stopping && (!fanout->queue.stop_ts || os_gettime_ns() >= fanout->queue.shutdown_timeout_ts);
+		pthread_mutex_unlock(&fanout->mutex);
+
+		if (!active || timed_out)
+			break;
+	}
+
+	/* whatever could not be flushed in time is cut off */
+	for (size_t i = 0; i < fanout->dests.num; i++) {
+		struct fanout_dest *dest = fanout->dests.array[i];
+
+		if (dest->state == DEST_SENDING || dest->state == DEST_FLUSHING) {
+			if (dest->state == DEST_SENDING)
+				finish_dest(fanout, dest);
+			if (dest->fd != -1)
+				send_dest(fanout, dest);
+			if (dest->state != DEST_DONE) {
+				info("Stopped streaming to %s without sending everything", dest->name);
+				close_dest(fanout, dest, false);
+				dest->state = DEST_DONE;
+			}
+		}
+
+		if (dest->state == DEST_FAILED)
+			failed = true;
+	}
+
+	pthread_mutex_lock(&fanout->mutex);
+	fanout->running = false;
+	pthread_mutex_unlock(&fanout->mutex);
+
+	update_stats(fanout);
+
+	if (fanout->info.stopped)
+		fanout->info.stopped(fanout->info.param, failed);
+	return NULL;
+}
+
+bool rtmp_fanout_start(struct rtmp_fanout *fanout)
+{
+	if (!fanout->dests.num)
+		return false;
+
+	pthread_mutex_lock(&fanout->mutex);
+	fanout->running = true;
+	pthread_mutex_unlock(&fanout->mutex);
+
+	if (pthread_create(&fanout->thread, NULL, fanout_thread, fanout) != 0) {
+		warn("Failed to create loop thread");
+		fanout->running = false;
+		return false;
+	}
+
+	fanout->thread_active = true;
+	info("Streaming to %zu destinations", fanout->dests.num);
+	return true;
+}
+
+#endif
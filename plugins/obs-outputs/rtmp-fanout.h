@@ -0,0 +1,101 @@
+/******************************************************************************
+    Copyright (C) 2023 by Lain Bailey <lain@obsproject.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+#ifdef __linux__
+
+#include <obs-module.h>
+
+#include "librtmp/rtmp.h"
+#include "flv-mux.h"
+
+/*
+ * Sends one set of encoded packets to several RTMP servers from a single
+ * thread.
+ *
+ * The packets are kept once, in a queue shared by all destinations, each of
+ * which only remembers the sequence number of the next packet it sends.  A
+ * packet is released when every destination is past it.
+ *
+ * One epoll loop drives all sockets, which are non-blocking.  librtmp still
+ * does the chunking: its custom send function appends to a buffer per
+ * destination, which is only refilled from the queue once the socket has
+ * taken most of it.  How far a destination is behind the newest packet is
+ * its lag, and frames are dropped for each destination on its own, the same
+ * way the RTMP stream output drops them from its buffer.
+ */
+
+struct rtmp_fanout;
+
+struct rtmp_fanout_info {
+	int64_t drop_threshold_usec;
+	int64_t pframe_drop_threshold_usec;
+	uint64_t max_shutdown_time_ns;
+
+	/* destinations further behind than this are disconnected, so they
+	 * don't keep the packets of all the others around (0 for no limit) */
+	int64_t max_lag_usec;
+
+	enum audio_id_t audio_codec[MAX_OUTPUT_AUDIO_ENCODERS];
+	enum video_id_t video_codec[MAX_OUTPUT_VIDEO_ENCODERS];
+
+	/* FLV tags sent to every destination last */
+	const uint8_t *footers;
+	size_t footers_size;
+
+	/* called on the loop thread once every destination is done or
+	 * failed, with whether any of them failed */
+	void (*stopped)(void *param, bool failed);
+	void *param;
+};
+
+struct rtmp_fanout_stats {
+	const char *name;
+	bool active;
+	int64_t lag_usec;
+	float congestion;
+	uint64_t total_bytes;
+	int dropped_frames;
+	uint64_t packets; /* taken from the queue, sent or dropped */
+};
+
+struct rtmp_fanout *rtmp_fanout_create(const struct rtmp_fanout_info *info);
+void rtmp_fanout_destroy(struct rtmp_fanout *fanout);
+
+/* Takes over a connected RTMP allocated with RTMP_Alloc(), before
+ * rtmp_fanout_start().  Plain TCP only, returns false (and closes and frees
+ * it) for RTMPS or RTMPT. */
+bool rtmp_fanout_add(struct rtmp_fanout *fanout, const char *name, RTMP *rtmp);
+size_t rtmp_fanout_num_dests(struct rtmp_fanout *fanout);
+
+bool rtmp_fanout_start(struct rtmp_fanout *fanout);
+
+/* FLV tags sent to every destination in front of the first packet, which
+ * have to be set before the first packet is pushed */
+void rtmp_fanout_set_headers(struct rtmp_fanout *fanout, const uint8_t *data, size_t size);
+
+/* Takes the reference to the packet */
+void rtmp_fanout_push(struct rtmp_fanout *fanout, struct encoder_packet *packet);
+
+/* Sends what is queued up to the stop timestamp (in nanoseconds, like the
+ * output's stop), or stops right away if ts is 0 */
+void rtmp_fanout_stop(struct rtmp_fanout *fanout, uint64_t ts);
+
+void rtmp_fanout_get_stats(struct rtmp_fanout *fanout, size_t idx, struct rtmp_fanout_stats *stats);
+
+#endif
@@ -0,0 +1,201 @@
+/******************************************************************************
+    Copyright (C) 2023 by Lain Bailey <lain@obsproject.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include "rtmp-helpers.h"
+#include "rtmp-av1.h"
+#include "rtmp-hevc.h"
+
+#include <obs-avc.h>
+#include <obs-hevc.h>
+
+#define do_log(level, format, ...) \
+	blog(level, "[rtmp output: '%s'] " format, obs_output_get_name(output), ##__VA_ARGS__)
+
+static char flash_ver[] = "FMLE/3.0 (compatible; FMSc/1.0)";
+
+static bool write_audio_header(obs_output_t *output, const enum audio_id_t *audio_codec, size_t idx,
+			       rtmp_write_tag_t write, void *param, bool *next)
+{
+	obs_encoder_t *aencoder = obs_output_get_audio_encoder(output, idx);
+	struct encoder_packet packet = {.type = OBS_ENCODER_AUDIO, .timebase_den = 1};
+	uint8_t *data;
+	size_t size;
+	bool success;
+
+	if (!aencoder) {
+		*next = false;
+		return true;
+	}
+
+	if (!obs_encoder_get_extra_data(aencoder, &packet.data, &packet.size))
+		return false;
+
+	if (idx == 0)
+		flv_packet_mux(&packet, 0, &data, &size, true);
+	else
+		flv_packet_audio_start(&packet, audio_codec[idx], &data, &size, idx);
+
+	success = write(param, OBS_ENCODER_AUDIO, idx, data, size);
+	bfree(data);
+	return success;
+}
+
+static bool write_video_header(obs_output_t *output, const enum video_id_t *video_codec, size_t idx,
+			       rtmp_write_tag_t write, void *param)
+{
+	obs_encoder_t *vencoder = obs_output_get_video_encoder2(output, idx);
+	struct encoder_packet packet = {.type = OBS_ENCODER_VIDEO, .timebase_den = 1, .keyframe = true};
+	uint8_t *header;
+	uint8_t *data;
+	size_t size;
+	bool success;
+
+	if (!obs_encoder_get_extra_data(vencoder, &header, &size))
+		return false;
+
+	switch (video_codec[idx]) {
+	case CODEC_NONE:
+		do_log(LOG_ERROR, "Codec not initialized for track %zu while sending header", idx);
+		return false;
+
+	case CODEC_H264:
+		packet.size = obs_parse_avc_header(&packet.data, header, size);
+		break;
+	case CODEC_HEVC:
+#ifdef ENABLE_HEVC
+		packet.size = obs_parse_hevc_header(&packet.data, header, size);
+		break;
+#else
+		return false;
+#endif
+	case CODEC_AV1:
+		packet.size = obs_parse_av1_header(&packet.data, header, size);
+		break;
+	}
+
+	// Always send H.264 on track 0 as old style for compatibility.
+	if (idx == 0 && video_codec[idx] == CODEC_H264)
+		flv_packet_mux(&packet, 0, &data, &size, true);
+	else
+		flv_packet_start(&packet, video_codec[idx], &data, &size, idx);
+
+	bfree(packet.data);
+
+	success = write(param, OBS_ENCODER_VIDEO, idx, data, size);
+	bfree(data);
+	return success;
+}
+
+bool rtmp_write_headers(obs_output_t *output, const enum audio_id_t *audio_codec, const enum video_id_t *video_codec,
+			rtmp_write_tag_t write, void *param)
+{
+	size_t i = 0;
+	bool next = true;
+
+	if (!write_audio_header(output, audio_codec, i++, write, param, &next))
+		return false;
+
+	for (size_t j = 0; j < MAX_OUTPUT_VIDEO_ENCODERS; j++) {
+		if (!obs_output_get_video_encoder2(output, j))
+			continue;
+
+		if (!write_video_header(output, video_codec, j, write, param))
+			return false;
+	}
+
+	while (next) {
+		if (!write_audio_header(output, audio_codec, i++, write, param, &next))
+			return false;
+	}
+
+	return true;
+}
+
+bool rtmp_write_footers(obs_output_t *output, const enum video_id_t *video_codec, rtmp_write_tag_t write, void *param)
+{
+	for (size_t i = 0; i < MAX_OUTPUT_VIDEO_ENCODERS; i++) {
+		struct encoder_packet packet = {.type = OBS_ENCODER_VIDEO, .timebase_den = 1};
+		uint8_t *data;
+		size_t size;
+		bool success;
+
+		if (!obs_output_get_video_encoder2(output, i))
+			continue;
+		if (i == 0 && video_codec[i] == CODEC_H264)
+			continue;
+
+		flv_packet_end(&packet, video_codec[i], &data, &size, i);
+		success = write(param, OBS_ENCODER_VIDEO, i, data, size);
+		bfree(data);
+
+		if (!success)
+			return false;
+	}
+
+	return true;
+}
+
+bool rtmp_parse_packet(const enum video_id_t *video_codec, struct encoder_packet *new_packet,
+		       struct encoder_packet *packet)
+{
+	if (packet->type == OBS_ENCODER_AUDIO) {
+		obs_encoder_packet_ref(new_packet, packet);
+		return true;
+	}
+
+	switch (video_codec[packet->track_idx]) {
+	case CODEC_NONE:
+		return false;
+
+	case CODEC_H264:
+		obs_parse_avc_packet(new_packet, packet);
+		return true;
+	case CODEC_HEVC:
+#ifdef ENABLE_HEVC
+		obs_parse_hevc_packet(new_packet, packet);
+		return true;
+#else
+		return false;
+#endif
+	case CODEC_AV1:
+		obs_parse_av1_packet(new_packet, packet);
+		return true;
+	}
+
+	return false;
+}
+
+bool rtmp_setup_publish(RTMP *rtmp, char *url, const char *key)
+{
+	RTMP_Init(rtmp);
+
+	if (!RTMP_SetupURL(rtmp, url))
+		return false;
+
+	RTMP_EnableWrite(rtmp);
+
+	rtmp->Link.flashVer.av_val = flash_ver;
+	rtmp->Link.flashVer.av_len = (int)strlen(flash_ver);
+	rtmp->Link.swfUrl = rtmp->Link.tcUrl;
+
+	RTMP_AddStream(rtmp, key);
+
+	rtmp->m_outChunkSize = 4096;
+	rtmp->m_bSendChunkSizeInfo = true;
+	rtmp->m_bUseNagle = true;
+	return true;
+}
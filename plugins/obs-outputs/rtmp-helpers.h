@@ -18,6 +18,7 @@
 #pragma once
 
 #include "librtmp/rtmp.h"
+#include "flv-mux.h"
 
 static inline AVal *flv_str(AVal *out, const char *str)
 {
@@ -49,3 +50,28 @@ static inline void enc_str(char **enc, char *end, const char *str)
 	AVal s;
 	*enc = AMF_EncodeString(*enc, end, flv_str(&s, str));
 }
+
+/* Shared by the RTMP outputs */
+
+/* Called with each FLV tag, and the type and track it belongs to */
+typedef bool (*rtmp_write_tag_t)(void *param, enum obs_encoder_type type, size_t idx, const uint8_t *data,
+				 size_t size);
+
+/* The codec headers of every track: the first audio track, all video tracks,
+ * then the other audio tracks.  Audio track 0 and H.264 on video track 0 use
+ * the legacy format, everything else enhanced RTMP. */
+bool rtmp_write_headers(obs_output_t *output, const enum audio_id_t *audio_codec, const enum video_id_t *video_codec,
+			rtmp_write_tag_t write, void *param);
+
+/* The end of sequence tags of the enhanced RTMP video tracks */
+bool rtmp_write_footers(obs_output_t *output, const enum video_id_t *video_codec, rtmp_write_tag_t write,
+			void *param);
+
+/* References the packet, with the video converted to what FLV expects.
+ * Returns false if the track's codec isn't supported. */
+bool rtmp_parse_packet(const enum video_id_t *video_codec, struct encoder_packet *new_packet,
+		       struct encoder_packet *packet);
+
+/* Initialises rtmp for publishing to key at url, before RTMP_Connect().  Like
+ * RTMP_SetupURL(), url has to stay valid while rtmp is used. */
+bool rtmp_setup_publish(RTMP *rtmp, char *url, const char *key);
@@ -0,0 +1,522 @@
+/******************************************************************************
+    Copyright (C) 2023 by Lain Bailey <lain@obsproject.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#ifdef __linux__
+#include "rtmp-fanout.h"
+#include "rtmp-helpers.h"
+
+#include <util/darray.h>
+#include <util/dstr.h>
+#include <util/platform.h>
+#include <util/threading.h>
+
+#define do_log(level, format, ...) \
+	blog(level, "[rtmp multi stream: '%s'] " format, obs_output_get_name(ms->output), ##__VA_ARGS__)
+
+#define warn(format, ...) do_log(LOG_WARNING, format, ##__VA_ARGS__)
+#define info(format, ...) do_log(LOG_INFO, format, ##__VA_ARGS__)
+
+#define OPT_DROP_THRESHOLD "drop_threshold_ms"
+#define OPT_PFRAME_DROP_THRESHOLD "pframe_drop_threshold_ms"
+#define OPT_MAX_SHUTDOWN_TIME_SEC "max_shutdown_time_sec"
+#define OPT_MAX_LAG "max_lag_ms"
+
+/* array of objects with "server" and "key", sent to in addition to the
+ * service */
+#define OPT_DESTINATIONS "destinations"
+
+struct rtmp_multi_stream {
+	obs_output_t *output;
+
+	pthread_t connect_thread;
+	volatile bool connecting;
+	volatile bool active;
+	volatile bool stopping;
+	volatile bool encode_error;
+
+	/* protects the fanout pointer, which is replaced on every start */
+	pthread_mutex_t mutex;
+	struct rtmp_fanout *fanout;
+
+	bool sent_headers;
+	DARRAY(uint8_t) headers;
+	DARRAY(uint8_t) footers;
+
+	enum audio_id_t audio_codec[MAX_OUTPUT_AUDIO_ENCODERS];
+	enum video_id_t video_codec[MAX_OUTPUT_VIDEO_ENCODERS];
+};
+
+static const char *rtmp_multi_stream_getname(void *unused)
+{
+	UNUSED_PARAMETER(unused);
+	return obs_module_text("RTMPMultiStream");
+}
+
+static inline bool connecting(struct rtmp_multi_stream *ms)
+{
+	return os_atomic_load_bool(&ms->connecting);
+}
+
+static inline bool active(struct rtmp_multi_stream *ms)
+{
+	return os_atomic_load_bool(&ms->active);
+}
+
+static void destroy_fanout(struct rtmp_multi_stream *ms)
+{
+	struct rtmp_fanout *fanout;
+
+	pthread_mutex_lock(&ms->mutex);
+	fanout = ms->fanout;
+	ms->fanout = NULL;
+	pthread_mutex_unlock(&ms->mutex);
+
+	rtmp_fanout_destroy(fanout);
+}
+
+static void rtmp_multi_stream_destroy(void *data)
+{
+	struct rtmp_multi_stream *ms = data;
+
+	os_atomic_set_bool(&ms->stopping, true);
+
+	if (connecting(ms))
+		pthread_join(ms->connect_thread, NULL);
+
+	destroy_fanout(ms);
+	pthread_mutex_destroy(&ms->mutex);
+	da_free(ms->headers);
+	da_free(ms->footers);
+	bfree(ms);
+}
+
+static void *rtmp_multi_stream_create(obs_data_t *settings, obs_output_t *output)
+{
+	struct rtmp_multi_stream *ms = bzalloc(sizeof(*ms));
+	ms->output = output;
+
+	if (pthread_mutex_init(&ms->mutex, NULL) != 0) {
+		bfree(ms);
+		return NULL;
+	}
+
+	UNUSED_PARAMETER(settings);
+	return ms;
+}
+
+static void rtmp_multi_stream_stop(void *data, uint64_t ts)
+{
+	struct rtmp_multi_stream *ms = data;
+
+	os_atomic_set_bool(&ms->stopping, true);
+
+	if (connecting(ms))
+		pthread_join(ms->connect_thread, NULL);
+
+	pthread_mutex_lock(&ms->mutex);
+	if (active(ms) && ms->fanout)
+		rtmp_fanout_stop(ms->fanout, ts);
+	pthread_mutex_unlock(&ms->mutex);
+
+	if (!active(ms))
+		obs_output_signal_stop(ms->output, OBS_OUTPUT_SUCCESS);
+}
+
+/* called on the fanout's thread once every destination is done */
+static void fanout_stopped(void *param, bool failed)
+{
+	struct rtmp_multi_stream *ms = param;
+
+	os_atomic_set_bool(&ms->active, false);
+
+	if (os_atomic_load_bool(&ms->encode_error)) {
+		info("Encoder error, disconnected");
+		obs_output_signal_stop(ms->output, OBS_OUTPUT_ENCODE_ERROR);
+	} else if (os_atomic_load_bool(&ms->stopping)) {
+		info("User stopped the stream%s", failed ? ", some destinations had disconnected" : "");
+		obs_output_end_data_capture(ms->output);
+	} else {
+		info("Disconnected from every destination");
+		obs_output_signal_stop(ms->output, OBS_OUTPUT_DISCONNECTED);
+	}
+}
+
+static bool add_tag(void *param, enum obs_encoder_type type, size_t idx, const uint8_t *data, size_t size)
+{
+	UNUSED_PARAMETER(type);
+	UNUSED_PARAMETER(idx);
+
+	darray_push_back_array(sizeof(uint8_t), param, data, size);
+	return true;
+}
+
+/* same as the stream output's headers, without the HDR metadata */
+static bool build_headers(struct rtmp_multi_stream *ms)
+{
+	da_resize(ms->headers, 0);
+	return rtmp_write_headers(ms->output, ms->audio_codec, ms->video_codec, add_tag, &ms->headers.da);
+}
+
+static void build_footers(struct rtmp_multi_stream *ms)
+{
+	da_resize(ms->footers, 0);
+	rtmp_write_footers(ms->output, ms->video_codec, add_tag, &ms->footers.da);
+}
+
+/* connects the same way as the stream output, and sends the metadata while
+ * the socket is still blocking */
+static RTMP *connect_dest(struct rtmp_multi_stream *ms, const char *server, const char *key)
+{
+	RTMP *rtmp = RTMP_Alloc();
+	struct dstr url = {0};
+	uint8_t *meta_data;
+	size_t meta_data_size;
+	bool success;
+
+	dstr_copy(&url, server);
+	dstr_depad(&url);
+
+	info("Connecting to RTMP URL %s...", url.array);
+
+	if (dstr_is_empty(&url) || !rtmp_setup_publish(rtmp, url.array, key)) {
+		warn("Invalid URL: %s", server);
+		goto fail;
+	}
+
+	if (rtmp->Link.protocol & (RTMP_FEATURE_HTTP | RTMP_FEATURE_SSL)) {
+		warn("Skipping %s, only plain RTMP is supported", url.array);
+		goto fail;
+	}
+
+	if (!RTMP_Connect(rtmp, NULL) || !RTMP_ConnectStream(rtmp, 0)) {
+		warn("Connection to %s failed", url.array);
+		goto fail;
+	}
+
+	flv_meta_data(ms->output, &meta_data, &meta_data_size, false);
+	success = RTMP_Write(rtmp, (char *)meta_data, (int)meta_data_size, 0) >= 0;
+	bfree(meta_data);
+
+	if (!success) {
+		warn("Disconnected from %s while sending metadata", url.array);
+		goto fail;
+	}
+
+	info("Connection to %s successful", url.array);
+	dstr_free(&url);
+	return rtmp;
+
+fail:
+	RTMP_Close(rtmp);
+	RTMP_Free(rtmp);
+	dstr_free(&url);
+	return NULL;
+}
+
+static void add_dest(struct rtmp_multi_stream *ms, struct rtmp_fanout *fanout, const char *server, const char *key)
+{
+	RTMP *rtmp = connect_dest(ms, server, key);
+	if (rtmp)
+		rtmp_fanout_add(fanout, server, rtmp);
+}
+
+static bool hdr_enabled(struct rtmp_multi_stream *ms)
+{
+	for (size_t i = 0; i < MAX_OUTPUT_VIDEO_ENCODERS; i++) {
+		obs_encoder_t *encoder = obs_output_get_video_encoder2(ms->output, i);
+		if (!encoder)
+			continue;
+
+		video_t *video = obs_encoder_video(encoder);
+		if (!video)
+			continue;
+
+		enum video_colorspace colorspace = video_output_get_info(video)->colorspace;
+		if (colorspace == VIDEO_CS_2100_PQ || colorspace == VIDEO_CS_2100_HLG)
+			return true;
+	}
+
+	return false;
+}
+
+static int start_fanout(struct rtmp_multi_stream *ms)
+{
+	obs_service_t *service = obs_output_get_service(ms->output);
+	obs_data_t *settings = obs_output_get_settings(ms->output);
+	obs_data_array_t *dests = obs_data_get_array(settings, OPT_DESTINATIONS);
+	struct rtmp_fanout_info fanout_info = {0};
+	struct rtmp_fanout *fanout;
+	int64_t drop_b;
+	int64_t drop_p;
+
+	for (size_t i = 0; i < MAX_OUTPUT_AUDIO_ENCODERS; i++) {
+		obs_encoder_t *enc = obs_output_get_audio_encoder(ms->output, i);
+		if (enc)
+			ms->audio_codec[i] = to_audio_type(obs_encoder_get_codec(enc));
+	}
+
+	for (size_t i = 0; i < MAX_OUTPUT_VIDEO_ENCODERS; i++) {
+		obs_encoder_t *enc = obs_output_get_video_encoder2(ms->output, i);
+		if (enc)
+			ms->video_codec[i] = to_video_type(obs_encoder_get_codec(enc));
+	}
+
+	drop_b = (int64_t)obs_data_get_int(settings, OPT_DROP_THRESHOLD);
+	drop_p = (int64_t)obs_data_get_int(settings, OPT_PFRAME_DROP_THRESHOLD);
+	if (drop_p < (drop_b + 200))
+		drop_p = drop_b + 200;
+
+	fanout_info.drop_threshold_usec = 1000 * drop_b;
+	fanout_info.pframe_drop_threshold_usec = 1000 * drop_p;
+	fanout_info.max_lag_usec = 1000 * (int64_t)obs_data_get_int(settings, OPT_MAX_LAG);
+	fanout_info.max_shutdown_time_ns =
+		(uint64_t)obs_data_get_int(settings, OPT_MAX_SHUTDOWN_TIME_SEC) * 1000000000ULL;
+	memcpy(fanout_info.audio_codec, ms->audio_codec, sizeof(ms->audio_codec));
+	memcpy(fanout_info.video_codec, ms->video_codec, sizeof(ms->video_codec));
+	fanout_info.stopped = fanout_stopped;
+	fanout_info.param = ms;
+
+	build_footers(ms);
+	fanout_info.footers = ms->footers.array;
+	fanout_info.footers_size = ms->footers.num;
+
+	fanout = rtmp_fanout_create(&fanout_info);
+
+	if (!fanout) {
+		obs_data_array_release(dests);
+		obs_data_release(settings);
+		return OBS_OUTPUT_ERROR;
+	}
+
+	if (service)
+		add_dest(ms, fanout, obs_service_get_connect_info(service, OBS_SERVICE_CONNECT_INFO_SERVER_URL),
+			 obs_service_get_connect_info(service, OBS_SERVICE_CONNECT_INFO_STREAM_KEY));
+
+	for (size_t i = 0; i < obs_data_array_count(dests); i++) {
+		obs_data_t *dest = obs_data_array_item(dests, i);
+		add_dest(ms, fanout, obs_data_get_string(dest, "server"), obs_data_get_string(dest, "key"));
+		obs_data_release(dest);
+	}
+
+	obs_data_array_release(dests);
+	obs_data_release(settings);
+
+	if (!rtmp_fanout_num_dests(fanout) || os_atomic_load_bool(&ms->stopping)) {
+		rtmp_fanout_destroy(fanout);
+		return OBS_OUTPUT_CONNECT_FAILED;
+	}
+
+	pthread_mutex_lock(&ms->mutex);
+	ms->fanout = fanout;
+	pthread_mutex_unlock(&ms->mutex);
+
+	os_atomic_set_bool(&ms->active, true);
+
+	if (!rtmp_fanout_start(fanout)) {
+		os_atomic_set_bool(&ms->active, false);
+		destroy_fanout(ms);
+		return OBS_OUTPUT_ERROR;
+	}
+
+	obs_output_begin_data_capture(ms->output, 0);
+	return OBS_OUTPUT_SUCCESS;
+}
+
+static void *connect_thread(void *data)
+{
+	struct rtmp_multi_stream *ms = data;
+	int ret;
+
+	os_set_thread_name("rtmp-multi-stream: connect_thread");
+
+	/* the previous stream's connections are gone by now */
+	destroy_fanout(ms);
+	ms->sent_headers = false;
+
+	if (hdr_enabled(ms)) {
+		warn("HDR is not supported when streaming to multiple destinations");
+		ret = OBS_OUTPUT_HDR_DISABLED;
+	} else {
+		ret = start_fanout(ms);
+	}
+
+	/* when stopped while connecting, stop() signals instead */
+	if (ret != OBS_OUTPUT_SUCCESS && !os_atomic_load_bool(&ms->stopping))
+		obs_output_signal_stop(ms->output, ret);
+
+	if (!os_atomic_load_bool(&ms->stopping))
+		pthread_detach(ms->connect_thread);
+
+	os_atomic_set_bool(&ms->connecting, false);
+	return NULL;
+}
+
+static bool rtmp_multi_stream_start(void *data)
+{
+	struct rtmp_multi_stream *ms = data;
+
+	if (!obs_output_can_begin_data_capture(ms->output, 0))
+		return false;
+	if (!obs_output_initialize_encoders(ms->output, 0))
+		return false;
+
+	os_atomic_set_bool(&ms->stopping, false);
+	os_atomic_set_bool(&ms->encode_error, false);
+	os_atomic_set_bool(&ms->connecting, true);
+	return pthread_create(&ms->connect_thread, NULL, connect_thread, ms) == 0;
+}
+
+static void rtmp_multi_stream_data(void *data, struct encoder_packet *packet)
+{
+	struct rtmp_multi_stream *ms = data;
+	struct encoder_packet new_packet;
+
+	if (!active(ms))
+		return;
+
+	pthread_mutex_lock(&ms->mutex);
+
+	if (!ms->fanout)
+		goto unlock;
+
+	/* encoder fail */
+	if (!packet) {
+		os_atomic_set_bool(&ms->encode_error, true);
+		rtmp_fanout_stop(ms->fanout, 0);
+		goto unlock;
+	}
+
+	/* the encoders have their headers once they have output something */
+	if (!ms->sent_headers) {
+		if (!build_headers(ms)) {
+			warn("Failed to get the encoder headers");
+			rtmp_fanout_stop(ms->fanout, 0);
+			goto unlock;
+		}
+
+		rtmp_fanout_set_headers(ms->fanout, ms->headers.array, ms->headers.num);
+		ms->sent_headers = true;
+	}
+
+	if (rtmp_parse_packet(ms->video_codec, &new_packet, packet))
+		rtmp_fanout_push(ms->fanout, &new_packet);
+	else
+		do_log(LOG_ERROR, "Codec not initialized for track %zu", packet->track_idx);
+
+unlock:
+	pthread_mutex_unlock(&ms->mutex);
+}
+
+static void rtmp_multi_stream_defaults(obs_data_t *defaults)
+{
+	obs_data_set_default_int(defaults, OPT_DROP_THRESHOLD, 700);
+	obs_data_set_default_int(defaults, OPT_PFRAME_DROP_THRESHOLD, 900);
+	obs_data_set_default_int(defaults, OPT_MAX_SHUTDOWN_TIME_SEC, 30);
+	obs_data_set_default_int(defaults, OPT_MAX_LAG, 30000);
+}
+
+static obs_properties_t *rtmp_multi_stream_properties(void *unused)
+{
+	UNUSED_PARAMETER(unused);
+
+	obs_properties_t *props = obs_properties_create();
+	obs_property_t *p;
+
+	p = obs_properties_add_int(props, OPT_DROP_THRESHOLD, obs_module_text("RTMPStream.DropThreshold"), 200, 10000,
+				   100);
+	obs_property_int_set_suffix(p, " ms");
+
+	p = obs_properties_add_int(props, OPT_MAX_LAG, obs_module_text("RTMPMultiStream.MaxLag"), 1000, 300000, 1000);
+	obs_property_int_set_suffix(p, " ms");
+
+	return props;
+}
+
+static uint64_t rtmp_multi_stream_total_bytes_sent(void *data)
+{
+	struct rtmp_multi_stream *ms = data;
+	uint64_t total = 0;
+
+	pthread_mutex_lock(&ms->mutex);
+	for (size_t i = 0; ms->fanout && i < rtmp_fanout_num_dests(ms->fanout); i++) {
+		struct rtmp_fanout_stats stats;
+		rtmp_fanout_get_stats(ms->fanout, i, &stats);
+		total += stats.total_bytes;
+	}
+	pthread_mutex_unlock(&ms->mutex);
+
+	return total;
+}
+
+static int rtmp_multi_stream_dropped_frames(void *data)
+{
+	struct rtmp_multi_stream *ms = data;
+	int dropped = 0;
+
+	pthread_mutex_lock(&ms->mutex);
+	for (size_t i = 0; ms->fanout && i < rtmp_fanout_num_dests(ms->fanout); i++) {
+		struct rtmp_fanout_stats stats;
+		rtmp_fanout_get_stats(ms->fanout, i, &stats);
+		dropped += stats.dropped_frames;
+	}
+	pthread_mutex_unlock(&ms->mutex);
+
+	return dropped;
+}
+
+/* the most congested destination that is still connected */
+static float rtmp_multi_stream_congestion(void *data)
+{
+	struct rtmp_multi_stream *ms = data;
+	float congestion = 0.0f;
+
+	pthread_mutex_lock(&ms->mutex);
+	for (size_t i = 0; ms->fanout && i < rtmp_fanout_num_dests(ms->fanout); i++) {
+		struct rtmp_fanout_stats stats;
+		rtmp_fanout_get_stats(ms->fanout, i, &stats);
+		if (stats.active && stats.congestion > congestion)
+			congestion = stats.congestion;
+	}
+	pthread_mutex_unlock(&ms->mutex);
+
+	return congestion;
+}
+
+struct obs_output_info rtmp_multi_output_info = {
+	.id = "rtmp_multi_output",
+	.flags = OBS_OUTPUT_AV | OBS_OUTPUT_ENCODED | OBS_OUTPUT_SERVICE | OBS_OUTPUT_MULTI_TRACK_AV,
+	.protocols = "RTMP",
+#ifdef ENABLE_HEVC
+	.encoded_video_codecs = "h264;hevc;av1",
+#else
+	.encoded_video_codecs = "h264;av1",
+#endif
+	.encoded_audio_codecs = "aac",
+	.get_name = rtmp_multi_stream_getname,
+	.create = rtmp_multi_stream_create,
+	.destroy = rtmp_multi_stream_destroy,
+	.start = rtmp_multi_stream_start,
+	.stop = rtmp_multi_stream_stop,
+	.encoded_packet = rtmp_multi_stream_data,
+	.get_defaults = rtmp_multi_stream_defaults,
+	.get_properties = rtmp_multi_stream_properties,
+	.get_total_bytes = rtmp_multi_stream_total_bytes_sent,
+	.get_congestion = rtmp_multi_stream_congestion,
+	.get_dropped_frames = rtmp_multi_stream_dropped_frames,
+};
+
+#endif
@@ -16,11 +16,9 @@
 ******************************************************************************/
 
 #include "rtmp-stream.h"
-#include "rtmp-av1.h"
-#include "rtmp-hevc.h"
+#include "rtmp-helpers.h"
 
 #include <obs-avc.h>
-#include <obs-hevc.h>
 
 #ifdef _WIN32
 #include <util/windows/win-version.h>
@@ -38,11 +36,8 @@
 #define MSEC_TO_NSEC 1000000ULL
 #endif
 
-/* dynamic bitrate coefficients */
-#define DBR_INC_TIMER (4ULL * SEC_TO_NSEC)
-#define DBR_TRIGGER_USEC (200ULL * MSEC_TO_USEC)
-#define MIN_ESTIMATE_DURATION_MS 1000
-#define MAX_ESTIMATE_DURATION_MS 2000
+/* how often the socket statistics are read for dynamic bitrate */
+#define DBR_SAMPLE_INTERVAL_NS (10ULL * MSEC_TO_NSEC)
 
 static const char *rtmp_stream_getname(void *unused)
 {
@@ -125,7 +120,6 @@ static void rtmp_stream_destroy(void *data)
 	dstr_free(&stream->key);
 	dstr_free(&stream->username);
 	dstr_free(&stream->password);
-	dstr_free(&stream->encoder_name);
 	dstr_free(&stream->bind_ip);
 	os_event_destroy(stream->stop_event);
 	os_sem_destroy(stream->send_sem);
@@ -134,7 +128,7 @@ static void rtmp_stream_destroy(void *data)
 #ifdef TEST_FRAMEDROPS
 	deque_free(&stream->droptest_info);
 #endif
-	deque_free(&stream->dbr_frames);
+	dbr_estimator_free(&stream->dbr);
 	pthread_mutex_destroy(&stream->dbr_mutex);
 
 	os_event_destroy(stream->buffer_space_available_event);
@@ -396,7 +390,7 @@ static int handle_socket_read(struct rtmp_stream *stream)
 	return 0;
 }
 
-static int send_packet(struct rtmp_stream *stream, struct encoder_packet *packet, bool is_header)
+static int send_packet(struct rtmp_stream *stream, struct encoder_packet *packet)
 {
 	uint8_t *data;
 	size_t size;
@@ -405,7 +399,7 @@ static int send_packet(struct rtmp_stream *stream, struct encoder_packet *packet
 	if (handle_socket_read(stream))
 		return -1;
 
-	flv_packet_mux(packet, is_header ? 0 : stream->start_dts_offset, &data, &size, is_header);
+	flv_packet_mux(packet, stream->start_dts_offset, &data, &size, false);
 
 #ifdef TEST_FRAMEDROPS
 	droptest_cap_data_rate(stream, size);
@@ -414,17 +408,13 @@ static int send_packet(struct rtmp_stream *stream, struct encoder_packet *packet
 	ret = RTMP_Write(&stream->rtmp, (char *)data, (int)size, 0);
 	bfree(data);
 
-	if (is_header)
-		bfree(packet->data);
-	else
-		obs_encoder_packet_release(packet);
+	obs_encoder_packet_release(packet);
 
 	stream->total_bytes_sent += size;
 	return ret;
 }
 
-static int send_packet_ex(struct rtmp_stream *stream, struct encoder_packet *packet, bool is_header, bool is_footer,
-			  size_t idx)
+static int send_packet_ex(struct rtmp_stream *stream, struct encoder_packet *packet, size_t idx)
 {
 	uint8_t *data;
 	size_t size = 0;
@@ -433,13 +423,7 @@ static int send_packet_ex(struct rtmp_stream *stream, struct encoder_packet *pac
 	if (handle_socket_read(stream))
 		return -1;
 
-	if (is_header) {
-		flv_packet_start(packet, stream->video_codec[idx], &data, &size, idx);
-	} else if (is_footer) {
-		flv_packet_end(packet, stream->video_codec[idx], &data, &size, idx);
-	} else {
-		flv_packet_frames(packet, stream->video_codec[idx], stream->start_dts_offset, &data, &size, idx);
-	}
+	flv_packet_frames(packet, stream->video_codec[idx], stream->start_dts_offset, &data, &size, idx);
 
 #ifdef TEST_FRAMEDROPS
 	droptest_cap_data_rate(stream, size);
@@ -448,16 +432,13 @@ static int send_packet_ex(struct rtmp_stream *stream, struct encoder_packet *pac
 	ret = RTMP_Write(&stream->rtmp, (char *)data, (int)size, 0);
 	bfree(data);
 
-	if (is_header || is_footer) // manually created packets
-		bfree(packet->data);
-	else
-		obs_encoder_packet_release(packet);
+	obs_encoder_packet_release(packet);
 
 	stream->total_bytes_sent += size;
 	return ret;
 }
 
-static int send_audio_packet_ex(struct rtmp_stream *stream, struct encoder_packet *packet, bool is_header, size_t idx)
+static int send_audio_packet_ex(struct rtmp_stream *stream, struct encoder_packet *packet, size_t idx)
 {
 	uint8_t *data;
 	size_t size = 0;
@@ -466,23 +447,28 @@ static int send_audio_packet_ex(struct rtmp_stream *stream, struct encoder_packe
 	if (handle_socket_read(stream))
 		return -1;
 
-	if (is_header) {
-		flv_packet_audio_start(packet, stream->audio_codec[idx], &data, &size, idx);
-	} else {
-		flv_packet_audio_frames(packet, stream->audio_codec[idx], stream->start_dts_offset, &data, &size, idx);
-	}
+	flv_packet_audio_frames(packet, stream->audio_codec[idx], stream->start_dts_offset, &data, &size, idx);
 
 	ret = RTMP_Write(&stream->rtmp, (char *)data, (int)size, 0);
 	bfree(data);
 
-	if (is_header)
-		bfree(packet->data);
-	else
-		obs_encoder_packet_release(packet);
+	obs_encoder_packet_release(packet);
 
 	return ret;
 }
 
+/* enhanced RTMP for everything but the first H.264 track */
+static inline bool is_video_ex(struct rtmp_stream *stream, struct encoder_packet *packet)
+{
+	return packet->type == OBS_ENCODER_VIDEO &&
+	       (stream->video_codec[packet->track_idx] != CODEC_H264 || packet->track_idx != 0);
+}
+
+static inline bool is_audio_ex(struct encoder_packet *packet)
+{
+	return packet->type == OBS_ENCODER_AUDIO && packet->track_idx != 0;
+}
+
 static inline bool send_headers(struct rtmp_stream *stream);
 static inline bool send_footers(struct rtmp_stream *stream);
 
@@ -497,6 +483,77 @@ static inline bool can_shutdown_stream(struct rtmp_stream *stream, struct encode
 	return timeout || packet->sys_dts_usec >= (int64_t)stream->stop_ts;
 }
 
+#ifndef _WIN32
+static inline bool can_batch(struct rtmp_stream *stream)
+{
+	return !stream->new_socket_loop && !stream->rtmp.m_bCustomSend &&
+	       !(stream->rtmp.Link.protocol & (RTMP_FEATURE_HTTP | RTMP_FEATURE_SSL));
+}
+
+/* Same FLV tags as send_packet(), send_packet_ex() and send_audio_packet_ex(),
+ * but the packet data is sent from where it is */
+static bool add_batch_packet(struct rtmp_stream *stream, struct encoder_packet *packet)
+{
+	struct serializer *s = rtmp_batch_tag(&stream->batch);
+	size_t idx = packet->track_idx;
+	size_t size;
+
+	if (is_video_ex(stream, packet))
+		flv_packet_frames_header(s, packet, stream->video_codec[idx], stream->start_dts_offset, idx);
+	else if (is_audio_ex(packet))
+		flv_packet_audio_frames_header(s, packet, stream->audio_codec[idx], stream->start_dts_offset, idx);
+	else
+		flv_packet_mux_header(s, packet, stream->start_dts_offset);
+
+	/* header, data and previous tag size */
+	size = stream->batch.tag_data.bytes.num ? stream->batch.tag_data.bytes.num + packet->size + 4 : 0;
+
+#ifdef TEST_FRAMEDROPS
+	if (!is_audio_ex(packet))
+		droptest_cap_data_rate(stream, size);
+#endif
+
+	/* send_audio_packet_ex() doesn't count its bytes either */
+	if (!is_audio_ex(packet))
+		stream->total_bytes_sent += size;
+
+	return rtmp_batch_add(&stream->batch, packet);
+}
+
+/* Sends the packet along with whatever else is already queued.  The whole
+ * batch counts as one frame for the bitrate estimate, and shutdown is set if
+ * one of the queued packets is past the stop time. */
+static int send_batch(struct rtmp_stream *stream, struct encoder_packet *packet, struct dbr_frame *dbr_frame,
+		      bool *shutdown)
+{
+	struct encoder_packet next;
+
+	if (handle_socket_read(stream)) {
+		obs_encoder_packet_release(packet);
+		return -1;
+	}
+
+	if (!add_batch_packet(stream, packet))
+		return -1;
+
+	while (!rtmp_batch_full(&stream->batch) && get_next_packet(stream, &next)) {
+		if (stopping(stream) && can_shutdown_stream(stream, &next)) {
+			obs_encoder_packet_release(&next);
+			*shutdown = true;
+			break;
+		}
+
+		if (stream->dbr_enabled)
+			dbr_frame->size += next.size;
+
+		if (!add_batch_packet(stream, &next))
+			return -1;
+	}
+
+	return rtmp_batch_send(&stream->batch);
+}
+#endif
+
 static void set_output_error(struct rtmp_stream *stream)
 {
 	const char *msg = NULL;
@@ -582,36 +639,34 @@ static void set_output_error(struct rtmp_stream *stream)
 		obs_output_set_last_error(stream->output, msg);
 }
 
-static void dbr_add_frame(struct rtmp_stream *stream, struct dbr_frame *back)
-{
-	struct dbr_frame front;
-	uint64_t dur;
+static void dbr_set_bitrate(struct rtmp_stream *stream);
 
-	deque_push_back(&stream->dbr_frames, back, sizeof(*back));
-	deque_peek_front(&stream->dbr_frames, &front, sizeof(front));
+/* Feeds the send to the bandwidth estimate, then holds off the next one so
+ * the stream goes out at the pacing rate instead of in bursts */
+static void dbr_after_send(struct rtmp_stream *stream, struct dbr_frame *frame)
+{
+	struct dbr_sample sample;
+	uint64_t next_send;
 
-	stream->dbr_data_size += back->size;
+	frame->send_end = os_gettime_ns();
 
-	dur = (back->send_end - front.send_beg) / 1000000;
+	pthread_mutex_lock(&stream->dbr_mutex);
+	dbr_estimator_add_send(&stream->dbr, frame->send_beg, frame->send_end, frame->size);
 
-	if (dur >= MAX_ESTIMATE_DURATION_MS) {
-		stream->dbr_data_size -= front.size;
-		deque_pop_front(&stream->dbr_frames, NULL, sizeof(front));
+	if (frame->send_end >= stream->dbr_next_sample_ts &&
+	    dbr_socket_sample((int)stream->rtmp.m_sb.sb_socket, frame->send_end, &sample)) {
+		dbr_estimator_add_sample(&stream->dbr, &sample);
+		stream->dbr_next_sample_ts = frame->send_end + DBR_SAMPLE_INTERVAL_NS;
 	}
 
-	stream->dbr_est_bitrate = (dur >= MIN_ESTIMATE_DURATION_MS) ? (long)(stream->dbr_data_size * 1000 / dur) : 0;
-	stream->dbr_est_bitrate *= 8;
-	stream->dbr_est_bitrate /= 1000;
+	next_send = dbr_estimator_pace(&stream->dbr, frame->size, frame->send_end);
+	pthread_mutex_unlock(&stream->dbr_mutex);
 
-	if (stream->dbr_est_bitrate) {
-		stream->dbr_est_bitrate -= stream->audio_bitrate;
-		if (stream->dbr_est_bitrate < 50)
-			stream->dbr_est_bitrate = 50;
-	}
+	/* with the socket thread, sends only go to its buffer */
+	if (!stream->new_socket_loop && next_send > frame->send_end)
+		os_sleepto_ns(next_send);
 }
 
-static void dbr_set_bitrate(struct rtmp_stream *stream);
-
 #ifdef _WIN32
 #define socklen_t int
 
@@ -634,11 +689,19 @@ static void *send_thread(void *data)
 
 #ifdef _WIN32
 	log_sndbuf_size(stream);
+#else
+	stream->batching = can_batch(stream);
+	if (stream->batching) {
+		rtmp_batch_init(&stream->batch, &stream->rtmp, stream->zerocopy);
+		if (stream->batch.zerocopy)
+			info("Sending with MSG_ZEROCOPY");
+	}
 #endif
 
 	while (os_sem_wait(stream->send_sem) == 0) {
 		struct encoder_packet packet;
 		struct dbr_frame dbr_frame;
+		bool shutdown = false;
 
 		if (stopping(stream) && stream->stop_ts == 0) {
 			break;
@@ -667,14 +730,17 @@ static void *send_thread(void *data)
 		}
 
 		int sent;
-		if (packet.type == OBS_ENCODER_VIDEO &&
-		    (stream->video_codec[packet.track_idx] != CODEC_H264 ||
-		     (stream->video_codec[packet.track_idx] == CODEC_H264 && packet.track_idx != 0))) {
-			sent = send_packet_ex(stream, &packet, false, false, packet.track_idx);
-		} else if (packet.type == OBS_ENCODER_AUDIO && packet.track_idx != 0) {
-			sent = send_audio_packet_ex(stream, &packet, false, packet.track_idx);
+#ifndef _WIN32
+		if (stream->batching) {
+			sent = send_batch(stream, &packet, &dbr_frame, &shutdown);
+		} else
+#endif
+		if (is_video_ex(stream, &packet)) {
+			sent = send_packet_ex(stream, &packet, packet.track_idx);
+		} else if (is_audio_ex(&packet)) {
+			sent = send_audio_packet_ex(stream, &packet, packet.track_idx);
 		} else {
-			sent = send_packet(stream, &packet, false);
+			sent = send_packet(stream, &packet);
 		}
 
 		if (sent < 0) {
@@ -682,13 +748,11 @@ static void *send_thread(void *data)
 			break;
 		}
 
-		if (stream->dbr_enabled) {
-			dbr_frame.send_end = os_gettime_ns();
+		if (stream->dbr_enabled)
+			dbr_after_send(stream, &dbr_frame);
 
-			pthread_mutex_lock(&stream->dbr_mutex);
-			dbr_add_frame(stream, &dbr_frame);
-			pthread_mutex_unlock(&stream->dbr_mutex);
-		}
+		if (shutdown)
+			break;
 	}
 
 	bool encode_error = os_atomic_load_bool(&stream->encode_error);
@@ -719,10 +783,17 @@ static void *send_thread(void *data)
 
 	RTMP_Close(&stream->rtmp);
 
+#ifndef _WIN32
+	if (stream->batching) {
+		rtmp_batch_free(&stream->batch);
+		stream->batching = false;
+	}
+#endif
+
 	/* reset bitrate on stop */
 	if (stream->dbr_enabled) {
-		if (stream->dbr_cur_bitrate != stream->dbr_orig_bitrate) {
-			stream->dbr_cur_bitrate = stream->dbr_orig_bitrate;
+		if (stream->dbr.cur_bitrate != stream->dbr.orig_bitrate) {
+			stream->dbr.cur_bitrate = stream->dbr.orig_bitrate;
 			dbr_set_bitrate(stream);
 		}
 	}
@@ -757,73 +828,6 @@ static bool send_meta_data(struct rtmp_stream *stream)
 	return success;
 }
 
-static bool send_audio_header(struct rtmp_stream *stream, size_t idx, bool *next)
-{
-	obs_output_t *context = stream->output;
-	obs_encoder_t *aencoder = obs_output_get_audio_encoder(context, idx);
-	uint8_t *header;
-
-	struct encoder_packet packet = {.type = OBS_ENCODER_AUDIO, .timebase_den = 1};
-
-	if (!aencoder) {
-		*next = false;
-		return true;
-	}
-
-	if (obs_encoder_get_extra_data(aencoder, &header, &packet.size)) {
-		packet.data = bmemdup(header, packet.size);
-		if (idx == 0) {
-			return send_packet(stream, &packet, true) >= 0;
-		} else {
-			return send_audio_packet_ex(stream, &packet, true, idx) >= 0;
-		}
-	}
-	return false;
-}
-
-static bool send_video_header(struct rtmp_stream *stream, size_t idx)
-{
-	obs_output_t *context = stream->output;
-	obs_encoder_t *vencoder = obs_output_get_video_encoder2(context, idx);
-	uint8_t *header;
-	size_t size;
-
-	struct encoder_packet packet = {.type = OBS_ENCODER_VIDEO, .timebase_den = 1, .keyframe = true};
-
-	if (!vencoder)
-		return false;
-
-	if (!obs_encoder_get_extra_data(vencoder, &header, &size))
-		return false;
-
-	switch (stream->video_codec[idx]) {
-	case CODEC_NONE:
-		do_log(LOG_ERROR, "Codec not initialized for track %zu while sending header", idx);
-		return false;
-
-	case CODEC_H264:
-		packet.size = obs_parse_avc_header(&packet.data, header, size);
-		// Always send H.264 on track 0 as old style for compatibility.
-		if (idx == 0) {
-			return send_packet(stream, &packet, true) >= 0;
-		} else {
-			return send_packet_ex(stream, &packet, true, false, idx) >= 0;
-		}
-	case CODEC_HEVC:
-#ifdef ENABLE_HEVC
-		packet.size = obs_parse_hevc_header(&packet.data, header, size);
-		return send_packet_ex(stream, &packet, true, false, idx) >= 0;
-#else
-		return false;
-#endif
-	case CODEC_AV1:
-		packet.size = obs_parse_av1_header(&packet.data, header, size);
-		return send_packet_ex(stream, &packet, true, false, idx) >= 0;
-	}
-
-	return false;
-}
-
 // only returns false if there's an error, not if no metadata needs to be sent
 static bool send_video_metadata(struct rtmp_stream *stream, size_t idx)
 {
@@ -917,55 +921,45 @@ static bool send_video_metadata(struct rtmp_stream *stream, size_t idx)
 	return true;
 }
 
-static bool send_video_footer(struct rtmp_stream *stream, size_t idx)
+static bool send_tag(struct rtmp_stream *stream, const uint8_t *data, size_t size)
 {
-	struct encoder_packet packet = {.type = OBS_ENCODER_VIDEO, .timebase_den = 1, .keyframe = false};
-	packet.size = 0;
+	if (handle_socket_read(stream))
+		return false;
 
-	return send_packet_ex(stream, &packet, false, true, idx) >= 0;
+#ifdef TEST_FRAMEDROPS
+	droptest_cap_data_rate(stream, size);
+#endif
+
+	stream->total_bytes_sent += size;
+	return RTMP_Write(&stream->rtmp, (const char *)data, (int)size, 0) >= 0;
 }
 
-static inline bool send_headers(struct rtmp_stream *stream)
+static bool send_header(void *param, enum obs_encoder_type type, size_t idx, const uint8_t *data, size_t size)
 {
-	stream->sent_headers = true;
-	size_t i = 0;
-	bool next = true;
+	struct rtmp_stream *stream = param;
 
-	if (!send_audio_header(stream, i++, &next))
+	if (type == OBS_ENCODER_VIDEO && !send_video_metadata(stream, idx))
 		return false;
 
-	for (size_t j = 0; j < MAX_OUTPUT_VIDEO_ENCODERS; j++) {
-		obs_encoder_t *enc = obs_output_get_video_encoder2(stream->output, j);
-		if (!enc)
-			continue;
-
-		if (!send_video_metadata(stream, j) || !send_video_header(stream, j))
-			return false;
-	}
+	return send_tag(stream, data, size);
+}
 
-	while (next) {
-		if (!send_audio_header(stream, i++, &next))
-			return false;
-	}
+static bool send_footer(void *param, enum obs_encoder_type type, size_t idx, const uint8_t *data, size_t size)
+{
+	UNUSED_PARAMETER(type);
+	UNUSED_PARAMETER(idx);
+	return send_tag(param, data, size);
+}
 
-	return true;
+static inline bool send_headers(struct rtmp_stream *stream)
+{
+	stream->sent_headers = true;
+	return rtmp_write_headers(stream->output, stream->audio_codec, stream->video_codec, send_header, stream);
 }
 
 static inline bool send_footers(struct rtmp_stream *stream)
 {
-	for (size_t i = 0; i < MAX_OUTPUT_VIDEO_ENCODERS; i++) {
-		obs_encoder_t *encoder = obs_output_get_video_encoder2(stream->output, i);
-		if (!encoder)
-			continue;
-
-		if (i == 0 && stream->video_codec[i] == CODEC_H264)
-			continue;
-
-		if (!send_video_footer(stream, i))
-			return false;
-	}
-
-	return true;
+	return rtmp_write_footers(stream->output, stream->video_codec, send_footer, stream);
 }
 
 static inline bool reset_semaphore(struct rtmp_stream *stream)
@@ -1170,19 +1164,11 @@ static int try_connect(struct rtmp_stream *stream)
 	// free any existing RTMP TLS context
 	RTMP_TLS_Free(&stream->rtmp);
 
-	RTMP_Init(&stream->rtmp);
-
-	if (!RTMP_SetupURL(&stream->rtmp, stream->path.array))
+	if (!rtmp_setup_publish(&stream->rtmp, stream->path.array, stream->key.array))
 		return OBS_OUTPUT_BAD_PATH;
 
-	RTMP_EnableWrite(&stream->rtmp);
-
-	dstr_copy(&stream->encoder_name, "FMLE/3.0 (compatible; FMSc/1.0)");
-
 	set_rtmp_dstr(&stream->rtmp.Link.pubUser, &stream->username);
 	set_rtmp_dstr(&stream->rtmp.Link.pubPasswd, &stream->password);
-	set_rtmp_dstr(&stream->rtmp.Link.flashVer, &stream->encoder_name);
-	stream->rtmp.Link.swfUrl = stream->rtmp.Link.tcUrl;
 
 	if (dstr_is_empty(&stream->bind_ip) || dstr_cmp(&stream->bind_ip, "default") == 0) {
 		memset(&stream->rtmp.m_bindIP, 0, sizeof(stream->rtmp.m_bindIP));
@@ -1200,12 +1186,6 @@ static int try_connect(struct rtmp_stream *stream)
 	if (stream->rtmp.m_bindIP.addrLen == 0)
 		stream->rtmp.m_bindIP.addrLen = stream->addrlen_hint;
 
-	RTMP_AddStream(&stream->rtmp, stream->key.array);
-
-	stream->rtmp.m_outChunkSize = 4096;
-	stream->rtmp.m_bSendChunkSizeInfo = true;
-	stream->rtmp.m_bUseNagle = true;
-
 #ifdef _WIN32
 	win32_log_interface_type(stream);
 #endif
@@ -1284,14 +1264,10 @@ static bool init_connect(struct rtmp_stream *stream)
 		}
 	}
 
-	deque_free(&stream->dbr_frames);
-	stream->audio_bitrate = (long)obs_data_get_int(asettings, "bitrate");
-	stream->dbr_data_size = 0;
-	stream->dbr_orig_bitrate = (long)obs_data_get_int(vsettings, "bitrate");
-	stream->dbr_cur_bitrate = stream->dbr_orig_bitrate;
-	stream->dbr_est_bitrate = 0;
-	stream->dbr_inc_bitrate = stream->dbr_orig_bitrate / 10;
-	stream->dbr_inc_timeout = 0;
+	dbr_estimator_free(&stream->dbr);
+	dbr_estimator_init(&stream->dbr, (long)obs_data_get_int(vsettings, "bitrate"),
+			   (long)obs_data_get_int(asettings, "bitrate"), os_gettime_ns());
+	stream->dbr_next_sample_ts = 0;
 	stream->dbr_enabled = obs_data_get_bool(settings, OPT_DYN_BITRATE);
 
 	caps = obs_encoder_get_caps(venc);
@@ -1345,6 +1321,7 @@ static bool init_connect(struct rtmp_stream *stream)
 #else
 	stream->new_socket_loop = false;
 	stream->low_latency_mode = false;
+	stream->zerocopy = obs_data_get_bool(settings, OPT_ZEROCOPY_ENABLED);
 #endif
 
 	obs_data_release(settings);
@@ -1474,90 +1451,37 @@ static bool find_first_video_packet(struct rtmp_stream *stream, struct encoder_p
 	return false;
 }
 
-static bool dbr_bitrate_lowered(struct rtmp_stream *stream)
-{
-	long prev_bitrate = stream->dbr_prev_bitrate;
-	long est_bitrate = 0;
-	long new_bitrate;
-
-	if (stream->dbr_est_bitrate && stream->dbr_est_bitrate < stream->dbr_cur_bitrate) {
-		stream->dbr_data_size = 0;
-		deque_pop_front(&stream->dbr_frames, NULL, stream->dbr_frames.size);
-		est_bitrate = stream->dbr_est_bitrate / 100 * 100;
-		if (est_bitrate < 50) {
-			est_bitrate = 50;
-		}
-	}
-
-#if 0
-	if (prev_bitrate && est_bitrate) {
-		if (prev_bitrate < est_bitrate) {
-			blog(LOG_INFO, "going back to prev bitrate: "
-					"prev_bitrate (%d) < est_bitrate (%d)",
-					prev_bitrate,
-					est_bitrate);
-			new_bitrate = prev_bitrate;
-		} else {
-			new_bitrate = est_bitrate;
-		}
-		new_bitrate = est_bitrate;
-	} else if (prev_bitrate) {
-		new_bitrate = prev_bitrate;
-		info("going back to prev bitrate");
-
-	} else if (est_bitrate) {
-		new_bitrate = est_bitrate;
-
-	} else {
-		return false;
-	}
-#else
-	if (est_bitrate) {
-		new_bitrate = est_bitrate;
-
-	} else if (prev_bitrate) {
-		new_bitrate = prev_bitrate;
-		info("going back to prev bitrate");
-
-	} else {
-		return false;
-	}
-
-	if (new_bitrate == stream->dbr_cur_bitrate) {
-		return false;
-	}
-#endif
-
-	stream->dbr_prev_bitrate = 0;
-	stream->dbr_cur_bitrate = new_bitrate;
-	stream->dbr_inc_timeout = os_gettime_ns() + DBR_INC_TIMER;
-	info("bitrate decreased to: %ld", stream->dbr_cur_bitrate);
-	return true;
-}
-
 static void dbr_set_bitrate(struct rtmp_stream *stream)
 {
 	obs_encoder_t *vencoder = obs_output_get_video_encoder(stream->output);
 	obs_data_t *settings = obs_encoder_get_settings(vencoder);
 
-	obs_data_set_int(settings, "bitrate", stream->dbr_cur_bitrate);
+	obs_data_set_int(settings, "bitrate", stream->dbr.cur_bitrate);
 	obs_encoder_update(vencoder, settings);
 
 	obs_data_release(settings);
 }
 
-static void dbr_inc_bitrate(struct rtmp_stream *stream)
+static void dbr_update_bitrate(struct rtmp_stream *stream)
 {
-	stream->dbr_prev_bitrate = stream->dbr_cur_bitrate;
-	stream->dbr_cur_bitrate += stream->dbr_inc_bitrate;
-
-	if (stream->dbr_cur_bitrate >= stream->dbr_orig_bitrate) {
-		stream->dbr_cur_bitrate = stream->dbr_orig_bitrate;
-		info("bitrate increased to: %ld, done", stream->dbr_cur_bitrate);
-	} else if (stream->dbr_cur_bitrate < stream->dbr_orig_bitrate) {
-		stream->dbr_inc_timeout = os_gettime_ns() + DBR_INC_TIMER;
-		info("bitrate increased to: %ld, waiting", stream->dbr_cur_bitrate);
-	}
+	struct encoder_packet first;
+	int64_t buffer_duration_usec = 0;
+	long prev_bitrate, new_bitrate;
+
+	if (num_buffered_packets(stream) && find_first_video_packet(stream, &first))
+		buffer_duration_usec = stream->last_dts_usec - first.dts_usec;
+
+	pthread_mutex_lock(&stream->dbr_mutex);
+	prev_bitrate = stream->dbr.cur_bitrate;
+	new_bitrate = dbr_estimator_update(&stream->dbr, buffer_duration_usec, os_gettime_ns());
+	pthread_mutex_unlock(&stream->dbr_mutex);
+
+	if (!new_bitrate)
+		return;
+
+	debug("buffer_duration_msec: %" PRId64, buffer_duration_usec / 1000);
+	info("bitrate %s to: %ld", new_bitrate < prev_bitrate ? "decreased" : "increased", new_bitrate);
+	dbr_set_bitrate(stream);
 }
 
 static void check_to_drop_frames(struct rtmp_stream *stream, bool pframes)
@@ -1569,17 +1493,8 @@ static void check_to_drop_frames(struct rtmp_stream *stream, bool pframes)
 	int priority = pframes ? OBS_NAL_PRIORITY_HIGHEST : OBS_NAL_PRIORITY_HIGH;
 	int64_t drop_threshold = pframes ? stream->pframe_drop_threshold_usec : stream->drop_threshold_usec;
 
-	if (!pframes && stream->dbr_enabled) {
-		if (stream->dbr_inc_timeout) {
-			uint64_t t = os_gettime_ns();
-
-			if (t >= stream->dbr_inc_timeout) {
-				stream->dbr_inc_timeout = 0;
-				dbr_inc_bitrate(stream);
-				dbr_set_bitrate(stream);
-			}
-		}
-	}
+	if (!pframes && stream->dbr_enabled)
+		dbr_update_bitrate(stream);
 
 	if (num_packets < 5) {
 		if (!pframes)
@@ -1598,29 +1513,9 @@ static void check_to_drop_frames(struct rtmp_stream *stream, bool pframes)
 		stream->congestion = (float)buffer_duration_usec / (float)drop_threshold;
 	}
 
-	/* alternatively, drop only pframes:
-	 * (!pframes && stream->dbr_enabled)
-	 * but let's test without dropping frames
-	 * at all first */
-	if (stream->dbr_enabled) {
-		bool bitrate_changed = false;
-
-		if (pframes) {
-			return;
-		}
-
-		if ((uint64_t)buffer_duration_usec >= DBR_TRIGGER_USEC) {
-			pthread_mutex_lock(&stream->dbr_mutex);
-			bitrate_changed = dbr_bitrate_lowered(stream);
-			pthread_mutex_unlock(&stream->dbr_mutex);
-		}
-
-		if (bitrate_changed) {
-			debug("buffer_duration_msec: %" PRId64, buffer_duration_usec / 1000);
-			dbr_set_bitrate(stream);
-		}
+	/* with dynamic bitrate, the encoder slows down instead */
+	if (stream->dbr_enabled)
 		return;
-	}
 
 	if (buffer_duration_usec > drop_threshold) {
 		debug("buffer_duration_usec: %" PRId64, buffer_duration_usec);
@@ -1662,38 +1557,14 @@ static void rtmp_stream_data(void *data, struct encoder_packet *packet)
 		return;
 	}
 
-	if (packet->type == OBS_ENCODER_VIDEO) {
-		if (!stream->got_first_packet) {
-			stream->start_dts_offset = get_ms_time(packet, packet->dts);
-			stream->got_first_packet = true;
-		}
-
-		switch (stream->video_codec[packet->track_idx]) {
-		case CODEC_NONE:
-			do_log(LOG_ERROR, "Codec not initialized for track %zu", packet->track_idx);
-			return;
-
-		case CODEC_H264:
-			obs_parse_avc_packet(&new_packet, packet);
-			break;
-		case CODEC_HEVC:
-#ifdef ENABLE_HEVC
-			obs_parse_hevc_packet(&new_packet, packet);
-			break;
-#else
-			return;
-#endif
-		case CODEC_AV1:
-			obs_parse_av1_packet(&new_packet, packet);
-			break;
-		}
-	} else {
-		if (!stream->got_first_packet) {
-			stream->start_dts_offset = get_ms_time(packet, packet->dts);
-			stream->got_first_packet = true;
-		}
+	if (!stream->got_first_packet) {
+		stream->start_dts_offset = get_ms_time(packet, packet->dts);
+		stream->got_first_packet = true;
+	}
 
-		obs_encoder_packet_ref(&new_packet, packet);
+	if (!rtmp_parse_packet(stream->video_codec, &new_packet, packet)) {
+		do_log(LOG_ERROR, "Codec not initialized for track %zu", packet->track_idx);
+		return;
 	}
 
 	pthread_mutex_lock(&stream->packets_mutex);
@@ -1720,6 +1591,8 @@ static void rtmp_stream_defaults(obs_data_t *defaults)
 #ifdef _WIN32
 	obs_data_set_default_bool(defaults, OPT_NEWSOCKETLOOP_ENABLED, false);
 	obs_data_set_default_bool(defaults, OPT_LOWLATENCY_ENABLED, false);
+#elif defined(__linux__)
+	obs_data_set_default_bool(defaults, OPT_ZEROCOPY_ENABLED, false);
 #endif
 }
 
@@ -1757,6 +1630,8 @@ static obs_properties_t *rtmp_stream_properties(void *unused)
 #ifdef _WIN32
 	obs_properties_add_bool(props, OPT_NEWSOCKETLOOP_ENABLED, obs_module_text("RTMPStream.NewSocketLoop"));
 	obs_properties_add_bool(props, OPT_LOWLATENCY_ENABLED, obs_module_text("RTMPStream.LowLatencyMode"));
+#elif defined(__linux__)
+	obs_properties_add_bool(props, OPT_ZEROCOPY_ENABLED, obs_module_text("RTMPStream.ZeroCopy"));
 #endif
 
 	return props;
@@ -8,11 +8,13 @@
 #include "librtmp/log.h"
 #include "flv-mux.h"
 #include "net-if.h"
+#include "rtmp-dbr.h"
 
 #ifdef _WIN32
 #include <Iphlpapi.h>
 #else
 #include <sys/ioctl.h>
+#include "rtmp-batch.h"
 #endif
 
 #define do_log(level, format, ...) \
@@ -31,6 +33,7 @@
 #define OPT_NEWSOCKETLOOP_ENABLED "new_socket_loop_enabled"
 #define OPT_LOWLATENCY_ENABLED "low_latency_mode_enabled"
 #define OPT_METADATA_MULTITRACK "metadata_multitrack"
+#define OPT_ZEROCOPY_ENABLED "zerocopy_enabled"
 
 //#define TEST_FRAMEDROPS
 //#define TEST_FRAMEDROPS_WITH_BITRATE_SHORTCUTS
@@ -79,7 +82,6 @@ struct rtmp_stream {
 
 	struct dstr path, key;
 	struct dstr username, password;
-	struct dstr encoder_name;
 	struct dstr bind_ip;
 	socklen_t addrlen_hint; /* hint IPv4 vs IPv6 */
 
@@ -102,15 +104,8 @@ struct rtmp_stream {
 #endif
 
 	pthread_mutex_t dbr_mutex;
-	struct deque dbr_frames;
-	size_t dbr_data_size;
-	uint64_t dbr_inc_timeout;
-	long audio_bitrate;
-	long dbr_est_bitrate;
-	long dbr_orig_bitrate;
-	long dbr_prev_bitrate;
-	long dbr_cur_bitrate;
-	long dbr_inc_bitrate;
+	struct dbr_estimator dbr;
+	uint64_t dbr_next_sample_ts;
 	bool dbr_enabled;
 
 	enum audio_id_t audio_codec[MAX_OUTPUT_AUDIO_ENCODERS];
@@ -131,6 +126,13 @@ struct rtmp_stream {
 	os_event_t *buffer_has_data_event;
 	os_event_t *socket_available_event;
 	os_event_t *send_thread_signaled_exit;
+
+#ifndef _WIN32
+	/* used by the send thread instead of RTMP_Write() where possible */
+	bool batching;
+	bool zerocopy;
+	struct rtmp_batch batch;
+#endif
 };
 
 #ifdef _WIN32
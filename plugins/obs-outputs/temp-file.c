@@ -0,0 +1,157 @@
+/******************************************************************************
+    Copyright (C) 2024 by Dennis Sädtler <dennis@obsproject.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#if defined(__linux__)
+#define _GNU_SOURCE
+#endif
+
+#include "temp-file.h"
+
+#include <errno.h>
+#include <string.h>
+
+#include <util/bmem.h>
+#include <util/dstr.h>
+#include <util/platform.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <fcntl.h>
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+static FILE *open_temp_file(const char *path)
+{
+	wchar_t *wpath = NULL;
+	HANDLE handle;
+	FILE *file;
+	int fd;
+
+	if (!os_utf8_to_wcs_ptr(path, 0, &wpath))
+		return NULL;
+
+	handle = CreateFileW(wpath, GENERIC_READ | GENERIC_WRITE, 0, NULL, CREATE_NEW,
+			     FILE_ATTRIBUTE_TEMPORARY | FILE_FLAG_DELETE_ON_CLOSE, NULL);
+	bfree(wpath);
+
+	if (handle == INVALID_HANDLE_VALUE)
+		return NULL;
+
+	fd = _open_osfhandle((intptr_t)handle, _O_RDWR | _O_BINARY);
+	if (fd == -1) {
+		CloseHandle(handle);
+		return NULL;
+	}
+
+	file = _fdopen(fd, "w+b");
+	if (!file)
+		_close(fd);
+	return file;
+}
+#else
+static FILE *open_temp_file(const char *path)
+{
+	FILE *file;
+	int fd;
+
+	fd = open(path, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+	if (fd == -1)
+		return NULL;
+
+	/* only reachable through the descriptor from here on */
+	unlink(path);
+
+	file = fdopen(fd, "w+b");
+	if (!file)
+		close(fd);
+	return file;
+}
+#endif
+
+/* Fallback for file systems without a way to reserve space */
+static bool write_zeros(FILE *file, uint64_t size)
+{
+	const size_t block_size = 1024 * 1024;
+	uint8_t *zeros = bzalloc(block_size);
+	bool success = os_fseeki64(file, 0, SEEK_SET) == 0;
+
+	while (success && size) {
+		size_t part = size < block_size ? (size_t)size : block_size;
+
+		success = fwrite(zeros, 1, part, file) == part;
+		size -= part;
+	}
+
+	bfree(zeros);
+	return success && fflush(file) == 0;
+}
+
+#ifdef _WIN32
+bool temp_file_allocate(FILE *file, uint64_t size)
+{
+	HANDLE handle = (HANDLE)_get_osfhandle(_fileno(file));
+	FILE_ALLOCATION_INFO alloc_info = {0};
+	FILE_END_OF_FILE_INFO eof_info = {0};
+
+	if (handle == INVALID_HANDLE_VALUE)
+		return false;
+
+	alloc_info.AllocationSize.QuadPart = (LONGLONG)size;
+	eof_info.EndOfFile.QuadPart = (LONGLONG)size;
+
+	if (!SetFileInformationByHandle(handle, FileAllocationInfo, &alloc_info, sizeof(alloc_info)))
+		return write_zeros(file, size);
+
+	return !!SetFileInformationByHandle(handle, FileEndOfFileInfo, &eof_info, sizeof(eof_info));
+}
+#else
+bool temp_file_allocate(FILE *file, uint64_t size)
+{
+#if defined(__linux__) || defined(__FreeBSD__)
+	/* returns the error instead of setting errno */
+	int ret = posix_fallocate(fileno(file), 0, (off_t)size);
+
+	if (ret == 0)
+		return true;
+	if (ret != EOPNOTSUPP && ret != EINVAL) {
+		errno = ret;
+		return false;
+	}
+#endif
+
+	return write_zeros(file, size);
+}
+#endif
+
+FILE *temp_file_create(const char *dir, const char *prefix)
+{
+	struct dstr path = {0};
+	char *uuid = os_generate_uuid();
+	FILE *file;
+
+	dstr_printf(&path, "%s/.%s-%s.tmp", dir, prefix, uuid);
+	file = open_temp_file(path.array);
+
+	dstr_free(&path);
+	bfree(uuid);
+	return file;
+}
@@ -0,0 +1,39 @@
+/******************************************************************************
+    Copyright (C) 2024 by Dennis Sädtler <dennis@obsproject.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+#include <stdio.h>
+
+#include <util/c99defs.h>
+
+/*
+ * Files for data an output moves out of memory while it runs.
+ *
+ * Unlike tmpfile(), the file is created in a given directory, usually the
+ * one the output writes to, as the system's temporary directory is often
+ * small or in memory.  It's removed once closed, or right away on systems
+ * that allow removing open files, so nothing is left behind after a crash.
+ */
+
+/* Returns NULL if the file couldn't be created */
+FILE *temp_file_create(const char *dir, const char *prefix);
+
+/* Reserves size bytes of disk space for the file and sets its size, so that
+ * running out of space shows up now rather than on a later write.  Only to be
+ * called on a newly created file. */
+bool temp_file_allocate(FILE *file, uint64_t size);
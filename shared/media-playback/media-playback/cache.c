@@ -542,6 +542,7 @@ bool mp_cache_init(mp_cache_t *c, const struct mp_media_info *info)
 	info2.v_preload_cb = NULL;
 	info2.v_seek_cb = NULL;
 	info2.stop_cb = NULL;
+	info2.output_source = NULL;
 	info2.full_decode = true;
 
 	mp_media_t *m = &c->m;
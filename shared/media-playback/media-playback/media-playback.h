@@ -34,6 +34,11 @@ struct mp_media_info {
 	mp_audio_cb a_cb;
 	mp_stop_cb stop_cb;
 
+	/* if set, frames that need pixel format conversion are converted
+	 * straight into frames acquired from this source and output without
+	 * going through v_cb */
+	obs_source_t *output_source;
+
 	const char *path;
 	const char *format;
 	char *ffmpeg_options;
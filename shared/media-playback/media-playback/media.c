@@ -373,6 +373,41 @@ void mp_media_next_audio(mp_media_t *m)
 	m->a_cb(m->opaque, &audio);
 }
 
+/* converts straight into a frame from the output source's frame pool rather
+ * than into scale_pic, which the source would then have to copy again */
+static bool mp_media_output_scaled_frame(mp_media_t *m, const struct obs_source_frame *info, AVFrame *f)
+{
+	struct obs_source_frame *out =
+		obs_source_acquire_output_frame(m->output_source, info->format, info->width, info->height);
+	int linesizes[MAX_AV_PLANES];
+
+	if (!out)
+		return false;
+
+	for (size_t i = 0; i < MAX_AV_PLANES; i++)
+		linesizes[i] = (int)out->linesize[i];
+
+	int ret = sws_scale(m->swscale, (const uint8_t *const *)f->data, f->linesize, 0, f->height, out->data,
+			    linesizes);
+	if (ret < 0) {
+		obs_source_discard_output_frame(m->output_source, out);
+		return true;
+	}
+
+	out->timestamp = info->timestamp;
+	out->full_range = info->full_range;
+	out->max_luminance = info->max_luminance;
+	out->flip = info->flip;
+	out->flags = info->flags;
+	out->trc = info->trc;
+	memcpy(out->color_matrix, info->color_matrix, sizeof(out->color_matrix));
+	memcpy(out->color_range_min, info->color_range_min, sizeof(out->color_range_min));
+	memcpy(out->color_range_max, info->color_range_max, sizeof(out->color_range_max));
+
+	obs_source_commit_output_frame(m->output_source, out);
+	return true;
+}
+
 void mp_media_next_video(mp_media_t *m, bool preload)
 {
 	struct mp_decode *d = &m->v;
@@ -396,11 +431,6 @@ void mp_media_next_video(mp_media_t *m, bool preload)
 
 	bool flip = false;
 	if (m->swscale) {
-		int ret = sws_scale(m->swscale, (const uint8_t *const *)f->data, f->linesize, 0, f->height,
-				    m->scale_pic, m->scale_linesizes);
-		if (ret < 0)
-			return;
-
 		flip = m->scale_linesizes[0] < 0 && m->scale_linesizes[1] == 0;
 		for (size_t i = 0; i < 4; i++) {
 			frame->data[i] = m->scale_pic[i];
@@ -479,6 +509,16 @@ void mp_media_next_video(mp_media_t *m, bool preload)
 		d->got_first_keyframe = true;
 	}
 
+	if (m->swscale) {
+		if (!preload && m->output_source && mp_media_output_scaled_frame(m, frame, f))
+			return;
+
+		int ret = sws_scale(m->swscale, (const uint8_t *const *)f->data, f->linesize, 0, f->height,
+				    m->scale_pic, m->scale_linesizes);
+		if (ret < 0)
+			return;
+	}
+
 	if (preload) {
 		if (m->seek_next_ts && m->v_seek_cb) {
 			m->v_seek_cb(m->opaque, frame);
@@ -874,6 +914,7 @@ bool mp_media_init(mp_media_t *media, const struct mp_media_info *info)
 	media->opaque = info->opaque;
 	media->v_cb = info->v_cb;
 	media->a_cb = info->a_cb;
+	media->output_source = info->output_source;
 	media->stop_cb = info->stop_cb;
 	media->ffmpeg_options = info->ffmpeg_options;
 	media->v_seek_cb = info->v_seek_cb;
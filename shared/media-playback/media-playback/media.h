@@ -47,6 +47,7 @@ struct mp_media {
 	mp_video_cb v_cb;
 	mp_audio_cb a_cb;
 	void *opaque;
+	obs_source_t *output_source;
 
 	char *path;
 	char *format_name;
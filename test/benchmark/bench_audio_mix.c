@@ -0,0 +1,58 @@
+#include <stdio.h>
+
+#include <obs-audio-mix.h>
+#include <media-io/audio-io.h>
+#include <util/platform.h>
+
+#define MIXES 6
+#define CHANNELS 2
+#define TICKS 100000
+
+static void mix_audio_channel_scalar(float *mix, const float *aud, size_t count)
+{
+	for (size_t i = 0; i < count; i++)
+		mix[i] += aud[i];
+}
+
+typedef void (*mix_func_t)(float *mix, const float *aud, size_t count);
+
+static float mix[MIXES][CHANNELS][AUDIO_OUTPUT_FRAMES + 1];
+static float aud[MIXES][CHANNELS][AUDIO_OUTPUT_FRAMES + 1];
+
+/* start_point shifts the buffers off their alignment like a source that
+ * starts within the tick */
+static void bench(const char *name, mix_func_t func, size_t start_point)
+{
+	size_t count = AUDIO_OUTPUT_FRAMES - start_point;
+	uint64_t start = os_gettime_ns();
+
+	for (size_t tick = 0; tick < TICKS; tick++) {
+		for (size_t mix_idx = 0; mix_idx < MIXES; mix_idx++) {
+			for (size_t ch = 0; ch < CHANNELS; ch++)
+				func(mix[mix_idx][ch] + start_point, aud[mix_idx][ch], count);
+		}
+	}
+
+	double ns = (double)(os_gettime_ns() - start) / TICKS;
+	printf("%-24s start %zu: %8.1f ns per tick\n", name, start_point, ns);
+}
+
+int main(void)
+{
+	for (size_t mix_idx = 0; mix_idx < MIXES; mix_idx++) {
+		for (size_t ch = 0; ch < CHANNELS; ch++) {
+			for (size_t i = 0; i < AUDIO_OUTPUT_FRAMES + 1; i++)
+				aud[mix_idx][ch][i] = (float)i / AUDIO_OUTPUT_FRAMES;
+		}
+	}
+
+	printf("%d mixes, %d channels, %d ticks\n", MIXES, CHANNELS, TICKS);
+
+	for (size_t start_point = 0; start_point < 2; start_point++) {
+		bench("scalar", mix_audio_channel_scalar, start_point);
+		bench("mix_audio_channel", mix_audio_channel, start_point);
+	}
+
+	/* keeps the stores from being optimized out */
+	return mix[0][0][AUDIO_OUTPUT_FRAMES / 2] < 0.0f;
+}
@@ -0,0 +1,97 @@
+#include <stdio.h>
+
+#include <graphics/effect.h>
+#include <util/platform.h>
+
+#define BENCH_ITEMS 200
+#define BENCH_FRAMES 5000
+
+/* The param lookups render_item_texture does for each of 200 scaled scene
+ * items per frame, by name with the old linear scan and by ID.  There's no
+ * graphics device here, so it's the lookups alone without the draws. */
+
+/* the params of the scale effects (bicubic_scale.effect etc.) that scene
+ * items are drawn with, in the order they're declared */
+static const char *param_names[] = {
+	"ViewProj", "image", "base_dimension", "base_dimension_i", "undistort_factor", "multiplier",
+};
+
+static void create_effect(gs_effect_t *effect, const char **names, size_t num)
+{
+	effect_init(effect);
+	da_resize(effect->params, num);
+
+	for (size_t i = 0; i < num; i++) {
+		struct gs_effect_param *param = effect->params.array + i;
+
+		effect_param_init(param);
+		param->name = bstrdup(names[i]);
+		param->id = gs_effect_param_id(names[i]);
+		param->section = EFFECT_PARAM;
+		param->effect = effect;
+	}
+
+	effect_build_param_table(effect);
+}
+
+static gs_eparam_t *get_param_linear(const gs_effect_t *effect, const char *name)
+{
+	for (size_t i = 0; i < effect->params.num; i++) {
+		if (strcmp(effect->params.array[i].name, name) == 0)
+			return effect->params.array + i;
+	}
+
+	return NULL;
+}
+
+static void print_result(const char *name, uint64_t start)
+{
+	double ns = (double)(os_gettime_ns() - start) / BENCH_FRAMES;
+	printf("%-32s %8.0f ns/frame\n", name, ns);
+}
+
+int main(void)
+{
+	gs_effect_t effect;
+	volatile uintptr_t sink = 0;
+	uint64_t start;
+
+	create_effect(&effect, param_names, sizeof(param_names) / sizeof(param_names[0]));
+
+	start = os_gettime_ns();
+	for (size_t frame = 0; frame < BENCH_FRAMES; frame++) {
+		for (size_t item = 0; item < BENCH_ITEMS; item++) {
+			sink += (uintptr_t)get_param_linear(&effect, "base_dimension");
+			sink += (uintptr_t)get_param_linear(&effect, "base_dimension_i");
+			sink += (uintptr_t)get_param_linear(&effect, "multiplier");
+		}
+	}
+	print_result("by name, linear scan", start);
+
+	start = os_gettime_ns();
+	for (size_t frame = 0; frame < BENCH_FRAMES; frame++) {
+		for (size_t item = 0; item < BENCH_ITEMS; item++) {
+			sink += (uintptr_t)gs_effect_get_param_by_name(&effect, "base_dimension");
+			sink += (uintptr_t)gs_effect_get_param_by_name(&effect, "base_dimension_i");
+			sink += (uintptr_t)gs_effect_get_param_by_name(&effect, "multiplier");
+		}
+	}
+	print_result("by name, hashed", start);
+
+	gs_param_id_t base_dimension = gs_effect_param_id("base_dimension");
+	gs_param_id_t base_dimension_i = gs_effect_param_id("base_dimension_i");
+	gs_param_id_t multiplier = gs_effect_param_id("multiplier");
+
+	start = os_gettime_ns();
+	for (size_t frame = 0; frame < BENCH_FRAMES; frame++) {
+		for (size_t item = 0; item < BENCH_ITEMS; item++) {
+			sink += (uintptr_t)gs_effect_get_param_by_id(&effect, base_dimension);
+			sink += (uintptr_t)gs_effect_get_param_by_id(&effect, base_dimension_i);
+			sink += (uintptr_t)gs_effect_get_param_by_id(&effect, multiplier);
+		}
+	}
+	print_result("by ID", start);
+
+	effect_free(&effect);
+	return 0;
+}
@@ -0,0 +1,226 @@
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <util/platform.h>
+#include <util/threading.h>
+
+#include "ffmpeg-mux.h"
+#include "ffmpeg-mux-shm.h"
+
+/* Pushes a minute of a 60 FPS, 50 Mbps video track with four audio tracks
+ * through a pipe the way obs-ffmpeg-mux reads stdin, and through the shared
+ * memory ring. */
+
+#define BENCH_SECONDS 60
+#define BENCH_FPS 60
+#define BENCH_KEYINT 120
+#define BENCH_AUDIO_TRACKS 4
+#define BENCH_AUDIO_PKTS 47
+
+struct reader {
+	const char *name;
+	struct ffm_shm *shm;
+	uint64_t bytes;
+	uint64_t packets;
+	uint64_t checksum;
+};
+
+struct bench {
+	/* pipe */
+	FILE *in;
+	FILE *out;
+
+	struct reader reader;
+};
+
+static inline uint32_t next_rand(uint32_t *seed)
+{
+	*seed = *seed * 1664525 + 1013904223;
+	return *seed >> 8;
+}
+
+static size_t pipe_read(FILE *in, void *vdata, size_t size)
+{
+	uint8_t *data = vdata;
+	size_t total = size;
+
+	while (size > 0) {
+		size_t in_size = fread(data, 1, size, in);
+		if (in_size == 0)
+			return 0;
+
+		size -= in_size;
+		data += in_size;
+	}
+
+	return total;
+}
+
+static void *pipe_bench_reader(void *param)
+{
+	struct bench *b = param;
+	struct ffm_packet_info info;
+	uint8_t *buf = NULL;
+	size_t capacity = 0;
+
+	while (pipe_read(b->in, &info, sizeof(info)) == sizeof(info)) {
+		if (capacity < info.size) {
+			capacity = info.size;
+			buf = realloc(buf, capacity);
+		}
+		if (pipe_read(b->in, buf, info.size) != info.size)
+			break;
+
+		b->reader.checksum += buf[0] + buf[info.size - 1];
+		b->reader.bytes += info.size;
+		b->reader.packets++;
+	}
+
+	free(buf);
+	return NULL;
+}
+
+static void *shm_bench_reader(void *param)
+{
+	struct bench *b = param;
+	struct reader *r = &b->reader;
+	struct ffm_packet_info info;
+
+	r->shm = ffm_shm_open(r->name);
+	if (!r->shm)
+		return NULL;
+
+	while (ffm_shm_read(r->shm, &info, sizeof(info)) == sizeof(info)) {
+		const uint8_t *data = ffm_shm_peek(r->shm, info.size);
+		if (!data)
+			break;
+
+		r->checksum += data[0] + data[info.size - 1];
+		r->bytes += info.size;
+		r->packets++;
+
+		ffm_shm_consume(r->shm, info.size);
+	}
+
+	ffm_shm_destroy(r->shm);
+	return NULL;
+}
+
+static bool bench_write(struct bench *b, struct ffm_shm *shm, const void *data, size_t size)
+{
+	if (shm)
+		return ffm_shm_write(shm, data, size);
+
+	return fwrite(data, 1, size, b->out) == size;
+}
+
+static uint64_t bench_packets(struct bench *b, struct ffm_shm *shm, const uint8_t *data, uint64_t *checksum)
+{
+	uint32_t seed = 1;
+	uint64_t bytes = 0;
+
+	for (uint64_t frame = 0; frame < BENCH_SECONDS * BENCH_FPS; frame++) {
+		bool keyframe = frame % BENCH_KEYINT == 0;
+		uint32_t size = keyframe ? 500000 + next_rand(&seed) % 200000 : 60000 + next_rand(&seed) % 80000;
+		struct ffm_packet_info info = {.pts = (int64_t)frame,
+					       .dts = (int64_t)frame,
+					       .size = size,
+					       .type = FFM_PACKET_VIDEO,
+					       .keyframe = keyframe};
+
+		if (!bench_write(b, shm, &info, sizeof(info)) || !bench_write(b, shm, data, size))
+			return bytes;
+		*checksum += data[0] + data[size - 1];
+		bytes += size;
+
+		if (frame % BENCH_FPS != 0)
+			continue;
+
+		for (uint32_t track = 0; track < BENCH_AUDIO_TRACKS; track++) {
+			for (uint32_t pkt = 0; pkt < BENCH_AUDIO_PKTS; pkt++) {
+				info.size = 300 + next_rand(&seed) % 400;
+				info.index = track;
+				info.type = FFM_PACKET_AUDIO;
+
+				if (!bench_write(b, shm, &info, sizeof(info)) || !bench_write(b, shm, data, info.size))
+					return bytes;
+				*checksum += data[0] + data[info.size - 1];
+				bytes += info.size;
+			}
+		}
+	}
+
+	return bytes;
+}
+
+int main(void)
+{
+	int ret = 0;
+	uint8_t *data = malloc(700000);
+	for (size_t i = 0; i < 700000; i++)
+		data[i] = (uint8_t)i;
+
+	for (int use_shm = 0; use_shm < 2; use_shm++) {
+		struct bench b = {0};
+		struct ffm_shm *shm = NULL;
+		uint64_t checksum = 0;
+		uint64_t bytes;
+		uint64_t start;
+		pthread_t thread;
+		double ms;
+
+		start = os_gettime_ns();
+
+		if (use_shm) {
+			shm = ffm_shm_create(FFM_SHM_DEFAULT_CAPACITY);
+			if (!shm) {
+				ret = 1;
+				break;
+			}
+
+			b.reader.name = ffm_shm_name(shm);
+			pthread_create(&thread, NULL, shm_bench_reader, &b);
+		} else {
+			int fds[2];
+			if (pipe(fds) != 0) {
+				ret = 1;
+				break;
+			}
+
+			b.in = fdopen(fds[0], "rb");
+			b.out = fdopen(fds[1], "wb");
+			pthread_create(&thread, NULL, pipe_bench_reader, &b);
+		}
+
+		bytes = bench_packets(&b, shm, data, &checksum);
+
+		if (use_shm) {
+			ffm_shm_close(shm);
+		} else {
+			fclose(b.out);
+		}
+
+		pthread_join(thread, NULL);
+		ms = (double)(os_gettime_ns() - start) / 1000000.0;
+
+		if (use_shm) {
+			ffm_shm_destroy(shm);
+		} else {
+			fclose(b.in);
+		}
+
+		if (b.reader.bytes != bytes || b.reader.checksum != checksum) {
+			printf("%s: data didn't arrive intact\n", use_shm ? "shared memory" : "pipe");
+			ret = 1;
+		}
+
+		printf("%-14s %8.1f MiB in %6" PRIu64 " packets, %8.0f ms, %8.1f MiB/s\n",
+		       use_shm ? "shared memory:" : "pipe:", (double)bytes / (1024.0 * 1024.0), b.reader.packets, ms,
+		       (double)bytes / (1024.0 * 1024.0) / (ms / 1000.0));
+	}
+
+	free(data);
+	return ret;
+}
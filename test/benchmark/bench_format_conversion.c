@@ -0,0 +1,159 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <util/bmem.h>
+#include <util/platform.h>
+#include <media-io/format-conversion.h>
+
+#define WIDTH 1920
+#define HEIGHT 1080
+#define FRAMES 500
+
+/* MPix/s of the decompress paths in format-conversion.c against plain scalar
+ * loops doing the same conversion. */
+
+static void scalar_decompress_420(const uint8_t *const input[], const uint32_t in_linesize[], uint32_t width,
+			       uint32_t height, uint8_t *output, uint32_t out_linesize)
+{
+	for (uint32_t y = 0; y < height; y++) {
+		uint32_t *out = (uint32_t *)(output + y * out_linesize);
+
+		for (uint32_t x = 0; x < width; x++) {
+			uint32_t lum = input[0][y * in_linesize[0] + x];
+			uint32_t u = input[1][(y / 2) * in_linesize[1] + x / 2];
+			uint32_t v = input[2][(y / 2) * in_linesize[2] + x / 2];
+
+			out[x] = (lum << 16) | (u << 8) | v;
+		}
+	}
+}
+
+static void scalar_decompress_nv12(const uint8_t *const input[], const uint32_t in_linesize[], uint32_t width,
+				uint32_t height, uint8_t *output, uint32_t out_linesize)
+{
+	for (uint32_t y = 0; y < height; y++) {
+		uint32_t *out = (uint32_t *)(output + y * out_linesize);
+
+		for (uint32_t x = 0; x < width; x++) {
+			uint32_t lum = input[0][y * in_linesize[0] + x];
+			uint32_t u = input[1][(y / 2) * in_linesize[1] + (x & ~1)];
+			uint32_t v = input[1][(y / 2) * in_linesize[1] + (x & ~1) + 1];
+
+			out[x] = lum | (u << 8) | (v << 16);
+		}
+	}
+}
+
+static void scalar_decompress_422(const uint8_t *input, uint32_t in_linesize, uint32_t dwords, uint32_t height,
+			       uint8_t *output, uint32_t out_linesize, bool leading_lum)
+{
+	for (uint32_t y = 0; y < height; y++) {
+		const uint32_t *in = (const uint32_t *)(input + y * in_linesize);
+		uint32_t *out = (uint32_t *)(output + y * out_linesize);
+
+		for (uint32_t x = 0; x < dwords; x++) {
+			uint32_t dw = in[x];
+
+			out[x * 2] = dw;
+			if (leading_lum)
+				out[x * 2 + 1] = (dw & 0xFFFFFF00) | ((dw >> 16) & 0xFF);
+			else
+				out[x * 2 + 1] = (dw & 0xFFFF00FF) | ((dw >> 16) & 0xFF00);
+		}
+	}
+}
+
+static uint8_t *alloc_random(size_t size)
+{
+	uint8_t *data = bmalloc(size);
+
+	for (size_t i = 0; i < size; i++)
+		data[i] = (uint8_t)rand();
+	return data;
+}
+
+static inline double mpix_per_sec(uint64_t ns)
+{
+	return (double)WIDTH * HEIGHT * FRAMES / ((double)ns / 1000.0);
+}
+
+static void print_result(const char *format, uint64_t scalar_ns, uint64_t simd_ns)
+{
+	double scalar = mpix_per_sec(scalar_ns);
+	double simd = mpix_per_sec(simd_ns);
+
+	printf("%-6s scalar %8.1f MPix/s, simd %8.1f MPix/s (%.2fx)\n", format, scalar, simd, simd / scalar);
+}
+
+int main(void)
+{
+	uint32_t out_linesize = WIDTH * 4;
+	uint8_t *out = bzalloc(out_linesize * HEIGHT);
+	uint64_t start, scalar_ns, simd_ns;
+
+	/* I420 */
+	uint32_t linesize_420[3] = {WIDTH, WIDTH / 2, WIDTH / 2};
+	uint8_t *planes_420[3] = {alloc_random(WIDTH * HEIGHT), alloc_random(WIDTH * HEIGHT / 4),
+				  alloc_random(WIDTH * HEIGHT / 4)};
+
+	start = os_gettime_ns();
+	for (int i = 0; i < FRAMES; i++)
+		scalar_decompress_420((const uint8_t *const *)planes_420, linesize_420, WIDTH, HEIGHT, out,
+				      out_linesize);
+	scalar_ns = os_gettime_ns() - start;
+
+	start = os_gettime_ns();
+	for (int i = 0; i < FRAMES; i++)
+		decompress_420((const uint8_t *const *)planes_420, linesize_420, 0, HEIGHT, out, out_linesize);
+	simd_ns = os_gettime_ns() - start;
+
+	print_result("I420", scalar_ns, simd_ns);
+
+	/* NV12 */
+	uint32_t linesize_nv12[2] = {WIDTH, WIDTH};
+	uint8_t *planes_nv12[2] = {alloc_random(WIDTH * HEIGHT), alloc_random(WIDTH * HEIGHT / 2)};
+
+	start = os_gettime_ns();
+	for (int i = 0; i < FRAMES; i++)
+		scalar_decompress_nv12((const uint8_t *const *)planes_nv12, linesize_nv12, WIDTH, HEIGHT, out,
+				       out_linesize);
+	scalar_ns = os_gettime_ns() - start;
+
+	start = os_gettime_ns();
+	for (int i = 0; i < FRAMES; i++)
+		decompress_nv12((const uint8_t *const *)planes_nv12, linesize_nv12, 0, HEIGHT, out, out_linesize);
+	simd_ns = os_gettime_ns() - start;
+
+	print_result("NV12", scalar_ns, simd_ns);
+
+	/* packed 4:2:2, UYVY has the chroma first and YUY2 the luma.
+	 * decompress_422 converts in_linesize / 2 dwords of each row, so
+	 * the rows are passed with half their size as the stride to convert
+	 * WIDTH pixels each. */
+	uint32_t linesize_422 = WIDTH;
+	uint8_t *packed_422 = alloc_random(WIDTH * 2 * HEIGHT);
+	static const char *names_422[] = {"UYVY", "YUY2"};
+
+	for (int leading_lum = 0; leading_lum < 2; leading_lum++) {
+		start = os_gettime_ns();
+		for (int i = 0; i < FRAMES; i++)
+			scalar_decompress_422(packed_422, linesize_422, WIDTH / 2, HEIGHT, out, out_linesize,
+					      leading_lum);
+		scalar_ns = os_gettime_ns() - start;
+
+		start = os_gettime_ns();
+		for (int i = 0; i < FRAMES; i++)
+			decompress_422(packed_422, linesize_422, 0, HEIGHT, out, out_linesize, leading_lum);
+		simd_ns = os_gettime_ns() - start;
+
+		print_result(names_422[leading_lum], scalar_ns, simd_ns);
+	}
+
+	bfree(packed_422);
+	bfree(planes_nv12[0]);
+	bfree(planes_nv12[1]);
+	for (size_t i = 0; i < 3; i++)
+		bfree(planes_420[i]);
+	bfree(out);
+	return 0;
+}
@@ -0,0 +1,201 @@
+#include <stdio.h>
+
+#include <util/platform.h>
+
+#include "mp4-sample-table.h"
+
+/* A 24 hour recording with one 60 FPS video track with b-frames and five AAC
+ * tracks, with a chunk per track every second.  Compares the memory used by
+ * the sample tables to the arrays the muxer used before (4 bytes per sample
+ * size and sync sample, 16 bytes per chunk, 8 bytes per delta/offset run, not
+ * counting unused capacity), and times reading them back like writing the
+ * moov does. */
+
+#define BENCH_SECONDS (24 * 60 * 60)
+#define BENCH_FPS 60
+#define BENCH_KEYINT 120
+#define BENCH_AUDIO_TRACKS 5
+/* 48 kHz AAC, 1024 samples per packet */
+#define BENCH_AUDIO_PKTS_NUM 375
+#define BENCH_AUDIO_PKTS_DEN 8
+
+struct bench_track {
+	struct sample_table sample_sizes;
+	struct sample_table chunk_offsets;
+	struct sample_table chunk_runs;
+	struct sample_table deltas;
+	struct sample_table offsets;
+	struct sample_table sync_samples;
+
+	uint32_t last_sample_size;
+	uint32_t last_run_samples;
+	uint64_t samples;
+	uint64_t old_memory;
+};
+
+static inline uint32_t next_rand(uint32_t *seed)
+{
+	*seed = *seed * 1664525 + 1013904223;
+	return *seed >> 8;
+}
+
+static void bench_track_init(struct bench_track *track, bool spill)
+{
+	memset(track, 0, sizeof(struct bench_track));
+	sample_table_init(&track->sample_sizes, spill ? "." : NULL);
+	sample_table_init(&track->chunk_offsets, spill ? "." : NULL);
+	sample_table_init(&track->chunk_runs, spill ? "." : NULL);
+	sample_table_init(&track->deltas, spill ? "." : NULL);
+	sample_table_init(&track->offsets, spill ? "." : NULL);
+	sample_table_init(&track->sync_samples, spill ? "." : NULL);
+}
+
+static void bench_track_free(struct bench_track *track)
+{
+	sample_table_free(&track->sample_sizes);
+	sample_table_free(&track->chunk_offsets);
+	sample_table_free(&track->chunk_runs);
+	sample_table_free(&track->deltas);
+	sample_table_free(&track->offsets);
+	sample_table_free(&track->sync_samples);
+}
+
+static size_t bench_track_memory(struct bench_track *track)
+{
+	return sample_table_memory(&track->sample_sizes) + sample_table_memory(&track->chunk_offsets) +
+	       sample_table_memory(&track->chunk_runs) + sample_table_memory(&track->deltas) +
+	       sample_table_memory(&track->offsets) + sample_table_memory(&track->sync_samples);
+}
+
+static void push_sample(struct bench_track *track, uint32_t size)
+{
+	sample_table_push_signed(&track->sample_sizes, (int64_t)size - (int64_t)track->last_sample_size);
+	track->last_sample_size = size;
+	track->samples++;
+	track->old_memory += 4;
+}
+
+static void push_chunk(struct bench_track *track, uint64_t offset_diff, uint32_t samples)
+{
+	sample_table_push(&track->chunk_offsets, offset_diff);
+	track->old_memory += 16;
+
+	if (samples != track->last_run_samples) {
+		sample_table_push(&track->chunk_runs, 1);
+		sample_table_push(&track->chunk_runs, samples);
+		track->last_run_samples = samples;
+	}
+}
+
+static void simulate(struct bench_track *tracks, bool spill)
+{
+	uint32_t seed = 1;
+	uint64_t audio_pkts = 0;
+
+	for (size_t i = 0; i < 1 + BENCH_AUDIO_TRACKS; i++)
+		bench_track_init(&tracks[i], spill);
+
+	for (uint64_t sec = 0; sec < BENCH_SECONDS; sec++) {
+		struct bench_track *video = &tracks[0];
+		uint64_t chunk_size = 0;
+
+		for (uint32_t frame = 0; frame < BENCH_FPS; frame++) {
+			bool keyframe = video->samples % BENCH_KEYINT == 0;
+			uint32_t size = keyframe ? 150000 + next_rand(&seed) % 50000 : 10000 + next_rand(&seed) % 20000;
+
+			push_sample(video, size);
+			chunk_size += size;
+
+			if (keyframe) {
+				sample_table_push(&video->sync_samples, BENCH_KEYINT);
+				video->old_memory += 4;
+			}
+
+			/* IPBB..., every frame starts a new offset run */
+			sample_table_push(&video->offsets, 1);
+			sample_table_push_signed(&video->offsets, frame % 3 == 0 ? 2 : 0);
+			video->old_memory += 8;
+		}
+
+		push_chunk(video, chunk_size, BENCH_FPS);
+
+		uint64_t pkts = (sec + 1) * BENCH_AUDIO_PKTS_NUM / BENCH_AUDIO_PKTS_DEN - audio_pkts;
+		audio_pkts += pkts;
+
+		for (size_t i = 1; i < 1 + BENCH_AUDIO_TRACKS; i++) {
+			chunk_size = 0;
+
+			for (uint64_t pkt = 0; pkt < pkts; pkt++) {
+				uint32_t size = 300 + next_rand(&seed) % 400;
+				push_sample(&tracks[i], size);
+				chunk_size += size;
+			}
+
+			push_chunk(&tracks[i], chunk_size, (uint32_t)pkts);
+		}
+	}
+
+	/* constant durations, a single run per track */
+	for (size_t i = 0; i < 1 + BENCH_AUDIO_TRACKS; i++) {
+		sample_table_push(&tracks[i].deltas, tracks[i].samples);
+		sample_table_push(&tracks[i].deltas, i ? 1024 : 1);
+		tracks[i].old_memory += 8;
+	}
+}
+
+static uint64_t read_all(struct sample_table *table)
+{
+	struct sample_table_reader reader;
+	uint64_t sum = 0;
+
+	sample_table_reader_init(&reader, table);
+	for (uint64_t i = 0; i < table->num; i++)
+		sum += sample_table_read(&reader);
+
+	return sum;
+}
+
+int main(void)
+{
+	for (int spill = 0; spill < 2; spill++) {
+		struct bench_track tracks[1 + BENCH_AUDIO_TRACKS];
+		uint64_t old_memory = 0;
+		size_t memory = 0;
+		uint64_t sum = 0;
+		uint64_t start;
+		double push_ms, read_ms;
+
+		start = os_gettime_ns();
+		simulate(tracks, spill);
+		push_ms = (double)(os_gettime_ns() - start) / 1000000.0;
+
+		start = os_gettime_ns();
+		for (size_t i = 0; i < 1 + BENCH_AUDIO_TRACKS; i++) {
+			sum += read_all(&tracks[i].sample_sizes);
+			sum += read_all(&tracks[i].chunk_offsets);
+			sum += read_all(&tracks[i].chunk_runs);
+			sum += read_all(&tracks[i].deltas);
+			sum += read_all(&tracks[i].offsets);
+			sum += read_all(&tracks[i].sync_samples);
+		}
+		read_ms = (double)(os_gettime_ns() - start) / 1000000.0;
+
+		for (size_t i = 0; i < 1 + BENCH_AUDIO_TRACKS; i++) {
+			old_memory += tracks[i].old_memory;
+			memory += bench_track_memory(&tracks[i]);
+		}
+
+		printf("%-12s %8.1f MiB before, %8.1f MiB now, %8.0f ms adding, %8.0f ms reading\n",
+		       spill ? "spilled:" : "in memory:", (double)old_memory / (1024.0 * 1024.0),
+		       (double)memory / (1024.0 * 1024.0), push_ms, read_ms);
+
+		for (size_t i = 0; i < 1 + BENCH_AUDIO_TRACKS; i++)
+			bench_track_free(&tracks[i]);
+
+		/* keeps the reads from being optimized out */
+		if (!sum)
+			return 1;
+	}
+
+	return 0;
+}
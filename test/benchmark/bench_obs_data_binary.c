@@ -0,0 +1,102 @@
+#include <stdio.h>
+
+#include <obs-data.h>
+#include <util/platform.h>
+
+#define BENCH_SOURCES 5000
+#define BENCH_JSON_FILE "bench_obs_data_binary.json"
+#define BENCH_BINARY_FILE "bench_obs_data_binary.bin"
+
+/* Load time and size of a large scene collection as Json and in the binary
+ * format. */
+
+static obs_data_t *create_source(size_t idx)
+{
+	obs_data_t *source = obs_data_create();
+	obs_data_t *settings = obs_data_create();
+	obs_data_array_t *filters = obs_data_array_create();
+	char name[64];
+
+	snprintf(name, sizeof(name), "Source %zu", idx);
+	obs_data_set_string(source, "name", name);
+	obs_data_set_string(source, "id", "ffmpeg_source");
+	obs_data_set_string(source, "uuid", "1b0bd0a5-6f35-4a4e-a9e5-5f2f6f0c8a1e");
+	obs_data_set_int(source, "mixers", 255);
+	obs_data_set_double(source, "volume", 0.75);
+	obs_data_set_bool(source, "enabled", true);
+
+	obs_data_set_string(settings, "local_file", "/home/user/Videos/clip.mp4");
+	obs_data_set_bool(settings, "looping", idx % 2 == 0);
+	obs_data_set_int(settings, "buffering_mb", 2);
+	obs_data_set_obj(source, "settings", settings);
+
+	for (size_t i = 0; i < 3; i++) {
+		obs_data_t *filter = obs_data_create();
+		obs_data_t *filter_settings = obs_data_create();
+
+		snprintf(name, sizeof(name), "Filter %zu", i);
+		obs_data_set_string(filter, "name", name);
+		obs_data_set_string(filter, "id", "color_filter_v2");
+		obs_data_set_double(filter_settings, "brightness", 0.1 * (double)i);
+		obs_data_set_double(filter_settings, "contrast", -0.25);
+		obs_data_set_int(filter_settings, "color_multiply", 0xFFFFFFFF);
+		obs_data_set_obj(filter, "settings", filter_settings);
+		obs_data_array_push_back(filters, filter);
+
+		obs_data_release(filter_settings);
+		obs_data_release(filter);
+	}
+
+	obs_data_set_array(source, "filters", filters);
+
+	obs_data_array_release(filters);
+	obs_data_release(settings);
+	return source;
+}
+
+static obs_data_t *create_collection(size_t num_sources)
+{
+	obs_data_t *collection = obs_data_create();
+	obs_data_array_t *sources = obs_data_array_create();
+
+	for (size_t i = 0; i < num_sources; i++) {
+		obs_data_t *source = create_source(i);
+		obs_data_array_push_back(sources, source);
+		obs_data_release(source);
+	}
+
+	obs_data_set_string(collection, "name", "Benchmark");
+	obs_data_set_string(collection, "current_scene", "Scene");
+	obs_data_set_array(collection, "sources", sources);
+
+	obs_data_array_release(sources);
+	return collection;
+}
+
+int main(void)
+{
+	obs_data_t *collection = create_collection(BENCH_SOURCES);
+	uint64_t start, json_ns, binary_ns;
+
+	if (!obs_data_save_json(collection, BENCH_JSON_FILE) || !obs_data_save_binary(collection, BENCH_BINARY_FILE))
+		return 1;
+
+	start = os_gettime_ns();
+	obs_data_t *from_json = obs_data_create_from_json_file(BENCH_JSON_FILE);
+	json_ns = os_gettime_ns() - start;
+
+	start = os_gettime_ns();
+	obs_data_t *from_binary = obs_data_create_from_binary_file(BENCH_BINARY_FILE);
+	binary_ns = os_gettime_ns() - start;
+
+	printf("%d sources: json %.2f ms (%lld bytes), binary %.2f ms (%lld bytes)\n", BENCH_SOURCES,
+	       (double)json_ns / 1000000.0, (long long)os_get_file_size(BENCH_JSON_FILE),
+	       (double)binary_ns / 1000000.0, (long long)os_get_file_size(BENCH_BINARY_FILE));
+
+	obs_data_release(from_binary);
+	obs_data_release(from_json);
+	obs_data_release(collection);
+	os_unlink(BENCH_JSON_FILE);
+	os_unlink(BENCH_BINARY_FILE);
+	return 0;
+}
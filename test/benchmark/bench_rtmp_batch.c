@@ -0,0 +1,235 @@
+#define _GNU_SOURCE /* RUSAGE_THREAD */
+
+#include <limits.h>
+#include <stdio.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+
+#include <util/platform.h>
+#include <util/threading.h>
+
+#include "flv-mux.h"
+#include "rtmp-batch.h"
+
+/* loopback connection, with a thread reading everything from the other end */
+
+struct sink {
+	int listen_fd;
+	int fd;
+	pthread_t thread;
+	uint64_t bytes;
+};
+
+static void *sink_thread(void *param)
+{
+	struct sink *sink = param;
+	uint8_t buf[65536];
+	ssize_t size;
+
+	while ((size = recv(sink->fd, buf, sizeof(buf), 0)) > 0)
+		sink->bytes += (uint64_t)size;
+
+	return NULL;
+}
+
+static int sink_connect(struct sink *sink)
+{
+	struct sockaddr_in addr = {0};
+	socklen_t len = sizeof(addr);
+	int fd;
+
+	memset(sink, 0, sizeof(*sink));
+
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+	sink->listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+	bind(sink->listen_fd, (struct sockaddr *)&addr, sizeof(addr));
+	listen(sink->listen_fd, 1);
+	getsockname(sink->listen_fd, (struct sockaddr *)&addr, &len);
+
+	fd = socket(AF_INET, SOCK_STREAM, 0);
+	connect(fd, (struct sockaddr *)&addr, sizeof(addr));
+
+	sink->fd = accept(sink->listen_fd, NULL, NULL);
+	pthread_create(&sink->thread, NULL, sink_thread, sink);
+	return fd;
+}
+
+static void sink_finish(struct sink *sink)
+{
+	pthread_join(sink->thread, NULL);
+	close(sink->fd);
+	close(sink->listen_fd);
+}
+
+/* a connection that is past the handshake, as far as sending goes */
+static void fake_connect(RTMP *rtmp, int fd)
+{
+	RTMP_Init(rtmp);
+	rtmp->m_sb.sb_socket = fd;
+	rtmp->m_outChunkSize = 4096;
+	rtmp->Link.streams[0].id = 1;
+	rtmp->Link.nStreams = 1;
+}
+
+static void fake_close(RTMP *rtmp)
+{
+	shutdown(rtmp->m_sb.sb_socket, SHUT_WR);
+	close(rtmp->m_sb.sb_socket);
+	rtmp->m_sb.sb_socket = -1;
+	RTMP_Close(rtmp);
+}
+
+enum packet_kind {
+	KIND_LEGACY,   /* H.264 track 0, or audio track 0 */
+	KIND_AUDIO_EX, /* any other audio track */
+};
+
+struct test_packet {
+	struct encoder_packet packet;
+	enum packet_kind kind;
+};
+
+/* both take over a reference, but leave tp alone */
+static void write_old(RTMP *rtmp, struct test_packet *tp)
+{
+	struct encoder_packet copy = tp->packet;
+	struct encoder_packet *packet = &copy;
+	uint8_t *data;
+	size_t size;
+
+	if (tp->kind == KIND_AUDIO_EX)
+		flv_packet_audio_frames(packet, AUDIO_CODEC_AAC, 0, &data, &size, packet->track_idx);
+	else
+		flv_packet_mux(packet, 0, &data, &size, false);
+
+	RTMP_Write(rtmp, (char *)data, (int)size, 0);
+	bfree(data);
+	obs_encoder_packet_release(packet);
+}
+
+static void add_new(struct rtmp_batch *batch, struct test_packet *tp)
+{
+	struct encoder_packet copy = tp->packet;
+	struct encoder_packet *packet = &copy;
+	struct serializer *s = rtmp_batch_tag(batch);
+
+	if (tp->kind == KIND_AUDIO_EX)
+		flv_packet_audio_frames_header(s, packet, AUDIO_CODEC_AAC, 0, packet->track_idx);
+	else
+		flv_packet_mux_header(s, packet, 0);
+
+	rtmp_batch_add(batch, packet);
+}
+
+/* Sends a minute of a 60 FPS, 50 Mbps stream with a second audio track,
+ * through RTMP_Write() and through the batch, and prints the CPU time of the
+ * sending thread per Mbit sent. */
+
+#define BENCH_SECONDS 60
+#define BENCH_FPS 60
+#define BENCH_AUDIO_TRACKS 2
+
+static inline uint32_t next_rand(uint32_t *seed)
+{
+	*seed = *seed * 1664525 + 1013904223;
+	return *seed >> 8;
+}
+
+static uint64_t thread_cpu_usec(void)
+{
+	struct rusage usage;
+	getrusage(RUSAGE_THREAD, &usage);
+	return (uint64_t)usage.ru_utime.tv_sec * 1000000 + (uint64_t)usage.ru_utime.tv_usec +
+	       (uint64_t)usage.ru_stime.tv_sec * 1000000 + (uint64_t)usage.ru_stime.tv_usec;
+}
+
+/* all packets share the same data, which is never released */
+static void bench_packet(struct test_packet *tp, const uint8_t *data, uint32_t *seed, uint64_t frame, size_t n)
+{
+	int64_t dts = (int64_t)frame * 1000 / BENCH_FPS;
+
+	memset(tp, 0, sizeof(*tp));
+	tp->packet.data = (uint8_t *)data;
+	tp->packet.timebase_num = 1;
+	tp->packet.timebase_den = 1000;
+	tp->packet.dts = dts;
+	tp->packet.pts = dts;
+
+	/* one packet per audio track after every video frame */
+	if (n == 0) {
+		tp->packet.type = OBS_ENCODER_VIDEO;
+		tp->packet.keyframe = frame % 120 == 0;
+		tp->packet.size = tp->packet.keyframe ? 500000 + next_rand(seed) % 200000
+						      : 60000 + next_rand(seed) % 80000;
+		tp->kind = KIND_LEGACY;
+	} else {
+		tp->packet.type = OBS_ENCODER_AUDIO;
+		tp->packet.track_idx = n - 1;
+		tp->packet.size = 300 + next_rand(seed) % 400;
+		tp->kind = n == 1 ? KIND_LEGACY : KIND_AUDIO_EX;
+	}
+}
+
+int main(void)
+{
+	int ret = 0;
+	long *shared = bzalloc(sizeof(long) + 700000);
+	const uint8_t *data = (const uint8_t *)(shared + 1);
+
+	*shared = LONG_MAX;
+
+	for (int use_batch = 0; use_batch < 2; use_batch++) {
+		struct rtmp_batch batch;
+		struct sink sink;
+		uint32_t seed = 1;
+		uint64_t start_ns, start_cpu, cpu, bytes;
+		double seconds, mbps;
+		RTMP rtmp;
+
+		fake_connect(&rtmp, sink_connect(&sink));
+		if (use_batch)
+			rtmp_batch_init(&batch, &rtmp, false);
+
+		start_ns = os_gettime_ns();
+		start_cpu = thread_cpu_usec();
+
+		for (uint64_t frame = 0; frame < BENCH_SECONDS * BENCH_FPS; frame++) {
+			/* what the send thread finds queued at once */
+			for (size_t n = 0; n <= BENCH_AUDIO_TRACKS; n++) {
+				struct test_packet tp;
+				bench_packet(&tp, data, &seed, frame, n);
+
+				if (use_batch)
+					add_new(&batch, &tp);
+				else
+					write_old(&rtmp, &tp);
+			}
+
+			if (use_batch && rtmp_batch_send(&batch) <= 0)
+				ret = 1;
+		}
+
+		cpu = thread_cpu_usec() - start_cpu;
+
+		fake_close(&rtmp);
+		sink_finish(&sink);
+		seconds = (double)(os_gettime_ns() - start_ns) / 1000000000.0;
+		if (use_batch)
+			rtmp_batch_free(&batch);
+
+		bytes = sink.bytes;
+		mbps = (double)bytes * 8.0 / 1000000.0 / seconds;
+
+		printf("%-12s %8.1f MiB, %8.0f Mbps, %6.0f ms CPU, %8.2f us CPU per Mbit\n",
+		       use_batch ? "batch:" : "RTMP_Write:", (double)bytes / (1024.0 * 1024.0), mbps,
+		       (double)cpu / 1000.0, (double)cpu / ((double)bytes * 8.0 / 1000000.0));
+	}
+
+	bfree(shared);
+	return ret;
+}
@@ -0,0 +1,35 @@
+#include <stdio.h>
+
+#include "rtmp-dbr-sim.h"
+
+/* Throughput, latency and late frames of the network simulator's scenarios,
+ * with the bitrate fixed and with dynamic bitrate. */
+
+static void print_result(const struct dbr_scenario *scn, bool use_dbr)
+{
+	struct dbr_result res;
+
+	dbr_sim_run(scn, use_dbr, &res);
+
+	printf("%-22s %-5s %6.2f Mbps, latency %7.1f ms mean %7.1f ms p95, %5d late frames, "
+	       "%3d bitrate changes (min %ld, final %ld kbps)\n",
+	       scn->name, use_dbr ? "dbr" : "fixed", res.throughput_mbps, res.mean_latency_ms, res.p95_latency_ms,
+	       res.late_frames, res.bitrate_changes, res.min_bitrate, res.final_bitrate);
+}
+
+int main(void)
+{
+	const struct dbr_scenario *scenarios[] = {
+		&dbr_sim_constant,
+		&dbr_sim_step,
+		&dbr_sim_step_no_tcp_info,
+		&dbr_sim_loss,
+	};
+
+	for (size_t i = 0; i < sizeof(scenarios) / sizeof(scenarios[0]); i++) {
+		print_result(scenarios[i], false);
+		print_result(scenarios[i], true);
+	}
+
+	return 0;
+}
@@ -0,0 +1,60 @@
+#include <stdio.h>
+
+#include <callback/signal.h>
+#include <util/platform.h>
+
+#define BENCH_SIGNALS 1000000
+
+/* Signals per second with different numbers of connected callbacks, by name
+ * and by handle. */
+
+static void empty_callback(void *data, calldata_t *params)
+{
+	UNUSED_PARAMETER(data);
+	UNUSED_PARAMETER(params);
+}
+
+int main(void)
+{
+	static const char *signals[] = {
+		"void destroy(ptr source)",
+		"void remove(ptr source)",
+		"void update(ptr source)",
+		"void rename(ptr source, string new_name, string prev_name)",
+		"void volume(in out ptr source, in out float volume)",
+		NULL,
+	};
+	static const size_t callback_counts[] = {0, 1, 4, 16};
+	signal_handler_t *handler = signal_handler_create();
+	calldata_t params = {0};
+	size_t connected = 0;
+
+	if (!signal_handler_add_array(handler, signals))
+		return 1;
+	signal_t *volume = signal_handler_get_signal(handler, "volume");
+
+	for (size_t c = 0; c < sizeof(callback_counts) / sizeof(callback_counts[0]); c++) {
+		uint64_t start;
+		double by_name, by_handle;
+
+		for (; connected < callback_counts[c]; connected++)
+			signal_handler_connect(handler, "volume", empty_callback, (void *)(uintptr_t)(connected + 1));
+
+		start = os_gettime_ns();
+		for (size_t i = 0; i < BENCH_SIGNALS; i++)
+			signal_handler_signal(handler, "volume", &params);
+		by_name = (double)BENCH_SIGNALS / ((double)(os_gettime_ns() - start) / 1000000000.0);
+
+		start = os_gettime_ns();
+		for (size_t i = 0; i < BENCH_SIGNALS; i++)
+			signal_handler_emit(handler, volume, &params);
+		by_handle = (double)BENCH_SIGNALS / ((double)(os_gettime_ns() - start) / 1000000000.0);
+
+		printf("%2zu callbacks: %8.2f M/s by name, %8.2f M/s by handle\n", callback_counts[c],
+		       by_name / 1000000.0, by_handle / 1000000.0);
+	}
+
+	calldata_free(&params);
+	signal_handler_destroy(handler);
+	return 0;
+}
@@ -0,0 +1,129 @@
+#include <stdio.h>
+
+#include <util/spsc-ring.h>
+#include <util/deque.h>
+#include <util/platform.h>
+#include <util/threading.h>
+
+#define BENCH_FLOATS (16 * 1024 * 1024)
+#define BENCH_CHUNK 1024
+
+/* Throughput of the ring compared to a mutex protected deque, the way source
+ * audio is buffered now.  Both sides yield when the buffer is full or
+ * empty so that it also finishes on a single core. */
+
+struct bench_data {
+	struct spsc_ring ring;
+	struct deque dq;
+	pthread_mutex_t mutex;
+	size_t total;
+};
+
+static void *bench_ring_producer(void *param)
+{
+	struct bench_data *data = param;
+	float chunk[BENCH_CHUNK] = {0};
+
+	for (size_t sent = 0; sent < data->total;) {
+		if (spsc_ring_push_back(&data->ring, chunk, sizeof(chunk)))
+			sent += BENCH_CHUNK;
+		else
+			os_sleep_ms(0);
+	}
+
+	return NULL;
+}
+
+static void *bench_deque_producer(void *param)
+{
+	struct bench_data *data = param;
+	float chunk[BENCH_CHUNK] = {0};
+
+	for (size_t sent = 0; sent < data->total;) {
+		pthread_mutex_lock(&data->mutex);
+		bool full = data->dq.size >= data->ring.capacity;
+		if (!full) {
+			deque_push_back(&data->dq, chunk, sizeof(chunk));
+			sent += BENCH_CHUNK;
+		}
+		pthread_mutex_unlock(&data->mutex);
+
+		if (full)
+			os_sleep_ms(0);
+	}
+
+	return NULL;
+}
+
+static void print_result(const char *name, uint64_t start, size_t floats)
+{
+	double sec = (double)(os_gettime_ns() - start) / 1000000000.0;
+	printf("%-32s %8.1f Mfloats/s\n", name, (double)floats / sec / 1000000.0);
+}
+
+int main(void)
+{
+	struct bench_data data = {0};
+	float chunk[BENCH_CHUNK] = {0};
+	pthread_t thread;
+	uint64_t start;
+
+	if (!spsc_ring_init(&data.ring, 64 * BENCH_CHUNK * sizeof(float)))
+		return 1;
+	pthread_mutex_init(&data.mutex, NULL);
+	data.total = BENCH_FLOATS;
+
+	/* uncontended: push and pop on the same thread */
+	start = os_gettime_ns();
+	for (size_t i = 0; i < data.total; i += BENCH_CHUNK) {
+		spsc_ring_push_back(&data.ring, chunk, sizeof(chunk));
+		spsc_ring_pop_front(&data.ring, chunk, sizeof(chunk));
+	}
+	print_result("spsc ring, single thread", start, data.total);
+
+	start = os_gettime_ns();
+	for (size_t i = 0; i < data.total; i += BENCH_CHUNK) {
+		pthread_mutex_lock(&data.mutex);
+		deque_push_back(&data.dq, chunk, sizeof(chunk));
+		pthread_mutex_unlock(&data.mutex);
+
+		pthread_mutex_lock(&data.mutex);
+		deque_pop_front(&data.dq, chunk, sizeof(chunk));
+		pthread_mutex_unlock(&data.mutex);
+	}
+	print_result("deque + mutex, single thread", start, data.total);
+
+	/* contended: producer and consumer on separate threads */
+	start = os_gettime_ns();
+	pthread_create(&thread, NULL, bench_ring_producer, &data);
+	for (size_t received = 0; received < data.total;) {
+		if (spsc_ring_pop_front(&data.ring, chunk, sizeof(chunk)))
+			received += BENCH_CHUNK;
+		else
+			os_sleep_ms(0);
+	}
+	pthread_join(thread, NULL);
+	print_result("spsc ring, two threads", start, data.total);
+
+	start = os_gettime_ns();
+	pthread_create(&thread, NULL, bench_deque_producer, &data);
+	for (size_t received = 0; received < data.total;) {
+		pthread_mutex_lock(&data.mutex);
+		bool empty = data.dq.size < sizeof(chunk);
+		if (!empty) {
+			deque_pop_front(&data.dq, chunk, sizeof(chunk));
+			received += BENCH_CHUNK;
+		}
+		pthread_mutex_unlock(&data.mutex);
+
+		if (empty)
+			os_sleep_ms(0);
+	}
+	pthread_join(thread, NULL);
+	print_result("deque + mutex, two threads", start, data.total);
+
+	pthread_mutex_destroy(&data.mutex);
+	deque_free(&data.dq);
+	spsc_ring_free(&data.ring);
+	return 0;
+}
@@ -0,0 +1,517 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include <util/darray.h>
+#include <util/deque.h>
+
+#include "rtmp-dbr.h"
+#include "rtmp-dbr-sim.h"
+
+/* ------------------------------------------------------------------------- */
+/* network simulator                                                         */
+
+/* Stepped once per millisecond: a send buffer, a congestion window that
+ * grows like Reno and halves on loss, a bottleneck link with a tail-drop
+ * queue, random loss and fixed propagation delay.  The socket statistics it reports are computed
+ * the way Linux computes them for TCP_INFO. */
+
+#define START_TS (10 * SEC)
+
+#define MSS 1448
+#define BOTTLENECK_QUEUE_SIZE (256 * 1024)
+#define SAMPLE_INTERVAL (10 * MSEC)
+
+#define FPS 60
+#define KEYINT (2 * FPS)
+#define AUDIO_BITRATE 160
+#define LATE_USEC 1000000
+
+struct segment {
+	uint64_t seq;
+	uint32_t size;
+	bool retransmit;
+
+	uint64_t sent_ts;
+	uint64_t event_ts;
+
+	/* state when sent, for the delivery rate */
+	uint64_t delivered;
+	uint64_t delivered_ts;
+	bool app_limited;
+};
+
+struct frame {
+	uint64_t capture_ts;
+	uint64_t end_offset;
+	size_t size;
+	size_t written;
+};
+
+struct sim {
+	const struct dbr_scenario *scn;
+	uint64_t now;
+	uint32_t rand_state;
+
+	/* application */
+	struct deque app_queue;
+	struct deque sent_frames;
+	uint64_t app_offset;
+	uint64_t pace_ts;
+	uint64_t write_beg;
+
+	/* sender */
+	uint64_t sndbuf_end;
+	uint64_t snd_nxt;
+	uint64_t inflight;
+	double cwnd;
+	double ssthresh;
+	uint64_t recovery_end;
+	uint64_t delivered;
+	uint64_t delivered_ts;
+	uint64_t srtt;
+	uint64_t delivery_rate;
+	bool delivery_app_limited;
+	struct deque retransmits;
+
+	/* network */
+	struct deque bottleneck;
+	size_t bottleneck_bytes;
+	double link_credit;
+	struct deque arrivals;
+	struct deque acks;
+	struct deque losses;
+
+	/* receiver */
+	DARRAY(uint64_t) holes;
+	uint64_t highest_arrived;
+
+	/* results */
+	DARRAY(uint64_t) latencies;
+	uint64_t payload_delivered;
+	int bitrate_changes;
+	long min_bitrate;
+};
+
+static uint32_t sim_rand(struct sim *sim)
+{
+	uint32_t x = sim->rand_state;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	return sim->rand_state = x;
+}
+
+static uint64_t link_rate(const struct dbr_scenario *scn, uint64_t ts)
+{
+	uint64_t rate = scn->rates[0].bits_per_sec;
+
+	for (size_t i = 1; i < scn->num_rates; i++) {
+		if (START_TS + scn->rates[i].ts <= ts)
+			rate = scn->rates[i].bits_per_sec;
+	}
+
+	return rate;
+}
+
+static void add_hole(struct sim *sim, uint64_t seq)
+{
+	size_t idx = 0;
+
+	while (idx < sim->holes.num && sim->holes.array[idx] < seq)
+		idx++;
+	if (idx < sim->holes.num && sim->holes.array[idx] == seq)
+		return;
+
+	da_insert(sim->holes, idx, &seq);
+}
+
+static void lose_segment(struct sim *sim, struct segment *seg)
+{
+	add_hole(sim, seg->seq);
+
+	/* found out about it from duplicate acks about a round trip later */
+	seg->event_ts = sim->now + sim->scn->rtt;
+	deque_push_back(&sim->losses, seg, sizeof(*seg));
+}
+
+static void transmit(struct sim *sim, struct segment *seg)
+{
+	seg->sent_ts = sim->now;
+	seg->delivered = sim->delivered;
+	seg->delivered_ts = sim->delivered_ts;
+	sim->inflight += seg->size;
+
+	if (sim->bottleneck_bytes + seg->size > BOTTLENECK_QUEUE_SIZE) {
+		lose_segment(sim, seg);
+		return;
+	}
+
+	sim->bottleneck_bytes += seg->size;
+	deque_push_back(&sim->bottleneck, seg, sizeof(*seg));
+}
+
+static void send_segments(struct sim *sim)
+{
+	struct segment seg;
+
+	while (sim->inflight + MSS <= (uint64_t)sim->cwnd) {
+		if (sim->retransmits.size) {
+			deque_pop_front(&sim->retransmits, &seg, sizeof(seg));
+			seg.retransmit = true;
+
+		} else if (sim->snd_nxt < sim->sndbuf_end) {
+			memset(&seg, 0, sizeof(seg));
+			seg.seq = sim->snd_nxt;
+			seg.size = (uint32_t)(sim->sndbuf_end - sim->snd_nxt);
+			if (seg.size > MSS)
+				seg.size = MSS;
+			sim->snd_nxt += seg.size;
+
+		} else {
+			break;
+		}
+
+		/* nothing more to send although the window has room */
+		seg.app_limited = sim->snd_nxt == sim->sndbuf_end && !sim->retransmits.size &&
+				  sim->inflight + seg.size + MSS <= (uint64_t)sim->cwnd;
+		transmit(sim, &seg);
+	}
+}
+
+static void serve_bottleneck(struct sim *sim)
+{
+	sim->link_credit += (double)link_rate(sim->scn, sim->now) / 8.0 / 1000.0;
+
+	while (sim->bottleneck.size) {
+		struct segment *seg = deque_data(&sim->bottleneck, 0);
+		struct segment served;
+
+		if (sim->link_credit < (double)seg->size)
+			return;
+
+		sim->link_credit -= (double)seg->size;
+		sim->bottleneck_bytes -= seg->size;
+		deque_pop_front(&sim->bottleneck, &served, sizeof(served));
+
+		if ((double)sim_rand(sim) / (double)UINT32_MAX < sim->scn->loss) {
+			lose_segment(sim, &served);
+			continue;
+		}
+
+		served.event_ts = sim->now + sim->scn->rtt / 2;
+		deque_push_back(&sim->arrivals, &served, sizeof(served));
+	}
+
+	/* an idle link doesn't save up capacity */
+	if (sim->link_credit > MSS)
+		sim->link_credit = MSS;
+}
+
+static uint64_t receive_point(struct sim *sim)
+{
+	return sim->holes.num ? sim->holes.array[0] : sim->highest_arrived;
+}
+
+static void complete_frames(struct sim *sim)
+{
+	uint64_t point = receive_point(sim);
+
+	while (sim->sent_frames.size) {
+		struct frame *frame = deque_data(&sim->sent_frames, 0);
+		uint64_t latency;
+
+		if (frame->end_offset > point)
+			break;
+
+		latency = (sim->now - frame->capture_ts) / 1000;
+		da_push_back(sim->latencies, &latency);
+		deque_pop_front(&sim->sent_frames, NULL, sizeof(*frame));
+	}
+}
+
+static void process_arrivals(struct sim *sim)
+{
+	struct segment seg;
+
+	while (sim->arrivals.size) {
+		struct segment *front = deque_data(&sim->arrivals, 0);
+		if (front->event_ts > sim->now)
+			break;
+
+		deque_pop_front(&sim->arrivals, &seg, sizeof(seg));
+
+		if (seg.retransmit)
+			da_erase_item(sim->holes, &seg.seq);
+		if (seg.seq + seg.size > sim->highest_arrived)
+			sim->highest_arrived = seg.seq + seg.size;
+		sim->payload_delivered += seg.size;
+
+		seg.event_ts = sim->now + sim->scn->rtt / 2;
+		deque_push_back(&sim->acks, &seg, sizeof(seg));
+	}
+
+	complete_frames(sim);
+}
+
+static void process_acks(struct sim *sim)
+{
+	struct segment seg;
+
+	while (sim->acks.size) {
+		struct segment *front = deque_data(&sim->acks, 0);
+		uint64_t rtt, interval;
+
+		if (front->event_ts > sim->now)
+			break;
+
+		deque_pop_front(&sim->acks, &seg, sizeof(seg));
+		sim->inflight -= seg.size;
+		sim->delivered += seg.size;
+		sim->delivered_ts = sim->now;
+
+		rtt = sim->now - seg.sent_ts;
+		sim->srtt = sim->srtt ? (sim->srtt * 7 + rtt) / 8 : rtt;
+
+		/* delivered since the segment was sent, over the time that
+		 * took, like tcp_rate_gen() */
+		interval = sim->now - seg.delivered_ts;
+		if (seg.sent_ts - seg.delivered_ts > interval)
+			interval = seg.sent_ts - seg.delivered_ts;
+		if (interval >= MSEC && seg.delivered_ts) {
+			uint64_t rate = (sim->delivered - seg.delivered) * 8 * SEC / interval;
+
+			/* app limited samples only replace a higher rate */
+			if (!seg.app_limited || rate >= sim->delivery_rate) {
+				sim->delivery_rate = rate;
+				sim->delivery_app_limited = seg.app_limited;
+			}
+		}
+
+		if (sim->cwnd < sim->ssthresh)
+			sim->cwnd += seg.size;
+		else
+			sim->cwnd += (double)MSS * MSS / sim->cwnd;
+	}
+}
+
+static void process_losses(struct sim *sim)
+{
+	struct segment seg;
+
+	while (sim->losses.size) {
+		struct segment *front = deque_data(&sim->losses, 0);
+		if (front->event_ts > sim->now)
+			break;
+
+		deque_pop_front(&sim->losses, &seg, sizeof(seg));
+		sim->inflight -= seg.size;
+		deque_push_back(&sim->retransmits, &seg, sizeof(seg));
+
+		/* one window reduction per round trip */
+		if (sim->now >= sim->recovery_end) {
+			sim->ssthresh = sim->cwnd / 2 > 4 * MSS ? sim->cwnd / 2 : 4 * MSS;
+			sim->cwnd = sim->ssthresh;
+			sim->recovery_end = sim->now + sim->srtt;
+		}
+	}
+}
+
+static void sim_sample(struct sim *sim, struct dbr_sample *sample)
+{
+	sample->ts = sim->now;
+	sample->delivery_rate = sim->delivery_rate;
+	sample->app_limited = sim->delivery_app_limited;
+	sample->rtt_usec = (uint32_t)(sim->srtt / 1000);
+	sample->notsent_bytes = (uint32_t)(sim->sndbuf_end - sim->snd_nxt);
+}
+
+/* ------------------------------------------------------------------------- */
+/* the stream, driven the way rtmp-stream drives the estimator               */
+
+static size_t frame_size(long bitrate, uint64_t frame)
+{
+	/* a keyframe is four times the size of the other frames */
+	uint64_t gop_bytes = (uint64_t)bitrate * 1000 / 8 * KEYINT / FPS;
+	uint64_t unit = gop_bytes / (KEYINT + 3);
+	uint64_t audio = AUDIO_BITRATE * 1000 / 8 / FPS;
+
+	return (size_t)((frame % KEYINT ? unit : unit * 4) + audio);
+}
+
+static int64_t app_queue_usec(struct sim *sim)
+{
+	struct frame *front;
+
+	if (!sim->app_queue.size)
+		return 0;
+
+	front = deque_data(&sim->app_queue, 0);
+	return (int64_t)(sim->now - front->capture_ts) / 1000;
+}
+
+static void write_frames(struct sim *sim, struct dbr_estimator *dbr, bool use_dbr)
+{
+	while (sim->app_queue.size && sim->now >= sim->pace_ts) {
+		struct frame *frame = deque_data(&sim->app_queue, 0);
+		size_t space = sim->scn->sndbuf_size - (size_t)(sim->sndbuf_end - sim->snd_nxt) - (size_t)sim->inflight;
+		size_t size = frame->size - frame->written;
+
+		if (!frame->written)
+			sim->write_beg = sim->now;
+		if (size > space)
+			size = space;
+		if (!size)
+			return;
+
+		frame->written += size;
+		sim->sndbuf_end += size;
+		if (frame->written < frame->size)
+			return;
+
+		if (use_dbr) {
+			dbr_estimator_add_send(dbr, sim->write_beg, sim->now, frame->size);
+			sim->pace_ts = dbr_estimator_pace(dbr, frame->size, sim->now);
+		}
+
+		deque_push_back(&sim->sent_frames, frame, sizeof(*frame));
+		deque_pop_front(&sim->app_queue, NULL, sizeof(*frame));
+	}
+}
+
+static int count_late(struct sim *sim, struct deque *frames)
+{
+	size_t count = frames->size / sizeof(struct frame);
+	int late = 0;
+
+	for (size_t i = 0; i < count; i++) {
+		struct frame *frame = deque_data(frames, i * sizeof(*frame));
+		if ((sim->now - frame->capture_ts) / 1000 > LATE_USEC)
+			late++;
+	}
+
+	return late;
+}
+
+static int cmp_u64(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a;
+	uint64_t y = *(const uint64_t *)b;
+	return x < y ? -1 : x > y;
+}
+
+void dbr_sim_run(const struct dbr_scenario *scn, bool use_dbr, struct dbr_result *res)
+{
+	struct dbr_estimator dbr;
+	struct sim sim = {0};
+	uint64_t next_frame = 0;
+	uint64_t next_sample = START_TS;
+	uint64_t total_latency = 0;
+	long bitrate = scn->bitrate;
+
+	sim.scn = scn;
+	sim.rand_state = 0x2545f491;
+	sim.cwnd = 10 * MSS;
+	sim.ssthresh = 1e12;
+	sim.delivered_ts = START_TS;
+
+	dbr_estimator_init(&dbr, scn->bitrate, AUDIO_BITRATE, START_TS);
+	sim.min_bitrate = bitrate;
+
+	for (sim.now = START_TS; sim.now < START_TS + scn->duration; sim.now += MSEC) {
+		process_losses(&sim);
+		process_acks(&sim);
+		process_arrivals(&sim);
+
+		/* the encoder hands over a frame */
+		while (START_TS + next_frame * SEC / FPS <= sim.now) {
+			struct frame frame = {0};
+
+			if (use_dbr) {
+				long new_bitrate = dbr_estimator_update(&dbr, app_queue_usec(&sim), sim.now);
+				if (new_bitrate) {
+					bitrate = new_bitrate;
+					sim.bitrate_changes++;
+					if (bitrate < sim.min_bitrate)
+						sim.min_bitrate = bitrate;
+				}
+			}
+
+			frame.capture_ts = START_TS + next_frame * SEC / FPS;
+			frame.size = frame_size(bitrate, next_frame);
+			sim.app_offset += frame.size;
+			frame.end_offset = sim.app_offset;
+			deque_push_back(&sim.app_queue, &frame, sizeof(frame));
+			next_frame++;
+		}
+
+		write_frames(&sim, &dbr, use_dbr);
+		send_segments(&sim);
+		serve_bottleneck(&sim);
+
+		if (use_dbr && scn->tcp_info && sim.now >= next_sample) {
+			struct dbr_sample sample;
+			sim_sample(&sim, &sample);
+			dbr_estimator_add_sample(&dbr, &sample);
+			next_sample = sim.now + SAMPLE_INTERVAL;
+		}
+	}
+
+	memset(res, 0, sizeof(*res));
+	res->throughput_mbps = (double)sim.payload_delivered * 8.0 / ((double)scn->duration / SEC) / 1000000.0;
+	res->frames = (int)sim.latencies.num;
+	res->bitrate_changes = sim.bitrate_changes;
+	res->min_bitrate = sim.min_bitrate;
+	res->final_bitrate = bitrate;
+
+	/* frames still on their way at the end only count if already late */
+	res->late_frames = count_late(&sim, &sim.sent_frames) + count_late(&sim, &sim.app_queue);
+	for (size_t i = 0; i < sim.latencies.num; i++) {
+		total_latency += sim.latencies.array[i];
+		if (sim.latencies.array[i] > LATE_USEC)
+			res->late_frames++;
+	}
+
+	if (sim.latencies.num) {
+		qsort(sim.latencies.array, sim.latencies.num, sizeof(uint64_t), cmp_u64);
+		res->mean_latency_ms = (double)total_latency / (double)sim.latencies.num / 1000.0;
+		res->p95_latency_ms = (double)sim.latencies.array[sim.latencies.num * 95 / 100] / 1000.0;
+	}
+
+	dbr_estimator_free(&dbr);
+	deque_free(&sim.app_queue);
+	deque_free(&sim.sent_frames);
+	deque_free(&sim.retransmits);
+	deque_free(&sim.bottleneck);
+	deque_free(&sim.arrivals);
+	deque_free(&sim.acks);
+	deque_free(&sim.losses);
+	da_free(sim.holes);
+	da_free(sim.latencies);
+}
+
+/* ------------------------------------------------------------------------- */
+/* scenarios                                                                 */
+
+static const struct dbr_rate_step rates_10mbps[] = {{0, 10000000}};
+static const struct dbr_rate_step rates_step[] = {{0, 10000000}, {10 * SEC, 3000000}, {30 * SEC, 10000000}};
+
+/* a 6 Mbps stream over a 10 Mbps link */
+const struct dbr_scenario dbr_sim_constant = {
+	"constant 10 Mbps", rates_10mbps, 1, 40 * MSEC, 0.0, 30 * SEC, 6000, true, 1024 * 1024,
+};
+
+/* the link drops to 3 Mbps for 20 seconds */
+const struct dbr_scenario dbr_sim_step = {
+	"step 10/3/10 Mbps", rates_step, 3, 40 * MSEC, 0.0, 50 * SEC, 6000, true, 1024 * 1024,
+};
+
+/* the same, estimated only from how long sends block, like on Windows,
+ * where the send buffer is small enough for sends to block */
+const struct dbr_scenario dbr_sim_step_no_tcp_info = {
+	"step, no TCP_INFO", rates_step, 3, 40 * MSEC, 0.0, 50 * SEC, 6000, false, 64 * 1024,
+};
+
+/* 1% random loss */
+const struct dbr_scenario dbr_sim_loss = {
+	"10 Mbps, 1% loss", rates_10mbps, 1, 50 * MSEC, 0.01, 30 * SEC, 6000, true, 1024 * 1024,
+};
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <util/c99defs.h>
+
+/* A deterministic model of one TCP connection in virtual time, streaming
+ * frames the way rtmp-stream does, with or without the dynamic bitrate
+ * estimator.  Shared by test_rtmp_dbr and bench_rtmp_dbr. */
+
+#define MSEC 1000000ULL
+#define SEC 1000000000ULL
+
+struct dbr_rate_step {
+	uint64_t ts;
+	uint64_t bits_per_sec;
+};
+
+struct dbr_scenario {
+	const char *name;
+	const struct dbr_rate_step *rates;
+	size_t num_rates;
+	uint64_t rtt;
+	double loss;
+	uint64_t duration;
+	long bitrate;
+	bool tcp_info;
+	size_t sndbuf_size;
+};
+
+struct dbr_result {
+	double throughput_mbps;
+	double mean_latency_ms;
+	double p95_latency_ms;
+	int late_frames;
+	int frames;
+	int bitrate_changes;
+	long min_bitrate;
+	long final_bitrate;
+};
+
+void dbr_sim_run(const struct dbr_scenario *scn, bool use_dbr, struct dbr_result *res);
+
+extern const struct dbr_scenario dbr_sim_constant;
+extern const struct dbr_scenario dbr_sim_step;
+extern const struct dbr_scenario dbr_sim_step_no_tcp_info;
+extern const struct dbr_scenario dbr_sim_loss;
@@ -0,0 +1,200 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <obs-audio-graph.h>
+
+#define MAX_NODES 16
+
+struct node {
+	const char *name;
+	int level;
+	bool in_order;
+	struct node *inputs[MAX_NODES];
+};
+
+static int *node_level(void *node)
+{
+	return &((struct node *)node)->level;
+}
+
+static bool node_in_order(void *data, void *node)
+{
+	UNUSED_PARAMETER(data);
+	return ((struct node *)node)->in_order;
+}
+
+static void node_enum_inputs(void *data, void *node, audio_graph_visit_t visit, void *param)
+{
+	struct node *n = node;
+
+	for (size_t i = 0; i < MAX_NODES && n->inputs[i]; i++)
+		visit(n->inputs[i], param);
+
+	UNUSED_PARAMETER(data);
+}
+
+static const struct audio_graph_ops ops = {NULL, node_level, node_in_order, node_enum_inputs};
+
+static size_t position(void **sorted, size_t count, const struct node *node)
+{
+	for (size_t i = 0; i < count; i++) {
+		if (sorted[i] == node)
+			return i;
+	}
+
+	fail_msg("%s missing from the render order", node->name);
+	return 0;
+}
+
+/* every node has to be on a later level than all of its inputs that are
+ * rendered, which also puts it after them in the render order */
+static void check_order(void **nodes, size_t count)
+{
+	void *sorted[MAX_NODES];
+	size_t level_ends[MAX_NODES];
+	size_t levels;
+
+	levels = audio_graph_sort_levels(&ops, nodes, count, sorted, level_ends);
+	assert_true(levels >= 1);
+	assert_int_equal(level_ends[levels - 1], count);
+
+	for (size_t i = 0; i < count; i++) {
+		struct node *node = nodes[i];
+		size_t pos = position(sorted, count, node);
+
+		assert_true(node->level >= 0 && (size_t)node->level < levels);
+		assert_true(pos < level_ends[node->level]);
+		assert_true(node->level == 0 || pos >= level_ends[node->level - 1]);
+
+		for (size_t j = 0; j < MAX_NODES && node->inputs[j]; j++) {
+			struct node *input = node->inputs[j];
+			if (!input->in_order)
+				continue;
+
+			assert_true(input->level < node->level);
+			assert_true(position(sorted, count, input) < pos);
+		}
+	}
+}
+
+static void independent_sources_test(void **state)
+{
+	struct node a = {"a", 0, true};
+	struct node b = {"b", 0, true};
+	struct node c = {"c", 0, true};
+	void *nodes[] = {&a, &b, &c};
+	void *sorted[3];
+	size_t level_ends[3];
+
+	assert_int_equal(audio_graph_sort_levels(&ops, nodes, 3, sorted, level_ends), 1);
+	assert_int_equal(level_ends[0], 3);
+	assert_ptr_equal(sorted[0], &a);
+	assert_ptr_equal(sorted[1], &b);
+	assert_ptr_equal(sorted[2], &c);
+
+	UNUSED_PARAMETER(state);
+}
+
+/* a scene that mixes a source and a nested scene, listed before both */
+static void nested_submix_test(void **state)
+{
+	struct node mic = {"mic", 0, true};
+	struct node music = {"music", 0, true};
+	struct node inner = {"inner", 0, true, {&music}};
+	struct node outer = {"outer", 0, true, {&mic, &inner}};
+	void *nodes[] = {&outer, &inner, &music, &mic};
+
+	check_order(nodes, 4);
+	assert_int_equal(outer.level, 2);
+	assert_int_equal(inner.level, 1);
+
+	UNUSED_PARAMETER(state);
+}
+
+/* a submix feeding the sidechain of another submix, which also feeds a scene,
+ * all listed in the reverse order */
+static void sidechain_test(void **state)
+{
+	struct node voice = {"voice", 0, true};
+	struct node music = {"music", 0, true};
+	struct node sidechain = {"sidechain", 0, true, {&voice}};
+	struct node ducked = {"ducked", 0, true, {&music, &sidechain}};
+	struct node scene = {"scene", 0, true, {&ducked, &voice}};
+	void *nodes[] = {&scene, &ducked, &sidechain, &music, &voice};
+
+	check_order(nodes, 5);
+	assert_int_equal(scene.level, 3);
+
+	UNUSED_PARAMETER(state);
+}
+
+/* a source read by several submixes is only rendered once, before all of them */
+static void shared_input_test(void **state)
+{
+	struct node shared = {"shared", 0, true};
+	struct node mix1 = {"mix1", 0, true, {&shared}};
+	struct node mix2 = {"mix2", 0, true, {&shared}};
+	struct node scene = {"scene", 0, true, {&mix1, &mix2}};
+	void *nodes[] = {&mix1, &scene, &shared, &mix2};
+
+	check_order(nodes, 4);
+	assert_int_equal(mix1.level, 1);
+	assert_int_equal(mix2.level, 1);
+
+	UNUSED_PARAMETER(state);
+}
+
+/* inputs that aren't rendered this tick don't raise the level */
+static void inactive_input_test(void **state)
+{
+	struct node hidden = {"hidden", 0, false};
+	struct node scene = {"scene", 0, true, {&hidden}};
+	void *nodes[] = {&scene};
+
+	check_order(nodes, 1);
+	assert_int_equal(scene.level, 0);
+
+	UNUSED_PARAMETER(state);
+}
+
+/* two submixes used as each other's sidechain must still terminate */
+static void cycle_test(void **state)
+{
+	struct node a = {"a", 0, true};
+	struct node b = {"b", 0, true, {&a}};
+	void *nodes[] = {&a, &b};
+	void *sorted[2];
+	size_t level_ends[2];
+
+	a.inputs[0] = &b;
+
+	assert_true(audio_graph_sort_levels(&ops, nodes, 2, sorted, level_ends) >= 1);
+	position(sorted, 2, &a);
+	position(sorted, 2, &b);
+
+	UNUSED_PARAMETER(state);
+}
+
+static void empty_test(void **state)
+{
+	assert_int_equal(audio_graph_sort_levels(&ops, NULL, 0, NULL, NULL), 0);
+
+	UNUSED_PARAMETER(state);
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(independent_sources_test),
+		cmocka_unit_test(nested_submix_test),
+		cmocka_unit_test(sidechain_test),
+		cmocka_unit_test(shared_input_test),
+		cmocka_unit_test(inactive_input_test),
+		cmocka_unit_test(cycle_test),
+		cmocka_unit_test(empty_test),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
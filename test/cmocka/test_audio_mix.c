@@ -0,0 +1,104 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <stdlib.h>
+
+#include <obs-audio-mix.h>
+#include <media-io/audio-io.h>
+
+#define MAX_OFFSET 4
+#define GUARD 8
+#define BUF_SIZE (AUDIO_OUTPUT_FRAMES + MAX_OFFSET + GUARD * 2)
+#define GUARD_VALUE -12345.0f
+
+static uint32_t rand_state;
+
+static uint32_t next_rand(void)
+{
+	rand_state = rand_state * 1103515245 + 12345;
+	return (rand_state >> 16) & 0x7FFF;
+}
+
+/* multiples of 1/256 in a small range, so every sum is exact and the results
+ * can be compared without a tolerance */
+static float next_sample(void)
+{
+	return (float)((int)(next_rand() % 1024) - 512) / 256.0f;
+}
+
+static void check_mix(size_t count, size_t mix_offset, size_t aud_offset)
+{
+	float mix[BUF_SIZE];
+	float expected[BUF_SIZE];
+	float aud[BUF_SIZE];
+
+	for (size_t i = 0; i < BUF_SIZE; i++) {
+		mix[i] = expected[i] = next_sample();
+		aud[i] = next_sample();
+	}
+
+	/* values around the mixed range must not be touched */
+	for (size_t i = 0; i < GUARD; i++) {
+		mix[mix_offset + i] = expected[mix_offset + i] = GUARD_VALUE;
+		mix[mix_offset + GUARD + count + i] = expected[mix_offset + GUARD + count + i] = GUARD_VALUE;
+	}
+
+	float *mix_start = mix + mix_offset + GUARD;
+	float *expected_start = expected + mix_offset + GUARD;
+	const float *aud_start = aud + aud_offset + GUARD;
+
+	for (size_t i = 0; i < count; i++)
+		expected_start[i] += aud_start[i];
+
+	mix_audio_channel(mix_start, aud_start, count);
+
+	for (size_t i = 0; i < BUF_SIZE; i++) {
+		if (mix[i] != expected[i]) {
+			fail_msg("count %zu, offsets %zu/%zu: float %zu is %f, expected %f", count, mix_offset,
+				 aud_offset, i, mix[i], expected[i]);
+		}
+	}
+}
+
+/* every length up to a few blocks, so each combination of the 16-float loop,
+ * the 4-float loop and the scalar tail runs */
+static void short_lengths_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	rand_state = 1;
+
+	for (size_t count = 0; count <= 80; count++) {
+		for (size_t mix_offset = 0; mix_offset < MAX_OFFSET; mix_offset++) {
+			for (size_t aud_offset = 0; aud_offset < MAX_OFFSET; aud_offset++)
+				check_mix(count, mix_offset, aud_offset);
+		}
+	}
+}
+
+/* a whole tick, and what is left of a tick when a source starts within it */
+static void tick_lengths_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	rand_state = 2;
+
+	for (size_t start_point = 0; start_point < 40; start_point++) {
+		size_t count = AUDIO_OUTPUT_FRAMES - start_point;
+
+		for (size_t aud_offset = 0; aud_offset < MAX_OFFSET; aud_offset++)
+			check_mix(count, start_point % MAX_OFFSET, aud_offset);
+	}
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(short_lengths_test),
+		cmocka_unit_test(tick_lengths_test),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,74 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <util/bmem.h>
+#include <util/buffered-file-serializer.h>
+#include <util/platform.h>
+#include <util/threading.h>
+
+#define CHUNK_SIZE 65536
+#define QUEUE_DEPTH 4
+
+/* how long freeing may take before the I/O thread is considered stuck */
+#define FREE_TIMEOUT_MS 10000
+
+struct free_thread {
+	struct serializer *s;
+	os_event_t *done;
+};
+
+static void *free_thread(void *param)
+{
+	struct free_thread *data = param;
+
+	buffered_file_serializer_free(data->s);
+	os_event_signal(data->done);
+	return NULL;
+}
+
+/* Every write to /dev/full fails with ENOSPC.  With several chunks in flight
+ * when the first one fails, the I/O thread still has to wind down. */
+static void write_error_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	struct free_thread data = {0};
+	struct serializer s;
+	pthread_t thread;
+	uint8_t *buf;
+
+	assert_true(buffered_file_serializer_init_ex(&s, "/dev/full", 0, CHUNK_SIZE, QUEUE_DEPTH, false));
+
+	buf = bzalloc(CHUNK_SIZE);
+
+	/* the writer notices the error at some point, but not necessarily on
+	 * the first write */
+	for (size_t i = 0; i < 4 * QUEUE_DEPTH; i++) {
+		if (s.write(s.data, buf, CHUNK_SIZE) != CHUNK_SIZE)
+			break;
+	}
+
+	assert_false(buffered_file_serializer_sync(&s));
+	assert_true(serializer_get_pos(&s) < 0);
+
+	data.s = &s;
+	assert_int_equal(os_event_init(&data.done, OS_EVENT_TYPE_MANUAL), 0);
+	assert_int_equal(pthread_create(&thread, NULL, free_thread, &data), 0);
+
+	assert_int_equal(os_event_timedwait(data.done, FREE_TIMEOUT_MS), 0);
+	pthread_join(thread, NULL);
+
+	os_event_destroy(data.done);
+	bfree(buf);
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(write_error_test),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
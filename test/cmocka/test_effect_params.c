@@ -0,0 +1,91 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <graphics/effect.h>
+
+/* the params of format_conversion.effect */
+static const char *param_names[] = {
+	"width",
+	"height",
+	"width_i",
+	"height_i",
+	"width_d2",
+	"height_d2",
+	"width_x2_i",
+	"height_x2_i",
+	"maximum_over_sdr_white_nits",
+	"sdr_white_nits_over_maximum",
+	"hlg_exponent",
+	"hdr_lw",
+	"hdr_lmax",
+	"color_vec0",
+	"color_vec1",
+	"color_vec2",
+	"color_range_min",
+	"color_range_max",
+	"image",
+	"image1",
+	"image2",
+	"image3",
+};
+
+static void create_effect(gs_effect_t *effect, const char **names, size_t num)
+{
+	effect_init(effect);
+	da_resize(effect->params, num);
+
+	for (size_t i = 0; i < num; i++) {
+		struct gs_effect_param *param = effect->params.array + i;
+
+		effect_param_init(param);
+		param->name = bstrdup(names[i]);
+		param->id = gs_effect_param_id(names[i]);
+		param->section = EFFECT_PARAM;
+		param->effect = effect;
+	}
+
+	effect_build_param_table(effect);
+}
+
+static void lookup_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	const size_t num = sizeof(param_names) / sizeof(param_names[0]);
+	gs_effect_t effect;
+
+	create_effect(&effect, param_names, num);
+
+	for (size_t i = 0; i < num; i++) {
+		gs_eparam_t *expected = effect.params.array + i;
+		gs_param_id_t id = gs_effect_param_id(param_names[i]);
+
+		assert_ptr_equal(gs_effect_get_param_by_name(&effect, param_names[i]), expected);
+		assert_ptr_equal(gs_effect_get_param_by_id(&effect, id), expected);
+	}
+
+	assert_null(gs_effect_get_param_by_name(&effect, "multiplier"));
+	assert_null(gs_effect_get_param_by_id(&effect, gs_effect_param_id("multiplier")));
+	assert_null(gs_effect_get_param_by_name(&effect, ""));
+	assert_null(gs_effect_get_param_by_id(NULL, gs_effect_param_id("image")));
+
+	effect_free(&effect);
+
+	/* an effect without params has no table */
+	create_effect(&effect, NULL, 0);
+	assert_null(effect.param_table);
+	assert_null(gs_effect_get_param_by_name(&effect, "image"));
+	assert_null(gs_effect_get_param_by_id(&effect, gs_effect_param_id("image")));
+	effect_free(&effect);
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(lookup_test),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,123 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <stdlib.h>
+
+#include <util/threading.h>
+
+#include "ffmpeg-mux.h"
+#include "ffmpeg-mux-shm.h"
+
+/* ------------------------------------------------------------------------- */
+
+struct reader {
+	const char *name;
+	struct ffm_shm *shm;
+	uint64_t bytes;
+	uint64_t packets;
+	uint64_t checksum;
+};
+
+static inline uint8_t pattern(uint64_t packet, size_t i)
+{
+	return (uint8_t)(packet * 31 + i);
+}
+
+static void *roundtrip_reader(void *param)
+{
+	struct reader *r = param;
+	struct ffm_packet_info info;
+	uint8_t *buf = NULL;
+
+	r->shm = ffm_shm_open(r->name);
+	if (!r->shm)
+		return NULL;
+
+	while (ffm_shm_read(r->shm, &info, sizeof(info)) == sizeof(info)) {
+		bool copied = info.size > ffm_shm_capacity(r->shm);
+		const uint8_t *data;
+
+		/* larger than the ring, has to be copied out */
+		if (copied) {
+			buf = realloc(buf, info.size);
+			if (ffm_shm_read(r->shm, buf, info.size) != info.size)
+				break;
+			data = buf;
+		} else {
+			data = ffm_shm_peek(r->shm, info.size);
+			if (!data)
+				break;
+		}
+
+		for (size_t i = 0; i < info.size; i++)
+			r->checksum += data[i] == pattern((uint64_t)info.pts, i) ? 0 : 1;
+
+		if (!copied)
+			ffm_shm_consume(r->shm, info.size);
+
+		r->bytes += info.size;
+		r->packets++;
+	}
+
+	free(buf);
+	ffm_shm_destroy(r->shm);
+	return NULL;
+}
+
+static void roundtrip_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	static const uint32_t sizes[] = {1, 7, 4096, 100, 65536, 3, 200000, 0, 12345};
+	const size_t num_sizes = sizeof(sizes) / sizeof(sizes[0]);
+	struct reader r = {0};
+	uint64_t bytes = 0;
+	pthread_t thread;
+	uint8_t *data;
+
+	/* smaller than some of the packets, and wraps around many times */
+	struct ffm_shm *shm = ffm_shm_create(64 * 1024);
+	assert_non_null(shm);
+	assert_int_equal(ffm_shm_capacity(shm), 64 * 1024);
+
+	r.name = ffm_shm_name(shm);
+	assert_int_equal(pthread_create(&thread, NULL, roundtrip_reader, &r), 0);
+
+	data = malloc(200000);
+
+	for (uint64_t i = 0; i < 1000; i++) {
+		struct ffm_packet_info info = {.pts = (int64_t)i, .size = sizes[i % num_sizes]};
+
+		for (size_t j = 0; j < info.size; j++)
+			data[j] = pattern(i, j);
+
+		assert_true(ffm_shm_write(shm, &info, sizeof(info)));
+		assert_true(ffm_shm_write(shm, data, info.size));
+		bytes += info.size;
+	}
+
+	/* the reader still gets everything written before closing */
+	ffm_shm_close(shm);
+	pthread_join(thread, NULL);
+
+	assert_int_equal(r.packets, 1000);
+	assert_int_equal(r.bytes, bytes);
+	assert_int_equal(r.checksum, 0);
+
+	/* the reader has detached, so writing fails instead of blocking */
+	assert_false(ffm_shm_write(shm, data, 1));
+
+	free(data);
+	ffm_shm_destroy(shm);
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(roundtrip_test),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
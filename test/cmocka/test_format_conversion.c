@@ -0,0 +1,160 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <util/bmem.h>
+#include <media-io/format-conversion.h>
+
+/* odd chroma widths so the scalar tail after the vector loop is covered */
+#define TEST_WIDTH 166
+#define TEST_HEIGHT 8
+
+static void fill_random(uint8_t *data, size_t size)
+{
+	for (size_t i = 0; i < size; i++)
+		data[i] = (uint8_t)rand();
+}
+
+static void ref_decompress_420(const uint8_t *const input[], const uint32_t in_linesize[], uint32_t width,
+			       uint32_t height, uint8_t *output, uint32_t out_linesize)
+{
+	for (uint32_t y = 0; y < height; y++) {
+		uint32_t *out = (uint32_t *)(output + y * out_linesize);
+
+		for (uint32_t x = 0; x < width; x++) {
+			uint32_t lum = input[0][y * in_linesize[0] + x];
+			uint32_t u = input[1][(y / 2) * in_linesize[1] + x / 2];
+			uint32_t v = input[2][(y / 2) * in_linesize[2] + x / 2];
+
+			out[x] = (lum << 16) | (u << 8) | v;
+		}
+	}
+}
+
+static void ref_decompress_nv12(const uint8_t *const input[], const uint32_t in_linesize[], uint32_t width,
+				uint32_t height, uint8_t *output, uint32_t out_linesize)
+{
+	for (uint32_t y = 0; y < height; y++) {
+		uint32_t *out = (uint32_t *)(output + y * out_linesize);
+
+		for (uint32_t x = 0; x < width; x++) {
+			uint32_t lum = input[0][y * in_linesize[0] + x];
+			uint32_t u = input[1][(y / 2) * in_linesize[1] + (x & ~1)];
+			uint32_t v = input[1][(y / 2) * in_linesize[1] + (x & ~1) + 1];
+
+			out[x] = lum | (u << 8) | (v << 16);
+		}
+	}
+}
+
+static void ref_decompress_422(const uint8_t *input, uint32_t in_linesize, uint32_t dwords, uint32_t height,
+			       uint8_t *output, uint32_t out_linesize, bool leading_lum)
+{
+	for (uint32_t y = 0; y < height; y++) {
+		const uint32_t *in = (const uint32_t *)(input + y * in_linesize);
+		uint32_t *out = (uint32_t *)(output + y * out_linesize);
+
+		for (uint32_t x = 0; x < dwords; x++) {
+			uint32_t dw = in[x];
+
+			out[x * 2] = dw;
+			if (leading_lum)
+				out[x * 2 + 1] = (dw & 0xFFFFFF00) | ((dw >> 16) & 0xFF);
+			else
+				out[x * 2 + 1] = (dw & 0xFFFF00FF) | ((dw >> 16) & 0xFF00);
+		}
+	}
+}
+
+static void decompress_420_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	uint32_t in_linesize[3] = {TEST_WIDTH, TEST_WIDTH / 2, TEST_WIDTH / 2};
+	uint32_t out_linesize = TEST_WIDTH * 4;
+	uint8_t *planes[3];
+
+	planes[0] = bmalloc(in_linesize[0] * TEST_HEIGHT);
+	planes[1] = bmalloc(in_linesize[1] * TEST_HEIGHT / 2);
+	planes[2] = bmalloc(in_linesize[2] * TEST_HEIGHT / 2);
+	fill_random(planes[0], in_linesize[0] * TEST_HEIGHT);
+	fill_random(planes[1], in_linesize[1] * TEST_HEIGHT / 2);
+	fill_random(planes[2], in_linesize[2] * TEST_HEIGHT / 2);
+
+	uint8_t *out = bzalloc(out_linesize * TEST_HEIGHT);
+	uint8_t *ref = bzalloc(out_linesize * TEST_HEIGHT);
+
+	decompress_420((const uint8_t *const *)planes, in_linesize, 0, TEST_HEIGHT, out, out_linesize);
+	ref_decompress_420((const uint8_t *const *)planes, in_linesize, TEST_WIDTH, TEST_HEIGHT, ref, out_linesize);
+	assert_memory_equal(out, ref, out_linesize * TEST_HEIGHT);
+
+	bfree(ref);
+	bfree(out);
+	for (size_t i = 0; i < 3; i++)
+		bfree(planes[i]);
+}
+
+static void decompress_nv12_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	uint32_t in_linesize[2] = {TEST_WIDTH, TEST_WIDTH};
+	uint32_t out_linesize = TEST_WIDTH * 4;
+	uint8_t *planes[2];
+
+	planes[0] = bmalloc(in_linesize[0] * TEST_HEIGHT);
+	planes[1] = bmalloc(in_linesize[1] * TEST_HEIGHT / 2);
+	fill_random(planes[0], in_linesize[0] * TEST_HEIGHT);
+	fill_random(planes[1], in_linesize[1] * TEST_HEIGHT / 2);
+
+	uint8_t *out = bzalloc(out_linesize * TEST_HEIGHT);
+	uint8_t *ref = bzalloc(out_linesize * TEST_HEIGHT);
+
+	decompress_nv12((const uint8_t *const *)planes, in_linesize, 0, TEST_HEIGHT, out, out_linesize);
+	ref_decompress_nv12((const uint8_t *const *)planes, in_linesize, TEST_WIDTH, TEST_HEIGHT, ref, out_linesize);
+	assert_memory_equal(out, ref, out_linesize * TEST_HEIGHT);
+
+	bfree(ref);
+	bfree(out);
+	bfree(planes[0]);
+	bfree(planes[1]);
+}
+
+static void decompress_422_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	uint32_t in_linesize = TEST_WIDTH * 2;
+	uint32_t out_linesize = TEST_WIDTH * 4;
+	uint32_t dwords = in_linesize / 2;
+
+	uint8_t *in = bmalloc(in_linesize * TEST_HEIGHT * 2);
+	uint8_t *out = bzalloc(out_linesize * TEST_HEIGHT * 2);
+	uint8_t *ref = bzalloc(out_linesize * TEST_HEIGHT * 2);
+	fill_random(in, in_linesize * TEST_HEIGHT * 2);
+
+	for (int leading_lum = 0; leading_lum < 2; leading_lum++) {
+		decompress_422(in, in_linesize, 0, TEST_HEIGHT, out, out_linesize, leading_lum);
+		ref_decompress_422(in, in_linesize, dwords, TEST_HEIGHT, ref, out_linesize, leading_lum);
+		assert_memory_equal(out, ref, out_linesize * TEST_HEIGHT);
+	}
+
+	bfree(ref);
+	bfree(out);
+	bfree(in);
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(decompress_420_test),
+		cmocka_unit_test(decompress_nv12_test),
+		cmocka_unit_test(decompress_422_test),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,257 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <stdlib.h>
+
+#include <obs-interleave.h>
+
+#define VIDEO_TRACKS 2
+#define AUDIO_TRACKS 6
+#define DURATION_USEC (10 * 1000000LL)
+
+struct timeline {
+	DARRAY(struct encoder_packet) packets;
+	DARRAY(int64_t) arrival;
+};
+
+static uint32_t rand_state;
+
+static uint32_t next_rand(void)
+{
+	rand_state = rand_state * 1103515245 + 12345;
+	return (rand_state >> 16) & 0x7FFF;
+}
+
+static void add_packet(struct timeline *t, enum obs_encoder_type type, size_t track, int64_t dts_usec,
+		       int64_t arrival)
+{
+	struct encoder_packet *packet = da_push_back_new(t->packets);
+
+	packet->type = type;
+	packet->track_idx = track;
+	packet->dts_usec = dts_usec;
+	/* unique id, so the output order can be compared */
+	packet->pts = (int64_t)t->packets.num;
+
+	da_push_back(t->arrival, &arrival);
+}
+
+/* sorts by arrival time, keeping the generation order for equal arrivals */
+static void sort_by_arrival(struct timeline *t)
+{
+	for (size_t i = 1; i < t->packets.num; i++) {
+		struct encoder_packet packet = t->packets.array[i];
+		int64_t arrival = t->arrival.array[i];
+		size_t j = i;
+
+		while (j > 0 && t->arrival.array[j - 1] > arrival) {
+			t->packets.array[j] = t->packets.array[j - 1];
+			t->arrival.array[j] = t->arrival.array[j - 1];
+			j--;
+		}
+
+		t->packets.array[j] = packet;
+		t->arrival.array[j] = arrival;
+	}
+}
+
+/* shaped like a recording with two video encoders and six 48 kHz audio
+ * tracks, where the audio tracks share timestamps and every encoder has its
+ * own varying latency */
+static void generate_timeline(struct timeline *t, uint32_t seed, int64_t max_video_latency)
+{
+	rand_state = seed;
+
+	for (size_t track = 0; track < VIDEO_TRACKS; track++) {
+		for (int64_t frame = 0;; frame++) {
+			int64_t dts = frame * 1000000LL / 60;
+			if (dts >= DURATION_USEC)
+				break;
+
+			int64_t latency = 5000 + (int64_t)(next_rand() % (uint32_t)max_video_latency);
+			add_packet(t, OBS_ENCODER_VIDEO, track, dts, dts + latency);
+		}
+	}
+
+	for (size_t track = 0; track < AUDIO_TRACKS; track++) {
+		for (int64_t frame = 0;; frame++) {
+			int64_t dts = frame * 1024 * 1000000LL / 48000;
+			if (dts >= DURATION_USEC)
+				break;
+
+			int64_t latency = (int64_t)(next_rand() % 3000);
+			add_packet(t, OBS_ENCODER_AUDIO, track, dts, dts + latency);
+		}
+	}
+
+	sort_by_arrival(t);
+}
+
+static void free_timeline(struct timeline *t)
+{
+	da_free(t->packets);
+	da_free(t->arrival);
+}
+
+struct highest_ts {
+	int64_t video[VIDEO_TRACKS];
+	int64_t audio;
+};
+
+static void set_highest(struct highest_ts *h, const struct encoder_packet *packet)
+{
+	if (packet->type == OBS_ENCODER_VIDEO) {
+		if (h->video[packet->track_idx] < packet->dts_usec)
+			h->video[packet->track_idx] = packet->dts_usec;
+	} else if (h->audio < packet->dts_usec) {
+		h->audio = packet->dts_usec;
+	}
+}
+
+/* same rule the output uses before sending the earliest packet */
+static bool can_send(const struct highest_ts *h, const struct encoder_packet *packet)
+{
+	bool has_higher = true;
+
+	for (size_t i = 0; i < VIDEO_TRACKS; i++) {
+		if (packet->type == OBS_ENCODER_VIDEO && i == packet->track_idx)
+			continue;
+		has_higher = has_higher && h->video[i] > packet->dts_usec;
+	}
+
+	return packet->type == OBS_ENCODER_AUDIO ? has_higher : (has_higher && h->audio > packet->dts_usec);
+}
+
+/* the original sorted array implementation */
+static void replay_sorted(const struct timeline *t, int64_t *order)
+{
+	DARRAY(struct encoder_packet) packets = {0};
+	struct highest_ts h = {{INT64_MIN, INT64_MIN}, INT64_MIN};
+	size_t sent = 0;
+
+	for (size_t i = 0; i < t->packets.num; i++) {
+		struct encoder_packet *packet = &t->packets.array[i];
+		size_t idx = interleave_sorted_insert_idx(packets.array, packets.num, packet);
+
+		da_insert(packets, idx, packet);
+		set_highest(&h, packet);
+
+		if (can_send(&h, &packets.array[0])) {
+			order[sent++] = packets.array[0].pts;
+			da_erase(packets, 0);
+		}
+	}
+
+	while (packets.num) {
+		order[sent++] = packets.array[0].pts;
+		da_erase(packets, 0);
+	}
+
+	assert_int_equal(sent, t->packets.num);
+	da_free(packets);
+}
+
+static void replay_heap(const struct timeline *t, int64_t *order)
+{
+	struct interleave_heap heap = {0};
+	struct highest_ts h = {{INT64_MIN, INT64_MIN}, INT64_MIN};
+	struct encoder_packet out;
+	size_t sent = 0;
+
+	for (size_t i = 0; i < t->packets.num; i++) {
+		struct encoder_packet *packet = &t->packets.array[i];
+
+		interleave_heap_push(&heap, packet);
+		set_highest(&h, packet);
+
+		if (can_send(&h, interleave_heap_peek(&heap))) {
+			interleave_heap_pop(&heap, &out);
+			order[sent++] = out.pts;
+		}
+	}
+
+	while (interleave_heap_pop(&heap, &out))
+		order[sent++] = out.pts;
+
+	assert_int_equal(sent, t->packets.num);
+	interleave_heap_free(&heap);
+}
+
+static void compare_replays(struct timeline *t)
+{
+	int64_t *sorted_order = bzalloc(t->packets.num * sizeof(int64_t));
+	int64_t *heap_order = bzalloc(t->packets.num * sizeof(int64_t));
+
+	replay_sorted(t, sorted_order);
+	replay_heap(t, heap_order);
+	assert_memory_equal(sorted_order, heap_order, t->packets.num * sizeof(int64_t));
+
+	bfree(heap_order);
+	bfree(sorted_order);
+}
+
+static void recorded_timeline_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	/* low latency encoders, and a slow video encoder that buffers up
+	 * hundreds of audio packets ahead of it */
+	const int64_t latencies[] = {10000, 40000, 400000};
+
+	for (size_t i = 0; i < sizeof(latencies) / sizeof(latencies[0]); i++) {
+		struct timeline t = {0};
+
+		generate_timeline(&t, (uint32_t)(i + 1), latencies[i]);
+		compare_replays(&t);
+		free_timeline(&t);
+	}
+}
+
+static void shuffled_timeline_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	struct timeline t = {0};
+	generate_timeline(&t, 1234, 10000);
+
+	/* arbitrary arrival order */
+	for (size_t i = 0; i < t.packets.num; i++) {
+		size_t j = next_rand() % t.packets.num;
+		struct encoder_packet tmp = t.packets.array[i];
+
+		t.packets.array[i] = t.packets.array[j];
+		t.packets.array[j] = tmp;
+	}
+
+	/* equal timestamps within the same track */
+	for (size_t i = 0; i < t.packets.num; i++) {
+		struct encoder_packet *packet = &t.packets.array[i];
+
+		if (next_rand() % 8 != 0)
+			continue;
+
+		for (size_t j = i + 1; j < t.packets.num; j++) {
+			struct encoder_packet *other = &t.packets.array[j];
+
+			if (other->type == packet->type && other->track_idx == packet->track_idx) {
+				other->dts_usec = packet->dts_usec;
+				break;
+			}
+		}
+	}
+
+	compare_replays(&t);
+	free_timeline(&t);
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(recorded_timeline_test),
+		cmocka_unit_test(shuffled_timeline_test),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
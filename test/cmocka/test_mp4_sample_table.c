@@ -0,0 +1,84 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include "mp4-sample-table.h"
+
+static void roundtrip_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	static const int64_t values[] = {
+		0, 1, -1, 63, -64, 64, 127, 128, 300, -300, INT32_MAX, INT32_MIN, INT64_MAX, INT64_MIN,
+	};
+	const size_t num_values = sizeof(values) / sizeof(values[0]);
+
+	for (int spill = 0; spill < 2; spill++) {
+		struct sample_table table;
+		struct sample_table_reader reader;
+		const size_t count = SAMPLE_TABLE_SPILL_SIZE;
+
+		sample_table_init(&table, spill ? "." : NULL);
+
+		for (size_t i = 0; i < count; i++) {
+			sample_table_push(&table, i);
+			sample_table_push_signed(&table, values[i % num_values]);
+		}
+
+		assert_int_equal(table.num, count * 2);
+		if (spill) {
+			assert_non_null(table.file);
+			assert_true(sample_table_memory(&table) <= SAMPLE_TABLE_SPILL_SIZE * 2);
+		}
+
+		/* read twice, as the moov may be written more than once */
+		for (int pass = 0; pass < 2; pass++) {
+			sample_table_reader_init(&reader, &table);
+
+			for (size_t i = 0; i < count; i++) {
+				assert_int_equal(sample_table_read(&reader), i);
+				assert_int_equal(sample_table_read_signed(&reader), values[i % num_values]);
+			}
+		}
+
+		sample_table_free(&table);
+	}
+}
+
+/* frame size differences of a video track take less than the 4 bytes per
+ * sample of a plain array */
+static void memory_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	struct sample_table table;
+	uint32_t seed = 1;
+	uint32_t last_size = 0;
+	const size_t count = 60 * 60 * 60;
+
+	sample_table_init(&table, NULL);
+
+	for (size_t i = 0; i < count; i++) {
+		seed = seed * 1664525 + 1013904223;
+		uint32_t size = 10000 + (seed >> 8) % 20000;
+
+		sample_table_push_signed(&table, (int64_t)size - (int64_t)last_size);
+		last_size = size;
+	}
+
+	assert_int_equal(table.num, count);
+	assert_true(table.data.num < count * 4);
+
+	sample_table_free(&table);
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(roundtrip_test),
+		cmocka_unit_test(memory_test),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,125 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <string.h>
+
+#include <obs-data.h>
+#include <util/bmem.h>
+
+typedef obs_data_t *(*create_t)(void);
+
+/* roughly what a source's get_defaults and a properties refresh do */
+static void fill_settings(obs_data_t *settings)
+{
+	obs_data_t *font = obs_data_create();
+
+	obs_data_set_default_string(settings, "local_file", "");
+	obs_data_set_default_bool(settings, "looping", false);
+	obs_data_set_default_bool(settings, "restart_on_activate", true);
+	obs_data_set_default_int(settings, "buffering_mb", 2);
+	obs_data_set_default_int(settings, "speed_percent", 100);
+	obs_data_set_default_double(settings, "volume", 1.0);
+	obs_data_set_default_string(settings, "color_range", "auto");
+
+	obs_data_set_string(settings, "local_file", "/home/user/Videos/clip.mp4");
+	obs_data_set_bool(settings, "looping", true);
+	obs_data_set_int(settings, "speed_percent", 150);
+
+	obs_data_set_default_string(font, "face", "Sans Serif");
+	obs_data_set_default_int(font, "size", 36);
+	obs_data_set_default_obj(settings, "font", font);
+	obs_data_release(font);
+}
+
+static void read_settings(obs_data_t *settings)
+{
+	assert_string_equal(obs_data_get_string(settings, "local_file"), "/home/user/Videos/clip.mp4");
+	assert_true(obs_data_get_bool(settings, "looping"));
+	assert_true(obs_data_get_bool(settings, "restart_on_activate"));
+	assert_int_equal(obs_data_get_int(settings, "buffering_mb"), 2);
+	assert_int_equal(obs_data_get_int(settings, "speed_percent"), 150);
+	assert_true(obs_data_get_double(settings, "volume") == 1.0);
+	assert_string_equal(obs_data_get_string(settings, "color_range"), "auto");
+}
+
+static void arena_values_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	long allocs = bnum_allocs();
+	obs_data_t *settings = obs_data_create_arena();
+
+	fill_settings(settings);
+	read_settings(settings);
+
+	/* growing a value moves the item out of the arena */
+	char str[256];
+	for (size_t i = 0; i < sizeof(str) - 1; i++) {
+		memset(str, 'a', i);
+		str[i] = 0;
+		obs_data_set_string(settings, "growing", str);
+		assert_string_equal(obs_data_get_string(settings, "growing"), str);
+	}
+
+	obs_data_erase(settings, "growing");
+	assert_false(obs_data_has_user_value(settings, "growing"));
+	read_settings(settings);
+
+	/* child objects created on behalf of an arena object keep their values */
+	obs_data_t *defaults = obs_data_get_defaults(settings);
+	obs_data_t *font = obs_data_get_obj(defaults, "font");
+	assert_string_equal(obs_data_get_string(font, "face"), "Sans Serif");
+	assert_int_equal(obs_data_get_int(font, "size"), 36);
+	obs_data_release(font);
+	obs_data_release(defaults);
+
+	/* apply only copies user values */
+	obs_data_t *copy = obs_data_create_arena();
+	obs_data_apply(copy, settings);
+	assert_string_equal(obs_data_get_string(copy, "local_file"), "/home/user/Videos/clip.mp4");
+	assert_true(obs_data_get_bool(copy, "looping"));
+	assert_int_equal(obs_data_get_int(copy, "speed_percent"), 150);
+	obs_data_release(copy);
+
+	/* items and child objects may outlive the object they came from */
+	obs_data_item_t *item = obs_data_item_byname(settings, "local_file");
+	obs_data_release(settings);
+
+	assert_string_equal(obs_data_item_get_name(item), "local_file");
+	assert_string_equal(obs_data_item_get_string(item), "/home/user/Videos/clip.mp4");
+	obs_data_item_release(&item);
+
+	assert_int_equal(bnum_allocs(), allocs);
+}
+
+static long count_allocs(create_t create)
+{
+	long allocs = bnum_allocs();
+	obs_data_t *settings = create();
+
+	fill_settings(settings);
+	allocs = bnum_allocs() - allocs;
+	obs_data_release(settings);
+
+	return allocs;
+}
+
+/* the point of the arena is to save allocations */
+static void arena_allocs_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	assert_true(count_allocs(obs_data_create_arena) < count_allocs(obs_data_create));
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(arena_values_test),
+		cmocka_unit_test(arena_allocs_test),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
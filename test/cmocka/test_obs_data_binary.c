@@ -0,0 +1,272 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <stdio.h>
+#include <string.h>
+
+#include <obs-data.h>
+#include <util/bmem.h>
+#include <util/platform.h>
+
+#define TEST_BINARY_FILE "test_obs_data_binary.bin"
+#define TEST_JSON_FILE "test_obs_data_binary.json"
+
+#define TEST_SOURCES 50
+
+static bool data_equal(obs_data_t *a, obs_data_t *b);
+
+static bool array_equal(obs_data_array_t *a, obs_data_array_t *b)
+{
+	size_t count = obs_data_array_count(a);
+	bool equal = count == obs_data_array_count(b);
+
+	for (size_t i = 0; equal && i < count; i++) {
+		obs_data_t *item_a = obs_data_array_item(a, i);
+		obs_data_t *item_b = obs_data_array_item(b, i);
+		equal = data_equal(item_a, item_b);
+		obs_data_release(item_a);
+		obs_data_release(item_b);
+	}
+
+	return equal;
+}
+
+static bool item_equal(obs_data_item_t *a, obs_data_item_t *b)
+{
+	enum obs_data_type type = obs_data_item_gettype(a);
+	bool equal = false;
+
+	if (!b || type != obs_data_item_gettype(b))
+		return false;
+
+	if (type == OBS_DATA_STRING) {
+		equal = strcmp(obs_data_item_get_string(a), obs_data_item_get_string(b)) == 0;
+
+	} else if (type == OBS_DATA_NUMBER) {
+		equal = obs_data_item_numtype(a) == obs_data_item_numtype(b);
+		if (obs_data_item_numtype(a) == OBS_DATA_NUM_INT)
+			equal = equal && obs_data_item_get_int(a) == obs_data_item_get_int(b);
+		else
+			equal = equal && obs_data_item_get_double(a) == obs_data_item_get_double(b);
+
+	} else if (type == OBS_DATA_BOOLEAN) {
+		equal = obs_data_item_get_bool(a) == obs_data_item_get_bool(b);
+
+	} else if (type == OBS_DATA_OBJECT) {
+		obs_data_t *obj_a = obs_data_item_get_obj(a);
+		obs_data_t *obj_b = obs_data_item_get_obj(b);
+		equal = data_equal(obj_a, obj_b);
+		obs_data_release(obj_a);
+		obs_data_release(obj_b);
+
+	} else if (type == OBS_DATA_ARRAY) {
+		obs_data_array_t *array_a = obs_data_item_get_array(a);
+		obs_data_array_t *array_b = obs_data_item_get_array(b);
+		equal = array_equal(array_a, array_b);
+		obs_data_array_release(array_a);
+		obs_data_array_release(array_b);
+	}
+
+	return equal;
+}
+
+static size_t count_items(obs_data_t *data)
+{
+	size_t count = 0;
+
+	for (obs_data_item_t *item = obs_data_first(data); item; obs_data_item_next(&item))
+		count++;
+
+	return count;
+}
+
+static bool data_equal(obs_data_t *a, obs_data_t *b)
+{
+	if (!a || !b)
+		return a == b;
+	if (count_items(a) != count_items(b))
+		return false;
+
+	for (obs_data_item_t *item = obs_data_first(a); item; obs_data_item_next(&item)) {
+		obs_data_item_t *other = obs_data_item_byname(b, obs_data_item_get_name(item));
+		bool equal = item_equal(item, other);
+
+		obs_data_item_release(&other);
+		if (!equal) {
+			obs_data_item_release(&item);
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static obs_data_t *create_source(size_t idx)
+{
+	obs_data_t *source = obs_data_create();
+	obs_data_t *settings = obs_data_create();
+	obs_data_array_t *filters = obs_data_array_create();
+	char name[64];
+
+	snprintf(name, sizeof(name), "Source %zu", idx);
+	obs_data_set_string(source, "name", name);
+	obs_data_set_string(source, "id", "ffmpeg_source");
+	obs_data_set_string(source, "uuid", "1b0bd0a5-6f35-4a4e-a9e5-5f2f6f0c8a1e");
+	obs_data_set_int(source, "mixers", 255);
+	obs_data_set_double(source, "volume", 0.75);
+	obs_data_set_bool(source, "enabled", true);
+
+	obs_data_set_string(settings, "local_file", "/home/user/Videos/clip.mp4");
+	obs_data_set_bool(settings, "looping", idx % 2 == 0);
+	obs_data_set_int(settings, "buffering_mb", 2);
+	obs_data_set_obj(source, "settings", settings);
+
+	for (size_t i = 0; i < 3; i++) {
+		obs_data_t *filter = obs_data_create();
+		obs_data_t *filter_settings = obs_data_create();
+
+		snprintf(name, sizeof(name), "Filter %zu", i);
+		obs_data_set_string(filter, "name", name);
+		obs_data_set_string(filter, "id", "color_filter_v2");
+		obs_data_set_double(filter_settings, "brightness", 0.1 * (double)i);
+		obs_data_set_double(filter_settings, "contrast", -0.25);
+		obs_data_set_int(filter_settings, "color_multiply", 0xFFFFFFFF);
+		obs_data_set_obj(filter, "settings", filter_settings);
+		obs_data_array_push_back(filters, filter);
+
+		obs_data_release(filter_settings);
+		obs_data_release(filter);
+	}
+
+	obs_data_set_array(source, "filters", filters);
+
+	obs_data_array_release(filters);
+	obs_data_release(settings);
+	return source;
+}
+
+static obs_data_t *create_collection(size_t num_sources)
+{
+	obs_data_t *collection = obs_data_create();
+	obs_data_array_t *sources = obs_data_array_create();
+
+	for (size_t i = 0; i < num_sources; i++) {
+		obs_data_t *source = create_source(i);
+		obs_data_array_push_back(sources, source);
+		obs_data_release(source);
+	}
+
+	obs_data_set_string(collection, "name", "Collection");
+	obs_data_set_string(collection, "current_scene", "Scene");
+	obs_data_set_array(collection, "sources", sources);
+
+	obs_data_array_release(sources);
+	return collection;
+}
+
+static uint8_t *read_file(const char *file, size_t *size)
+{
+	FILE *f = os_fopen(file, "rb");
+	int64_t file_size = os_fgetsize(f);
+	uint8_t *data = bmalloc((size_t)file_size);
+
+	assert_int_equal(fread(data, 1, (size_t)file_size, f), (size_t)file_size);
+	fclose(f);
+
+	*size = (size_t)file_size;
+	return data;
+}
+
+static void round_trip_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	obs_data_t *data = obs_data_create();
+	obs_data_t *empty_obj = obs_data_create();
+	obs_data_array_t *empty_array = obs_data_array_create();
+
+	obs_data_set_string(data, "string", "h\xC3\xA9llo");
+	obs_data_set_string(data, "empty_string", "");
+	obs_data_set_int(data, "int", -1234567890123LL);
+	obs_data_set_double(data, "double", 3.0e-300);
+	obs_data_set_bool(data, "true", true);
+	obs_data_set_bool(data, "false", false);
+	obs_data_set_obj(data, "empty_obj", empty_obj);
+	obs_data_set_array(data, "empty_array", empty_array);
+	obs_data_set_default_int(data, "default_only", 5);
+
+	assert_true(obs_data_save_binary(data, TEST_BINARY_FILE));
+
+	obs_data_t *loaded = obs_data_create_from_binary_file(TEST_BINARY_FILE);
+	assert_non_null(loaded);
+
+	/* defaults are not saved, same as json */
+	assert_false(obs_data_has_user_value(loaded, "default_only"));
+	obs_data_erase(data, "default_only");
+
+	assert_true(data_equal(data, loaded));
+
+	obs_data_release(loaded);
+	obs_data_array_release(empty_array);
+	obs_data_release(empty_obj);
+	obs_data_release(data);
+	os_unlink(TEST_BINARY_FILE);
+}
+
+static void corrupt_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	obs_data_t *data = create_collection(2);
+	size_t size;
+
+	assert_true(obs_data_save_binary(data, TEST_BINARY_FILE));
+	uint8_t *binary = read_file(TEST_BINARY_FILE, &size);
+
+	/* every truncation must be rejected without reading out of bounds */
+	for (size_t i = 0; i < size; i++)
+		assert_null(obs_data_create_from_binary(binary, i));
+
+	binary[0] = 'X';
+	assert_null(obs_data_create_from_binary(binary, size));
+
+	bfree(binary);
+	obs_data_release(data);
+	os_unlink(TEST_BINARY_FILE);
+}
+
+/* a whole scene collection loads the same from both formats */
+static void collection_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	obs_data_t *collection = create_collection(TEST_SOURCES);
+
+	assert_true(obs_data_save_json(collection, TEST_JSON_FILE));
+	assert_true(obs_data_save_binary(collection, TEST_BINARY_FILE));
+
+	obs_data_t *from_json = obs_data_create_from_json_file(TEST_JSON_FILE);
+	obs_data_t *from_binary = obs_data_create_from_binary_file(TEST_BINARY_FILE);
+
+	assert_true(data_equal(collection, from_json));
+	assert_true(data_equal(collection, from_binary));
+
+	obs_data_release(from_binary);
+	obs_data_release(from_json);
+	obs_data_release(collection);
+	os_unlink(TEST_JSON_FILE);
+	os_unlink(TEST_BINARY_FILE);
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(round_trip_test),
+		cmocka_unit_test(corrupt_test),
+		cmocka_unit_test(collection_test),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
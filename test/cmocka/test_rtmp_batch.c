@@ -0,0 +1,232 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+
+#include <util/darray.h>
+#include <util/threading.h>
+
+#include "flv-mux.h"
+#include "rtmp-batch.h"
+
+/* ------------------------------------------------------------------------- */
+/* loopback connection, with a thread reading everything from the other end  */
+
+struct sink {
+	int listen_fd;
+	int fd;
+	pthread_t thread;
+
+	DARRAY(uint8_t) data;
+};
+
+static void *sink_thread(void *param)
+{
+	struct sink *sink = param;
+	uint8_t buf[65536];
+	ssize_t size;
+
+	while ((size = recv(sink->fd, buf, sizeof(buf), 0)) > 0)
+		da_push_back_array(sink->data, buf, (size_t)size);
+
+	return NULL;
+}
+
+static int sink_connect(struct sink *sink)
+{
+	struct sockaddr_in addr = {0};
+	socklen_t len = sizeof(addr);
+	int fd;
+
+	memset(sink, 0, sizeof(*sink));
+
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+	sink->listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+	assert_true(sink->listen_fd >= 0);
+	assert_int_equal(bind(sink->listen_fd, (struct sockaddr *)&addr, sizeof(addr)), 0);
+	assert_int_equal(listen(sink->listen_fd, 1), 0);
+	assert_int_equal(getsockname(sink->listen_fd, (struct sockaddr *)&addr, &len), 0);
+
+	fd = socket(AF_INET, SOCK_STREAM, 0);
+	assert_int_equal(connect(fd, (struct sockaddr *)&addr, sizeof(addr)), 0);
+
+	sink->fd = accept(sink->listen_fd, NULL, NULL);
+	assert_true(sink->fd >= 0);
+	assert_int_equal(pthread_create(&sink->thread, NULL, sink_thread, sink), 0);
+	return fd;
+}
+
+static void sink_finish(struct sink *sink)
+{
+	pthread_join(sink->thread, NULL);
+	close(sink->fd);
+	close(sink->listen_fd);
+}
+
+/* a connection that is past the handshake, as far as sending goes */
+static void fake_connect(RTMP *rtmp, int fd)
+{
+	RTMP_Init(rtmp);
+	rtmp->m_sb.sb_socket = fd;
+	rtmp->m_outChunkSize = 4096;
+	rtmp->Link.streams[0].id = 1;
+	rtmp->Link.nStreams = 1;
+}
+
+static void fake_close(RTMP *rtmp)
+{
+	shutdown(rtmp->m_sb.sb_socket, SHUT_WR);
+	close(rtmp->m_sb.sb_socket);
+	rtmp->m_sb.sb_socket = -1;
+	RTMP_Close(rtmp);
+}
+
+/* ------------------------------------------------------------------------- */
+/* packets                                                                   */
+
+enum packet_kind {
+	KIND_LEGACY,   /* H.264 track 0, or audio track 0 */
+	KIND_VIDEO_EX, /* any other video track, H.264 here as well */
+	KIND_AUDIO_EX, /* any other audio track */
+};
+
+struct test_packet {
+	struct encoder_packet packet;
+	enum packet_kind kind;
+};
+
+/* same layout as the packets libobs hands out, with a reference count in
+ * front of the data */
+static void make_packet(struct test_packet *tp, enum obs_encoder_type type, size_t track, int64_t dts, size_t size,
+			long refs)
+{
+	long *data = bmalloc(sizeof(long) + size);
+	uint8_t *bytes = (uint8_t *)(data + 1);
+
+	*data = refs;
+	for (size_t i = 0; i < size; i++)
+		bytes[i] = (uint8_t)(i * 7 + (size_t)dts);
+
+	memset(tp, 0, sizeof(*tp));
+	tp->packet.type = type;
+	tp->packet.track_idx = track;
+	tp->packet.data = bytes;
+	tp->packet.size = size;
+	tp->packet.timebase_num = 1;
+	tp->packet.timebase_den = 1000;
+	tp->packet.dts = dts;
+	tp->packet.pts = type == OBS_ENCODER_VIDEO && dts % 3 ? dts + 33 : dts;
+	tp->packet.keyframe = type == OBS_ENCODER_VIDEO && dts % 1000 == 0;
+
+	if (type == OBS_ENCODER_VIDEO)
+		tp->kind = track == 0 ? KIND_LEGACY : KIND_VIDEO_EX;
+	else
+		tp->kind = track == 0 ? KIND_LEGACY : KIND_AUDIO_EX;
+}
+
+/* both take over a reference, but leave tp alone */
+static void write_old(RTMP *rtmp, struct test_packet *tp)
+{
+	struct encoder_packet copy = tp->packet;
+	struct encoder_packet *packet = &copy;
+	uint8_t *data;
+	size_t size;
+
+	if (tp->kind == KIND_VIDEO_EX)
+		flv_packet_frames(packet, CODEC_H264, 0, &data, &size, packet->track_idx);
+	else if (tp->kind == KIND_AUDIO_EX)
+		flv_packet_audio_frames(packet, AUDIO_CODEC_AAC, 0, &data, &size, packet->track_idx);
+	else
+		flv_packet_mux(packet, 0, &data, &size, false);
+
+	/* nothing at all for packets without data */
+	if (size)
+		assert_true(RTMP_Write(rtmp, (char *)data, (int)size, 0) > 0);
+	bfree(data);
+	obs_encoder_packet_release(packet);
+}
+
+static void add_new(struct rtmp_batch *batch, struct test_packet *tp)
+{
+	struct encoder_packet copy = tp->packet;
+	struct encoder_packet *packet = &copy;
+	struct serializer *s = rtmp_batch_tag(batch);
+
+	if (tp->kind == KIND_VIDEO_EX)
+		flv_packet_frames_header(s, packet, CODEC_H264, 0, packet->track_idx);
+	else if (tp->kind == KIND_AUDIO_EX)
+		flv_packet_audio_frames_header(s, packet, AUDIO_CODEC_AAC, 0, packet->track_idx);
+	else
+		flv_packet_mux_header(s, packet, 0);
+
+	assert_true(rtmp_batch_add(batch, packet));
+}
+
+/* ------------------------------------------------------------------------- */
+
+/* The batch has to put exactly the same bytes on the wire as RTMP_Write(),
+ * including chunking, header compression and extended timestamps */
+static void same_bytes_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	static const size_t sizes[] = {0, 1, 4085, 4086, 4096, 4097, 8192, 100000, 300};
+	const size_t num_sizes = sizeof(sizes) / sizeof(sizes[0]);
+	struct test_packet packets[400];
+	struct sink old_sink, new_sink;
+	struct rtmp_batch batch;
+	RTMP old_rtmp, new_rtmp;
+
+	for (size_t i = 0; i < 400; i++) {
+		enum obs_encoder_type type = i % 3 == 2 ? OBS_ENCODER_AUDIO : OBS_ENCODER_VIDEO;
+		size_t track = (i / 5) % 2;
+
+		/* the last ones are past 0xffffff ms */
+		int64_t dts = i < 300 ? (int64_t)(i / 2) * 16 : 0x1000000 + (int64_t)i * 16;
+
+		make_packet(&packets[i], type, track, dts, sizes[i % num_sizes], 2);
+	}
+
+	fake_connect(&old_rtmp, sink_connect(&old_sink));
+	fake_connect(&new_rtmp, sink_connect(&new_sink));
+	assert_true(rtmp_batch_init(&batch, &new_rtmp, true));
+
+	for (size_t i = 0; i < 400; i++)
+		write_old(&old_rtmp, &packets[i]);
+
+	/* batches of varying size */
+	for (size_t i = 0, n = 1; i < 400; n = n % 13 + 1) {
+		for (size_t j = 0; j < n && i < 400; j++)
+			add_new(&batch, &packets[i++]);
+		assert_true(rtmp_batch_send(&batch) >= 0);
+	}
+
+	fake_close(&old_rtmp);
+	fake_close(&new_rtmp);
+	sink_finish(&old_sink);
+	sink_finish(&new_sink);
+	rtmp_batch_free(&batch);
+
+	assert_true(old_sink.data.num > 1000000);
+	assert_int_equal(new_sink.data.num, old_sink.data.num);
+	assert_memory_equal(new_sink.data.array, old_sink.data.array, old_sink.data.num);
+
+	da_free(old_sink.data);
+	da_free(new_sink.data);
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(same_bytes_test),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
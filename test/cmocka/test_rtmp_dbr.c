@@ -0,0 +1,85 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include "rtmp-dbr-sim.h"
+
+/* A 6 Mbps stream over a 10 Mbps link is never held back */
+static void constant_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	struct dbr_result res;
+
+	dbr_sim_run(&dbr_sim_constant, true, &res);
+
+	assert_int_equal(res.final_bitrate, 6000);
+	assert_true(res.bitrate_changes <= 2);
+	assert_true(res.throughput_mbps > 5.9);
+	assert_true(res.p95_latency_ms < 150.0);
+	assert_int_equal(res.late_frames, 0);
+}
+
+/* The link drops to 3 Mbps for 20 seconds.  With the bitrate fixed, the
+ * stream falls behind by many seconds.  The estimator has to get below the
+ * new rate quickly, without overshooting far, and go back up afterwards. */
+static void step_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	struct dbr_result fixed, res;
+
+	dbr_sim_run(&dbr_sim_step, false, &fixed);
+	dbr_sim_run(&dbr_sim_step, true, &res);
+
+	assert_true(res.min_bitrate < 3000);
+	assert_true(res.min_bitrate > 1500);
+	assert_true(res.final_bitrate >= 5000);
+	assert_true(res.p95_latency_ms < 500.0);
+	assert_true(res.late_frames < res.frames / 50);
+	assert_true(res.late_frames < fixed.late_frames);
+	assert_true(res.bitrate_changes < 60);
+}
+
+/* The same, estimated only from how long sends block, like on Windows, where
+ * the send buffer is small enough for sends to block */
+static void step_no_tcp_info_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	struct dbr_result res;
+
+	dbr_sim_run(&dbr_sim_step_no_tcp_info, true, &res);
+
+	assert_true(res.min_bitrate < 3000);
+	assert_true(res.late_frames < res.frames / 10);
+}
+
+/* 1% random loss keeps the congestion window small, so TCP delivers well
+ * below the link rate and the stream has to settle at that */
+static void loss_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	struct dbr_result fixed, res;
+
+	dbr_sim_run(&dbr_sim_loss, false, &fixed);
+	dbr_sim_run(&dbr_sim_loss, true, &res);
+
+	assert_true(res.p95_latency_ms < 1000.0);
+	assert_true(res.late_frames < res.frames / 20);
+	assert_true(res.late_frames <= fixed.late_frames);
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(constant_test),
+		cmocka_unit_test(step_test),
+		cmocka_unit_test(step_no_tcp_info_test),
+		cmocka_unit_test(loss_test),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
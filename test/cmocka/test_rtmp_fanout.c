@@ -0,0 +1,297 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <stdio.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+
+#include <obs-nal.h>
+#include <util/platform.h>
+#include <util/threading.h>
+
+#include "rtmp-fanout.h"
+
+/* ------------------------------------------------------------------------- */
+/* loopback servers, which can hold off reading until they are resumed      */
+
+struct sink {
+	int listen_fd;
+	int fd;
+	pthread_t thread;
+
+	os_event_t *resume;
+	uint64_t bytes;
+};
+
+static void *sink_thread(void *param)
+{
+	struct sink *sink = param;
+	uint8_t buf[4096];
+	ssize_t size;
+
+	if (sink->resume)
+		os_event_wait(sink->resume);
+
+	while ((size = recv(sink->fd, buf, sizeof(buf), 0)) > 0)
+		sink->bytes += (uint64_t)size;
+
+	return NULL;
+}
+
+static int sink_connect(struct sink *sink, os_event_t *resume)
+{
+	struct sockaddr_in addr = {0};
+	socklen_t len = sizeof(addr);
+	int bufsize = 16 * 1024;
+	int fd;
+
+	memset(sink, 0, sizeof(*sink));
+	sink->resume = resume;
+
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+	/* small buffers on both ends, so a stalled sink fills up quickly */
+	sink->listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+	assert_true(sink->listen_fd >= 0);
+	if (resume)
+		setsockopt(sink->listen_fd, SOL_SOCKET, SO_RCVBUF, &bufsize, sizeof(bufsize));
+	assert_int_equal(bind(sink->listen_fd, (struct sockaddr *)&addr, sizeof(addr)), 0);
+	assert_int_equal(listen(sink->listen_fd, 1), 0);
+	assert_int_equal(getsockname(sink->listen_fd, (struct sockaddr *)&addr, &len), 0);
+
+	fd = socket(AF_INET, SOCK_STREAM, 0);
+	if (resume)
+		setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &bufsize, sizeof(bufsize));
+	assert_int_equal(connect(fd, (struct sockaddr *)&addr, sizeof(addr)), 0);
+
+	sink->fd = accept(sink->listen_fd, NULL, NULL);
+	assert_true(sink->fd >= 0);
+	assert_int_equal(pthread_create(&sink->thread, NULL, sink_thread, sink), 0);
+	return fd;
+}
+
+static void sink_finish(struct sink *sink)
+{
+	pthread_join(sink->thread, NULL);
+	close(sink->fd);
+	close(sink->listen_fd);
+}
+
+/* a connection that is past the handshake, as far as sending goes */
+static RTMP *fake_connect(int fd)
+{
+	RTMP *rtmp = RTMP_Alloc();
+
+	RTMP_Init(rtmp);
+	rtmp->m_sb.sb_socket = fd;
+	rtmp->m_outChunkSize = 4096;
+	rtmp->Link.streams[0].id = 1;
+	rtmp->Link.nStreams = 1;
+	return rtmp;
+}
+
+/* ------------------------------------------------------------------------- */
+
+/* Pushes four seconds of a 60 FPS, 7.5 Mbps stream as fast as the two
+ * reading servers take it, while the third doesn't read at all.  Lag is
+ * measured on the packet timestamps, so this doesn't depend on how fast the
+ * machine is: the stalled one falls seconds behind and has to drop frames
+ * once it reads again, without the other two noticing. */
+
+#define TEST_SECONDS 4
+#define TEST_FPS 60
+#define TEST_DESTS 3
+#define STALLED_DEST 2
+
+/* how long to wait for the loop thread before giving up */
+#define TIMEOUT_MS 10000
+
+static os_event_t *stopped_event;
+static volatile bool stopped_failed;
+
+static void stopped(void *param, bool failed)
+{
+	UNUSED_PARAMETER(param);
+
+	stopped_failed = failed;
+	os_event_signal(stopped_event);
+}
+
+/* same layout as the packets libobs hands out, with a reference count in
+ * front of the data */
+static void make_packet(struct encoder_packet *packet, enum obs_encoder_type type, uint64_t frame, size_t size,
+			int64_t sys_dts_usec)
+{
+	long *data = bzalloc(sizeof(long) + size);
+	int64_t dts = (int64_t)frame * 1000 / TEST_FPS;
+
+	*data = 1;
+
+	memset(packet, 0, sizeof(*packet));
+	packet->type = type;
+	packet->data = (uint8_t *)(data + 1);
+	packet->size = size;
+	packet->timebase_num = 1;
+	packet->timebase_den = 1000;
+	packet->dts = dts;
+	packet->pts = dts;
+	packet->dts_usec = dts * 1000;
+	packet->sys_dts_usec = sys_dts_usec;
+
+	if (type == OBS_ENCODER_VIDEO) {
+		packet->keyframe = frame % (2 * TEST_FPS) == 0;
+		if (packet->keyframe)
+			packet->priority = OBS_NAL_PRIORITY_HIGHEST;
+		else if (frame % 2 == 0)
+			packet->priority = OBS_NAL_PRIORITY_HIGH;
+		else
+			packet->priority = OBS_NAL_PRIORITY_DISPOSABLE;
+		packet->drop_priority = packet->priority;
+	}
+}
+
+static void print_stats(struct rtmp_fanout *fanout)
+{
+	for (size_t i = 0; i < TEST_DESTS; i++) {
+		struct rtmp_fanout_stats stats;
+		rtmp_fanout_get_stats(fanout, i, &stats);
+		printf("  %-10s %4d frames dropped, %8.1f KiB sent\n", stats.name, stats.dropped_frames,
+		       (double)stats.total_bytes / 1024.0);
+	}
+}
+
+/* waits until the reading servers were sent everything pushed so far */
+static void wait_fast_dests(struct rtmp_fanout *fanout, uint64_t pushed)
+{
+	for (int ms = 0; ms < TIMEOUT_MS; ms++) {
+		struct rtmp_fanout_stats stats[2];
+
+		rtmp_fanout_get_stats(fanout, 0, &stats[0]);
+		rtmp_fanout_get_stats(fanout, 1, &stats[1]);
+		if (stats[0].packets >= pushed && stats[1].packets >= pushed)
+			return;
+
+		os_sleep_ms(1);
+	}
+
+	fail_msg("timed out waiting for the fast destinations");
+}
+
+static void lag_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	struct rtmp_fanout_info info = {0};
+	struct rtmp_fanout_stats stats[TEST_DESTS];
+	struct sink sinks[TEST_DESTS];
+	struct rtmp_fanout *fanout;
+	os_event_t *resume;
+	uint8_t headers[15] = {0};
+	uint64_t payload = 0;
+	uint64_t pushed = 0;
+	uint64_t start;
+	uint64_t stop;
+
+	assert_int_equal(os_event_init(&stopped_event, OS_EVENT_TYPE_MANUAL), 0);
+	assert_int_equal(os_event_init(&resume, OS_EVENT_TYPE_MANUAL), 0);
+
+	info.drop_threshold_usec = 700000;
+	info.pframe_drop_threshold_usec = 900000;
+	info.max_shutdown_time_ns = TIMEOUT_MS * 1000000ULL;
+	info.video_codec[0] = CODEC_H264;
+	info.audio_codec[0] = AUDIO_CODEC_AAC;
+	info.stopped = stopped;
+
+	fanout = rtmp_fanout_create(&info);
+	assert_non_null(fanout);
+
+	for (size_t i = 0; i < TEST_DESTS; i++) {
+		const char *name = i == STALLED_DEST ? "stalled" : "reading";
+		os_event_t *event = i == STALLED_DEST ? resume : NULL;
+
+		assert_true(rtmp_fanout_add(fanout, name, fake_connect(sink_connect(&sinks[i], event))));
+	}
+
+	assert_true(rtmp_fanout_start(fanout));
+
+	/* an empty FLV script tag */
+	headers[0] = 18;
+	headers[14] = 11;
+	rtmp_fanout_set_headers(fanout, headers, sizeof(headers));
+
+	start = os_gettime_ns();
+	stop = start + TEST_SECONDS * 1000000000ULL;
+
+	for (uint64_t frame = 0; frame < TEST_SECONDS * TEST_FPS; frame++) {
+		uint64_t ts = start + frame * 1000000000ULL / TEST_FPS;
+		struct encoder_packet packet;
+
+		/* about 7.5 Mbps, with a keyframe five times the size */
+		make_packet(&packet, OBS_ENCODER_VIDEO, frame, frame % (2 * TEST_FPS) ? 15600 : 78000,
+			    (int64_t)(ts / 1000));
+		payload += packet.size;
+		rtmp_fanout_push(fanout, &packet);
+
+		make_packet(&packet, OBS_ENCODER_AUDIO, frame, 400, (int64_t)(ts / 1000));
+		payload += packet.size;
+		rtmp_fanout_push(fanout, &packet);
+
+		pushed += 2;
+		wait_fast_dests(fanout, pushed);
+	}
+
+	printf("pushed:\n");
+	print_stats(fanout);
+
+	/* stop at the last frame, like the output does, then let the stalled
+	 * one catch up to the audio packet past it */
+	rtmp_fanout_stop(fanout, stop);
+
+	struct encoder_packet packet;
+	make_packet(&packet, OBS_ENCODER_AUDIO, TEST_SECONDS * TEST_FPS, 400, (int64_t)(stop / 1000));
+	rtmp_fanout_push(fanout, &packet);
+
+	os_event_signal(resume);
+	assert_int_equal(os_event_timedwait(stopped_event, TIMEOUT_MS), 0);
+
+	printf("stopped:\n");
+	print_stats(fanout);
+
+	for (size_t i = 0; i < TEST_DESTS; i++)
+		rtmp_fanout_get_stats(fanout, i, &stats[i]);
+
+	rtmp_fanout_destroy(fanout);
+
+	for (size_t i = 0; i < TEST_DESTS; i++) {
+		sink_finish(&sinks[i]);
+		assert_true(sinks[i].bytes >= stats[i].total_bytes);
+	}
+
+	/* the reading ones get everything */
+	assert_int_equal(stats[0].dropped_frames, 0);
+	assert_int_equal(stats[1].dropped_frames, 0);
+	assert_true(sinks[0].bytes > payload);
+	assert_true(sinks[1].bytes > payload);
+
+	/* the stalled one drops frames, but still gets the audio and keyframes */
+	assert_true(stats[STALLED_DEST].dropped_frames > 0);
+	assert_true(sinks[STALLED_DEST].bytes > 0);
+
+	assert_false(stopped_failed);
+	os_event_destroy(resume);
+	os_event_destroy(stopped_event);
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(lag_test),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
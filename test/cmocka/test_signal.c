@@ -0,0 +1,190 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <callback/signal.h>
+#include <util/platform.h>
+#include <util/threading.h>
+
+#define STRESS_ITERATIONS 2000
+
+struct counter {
+	signal_handler_t *handler;
+	int calls;
+	int global_calls;
+	bool remove_self;
+	bool disconnect_next;
+	struct counter *next;
+};
+
+static void count_callback(void *data, calldata_t *params)
+{
+	struct counter *counter = data;
+	UNUSED_PARAMETER(params);
+
+	counter->calls++;
+
+	if (counter->remove_self)
+		signal_handler_remove_current();
+	if (counter->disconnect_next)
+		signal_handler_disconnect(counter->handler, "test", count_callback, counter->next);
+}
+
+static void count_global_callback(void *data, const char *signal, calldata_t *params)
+{
+	struct counter *counter = data;
+	UNUSED_PARAMETER(params);
+
+	assert_string_equal(signal, "test");
+	counter->global_calls++;
+}
+
+static void basic_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	signal_handler_t *handler = signal_handler_create();
+	struct counter a = {handler}, b = {handler};
+	calldata_t params = {0};
+
+	assert_true(signal_handler_add(handler, "void test(int value)"));
+	assert_false(signal_handler_add(handler, "void test(int value)"));
+
+	signal_t *test = signal_handler_get_signal(handler, "test");
+	assert_non_null(test);
+	assert_null(signal_handler_get_signal(handler, "missing"));
+
+	signal_handler_connect(handler, "test", count_callback, &a);
+	signal_handler_connect(handler, "test", count_callback, &a);
+	signal_handler_connect(handler, "test", count_callback, &b);
+	signal_handler_connect_global(handler, count_global_callback, &a);
+
+	signal_handler_signal(handler, "test", &params);
+	signal_handler_emit(handler, test, &params);
+	signal_handler_signal(handler, "missing", &params);
+	assert_int_equal(a.calls, 2);
+	assert_int_equal(b.calls, 2);
+	assert_int_equal(a.global_calls, 2);
+
+	/* a callback that disconnects one later in the list stops it from
+	 * being called in the same emission */
+	a.disconnect_next = true;
+	a.next = &b;
+	signal_handler_emit(handler, test, &params);
+	assert_int_equal(a.calls, 3);
+	assert_int_equal(b.calls, 2);
+	a.disconnect_next = false;
+
+	/* removes itself once, but stays connected until the emission ends */
+	a.remove_self = true;
+	signal_handler_emit(handler, test, &params);
+	a.remove_self = false;
+	signal_handler_emit(handler, test, &params);
+	assert_int_equal(a.calls, 4);
+
+	signal_handler_disconnect_global(handler, count_global_callback, &a);
+	signal_handler_connect(handler, "test", count_callback, &b);
+	signal_handler_emit(handler, test, &params);
+	assert_int_equal(a.global_calls, 5);
+	assert_int_equal(b.calls, 3);
+
+	signal_handler_disconnect(handler, "test", count_callback, &b);
+	signal_handler_emit(handler, test, &params);
+	assert_int_equal(b.calls, 3);
+
+	calldata_free(&params);
+	signal_handler_destroy(handler);
+}
+
+/* ------------------------------------------------------------------------- */
+
+/* Emits from two threads while the main thread keeps connecting and
+ * disconnecting.  Once signal_handler_disconnect has returned, the callback
+ * must not be running anymore or be called again, so the data it uses can be
+ * freed straight away. */
+
+struct stress_data {
+	signal_handler_t *handler;
+	signal_t *signal;
+	volatile bool stop;
+	volatile long emitted;
+};
+
+struct stress_callback {
+	volatile bool alive;
+	volatile long calls;
+};
+
+static void stress_callback(void *data, calldata_t *params)
+{
+	struct stress_callback *cb = data;
+	UNUSED_PARAMETER(params);
+
+	if (!os_atomic_load_bool(&cb->alive))
+		fail_msg("callback called after it was disconnected");
+
+	os_atomic_inc_long(&cb->calls);
+}
+
+static void *stress_emitter(void *param)
+{
+	struct stress_data *data = param;
+	calldata_t params = {0};
+
+	while (!os_atomic_load_bool(&data->stop)) {
+		signal_handler_emit(data->handler, data->signal, &params);
+		os_atomic_inc_long(&data->emitted);
+	}
+
+	calldata_free(&params);
+	return NULL;
+}
+
+static void stress_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	struct stress_data data = {0};
+	struct stress_callback always = {true};
+	pthread_t threads[2];
+
+	data.handler = signal_handler_create();
+	assert_true(signal_handler_add(data.handler, "void test()"));
+	data.signal = signal_handler_get_signal(data.handler, "test");
+
+	signal_handler_connect(data.handler, "test", stress_callback, &always);
+
+	for (size_t i = 0; i < 2; i++)
+		assert_int_equal(pthread_create(&threads[i], NULL, stress_emitter, &data), 0);
+
+	for (size_t i = 0; i < STRESS_ITERATIONS; i++) {
+		struct stress_callback *cb = bzalloc(sizeof(struct stress_callback));
+		cb->alive = true;
+
+		signal_handler_connect(data.handler, "test", stress_callback, cb);
+		if (i % 16 == 0)
+			os_sleep_ms(0);
+		signal_handler_disconnect(data.handler, "test", stress_callback, cb);
+
+		os_atomic_set_bool(&cb->alive, false);
+		bfree(cb);
+	}
+
+	os_atomic_set_bool(&data.stop, true);
+	for (size_t i = 0; i < 2; i++)
+		pthread_join(threads[i], NULL);
+
+	assert_int_equal(os_atomic_load_long(&always.calls), os_atomic_load_long(&data.emitted));
+	signal_handler_destroy(data.handler);
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(basic_test),
+		cmocka_unit_test(stress_test),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
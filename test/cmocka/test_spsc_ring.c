@@ -0,0 +1,143 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <util/spsc-ring.h>
+#include <util/deque.h>
+#include <util/platform.h>
+#include <util/threading.h>
+
+#define STRESS_FLOATS (4 * 1024 * 1024)
+
+static void basic_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	struct spsc_ring ring;
+	float in[6] = {1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f};
+	float out[6] = {0};
+
+	assert_false(spsc_ring_init(&ring, 0));
+	assert_true(spsc_ring_init(&ring, 5 * sizeof(float)));
+	assert_int_equal(ring.capacity, 8 * sizeof(float));
+	assert_int_equal(spsc_ring_size(&ring), 0);
+
+	assert_false(spsc_ring_pop_front(&ring, out, sizeof(float)));
+
+	assert_true(spsc_ring_push_back(&ring, in, sizeof(in)));
+	assert_int_equal(spsc_ring_size(&ring), sizeof(in));
+	assert_int_equal(spsc_ring_free_space(&ring), 2 * sizeof(float));
+
+	/* doesn't fit, nothing is written */
+	assert_false(spsc_ring_push_back(&ring, in, 3 * sizeof(float)));
+	assert_int_equal(spsc_ring_size(&ring), sizeof(in));
+
+	assert_true(spsc_ring_peek_front(&ring, out, 2 * sizeof(float)));
+	assert_memory_equal(out, in, 2 * sizeof(float));
+	assert_int_equal(spsc_ring_size(&ring), sizeof(in));
+
+	assert_true(spsc_ring_pop_front(&ring, out, 4 * sizeof(float)));
+	assert_memory_equal(out, in, 4 * sizeof(float));
+
+	/* wraps around the end of the buffer */
+	assert_true(spsc_ring_push_back(&ring, in, sizeof(in)));
+	assert_int_equal(spsc_ring_size(&ring), 8 * sizeof(float));
+	assert_int_equal(spsc_ring_free_space(&ring), 0);
+
+	assert_true(spsc_ring_pop_front(&ring, NULL, 2 * sizeof(float)));
+	assert_true(spsc_ring_pop_front(&ring, out, sizeof(in)));
+	assert_memory_equal(out, in, sizeof(in));
+	assert_int_equal(spsc_ring_size(&ring), 0);
+
+	assert_true(spsc_ring_push_back_zero(&ring, 3 * sizeof(float)));
+	assert_true(spsc_ring_pop_front(&ring, out, 3 * sizeof(float)));
+	assert_true(out[0] == 0.0f && out[1] == 0.0f && out[2] == 0.0f);
+
+	spsc_ring_free(&ring);
+}
+
+/* ------------------------------------------------------------------------- */
+
+struct stress_data {
+	struct spsc_ring ring;
+	size_t total;
+};
+
+static void *stress_producer(void *param)
+{
+	struct stress_data *data = param;
+	float chunk[777];
+	size_t sent = 0;
+	size_t size = 1;
+
+	while (sent < data->total) {
+		if (size > data->total - sent)
+			size = data->total - sent;
+
+		for (size_t i = 0; i < size; i++)
+			chunk[i] = (float)((sent + i) & 0xFFFFFF);
+
+		if (!spsc_ring_push_back(&data->ring, chunk, size * sizeof(float))) {
+			os_sleep_ms(0);
+			continue;
+		}
+
+		sent += size;
+		size = size % 777 + 1;
+	}
+
+	return NULL;
+}
+
+static void stress_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	struct stress_data data = {0};
+	float chunk[1024];
+	size_t received = 0;
+	size_t size = 1;
+	pthread_t thread;
+
+	/* a small ring so that both the full and the empty case are hit
+	 * constantly, with chunk sizes that wrap at every possible offset */
+	assert_true(spsc_ring_init(&data.ring, 2048 * sizeof(float)));
+	data.total = STRESS_FLOATS;
+
+	assert_int_equal(pthread_create(&thread, NULL, stress_producer, &data), 0);
+
+	while (received < data.total) {
+		if (size > data.total - received)
+			size = data.total - received;
+
+		if (!spsc_ring_pop_front(&data.ring, chunk, size * sizeof(float))) {
+			os_sleep_ms(0);
+			continue;
+		}
+
+		for (size_t i = 0; i < size; i++) {
+			if (chunk[i] != (float)((received + i) & 0xFFFFFF)) {
+				fail_msg("sample %zu has the wrong value", received + i);
+			}
+		}
+
+		received += size;
+		size = size % 1024 + 1;
+	}
+
+	pthread_join(thread, NULL);
+
+	assert_int_equal(spsc_ring_size(&data.ring), 0);
+	spsc_ring_free(&data.ring);
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(basic_test),
+		cmocka_unit_test(stress_test),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}